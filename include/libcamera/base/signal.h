@@ -22,6 +22,8 @@ class SignalBase
 public:
 	void disconnect(Object *object);
 
+	bool connected();
+
 protected:
 	using SlotList = std::list<BoundMethodBase *>;
 
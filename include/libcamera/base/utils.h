@@ -9,6 +9,7 @@
 
 #include <algorithm>
 #include <chrono>
+#include <functional>
 #include <iterator>
 #include <memory>
 #include <ostream>
@@ -369,6 +370,9 @@ decltype(auto) abs_diff(const T &a, const T &b)
 
 double strtod(const char *__restrict nptr, char **__restrict endptr);
 
+void parallelFor(unsigned int count, const std::function<void(unsigned int)> &func,
+		 unsigned int maxThreads = 0);
+
 } /* namespace utils */
 
 #ifndef __DOXYGEN__
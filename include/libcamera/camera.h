@@ -11,11 +11,13 @@
 #include <set>
 #include <stdint.h>
 #include <string>
+#include <vector>
 
 #include <libcamera/base/class.h>
 #include <libcamera/base/flags.h>
 #include <libcamera/base/object.h>
 #include <libcamera/base/signal.h>
+#include <libcamera/base/span.h>
 
 #include <libcamera/controls.h>
 #include <libcamera/request.h>
@@ -96,6 +98,7 @@ public:
 
 	Signal<Request *, FrameBuffer *> bufferCompleted;
 	Signal<Request *> requestCompleted;
+	Signal<std::shared_ptr<const std::vector<Request *>>> requestsCompleted;
 	Signal<> disconnected;
 
 	int acquire();
@@ -110,6 +113,7 @@ public:
 
 	std::unique_ptr<Request> createRequest(uint64_t cookie = 0);
 	int queueRequest(Request *request);
+	int queueRequests(Span<Request *const> requests);
 
 	int start(const ControlList *controls = nullptr);
 	int stop();
@@ -124,6 +128,7 @@ private:
 	friend class PipelineHandler;
 	void disconnect();
 	void requestComplete(Request *request);
+	void requestsComplete(std::shared_ptr<const std::vector<Request *>> requests);
 
 	friend class FrameBufferAllocator;
 	int exportFrameBuffers(Stream *stream,
@@ -0,0 +1,71 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+/*
+ * Copyright (C) 2022, Google Inc.
+ *
+ * buffer_pool.h - Recycling pool of dma-heap frame buffers
+ */
+
+#pragma once
+
+#include <map>
+#include <memory>
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#include <libcamera/base/class.h>
+#include <libcamera/base/mutex.h>
+#include <libcamera/base/unique_fd.h>
+
+#include "libcamera/internal/dma_heaps.h"
+
+namespace libcamera {
+
+class FrameBuffer;
+struct StreamConfiguration;
+
+class BufferPool : public std::enable_shared_from_this<BufferPool>
+{
+public:
+	struct Statistics {
+		uint64_t hits;
+		uint64_t misses;
+		uint64_t evictions;
+		unsigned int idle;
+		size_t idleSize;
+	};
+
+	BufferPool(DmaHeap::DmaHeapFlags type);
+	~BufferPool();
+
+	bool isValid() const { return heap_.isValid(); }
+
+	int allocate(const StreamConfiguration &config,
+		     std::vector<std::unique_ptr<FrameBuffer>> *buffers);
+
+	void setMaxIdleSize(size_t size);
+	void trim(size_t maxIdleSize = 0);
+
+	Statistics statistics() const;
+
+	static size_t sizeClass(size_t size);
+
+private:
+	LIBCAMERA_DISABLE_COPY_AND_MOVE(BufferPool)
+
+	class Buffer;
+
+	UniqueFD acquire(size_t *size);
+	void release(UniqueFD fd, size_t size);
+	void trimLocked(size_t maxIdleSize)
+		LIBCAMERA_TSA_REQUIRES(mutex_);
+
+	DmaHeap heap_;
+
+	mutable Mutex mutex_;
+	std::map<size_t, std::vector<UniqueFD>> idle_ LIBCAMERA_TSA_GUARDED_BY(mutex_);
+	size_t maxIdleSize_ LIBCAMERA_TSA_GUARDED_BY(mutex_);
+	Statistics stats_ LIBCAMERA_TSA_GUARDED_BY(mutex_);
+};
+
+} /* namespace libcamera */
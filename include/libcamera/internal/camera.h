@@ -12,14 +12,19 @@
 #include <memory>
 #include <set>
 #include <string>
+#include <vector>
 
 #include <libcamera/base/class.h>
 
 #include <libcamera/camera.h>
 
+#include "libcamera/internal/dma_heaps.h"
+
 namespace libcamera {
 
+class BufferPool;
 class CameraControlValidator;
+class FenceWaiter;
 class PipelineHandler;
 class Stream;
 
@@ -38,9 +43,14 @@ public:
 	ControlList properties_;
 
 	uint32_t requestSequence_;
+	std::shared_ptr<std::vector<Request *>> completedRequests_;
+	std::shared_ptr<std::vector<Request *>> completedBatch_;
 
 	const CameraControlValidator *validator() const { return validator_.get(); }
 
+	FenceWaiter *fenceWaiter();
+	BufferPool *bufferPool(DmaHeap::DmaHeapFlags heaps);
+
 private:
 	enum State {
 		CameraAvailable,
@@ -52,6 +62,7 @@ private:
 
 	bool isAcquired() const;
 	bool isRunning() const;
+	int validateRequest(const Request *request) const;
 	int isAccessAllowed(State state, bool allowDisconnected = false,
 			    const char *from = __builtin_FUNCTION()) const;
 	int isAccessAllowed(State low, State high,
@@ -70,6 +81,9 @@ private:
 	std::atomic<State> state_;
 
 	std::unique_ptr<CameraControlValidator> validator_;
+	std::unique_ptr<FenceWaiter> fenceWaiter_;
+	std::shared_ptr<BufferPool> bufferPool_;
+	DmaHeap::DmaHeapFlags bufferPoolHeaps_;
 };
 
 } /* namespace libcamera */
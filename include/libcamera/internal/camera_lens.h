@@ -30,6 +30,8 @@ public:
 
 	const std::string &model() const { return model_; }
 
+	V4L2Subdevice *device() { return subdev_.get(); }
+
 	const ControlInfoMap &controls() const;
 
 protected:
@@ -7,12 +7,16 @@
 
 #pragma once
 
+#include <map>
 #include <memory>
 #include <string>
+#include <tuple>
+#include <utility>
 #include <vector>
 
 #include <libcamera/base/class.h>
 #include <libcamera/base/log.h>
+#include <libcamera/base/mutex.h>
 
 #include <libcamera/control_ids.h>
 #include <libcamera/controls.h>
@@ -74,7 +78,39 @@ protected:
 private:
 	LIBCAMERA_DISABLE_COPY(CameraSensor)
 
+	struct Mode {
+		Size size;
+		unsigned int area;
+		float ratio;
+	};
+
+	struct ModeRange {
+		unsigned int code;
+		unsigned int begin;
+		unsigned int end;
+	};
+
+	static constexpr unsigned int kFormatCacheSize = 32;
+
+	using FormatCacheKey = std::pair<std::vector<unsigned int>, Size>;
+	using FormatCacheLookup = std::pair<const std::vector<unsigned int> &, const Size &>;
+
+	/* Compare cache keys with lookups without copying the media bus codes. */
+	struct FormatCacheCompare {
+		using is_transparent = void;
+
+		template<typename T, typename U>
+		bool operator()(const T &a, const U &b) const
+		{
+			return std::tie(a.first, a.second) < std::tie(b.first, b.second);
+		}
+	};
+
 	int generateId();
+	void initModes();
+	V4L2SubdeviceFormat findFormat(const std::vector<unsigned int> &mbusCodes,
+				       const Size &size) const;
+	V4L2Subdevice::Formats enumerateFormats();
 	int validateSensorDriver();
 	void initVimcDefaultProperties();
 	void initStaticProperties();
@@ -95,6 +131,8 @@ private:
 	V4L2Subdevice::Formats formats_;
 	std::vector<unsigned int> mbusCodes_;
 	std::vector<Size> sizes_;
+	std::vector<Mode> modes_;
+	std::vector<ModeRange> modeRanges_;
 	std::vector<controls::draft::TestPatternModeEnum> testPatternModes_;
 	controls::draft::TestPatternModeEnum testPatternMode_;
 
@@ -105,6 +143,10 @@ private:
 	ControlList properties_;
 
 	std::unique_ptr<CameraLens> focusLens_;
+
+	mutable Mutex formatCacheMutex_;
+	mutable std::map<FormatCacheKey, V4L2SubdeviceFormat, FormatCacheCompare>
+		formatCache_ LIBCAMERA_TSA_GUARDED_BY(formatCacheMutex_);
 };
 
 } /* namespace libcamera */
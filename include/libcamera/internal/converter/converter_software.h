@@ -0,0 +1,148 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+/*
+ * Copyright (C) 2022, Google Inc.
+ *
+ * converter_software.h - CPU-based Bayer format converter
+ */
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <optional>
+#include <stdint.h>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include <libcamera/base/mutex.h>
+#include <libcamera/base/object.h>
+#include <libcamera/base/signal.h>
+#include <libcamera/base/thread.h>
+
+#include <libcamera/geometry.h>
+#include <libcamera/pixel_format.h>
+
+#include "libcamera/internal/bayer_format.h"
+#include "libcamera/internal/converter.h"
+
+namespace libcamera {
+
+class BufferPool;
+class FrameBuffer;
+class MappedFrameBuffer;
+class MediaDevice;
+struct StreamConfiguration;
+
+class SoftwareConverter : public Converter, public Object
+{
+public:
+	struct Statistics {
+		static constexpr unsigned int kHistogramBins = 64;
+		static constexpr unsigned int kGridWidth = 8;
+		static constexpr unsigned int kGridHeight = 6;
+
+		struct Zone {
+			uint64_t red;
+			uint64_t green;
+			uint64_t blue;
+			uint32_t count;
+		};
+
+		void merge(const Statistics &other);
+
+		std::array<uint32_t, kHistogramBins> histogram{};
+		std::array<Zone, kGridWidth * kGridHeight> zones{};
+		uint64_t sharpness = 0;
+	};
+
+	SoftwareConverter(MediaDevice *media);
+	~SoftwareConverter();
+
+	int loadConfiguration([[maybe_unused]] const std::string &filename) { return 0; }
+	bool isValid() const { return true; }
+
+	std::vector<PixelFormat> formats(PixelFormat input);
+	SizeRange sizes(const Size &input);
+
+	std::tuple<unsigned int, unsigned int>
+	strideAndFrameSize(const PixelFormat &pixelFormat, const Size &size);
+
+	int configure(const StreamConfiguration &inputCfg,
+		      const std::vector<std::reference_wrapper<StreamConfiguration>> &outputCfgs);
+	int exportBuffers(unsigned int output, unsigned int count,
+			  std::vector<std::unique_ptr<FrameBuffer>> *buffers);
+
+	int start();
+	void stop();
+
+	int queueBuffers(FrameBuffer *input,
+			 const std::map<unsigned int, FrameBuffer *> &outputs);
+
+	void setStatisticsEnabled(bool enable) { statsEnabled_ = enable; }
+	void setColourGains(double red, double blue);
+
+	static bool isSupported(PixelFormat input);
+
+	Signal<uint32_t, const Statistics &> statisticsReady;
+
+private:
+	class Worker;
+
+	using Lut = std::array<uint8_t, 256>;
+
+	struct Output {
+		PixelFormat pixelFormat;
+		Size size;
+		std::array<unsigned int, 3> strides;
+
+		/* Input column sampled by each output column. */
+		std::vector<unsigned int> xMap;
+		/* Input row sampled by each output row. */
+		std::vector<unsigned int> yMap;
+	};
+
+	struct Frame {
+		FrameBuffer *input;
+		std::map<unsigned int, FrameBuffer *> outputs;
+
+		std::unique_ptr<MappedFrameBuffer> inputMap;
+		std::map<unsigned int, std::unique_ptr<MappedFrameBuffer>> outputMaps;
+
+		/* Red, green and blue gain tables, if gains are applied. */
+		std::optional<std::array<Lut, 3>> gains;
+		/* Statistics of each band, if enabled. */
+		std::vector<Statistics> stats;
+
+		std::atomic<unsigned int> pending;
+	};
+
+	void frameDone();
+	void completeFrame(Frame *frame);
+
+	BayerFormat inputFormat_;
+	Size inputSize_;
+	unsigned int inputStride_;
+
+	std::vector<Output> outputs_;
+
+	bool statsEnabled_;
+	std::optional<std::array<Lut, 3>> gains_;
+
+	std::shared_ptr<BufferPool> pool_;
+
+	std::vector<std::unique_ptr<Thread>> threads_;
+	std::vector<std::unique_ptr<Worker>> workers_;
+
+	std::deque<std::unique_ptr<Frame>> frames_;
+
+	Mutex mutex_;
+	ConditionVariable idle_;
+	unsigned int framesInFlight_ LIBCAMERA_TSA_GUARDED_BY(mutex_);
+};
+
+} /* namespace libcamera */
@@ -7,13 +7,20 @@
 
 #pragma once
 
+#include <array>
+#include <memory>
 #include <stdint.h>
 #include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <libcamera/base/utils.h>
 
 #include <libcamera/controls.h>
 
 namespace libcamera {
 
+class V4L2ControlTransaction;
 class V4L2Device;
 
 class DelayedControls
@@ -24,16 +31,36 @@ public:
 		bool priorityWrite;
 	};
 
+	struct Statistics {
+		uint64_t frames = 0;
+		uint64_t skipped = 0;
+		uint64_t underruns = 0;
+		uint64_t late = 0;
+		utils::Duration lastLatency{};
+		utils::Duration maxLatency{};
+		utils::Duration totalLatency{};
+	};
+
 	DelayedControls(V4L2Device *device,
-			const std::unordered_map<uint32_t, ControlParams> &controlParams);
+			const std::unordered_map<uint32_t, ControlParams> &controlParams,
+			V4L2ControlTransaction *transaction = nullptr);
+	~DelayedControls();
 
-	void reset();
+	void reset(unsigned int cookie = 0);
 
-	bool push(const ControlList &controls);
-	ControlList get(uint32_t sequence);
+	bool push(const ControlList &controls, unsigned int cookie = 0);
+	std::pair<const ControlList &, unsigned int> get(uint32_t sequence);
 
 	void applyControls(uint32_t sequence);
 
+	int enableFrameStart(V4L2Device *source);
+	void disableFrameStart();
+	bool frameStartEnabled() const { return frameStartSource_ != nullptr; }
+
+	void setLatencyLimit(utils::Duration limit) { latencyLimit_ = limit; }
+	const Statistics &statistics() const { return stats_; }
+	void resetStatistics() { stats_ = {}; }
+
 private:
 	class Info : public ControlValue
 	{
@@ -53,29 +80,45 @@ private:
 
 	/* \todo Make the listSize configurable at instance creation time. */
 	static constexpr int listSize = 16;
-	class ControlRingBuffer : public std::array<Info, listSize>
+	template<typename T>
+	class RingBuffer : public std::array<T, listSize>
 	{
 	public:
-		Info &operator[](unsigned int index)
+		T &operator[](unsigned int index)
 		{
-			return std::array<Info, listSize>::operator[](index % listSize);
+			return std::array<T, listSize>::operator[](index % listSize);
 		}
 
-		const Info &operator[](unsigned int index) const
+		const T &operator[](unsigned int index) const
 		{
-			return std::array<Info, listSize>::operator[](index % listSize);
+			return std::array<T, listSize>::operator[](index % listSize);
 		}
 	};
 
+	struct Control {
+		const ControlId *id;
+		ControlParams params;
+		RingBuffer<Info> values;
+	};
+
+	Control *findControl(unsigned int id);
+	void frameStarted(uint32_t sequence);
+
 	V4L2Device *device_;
-	/* \todo Evaluate if we should index on ControlId * or unsigned int */
-	std::unordered_map<const ControlId *, ControlParams> controlParams_;
+	std::unique_ptr<V4L2ControlTransaction> ownTransaction_;
+	V4L2ControlTransaction *transaction_;
+	std::vector<Control> controls_;
+	std::vector<uint32_t> ids_;
+	ControlList effectiveControls_;
 	unsigned int maxDelay_;
 
 	uint32_t queueCount_;
 	uint32_t writeCount_;
-	/* \todo Evaluate if we should index on ControlId * or unsigned int */
-	std::unordered_map<const ControlId *, ControlRingBuffer> values_;
+	RingBuffer<unsigned int> cookies_;
+
+	V4L2Device *frameStartSource_;
+	utils::Duration latencyLimit_;
+	Statistics stats_;
 };
 
 } /* namespace libcamera */
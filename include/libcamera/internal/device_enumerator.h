@@ -7,11 +7,13 @@
 
 #pragma once
 
+#include <chrono>
 #include <memory>
 #include <string>
 #include <vector>
 
 #include <libcamera/base/signal.h>
+#include <libcamera/base/timer.h>
 
 namespace libcamera {
 
@@ -36,6 +38,7 @@ class DeviceEnumerator
 public:
 	static std::unique_ptr<DeviceEnumerator> create();
 
+	DeviceEnumerator();
 	virtual ~DeviceEnumerator();
 
 	virtual int init() = 0;
@@ -43,15 +46,29 @@ public:
 
 	std::shared_ptr<MediaDevice> search(const DeviceMatch &dm);
 
+	void setHotplugDelay(std::chrono::milliseconds delay) { hotplugDelay_ = delay; }
+	bool hasNewDevices() const;
+	void clearNewDevices() { newDevices_.clear(); }
+
 	Signal<> devicesAdded;
 
 protected:
 	std::unique_ptr<MediaDevice> createDevice(const std::string &deviceNode);
+	std::vector<std::unique_ptr<MediaDevice>>
+	createDevices(const std::vector<std::string> &deviceNodes);
 	void addDevice(std::unique_ptr<MediaDevice> media);
 	void removeDevice(const std::string &deviceNode);
 
 private:
+	static constexpr std::chrono::milliseconds kDefaultHotplugDelay{ 100 };
+
+	void hotplugTimeout();
+
 	std::vector<std::shared_ptr<MediaDevice>> devices_;
+	std::vector<MediaDevice *> newDevices_;
+
+	std::chrono::milliseconds hotplugDelay_;
+	Timer hotplugTimer_;
 };
 
 } /* namespace libcamera */
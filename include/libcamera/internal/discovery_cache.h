@@ -0,0 +1,39 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+/*
+ * Copyright (C) 2022, Google Inc.
+ *
+ * discovery_cache.h - Persistent cache of device discovery results
+ */
+
+#pragma once
+
+#include <map>
+#include <optional>
+#include <string>
+
+namespace libcamera {
+
+class DiscoveryCache
+{
+public:
+	DiscoveryCache(const std::string &path, const std::string &signature);
+
+	static std::string directory();
+
+	const std::string &path() const { return path_; }
+
+	int load();
+	int save();
+
+	std::optional<std::string> value(const std::string &key) const;
+	void setValue(const std::string &key, const std::string &value);
+
+private:
+	std::string header() const;
+
+	std::string path_;
+	std::string signature_;
+	std::map<std::string, std::string> entries_;
+};
+
+} /* namespace libcamera */
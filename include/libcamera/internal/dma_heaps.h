@@ -0,0 +1,46 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+/*
+ * Copyright (C) 2020, Raspberry Pi Ltd
+ *
+ * dma_heaps.h - Helper class for dma-heap allocations.
+ */
+
+#pragma once
+
+#include <stddef.h>
+
+#include <libcamera/base/flags.h>
+#include <libcamera/base/unique_fd.h>
+
+namespace libcamera {
+
+class DmaHeap
+{
+public:
+	enum class DmaHeapFlag {
+		Cma = 1 << 0,
+		System = 1 << 1,
+		UDmaBuf = 1 << 2,
+		MemFd = 1 << 3,
+	};
+
+	using DmaHeapFlags = Flags<DmaHeapFlag>;
+
+	DmaHeap(DmaHeapFlags type = DmaHeapFlag::Cma);
+	~DmaHeap();
+	bool isValid() const { return !!type_; }
+	DmaHeapFlags type() const { return type_; }
+	UniqueFD alloc(const char *name, std::size_t size);
+
+private:
+	UniqueFD allocFromHeap(const char *name, std::size_t size);
+	UniqueFD allocFromUDmaBuf(const char *name, std::size_t size);
+	UniqueFD allocFromMemFd(const char *name, std::size_t size);
+
+	UniqueFD dmaHeapHandle_;
+	DmaHeapFlags type_;
+};
+
+LIBCAMERA_FLAGS_ENABLE_OPERATORS(DmaHeap::DmaHeapFlag)
+
+} /* namespace libcamera */
@@ -0,0 +1,82 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+/*
+ * Copyright (C) 2022, Google Inc.
+ *
+ * fence_waiter.h - Multiplexed wait on synchronization fences
+ */
+
+#pragma once
+
+#include <chrono>
+#include <deque>
+#include <vector>
+
+#include <libcamera/base/class.h>
+#include <libcamera/base/event_notifier.h>
+#include <libcamera/base/object.h>
+#include <libcamera/base/timer.h>
+#include <libcamera/base/unique_fd.h>
+
+namespace libcamera {
+
+class FrameBuffer;
+
+class FenceWaiter : public Object
+{
+public:
+	class Listener
+	{
+	public:
+		virtual ~Listener() = default;
+
+		virtual void fenceSignalled(FrameBuffer *buffer) = 0;
+		virtual void fenceTimeout() = 0;
+	};
+
+	FenceWaiter(Object *parent = nullptr);
+	~FenceWaiter();
+
+	bool isValid() const { return epollFd_.isValid(); }
+
+	int wait(Listener *listener, FrameBuffer *buffer, int fd);
+	void setTimeout(Listener *listener, std::chrono::milliseconds timeout);
+	void cancel(Listener *listener);
+
+	unsigned int pending() const { return active_.size(); }
+	unsigned int capacity() const { return entries_.size(); }
+
+private:
+	LIBCAMERA_DISABLE_COPY_AND_MOVE(FenceWaiter)
+
+	struct Entry {
+		Listener *listener;
+		FrameBuffer *buffer;
+		int fd;
+	};
+
+	struct Deadline {
+		Listener *listener;
+		std::chrono::steady_clock::time_point time;
+	};
+
+	void release(Entry *entry);
+	void updateTimer();
+
+	void eventsReady();
+	void timerExpired();
+
+	UniqueFD epollFd_;
+	EventNotifier *notifier_;
+	Timer timer_;
+
+	std::deque<Entry> entries_;
+	std::vector<Entry *> free_;
+	std::vector<Entry *> active_;
+	std::vector<Entry *> released_;
+	bool dispatching_;
+
+	std::vector<Deadline> deadlines_;
+	std::vector<Listener *> expired_;
+};
+
+} /* namespace libcamera */
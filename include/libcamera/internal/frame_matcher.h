@@ -0,0 +1,264 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+/*
+ * Copyright (C) 2022, Google Inc.
+ *
+ * frame_matcher.h - Match buffers from multiple video nodes by frame sequence
+ */
+
+#pragma once
+
+#include <array>
+#include <optional>
+#include <stdint.h>
+#include <utility>
+
+namespace libcamera {
+
+template<typename T, unsigned int N>
+class SequenceRing
+{
+public:
+	static_assert(N > 0, "SequenceRing capacity must not be zero");
+
+	SequenceRing()
+		: head_(0), last_(0), floor_(0), count_(0), started_(false)
+	{
+	}
+
+	bool empty() const { return count_ == 0; }
+	unsigned int size() const { return count_; }
+	uint32_t front() const { return head_; }
+	uint32_t back() const { return last_; }
+
+	bool contains(uint32_t sequence) const
+	{
+		const Slot &slot = slots_[sequence % N];
+		return slot.value && slot.sequence == sequence;
+	}
+
+	template<typename Drop>
+	void push(uint32_t sequence, T &&value, Drop &&drop)
+	{
+		/* Entries older than the consumed ones are late. */
+		if (started_ && before(sequence, floor_)) {
+			drop(std::move(value));
+			return;
+		}
+
+		if (!count_) {
+			head_ = sequence;
+			last_ = sequence;
+		} else if (before(sequence, head_)) {
+			/* Drop the new entry if it doesn't fit in the window. */
+			if (last_ - sequence >= N) {
+				drop(std::move(value));
+				return;
+			}
+
+			head_ = sequence;
+		} else {
+			/* Evict the oldest entries to make room. */
+			while (count_ && sequence - head_ >= N)
+				evict(drop);
+
+			if (!count_)
+				head_ = sequence;
+			if (before(last_, sequence) || !count_)
+				last_ = sequence;
+		}
+
+		Slot &slot = slots_[sequence % N];
+		if (slot.value) {
+			/* Duplicated sequence, drop the previous entry. */
+			drop(std::move(*slot.value));
+			count_--;
+		}
+
+		slot.value = std::move(value);
+		slot.sequence = sequence;
+		count_++;
+	}
+
+	bool take(uint32_t sequence, T *value)
+	{
+		Slot &slot = slots_[sequence % N];
+		if (!slot.value || slot.sequence != sequence)
+			return false;
+
+		*value = std::move(*slot.value);
+		slot.value.reset();
+		count_--;
+
+		if (!started_ || before(floor_, sequence + 1))
+			floor_ = sequence + 1;
+		started_ = true;
+
+		if (sequence == head_)
+			advance();
+
+		return true;
+	}
+
+	template<typename Drop>
+	void dropBefore(uint32_t sequence, Drop &&drop)
+	{
+		while (count_ && before(head_, sequence))
+			evict(drop);
+
+		if (!started_ || before(floor_, sequence))
+			floor_ = sequence;
+		started_ = true;
+	}
+
+	template<typename Drop>
+	void clear(Drop &&drop)
+	{
+		while (count_)
+			evict(drop);
+
+		started_ = false;
+	}
+
+private:
+	struct Slot {
+		std::optional<T> value;
+		uint32_t sequence = 0;
+	};
+
+	static bool before(uint32_t a, uint32_t b)
+	{
+		return static_cast<int32_t>(a - b) < 0;
+	}
+
+	template<typename Drop>
+	void evict(Drop &drop)
+	{
+		Slot &slot = slots_[head_ % N];
+		drop(std::move(*slot.value));
+		slot.value.reset();
+		count_--;
+
+		advance();
+	}
+
+	void advance()
+	{
+		if (!count_)
+			return;
+
+		do {
+			head_++;
+		} while (!contains(head_));
+	}
+
+	std::array<Slot, N> slots_;
+	uint32_t head_;
+	uint32_t last_;
+	uint32_t floor_;
+	unsigned int count_;
+	bool started_;
+};
+
+template<typename Primary, typename Secondary, unsigned int N>
+class FrameMatcher
+{
+public:
+	struct Statistics {
+		uint64_t matched;
+		uint64_t unmatched;
+		uint64_t primaryDropped;
+		uint64_t secondaryDropped;
+	};
+
+	FrameMatcher()
+		: secondaryRequired_(false), maxDelay_(0), stats_({})
+	{
+	}
+
+	void setSecondaryRequired(bool required, unsigned int maxDelay = 0)
+	{
+		secondaryRequired_ = required;
+		maxDelay_ = maxDelay;
+	}
+
+	template<typename Drop>
+	void pushPrimary(uint32_t sequence, Primary &&primary, Drop &&drop)
+	{
+		primary_.push(sequence, std::move(primary),
+			      [&](Primary &&p) {
+				      stats_.primaryDropped++;
+				      drop(std::move(p));
+			      });
+	}
+
+	template<typename Drop>
+	void pushSecondary(uint32_t sequence, Secondary &&secondary, Drop &&drop)
+	{
+		secondary_.push(sequence, std::move(secondary),
+				[&](Secondary &&s) {
+					stats_.secondaryDropped++;
+					drop(std::move(s));
+				});
+	}
+
+	template<typename Drop>
+	bool match(Primary *primary, std::optional<Secondary> *secondary,
+		   Drop &&dropSecondary)
+	{
+		if (primary_.empty())
+			return false;
+
+		uint32_t sequence = primary_.front();
+
+		/* Secondary entries older than the primary can't be matched. */
+		secondary_.dropBefore(sequence,
+				      [&](Secondary &&s) {
+					      stats_.secondaryDropped++;
+					      dropSecondary(std::move(s));
+				      });
+
+		Secondary value;
+		if (secondary_.take(sequence, &value)) {
+			*secondary = std::move(value);
+			stats_.matched++;
+		} else {
+			/*
+			 * Wait for the secondary entry if it may still arrive,
+			 * which is the case until a secondary entry more than
+			 * maxDelay_ frames newer is received.
+			 */
+			if (secondaryRequired_ &&
+			    (secondary_.empty() || secondary_.back() - sequence <= maxDelay_))
+				return false;
+
+			secondary->reset();
+			stats_.unmatched++;
+		}
+
+		primary_.take(sequence, primary);
+		return true;
+	}
+
+	template<typename DropPrimary, typename DropSecondary>
+	void clear(DropPrimary &&dropPrimary, DropSecondary &&dropSecondary)
+	{
+		primary_.clear(dropPrimary);
+		secondary_.clear(dropSecondary);
+	}
+
+	unsigned int primaryPending() const { return primary_.size(); }
+	unsigned int secondaryPending() const { return secondary_.size(); }
+
+	const Statistics &statistics() const { return stats_; }
+	void resetStatistics() { stats_ = {}; }
+
+private:
+	SequenceRing<Primary, N> primary_;
+	SequenceRing<Secondary, N> secondary_;
+
+	bool secondaryRequired_;
+	unsigned int maxDelay_;
+	Statistics stats_;
+};
+
+} /* namespace libcamera */
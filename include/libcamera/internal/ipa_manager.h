@@ -7,10 +7,15 @@
 
 #pragma once
 
+#include <future>
+#include <map>
+#include <memory>
 #include <stdint.h>
+#include <string>
 #include <vector>
 
 #include <libcamera/base/log.h>
+#include <libcamera/base/mutex.h>
 
 #include <libcamera/ipa/ipa_interface.h>
 #include <libcamera/ipa/ipa_module_info.h>
@@ -23,6 +28,8 @@ namespace libcamera {
 
 LOG_DECLARE_CATEGORY(IPAManager)
 
+class DiscoveryCache;
+
 class IPAManager
 {
 public:
@@ -47,20 +54,31 @@ public:
 		return proxy;
 	}
 
+	static void preload(PipelineHandler *pipe, uint32_t minVersion,
+			    uint32_t maxVersion);
+
 private:
 	static IPAManager *self_;
 
 	void parseDir(const char *libDir, unsigned int maxDepth,
 		      std::vector<std::string> &files);
 	unsigned int addDir(const char *libDir, unsigned int maxDepth = 0);
+	IPAModule *createModule(const std::string &file);
 
 	IPAModule *module(PipelineHandler *pipe, uint32_t minVersion,
 			  uint32_t maxVersion);
 
-	bool isSignatureValid(IPAModule *ipa) const;
+	bool isSignatureValid(IPAModule *ipa);
+	bool verifySignature(IPAModule *ipa);
 
 	std::vector<IPAModule *> modules_;
 
+	Mutex mutex_;
+	std::unique_ptr<DiscoveryCache> cache_ LIBCAMERA_TSA_GUARDED_BY(mutex_);
+	bool cacheDirty_ LIBCAMERA_TSA_GUARDED_BY(mutex_);
+	std::map<IPAModule *, std::shared_future<bool>> preloads_
+		LIBCAMERA_TSA_GUARDED_BY(mutex_);
+
 #if HAVE_IPA_PUBKEY
 	static const uint8_t publicKeyData_[];
 	static const PubKey pubKey_;
@@ -24,9 +24,11 @@ class IPAModule : public Loggable
 {
 public:
 	explicit IPAModule(const std::string &libPath);
+	IPAModule(const std::string &libPath, const struct IPAModuleInfo &info);
 	~IPAModule();
 
 	bool isValid() const;
+	bool verifyInfo();
 
 	const struct IPAModuleInfo &info() const;
 	const std::vector<uint8_t> signature() const;
@@ -44,12 +46,14 @@ protected:
 
 private:
 	int loadIPAModuleInfo();
+	void loadSignature();
 
 	struct IPAModuleInfo info_;
 	std::vector<uint8_t> signature_;
 
 	std::string libPath_;
 	bool valid_;
+	bool verified_;
 	bool loaded_;
 
 	void *dlHandle_;
@@ -7,11 +7,16 @@
 
 #pragma once
 
+#include <list>
+#include <map>
 #include <stdint.h>
+#include <sys/types.h>
+#include <unordered_map>
 #include <vector>
 
 #include <libcamera/base/class.h>
 #include <libcamera/base/flags.h>
+#include <libcamera/base/mutex.h>
 #include <libcamera/base/span.h>
 
 #include <libcamera/framebuffer.h>
@@ -38,6 +43,7 @@ protected:
 	int error_;
 	std::vector<Plane> planes_;
 	std::vector<Plane> maps_;
+	std::vector<Plane> cachedMaps_;
 
 private:
 	LIBCAMERA_DISABLE_COPY(MappedBuffer)
@@ -50,6 +56,7 @@ public:
 		Read = 1 << 0,
 		Write = 1 << 1,
 		ReadWrite = Read | Write,
+		Cached = 1 << 2,
 	};
 
 	using MapFlags = Flags<MapFlag>;
@@ -59,4 +66,67 @@ public:
 
 LIBCAMERA_FLAGS_ENABLE_OPERATORS(MappedFrameBuffer::MapFlag)
 
+class MappingCache
+{
+public:
+	struct Statistics {
+		uint64_t hits;
+		uint64_t misses;
+		uint64_t evictions;
+		unsigned int entries;
+		unsigned int idle;
+		size_t size;
+	};
+
+	static MappingCache *instance();
+
+	int map(int fd, size_t length, int prot, Span<uint8_t> *mapping);
+	void unmap(Span<uint8_t> mapping);
+	void release(int fd);
+	void release(const FrameBuffer *buffer);
+
+	void setMaxIdle(unsigned int maxIdle);
+	void trim(unsigned int maxIdle = 0);
+
+	Statistics statistics() const;
+
+private:
+	LIBCAMERA_DISABLE_COPY_AND_MOVE(MappingCache)
+
+	static constexpr unsigned int kDefaultMaxIdle = 32;
+
+	struct Key {
+		dev_t dev;
+		ino_t ino;
+		size_t length;
+		int prot;
+
+		bool operator<(const Key &other) const;
+	};
+
+	struct Entry {
+		Key key;
+		uint8_t *address;
+		size_t length;
+		unsigned int refs;
+		bool released;
+		std::list<Entry *>::iterator idle;
+	};
+
+	MappingCache();
+	~MappingCache();
+
+	void trimLocked(unsigned int maxIdle) LIBCAMERA_TSA_REQUIRES(mutex_);
+	void evictLocked(Entry *entry) LIBCAMERA_TSA_REQUIRES(mutex_);
+
+	mutable Mutex mutex_;
+
+	std::map<Key, Entry> entries_ LIBCAMERA_TSA_GUARDED_BY(mutex_);
+	std::unordered_map<const uint8_t *, Entry *> addresses_ LIBCAMERA_TSA_GUARDED_BY(mutex_);
+	std::list<Entry *> idle_ LIBCAMERA_TSA_GUARDED_BY(mutex_);
+
+	unsigned int maxIdle_ LIBCAMERA_TSA_GUARDED_BY(mutex_);
+	Statistics stats_ LIBCAMERA_TSA_GUARDED_BY(mutex_);
+};
+
 } /* namespace libcamera */
@@ -8,6 +8,7 @@
 #pragma once
 
 #include <map>
+#include <memory>
 #include <sstream>
 #include <string>
 #include <vector>
@@ -22,6 +23,8 @@
 
 namespace libcamera {
 
+class DiscoveryCache;
+
 class MediaDevice : protected Loggable
 {
 public:
@@ -44,6 +47,8 @@ public:
 	unsigned int version() const { return version_; }
 	unsigned int hwRevision() const { return hwRevision_; }
 
+	DiscoveryCache *discoveryCache() const { return cache_.get(); }
+
 	const std::vector<MediaEntity *> &entities() const { return entities_; }
 	MediaEntity *getEntityByName(const std::string &name) const;
 
@@ -73,6 +78,7 @@ private:
 	bool populatePads(const struct media_v2_topology &topology);
 	bool populateLinks(const struct media_v2_topology &topology);
 	void fixupEntityFlags(struct media_v2_entity *entity);
+	void loadDiscoveryCache(const struct media_device_info &info);
 
 	friend int MediaLink::setEnabled(bool enable);
 	int setupLink(const MediaLink *link, unsigned int flags);
@@ -83,6 +89,8 @@ private:
 	unsigned int version_;
 	unsigned int hwRevision_;
 
+	std::unique_ptr<DiscoveryCache> cache_;
+
 	UniqueFD fd_;
 	bool valid_;
 	bool acquired_;
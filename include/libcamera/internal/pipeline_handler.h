@@ -16,10 +16,12 @@
 
 #include <libcamera/base/mutex.h>
 #include <libcamera/base/object.h>
+#include <libcamera/base/span.h>
 
 #include <libcamera/controls.h>
 #include <libcamera/stream.h>
 
+#include "libcamera/internal/dma_heaps.h"
 #include "libcamera/internal/ipa_proxy.h"
 
 namespace libcamera {
@@ -45,7 +47,7 @@ public:
 	MediaDevice *acquireMediaDevice(DeviceEnumerator *enumerator,
 					const DeviceMatch &dm);
 
-	bool acquire();
+	bool acquire(Camera *camera);
 	void release(Camera *camera);
 
 	virtual std::unique_ptr<CameraConfiguration> generateConfiguration(Camera *camera,
@@ -54,6 +56,8 @@ public:
 
 	virtual int exportFrameBuffers(Camera *camera, Stream *stream,
 				       std::vector<std::unique_ptr<FrameBuffer>> *buffers) = 0;
+	virtual DmaHeap::DmaHeapFlags bufferPoolHeaps(Camera *camera,
+						      Stream *stream) const;
 
 	virtual int start(Camera *camera, const ControlList *controls) = 0;
 	void stop(Camera *camera);
@@ -61,19 +65,26 @@ public:
 
 	void registerRequest(Request *request);
 	void queueRequest(Request *request);
+	void queueRequests(const std::vector<Request *> &requests);
 
 	bool completeBuffer(Request *request, FrameBuffer *buffer);
 	void completeRequest(Request *request);
 
 	const char *name() const { return name_; }
 
+	bool lazyInit() const { return lazyInit_; }
+	bool prewarm(const std::string &id) const;
+
 protected:
 	void registerCamera(std::shared_ptr<Camera> camera);
 	void hotplugMediaDevice(MediaDevice *media);
 
 	virtual int queueRequestDevice(Camera *camera, Request *request) = 0;
+	virtual void queueRequestsDevice(Camera *camera,
+					 Span<Request *const> requests);
 	virtual void stopDevice(Camera *camera) = 0;
 
+	virtual bool acquireDevice(Camera *camera);
 	virtual void releaseDevice(Camera *camera);
 
 	CameraManager *manager_;
@@ -84,16 +95,22 @@ private:
 	void mediaDeviceDisconnected(MediaDevice *media);
 	virtual void disconnect();
 
-	void doQueueRequest(Request *request);
+	bool doQueueRequest(Request *request);
 	void doQueueRequests();
 
+	void flushCompletedRequests(std::shared_ptr<Camera> camera);
+
 	std::vector<std::shared_ptr<MediaDevice>> mediaDevices_;
 	std::vector<std::weak_ptr<Camera>> cameras_;
 
 	std::queue<Request *> waitingRequests_;
+	bool deferQueueing_;
 
 	const char *name_;
 
+	bool lazyInit_;
+	std::vector<std::string> prewarmIds_;
+
 	Mutex lock_;
 	unsigned int useCount_ LIBCAMERA_TSA_GUARDED_BY(lock_);
 
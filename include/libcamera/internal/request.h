@@ -8,14 +8,12 @@
 #define __LIBCAMERA_INTERNAL_REQUEST_H__
 
 #include <chrono>
-#include <map>
 #include <memory>
 
-#include <libcamera/base/event_notifier.h>
-#include <libcamera/base/timer.h>
-
 #include <libcamera/request.h>
 
+#include "libcamera/internal/fence_waiter.h"
+
 using namespace std::chrono_literals;
 
 namespace libcamera {
@@ -23,7 +21,8 @@ namespace libcamera {
 class Camera;
 class FrameBuffer;
 
-class Request::Private : public Extensible::Private
+class Request::Private : public Extensible::Private,
+			 public FenceWaiter::Listener
 {
 	LIBCAMERA_DECLARE_PUBLIC(Request)
 
@@ -48,8 +47,9 @@ private:
 
 	void doCancelRequest();
 	void emitPrepareCompleted();
-	void notifierActivated(FrameBuffer *buffer);
-	void timeout();
+	void cancelFences();
+	void fenceSignalled(FrameBuffer *buffer) override;
+	void fenceTimeout() override;
 
 	Camera *camera_;
 	bool cancelled_;
@@ -57,8 +57,7 @@ private:
 	bool prepared_ = false;
 
 	std::unordered_set<FrameBuffer *> pending_;
-	std::map<FrameBuffer *, std::unique_ptr<EventNotifier>> notifiers_;
-	std::unique_ptr<Timer> timer_;
+	unsigned int pendingFences_ = 0;
 };
 
 } /* namespace libcamera */
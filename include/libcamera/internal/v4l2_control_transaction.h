@@ -0,0 +1,73 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+/*
+ * Copyright (C) 2022, Google Inc.
+ *
+ * v4l2_control_transaction.h - Batched V4L2 control writes across devices
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+#include <linux/videodev2.h>
+
+#include <libcamera/base/class.h>
+#include <libcamera/base/utils.h>
+
+#include <libcamera/controls.h>
+
+namespace libcamera {
+
+class V4L2Device;
+
+class V4L2ControlTransaction
+{
+public:
+	struct Statistics {
+		uint64_t commits = 0;
+		uint64_t ioctls = 0;
+		uint64_t controls = 0;
+		utils::Duration last{};
+		utils::Duration max{};
+		utils::Duration total{};
+	};
+
+	V4L2ControlTransaction() = default;
+
+	int addControl(V4L2Device *device, uint32_t id, bool priority = false);
+	void clear();
+
+	int set(V4L2Device *device, uint32_t id, const ControlValue &value);
+	bool pending() const;
+	int commit();
+	void reset();
+
+	const Statistics &statistics() const { return stats_; }
+	void resetStatistics() { stats_ = {}; }
+
+private:
+	LIBCAMERA_DISABLE_COPY(V4L2ControlTransaction)
+
+	struct Entry {
+		uint32_t id;
+		ControlType type;
+		bool pending;
+		ControlValue value;
+	};
+
+	struct Batch {
+		V4L2Device *device;
+		bool priority;
+		std::vector<Entry> entries;
+	};
+
+	Entry *find(V4L2Device *device, uint32_t id);
+
+	std::vector<Batch> batches_;
+	std::vector<struct v4l2_ext_control> v4l2Ctrls_;
+
+	Statistics stats_;
+};
+
+} /* namespace libcamera */
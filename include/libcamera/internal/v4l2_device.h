@@ -7,7 +7,6 @@
 
 #pragma once
 
-#include <map>
 #include <memory>
 #include <optional>
 #include <vector>
@@ -18,6 +17,7 @@
 #include <libcamera/base/signal.h>
 #include <libcamera/base/span.h>
 #include <libcamera/base/unique_fd.h>
+#include <libcamera/base/utils.h>
 
 #include <libcamera/color_space.h>
 #include <libcamera/controls.h>
@@ -46,6 +46,7 @@ public:
 
 	int setFrameStartEnabled(bool enable);
 	Signal<uint32_t> frameStart;
+	utils::time_point frameStartTime() const { return frameStartTime_; }
 
 	void updateControlInfo();
 
@@ -68,18 +69,31 @@ protected:
 	static int fromColorSpace(const std::optional<ColorSpace> &colorSpace, T &v4l2Format);
 
 private:
+	struct ControlTableEntry {
+		struct v4l2_query_ext_ctrl info;
+		ControlType type;
+		size_t payloadSize;
+		bool registered;
+	};
+
 	static ControlType v4l2CtrlType(uint32_t ctrlType);
 	static std::unique_ptr<ControlId> v4l2ControlId(const v4l2_query_ext_ctrl &ctrl);
 	std::optional<ControlInfo> v4l2ControlInfo(const v4l2_query_ext_ctrl &ctrl);
 	std::optional<ControlInfo> v4l2MenuControlInfo(const v4l2_query_ext_ctrl &ctrl);
 
 	void listControls();
+	const ControlTableEntry *findControl(uint32_t id) const;
 	void updateControls(ControlList *ctrls,
 			    Span<const v4l2_ext_control> v4l2Ctrls);
 
+	int setControlValue(struct v4l2_ext_control *v4l2Ctrl,
+			    ControlType type, ControlValue &value) const;
+	int writeControls(Span<struct v4l2_ext_control> v4l2Ctrls);
+
 	void eventAvailable();
 
-	std::map<unsigned int, struct v4l2_query_ext_ctrl> controlInfo_;
+	std::vector<ControlTableEntry> controlTable_;
+	std::vector<struct v4l2_ext_control> v4l2Ctrls_;
 	std::vector<std::unique_ptr<ControlId>> controlIds_;
 	ControlIdMap controlIdMap_;
 	ControlInfoMap controls_;
@@ -88,6 +102,9 @@ private:
 
 	EventNotifier *fdEventNotifier_;
 	bool frameStartEnabled_;
+	utils::time_point frameStartTime_;
+
+	friend class V4L2ControlTransaction;
 };
 
 } /* namespace libcamera */
@@ -24,6 +24,8 @@
 #include <libcamera/formats.h>
 #include <libcamera/property_ids.h>
 
+#include "libcamera/internal/mapped_framebuffer.h"
+
 #include "system/graphics.h"
 
 #include "camera_buffer.h"
@@ -444,6 +446,13 @@ void CameraDevice::stop()
 
 	streams_.clear();
 
+	/*
+	 * Gralloc buffers are not owned by the HAL and may be freed by the
+	 * camera service after the streams are reconfigured. Drop their
+	 * cached mappings to avoid keeping their memory alive.
+	 */
+	MappingCache::instance()->trim();
+
 	state_ = State::Stopped;
 }
 
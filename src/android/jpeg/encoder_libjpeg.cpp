@@ -181,7 +181,8 @@ void EncoderLibJpeg::compressNV(const std::vector<Span<uint8_t>> &planes)
 int EncoderLibJpeg::encode(const FrameBuffer &source, Span<uint8_t> dest,
 			   Span<const uint8_t> exifData, unsigned int quality)
 {
-	MappedFrameBuffer frame(&source, MappedFrameBuffer::MapFlag::Read);
+	MappedFrameBuffer frame(&source, MappedFrameBuffer::MapFlag::Read |
+					 MappedFrameBuffer::MapFlag::Cached);
 	if (!frame.isValid()) {
 		LOG(JPEG, Error) << "Failed to map FrameBuffer : "
 				 << strerror(frame.error());
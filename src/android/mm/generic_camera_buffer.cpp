@@ -7,7 +7,6 @@
 
 #include "../camera_buffer.h"
 
-#include <sys/mman.h>
 #include <unistd.h>
 
 #include <libcamera/base/log.h>
@@ -179,19 +178,23 @@ void CameraBuffer::Private::map()
 	ASSERT(fd_ != -1);
 	ASSERT(bufferLength_ >= 0);
 
-	void *address = mmap(nullptr, bufferLength_, flags_, MAP_SHARED, fd_, 0);
-	if (address == MAP_FAILED) {
-		error_ = -errno;
+	/*
+	 * Camera buffers are wrapped in a new CameraBuffer for every request,
+	 * use the mapping cache to avoid mapping the same gralloc buffers for
+	 * every frame.
+	 */
+	Plane map;
+	int ret = MappingCache::instance()->map(fd_, bufferLength_, flags_, &map);
+	if (ret < 0) {
+		error_ = ret;
 		LOG(HAL, Error) << "Failed to mmap plane";
 		return;
 	}
-	maps_.emplace_back(static_cast<uint8_t *>(address), bufferLength_);
+	cachedMaps_.push_back(map);
 
 	planes_.reserve(planeInfo_.size());
-	for (const auto &info : planeInfo_) {
-		planes_.emplace_back(
-			static_cast<uint8_t *>(address) + info.offset, info.size);
-	}
+	for (const auto &info : planeInfo_)
+		planes_.emplace_back(map.data() + info.offset, info.size);
 
 	mapped_ = true;
 }
@@ -72,15 +72,18 @@ static constexpr uint32_t kMaxFocusSteps = 1023;
 static constexpr uint32_t kCoarseSearchStep = 30;
 static constexpr uint32_t kFineSearchStep = 1;
 
+/* Ratio of variance drop terminating the coarse scan, 0.0 < kDropRatio < 1.0 */
+static constexpr double kDropRatio = 0.1;
+
 /* Max ratio of variance change, 0.0 < kMaxChange < 1.0 */
 static constexpr double kMaxChange = 0.5;
 
+/* The numbers of frames the variance change must last to restart a scan. */
+static constexpr uint32_t kMaxChangeFrames = 2;
+
 /* The numbers of frame to be ignored, before performing focus scan. */
 static constexpr uint32_t kIgnoreFrame = 10;
 
-/* Fine scan range 0 < kFineRange < 1 */
-static constexpr double kFineRange = 0.05;
-
 /* Settings for IPU3 AF filter */
 static struct ipu3_uapi_af_filter_config afFilterConfigDefault = {
 	.y1_coeff_0 = { 0, 1, 3, 7 },
@@ -106,11 +109,15 @@ static struct ipu3_uapi_af_filter_config afFilterConfigDefault = {
  * blurred one. Therefore, if an image with the highest contrast can be
  * found through the scan, the position of the len indicates to a clearest
  * image.
+ *
+ * The search for the lens position is performed by the libipa AfSearch
+ * engine, using the variance of the Y1 filter output during the coarse phase
+ * and of the Y2 filter output during the fine phase and once focused.
  */
 Af::Af()
-	: focus_(0), bestFocus_(0), currentVariance_(0.0), previousVariance_(0.0),
-	  coarseCompleted_(false), fineCompleted_(false)
+	: ignoreCounter_(0)
 {
+	setProcessDependencies({});
 }
 
 /**
@@ -165,14 +172,22 @@ int Af::configure(IPAContext &context, const IPAConfigInfo &configInfo)
 	grid.y_start = utils::alignDown(start.y, 2);
 	grid.y_start |= IPU3_UAPI_GRID_Y_START_EN;
 
-	/* Initial max focus step */
-	maxStep_ = kMaxFocusSteps;
+	AfSearch::Config config{};
+	config.minPosition = 0;
+	config.maxPosition = kMaxFocusSteps;
+	config.coarseStep = kCoarseSearchStep;
+	config.fineStep = kFineSearchStep;
+	config.settleFrames = 0;
+	config.dropThreshold = kDropRatio;
+	config.rescanThreshold = kMaxChange;
+	config.rescanFrames = kMaxChangeFrames;
+	search_.configure(config);
 
 	/* Initial frame ignore counter */
 	afIgnoreFrameReset();
 
 	/* Initial focus value */
-	context.activeState.af.focus = 0;
+	context.activeState.af.focus = search_.position();
 	/* Maximum variance of the AF statistics */
 	context.activeState.af.maxVariance = 0;
 	/* The stable AF value flag. if it is true, the AF should be in a stable state. */
@@ -197,130 +212,6 @@ void Af::prepare(IPAContext &context,
 	params->use.acc_af = 1;
 }
 
-/**
- * \brief AF coarse scan
- * \param[in] context The shared IPA context
- *
- * Find a near focused image using a coarse step. The step is determined by
- * kCoarseSearchStep.
- */
-void Af::afCoarseScan(IPAContext &context)
-{
-	if (coarseCompleted_)
-		return;
-
-	if (afNeedIgnoreFrame())
-		return;
-
-	if (afScan(context, kCoarseSearchStep)) {
-		coarseCompleted_ = true;
-		context.activeState.af.maxVariance = 0;
-		focus_ = context.activeState.af.focus -
-			 (context.activeState.af.focus * kFineRange);
-		context.activeState.af.focus = focus_;
-		previousVariance_ = 0;
-		maxStep_ = std::clamp(focus_ + static_cast<uint32_t>((focus_ * kFineRange)),
-				      0U, kMaxFocusSteps);
-	}
-}
-
-/**
- * \brief AF fine scan
- * \param[in] context The shared IPA context
- *
- * Find an optimum lens position with moving 1 step for each search.
- */
-void Af::afFineScan(IPAContext &context)
-{
-	if (!coarseCompleted_)
-		return;
-
-	if (afNeedIgnoreFrame())
-		return;
-
-	if (afScan(context, kFineSearchStep)) {
-		context.activeState.af.stable = true;
-		fineCompleted_ = true;
-	}
-}
-
-/**
- * \brief AF reset
- * \param[in] context The shared IPA context
- *
- * Reset all the parameters to start over the AF process.
- */
-void Af::afReset(IPAContext &context)
-{
-	if (afNeedIgnoreFrame())
-		return;
-
-	context.activeState.af.maxVariance = 0;
-	context.activeState.af.focus = 0;
-	focus_ = 0;
-	context.activeState.af.stable = false;
-	ignoreCounter_ = kIgnoreFrame;
-	previousVariance_ = 0.0;
-	coarseCompleted_ = false;
-	fineCompleted_ = false;
-	maxStep_ = kMaxFocusSteps;
-}
-
-/**
- * \brief AF variance comparison
- * \param[in] context The IPA context
- * \param[in] min_step The VCM movement step
- *
- * We always pick the largest variance to replace the previous one. The image
- * with a larger variance also indicates it is a clearer image than previous
- * one. If we find a negative derivative, we return immediately.
- *
- * \return True, if it finds a AF value.
- */
-bool Af::afScan(IPAContext &context, int min_step)
-{
-	if (focus_ > maxStep_) {
-		/* If reach the max step, move lens to the position. */
-		context.activeState.af.focus = bestFocus_;
-		return true;
-	} else {
-		/*
-		 * Find the maximum of the variance by estimating its
-		 * derivative. If the direction changes, it means we have
-		 * passed a maximum one step before.
-		 */
-		if ((currentVariance_ - context.activeState.af.maxVariance) >=
-		    -(context.activeState.af.maxVariance * 0.1)) {
-			/*
-			 * Positive and zero derivative:
-			 * The variance is still increasing. The focus could be
-			 * increased for the next comparison. Also, the max variance
-			 * and previous focus value are updated.
-			 */
-			bestFocus_ = focus_;
-			focus_ += min_step;
-			context.activeState.af.focus = focus_;
-			context.activeState.af.maxVariance = currentVariance_;
-		} else {
-			/*
-			 * Negative derivative:
-			 * The variance starts to decrease which means the maximum
-			 * variance is found. Set focus step to previous good one
-			 * then return immediately.
-			 */
-			context.activeState.af.focus = bestFocus_;
-			return true;
-		}
-	}
-
-	previousVariance_ = currentVariance_;
-	LOG(IPU3Af, Debug) << " Previous step is "
-			   << bestFocus_
-			   << " Current step is "
-			   << focus_;
-	return false;
-}
-
 /**
  * \brief Determine the frame to be ignored
  * \return Return True if the frame should be ignored, false otherwise
@@ -347,8 +238,8 @@ void Af::afIgnoreFrameReset()
  * \param[in] y_items The AF filter data set from the IPU3 statistics buffer
  * \param[in] isY1 Selects between filter Y1 or Y2 to calculate the variance
  *
- * Calculate the mean of the data set provided by \a y_item, and then calculate
- * the variance of that data set from the mean.
+ * Calculate the variance of the data set provided by \a y_item in a single
+ * pass, from the sum and the sum of squares of its values.
  *
  * The operation can work on one of two sets of values contained within the
  * y_item data set supplied by the IPU3. The two data sets are the results of
@@ -359,48 +250,18 @@ void Af::afIgnoreFrameReset()
  */
 double Af::afEstimateVariance(Span<const y_table_item_t> y_items, bool isY1)
 {
-	uint32_t total = 0;
-	double mean;
-	double var_sum = 0;
-
-	for (auto y : y_items)
-		total += isY1 ? y.y1_avg : y.y2_avg;
+	uint64_t total = 0;
+	uint64_t squares = 0;
 
-	mean = total / y_items.size();
-
-	for (auto y : y_items) {
-		double avg = isY1 ? y.y1_avg : y.y2_avg;
-		var_sum += pow(avg - mean, 2);
+	for (const y_table_item_t &y : y_items) {
+		uint32_t avg = isY1 ? y.y1_avg : y.y2_avg;
+		total += avg;
+		squares += avg * avg;
 	}
 
-	return var_sum / y_items.size();
-}
+	double mean = static_cast<double>(total) / y_items.size();
 
-/**
- * \brief Determine out-of-focus situation
- * \param[in] context The IPA context
- *
- * Out-of-focus means that the variance change rate for a focused and a new
- * variance is greater than a threshold.
- *
- * \return True if the variance threshold is crossed indicating lost focus,
- * false otherwise
- */
-bool Af::afIsOutOfFocus(IPAContext &context)
-{
-	const uint32_t diff_var = std::abs(currentVariance_ -
-					   context.activeState.af.maxVariance);
-	const double var_ratio = diff_var / context.activeState.af.maxVariance;
-
-	LOG(IPU3Af, Debug) << "Variance change rate: "
-			   << var_ratio
-			   << " Current VCM step: "
-			   << context.activeState.af.focus;
-
-	if (var_ratio > kMaxChange)
-		return true;
-	else
-		return false;
+	return static_cast<double>(squares) / y_items.size() - mean * mean;
 }
 
 /**
@@ -415,10 +276,12 @@ bool Af::afIsOutOfFocus(IPAContext &context)
  * image for each focus step should be tested to find an optimal focus step.
  *
  * The Hill Climbing Algorithm[1] is used to find the maximum variance of the
- * AF statistics which is the AF output of IPU3. The focus step is increased
+ * AF statistics which is the AF output of IPU3. The focus step is adjusted
  * then the variance of the AF statistics are estimated. If it finds the
- * negative derivative we have just passed the peak, and we infer that the best
- * focus is found.
+ * negative derivative we have just passed the peak, and the best focus is
+ * interpolated from the variance measured around the peak. Once focused, the
+ * variance is monitored and a new scan is started from the current lens
+ * position when the scene changes.
  *
  * [1] Hill Climbing Algorithm, https://en.wikipedia.org/wiki/Hill_climbing
  */
@@ -436,22 +299,29 @@ void Af::process(IPAContext &context, [[maybe_unused]] const uint32_t frame,
 	Span<const y_table_item_t> y_items(reinterpret_cast<const y_table_item_t *>(&stats->af_raw_buffer.y_table),
 					   afRawBufferLen);
 
+	if (afNeedIgnoreFrame())
+		return;
+
 	/*
-	 * Calculate the mean and the variance of AF statistics for a given grid.
+	 * Calculate the variance of AF statistics for a given grid.
 	 * For coarse: y1 are used.
 	 * For fine: y2 results are used.
 	 */
-	currentVariance_ = afEstimateVariance(y_items, !coarseCompleted_);
-
-	if (!context.activeState.af.stable) {
-		afCoarseScan(context);
-		afFineScan(context);
-	} else {
-		if (afIsOutOfFocus(context))
-			afReset(context);
-		else
-			afIgnoreFrameReset();
-	}
+	AfSearch::State state = search_.state();
+	bool coarse = state == AfSearch::State::Coarse;
+	search_.process(afEstimateVariance(y_items, coarse));
+
+	/*
+	 * When a scene change restarts the scan, ignore the next frames to
+	 * let the lens and the statistics settle.
+	 */
+	if (state == AfSearch::State::Focused &&
+	    search_.state() != AfSearch::State::Focused)
+		afIgnoreFrameReset();
+
+	context.activeState.af.focus = search_.position();
+	context.activeState.af.maxVariance = search_.peak();
+	context.activeState.af.stable = search_.state() == AfSearch::State::Focused;
 }
 
 REGISTER_IPA_ALGORITHM(Af, "Af")
@@ -17,6 +17,8 @@
 #include <libcamera/control_ids.h>
 #include <libcamera/ipa/core_ipa_interface.h>
 
+#include "libcamera/internal/yaml_parser.h"
+
 #include "libipa/histogram.h"
 
 /**
@@ -43,6 +45,11 @@ namespace ipa::ipu3::algorithms {
  *
  * Reference: Battiato, Messina & Castorina. (2008). Exposure
  * Correction for Imaging Devices: An Overview. 10.1201/9781420054538.ch12.
+ *
+ * By default, the target exposure is filtered to smooth changes. When the
+ * "predictive" tuning parameter is set, exposure changes are instead scheduled
+ * by an ExposurePredictor that accounts for the sensor exposure and gain
+ * delays, converging in a few frames.
  */
 
 LOG_DEFINE_CATEGORY(IPU3Agc)
@@ -73,8 +80,20 @@ static constexpr double kRelativeLuminanceTarget = 0.16;
 
 Agc::Agc()
 	: frameCount_(0), minShutterSpeed_(0s),
-	  maxShutterSpeed_(0s), filteredExposure_(0s)
+	  maxShutterSpeed_(0s), filteredExposure_(0s), predictive_(false)
 {
+	/* The luminance estimation uses the AWB gains. */
+	setProcessDependencies({ "Awb" });
+}
+
+/**
+ * \copydoc libcamera::ipa::Algorithm::init
+ */
+int Agc::init([[maybe_unused]] IPAContext &context, const YamlObject &tuningData)
+{
+	predictive_ = tuningData["predictive"].get<bool>(false);
+
+	return 0;
 }
 
 /**
@@ -103,6 +122,9 @@ int Agc::configure(IPAContext &context,
 	activeState.agc.gain = std::max(minAnalogueGain_, kMinAnalogueGain);
 	activeState.agc.exposure = 10ms / configuration.sensor.lineDuration;
 
+	predictor_.configure(std::max(configuration.sensor.exposureDelay,
+				      configuration.sensor.gainDelay));
+
 	frameCount_ = 0;
 	return 0;
 }
@@ -180,11 +202,14 @@ utils::Duration Agc::filterExposure(utils::Duration exposureValue)
 
 /**
  * \brief Estimate the new exposure and gain values
+ * \param[in] context The shared IPA context
+ * \param[in] frame The frame context sequence number
  * \param[inout] frameContext The shared IPA frame Context
  * \param[in] yGain The gain calculated based on the relative luminance target
  * \param[in] iqMeanGain The gain calculated based on the relative luminance target
  */
-void Agc::computeExposure(IPAContext &context, IPAFrameContext &frameContext,
+void Agc::computeExposure(IPAContext &context, const uint32_t frame,
+			  IPAFrameContext &frameContext,
 			  double yGain, double iqMeanGain)
 {
 	const IPASessionConfiguration &configuration = context.configuration;
@@ -229,10 +254,14 @@ void Agc::computeExposure(IPAContext &context, IPAFrameContext &frameContext,
 			    << ", maximum is " << maxTotalExposure;
 
 	/*
-	 * Filter the exposure.
+	 * Filter the exposure, or schedule it according to the sensor delays
+	 * in predictive mode.
 	 * \todo estimate if we need to desaturate
 	 */
-	exposureValue = filterExposure(exposureValue);
+	if (predictive_)
+		exposureValue = predictor_.update(frame, exposureValue);
+	else
+		exposureValue = filterExposure(exposureValue);
 
 	/*
 	 * Divide the exposure value as new exposure and gain values.
@@ -326,7 +355,7 @@ double Agc::estimateLuminance(IPAActiveState &activeState,
  * Identify the current image brightness, and use that to estimate the optimal
  * new exposure and gain for the scene.
  */
-void Agc::process(IPAContext &context, [[maybe_unused]] const uint32_t frame,
+void Agc::process(IPAContext &context, const uint32_t frame,
 		  IPAFrameContext &frameContext,
 		  const ipu3_uapi_stats_3a *stats,
 		  ControlList &metadata)
@@ -364,7 +393,7 @@ void Agc::process(IPAContext &context, [[maybe_unused]] const uint32_t frame,
 			break;
 	}
 
-	computeExposure(context, frameContext, yGain, iqMeanGain);
+	computeExposure(context, frame, frameContext, yGain, iqMeanGain);
 	frameCount_++;
 
 	utils::Duration exposureTime = context.configuration.sensor.lineDuration
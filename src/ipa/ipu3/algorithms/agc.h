@@ -13,6 +13,8 @@
 
 #include <libcamera/geometry.h>
 
+#include "libipa/exposure_predictor.h"
+
 #include "algorithm.h"
 
 namespace libcamera {
@@ -27,6 +29,7 @@ public:
 	Agc();
 	~Agc() = default;
 
+	int init(IPAContext &context, const YamlObject &tuningData) override;
 	int configure(IPAContext &context, const IPAConfigInfo &configInfo) override;
 	void process(IPAContext &context, const uint32_t frame,
 		     IPAFrameContext &frameContext,
@@ -37,7 +40,8 @@ private:
 	double measureBrightness(const ipu3_uapi_stats_3a *stats,
 				 const ipu3_uapi_grid_config &grid) const;
 	utils::Duration filterExposure(utils::Duration currentExposure);
-	void computeExposure(IPAContext &context, IPAFrameContext &frameContext,
+	void computeExposure(IPAContext &context, const uint32_t frame,
+			     IPAFrameContext &frameContext,
 			     double yGain, double iqMeanGain);
 	double estimateLuminance(IPAActiveState &activeState,
 				 const ipu3_uapi_grid_config &grid,
@@ -54,6 +58,9 @@ private:
 
 	utils::Duration filteredExposure_;
 
+	bool predictive_;
+	ExposurePredictor predictor_;
+
 	uint32_t stride_;
 };
 
@@ -191,6 +191,8 @@ Awb::Awb()
 	asyncResults_.temperatureK = 4500;
 
 	zones_.reserve(kAwbStatsSizeX * kAwbStatsSizeY);
+
+	setProcessDependencies({});
 }
 
 Awb::~Awb() = default;
@@ -34,6 +34,7 @@ namespace ipa::ipu3::algorithms {
 
 BlackLevelCorrection::BlackLevelCorrection()
 {
+	setProcessDependencies({});
 }
 
 /**
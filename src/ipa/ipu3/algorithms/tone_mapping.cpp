@@ -29,6 +29,7 @@ namespace ipa::ipu3::algorithms {
 ToneMapping::ToneMapping()
 	: gamma_(1.0)
 {
+	setProcessDependencies({});
 }
 
 /**
@@ -39,6 +39,7 @@
 #include "algorithms/blc.h"
 #include "algorithms/tone_mapping.h"
 #include "libipa/camera_sensor_helper.h"
+#include "libipa/timing.h"
 
 #include "ipa_context.h"
 
@@ -372,6 +373,8 @@ int IPAIPU3::start()
 void IPAIPU3::stop()
 {
 	context_.frameContexts.clear();
+
+	logTimings();
 }
 
 /**
@@ -479,6 +482,8 @@ int IPAIPU3::configure(const IPAConfigInfo &configInfo,
 	context_.configuration.sensor.lineDuration = sensorInfo_.minLineLength
 						   * 1.0s / sensorInfo_.pixelRate;
 	context_.configuration.sensor.size = sensorInfo_.outputSize;
+	context_.configuration.sensor.exposureDelay = camHelper_->exposureDelay();
+	context_.configuration.sensor.gainDelay = camHelper_->gainDelay();
 
 	/*
 	 * Compute the sensor V4L2 controls to be used by the algorithms and
@@ -494,7 +499,16 @@ int IPAIPU3::configure(const IPAConfigInfo &configInfo,
 	/* Update the IPASessionConfiguration using the sensor settings. */
 	updateSessionConfiguration(sensorCtrls_);
 
+	/*
+	 * Account algorithm execution times against the shortest frame
+	 * duration of the sensor configuration.
+	 */
+	resetTimings();
+	setTimingBudget(sensorInfo_.minFrameLength *
+			context_.configuration.sensor.lineDuration);
+
 	for (auto const &algo : algorithms()) {
+		ScopedTiming timing(algo->timings().configure);
 		int ret = algo->configure(context_, configInfo);
 		if (ret)
 			return ret;
@@ -512,7 +526,8 @@ void IPAIPU3::mapBuffers(const std::vector<IPABuffer> &buffers)
 	for (const IPABuffer &buffer : buffers) {
 		const FrameBuffer fb(buffer.planes);
 		buffers_.emplace(buffer.id,
-				 MappedFrameBuffer(&fb, MappedFrameBuffer::MapFlag::ReadWrite));
+				 MappedFrameBuffer(&fb, MappedFrameBuffer::MapFlag::ReadWrite |
+							MappedFrameBuffer::MapFlag::Cached));
 	}
 }
 
@@ -564,8 +579,10 @@ void IPAIPU3::fillParamsBuffer(const uint32_t frame, const uint32_t bufferId)
 
 	IPAFrameContext &frameContext = context_.frameContexts.get(frame);
 
-	for (auto const &algo : algorithms())
+	for (auto const &algo : algorithms()) {
+		ScopedTiming timing(algo->timings().prepare);
 		algo->prepare(context_, frame, frameContext, params);
+	}
 
 	paramsBufferReady.emit(frame);
 }
@@ -602,8 +619,7 @@ void IPAIPU3::processStatsBuffer(const uint32_t frame,
 
 	ControlList metadata(controls::controls);
 
-	for (auto const &algo : algorithms())
-		algo->process(context_, frame, frameContext, stats, metadata);
+	processAlgorithms(context_, frame, frameContext, stats, metadata);
 
 	setControls(frame);
 
@@ -630,8 +646,10 @@ void IPAIPU3::queueRequest(const uint32_t frame, const ControlList &controls)
 {
 	IPAFrameContext &frameContext = context_.frameContexts.alloc(frame);
 
-	for (auto const &algo : algorithms())
+	for (auto const &algo : algorithms()) {
+		ScopedTiming timing(algo->timings().queueRequest);
 		algo->queueRequest(context_, frame, frameContext, controls);
+	}
 }
 
 /**
@@ -0,0 +1,461 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+/*
+ * Copyright (C) 2022, Ideas On Board
+ *
+ * af_search.cpp - Contrast-based auto focus search engine
+ */
+
+#include "af_search.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include <libcamera/base/log.h>
+
+/**
+ * \file af_search.h
+ * \brief Contrast-based auto focus search engine
+ */
+
+namespace libcamera {
+
+LOG_DEFINE_CATEGORY(AfSearch)
+
+namespace ipa {
+
+/*
+ * Relative contrast increase below which the curve is considered flat, and the
+ * search step is increased.
+ */
+static constexpr double kFlatGain = 0.05;
+
+/*
+ * Relative contrast increase above which the curve is considered steep, and
+ * the search step is reset to the coarse step.
+ */
+static constexpr double kSteepGain = 0.25;
+
+/* Maximum search step, as a multiple of the coarse step. */
+static constexpr int32_t kMaxStepScale = 4;
+
+/**
+ * \class AfSearch
+ * \brief Search for the lens position that maximizes the image contrast
+ *
+ * The AfSearch class implements a hardware-independent contrast detection auto
+ * focus. IPA modules compute a contrast measure (such as the variance of a
+ * high-pass filter output) for each frame from the statistics, feed it to the
+ * search engine with process(), and apply the lens position returned by
+ * position().
+ *
+ * The search runs in two phases. The coarse phase climbs the contrast curve
+ * from the start position. The step size adapts to the curve, growing on flat
+ * areas far from the peak and shrinking back to the coarse step on steep
+ * slopes. The search reverses its direction if the contrast decreases from the
+ * start position, and terminates as soon as the contrast drops significantly
+ * below the best measured value, or when the end of the lens range is reached.
+ * The peak position is then estimated by fitting a parabola through the best
+ * sample and its two neighbours.
+ *
+ * The fine phase measures the contrast at three positions around the estimated
+ * peak, and fits a parabola through them to compute the final lens position.
+ * Callers may use a different, more precise, contrast measure during the fine
+ * phase, as the fine phase doesn't compare its samples with the coarse ones.
+ *
+ * Once focused, the contrast is monitored to detect scene changes. When the
+ * contrast deviates from its reference value by more than a threshold for a
+ * number of consecutive frames, a new coarse search is started from the
+ * current lens position, implementing continuous auto focus.
+ *
+ * A search can also be started explicitly with trigger(), optionally from a
+ * position estimated by other means, such as phase detection. Starting the
+ * search close to the peak minimizes the number of frames needed to focus.
+ */
+
+/**
+ * \enum AfSearch::State
+ * \brief The search state
+ * \var AfSearch::State::Idle
+ * \brief The search engine hasn't been configured
+ * \var AfSearch::State::Coarse
+ * \brief The coarse search phase is in progress
+ * \var AfSearch::State::Fine
+ * \brief The fine search phase is in progress
+ * \var AfSearch::State::Focused
+ * \brief The search has completed, and the contrast is monitored
+ */
+
+/**
+ * \struct AfSearch::Config
+ * \brief Auto focus search parameters
+ *
+ * \var AfSearch::Config::minPosition
+ * \brief The minimum lens position
+ *
+ * \var AfSearch::Config::maxPosition
+ * \brief The maximum lens position
+ *
+ * \var AfSearch::Config::coarseStep
+ * \brief The initial lens movement step of the coarse phase
+ *
+ * \var AfSearch::Config::fineStep
+ * \brief The minimum lens movement step of the fine phase
+ *
+ * \var AfSearch::Config::settleFrames
+ * \brief The number of frames to skip after moving the lens
+ *
+ * \var AfSearch::Config::dropThreshold
+ * \brief The relative contrast drop from the best value that terminates the
+ * coarse phase
+ *
+ * \var AfSearch::Config::rescanThreshold
+ * \brief The relative contrast change that triggers a new search when focused
+ *
+ * \var AfSearch::Config::rescanFrames
+ * \brief The number of consecutive frames the contrast change must last to
+ * trigger a new search
+ */
+
+AfSearch::AfSearch()
+	: config_{}, state_(State::Idle), best_(0), position_(0), step_(0),
+	  direction_(1), reversed_(false), settle_(0), fineIndex_(0),
+	  peak_(0.0), reference_(0.0), frames_(0), rescanCount_(0)
+{
+}
+
+/**
+ * \brief Configure the search engine
+ * \param[in] config The search parameters
+ *
+ * A full search is started from the minimum lens position.
+ */
+void AfSearch::configure(const Config &config)
+{
+	config_ = config;
+	config_.coarseStep = std::max(config_.coarseStep, 1);
+	config_.fineStep = std::max(config_.fineStep, 1);
+	config_.rescanFrames = std::max(config_.rescanFrames, 1U);
+
+	reset();
+}
+
+/**
+ * \brief Start a full search from the minimum lens position
+ */
+void AfSearch::reset()
+{
+	peak_ = 0.0;
+	start(config_.minPosition);
+}
+
+/**
+ * \brief Start a search from the current lens position
+ */
+void AfSearch::trigger()
+{
+	start(position_);
+}
+
+/**
+ * \brief Start a search from a given lens position
+ * \param[in] position The estimated in-focus lens position
+ */
+void AfSearch::trigger(int32_t position)
+{
+	start(std::clamp(position, config_.minPosition, config_.maxPosition));
+}
+
+/**
+ * \brief Process the contrast measured on a frame
+ * \param[in] contrast The contrast measure
+ *
+ * The \a contrast shall be measured on a frame captured with the lens at the
+ * position returned by position() before this call. The lens position to be
+ * applied to the next frames is available through position() after this call.
+ */
+void AfSearch::process(double contrast)
+{
+	if (state_ == State::Idle)
+		return;
+
+	if (state_ != State::Focused)
+		frames_++;
+
+	if (settle_) {
+		settle_--;
+		return;
+	}
+
+	switch (state_) {
+	case State::Coarse:
+		processCoarse(contrast);
+		break;
+	case State::Fine:
+		processFine(contrast);
+		break;
+	case State::Focused:
+		processFocused(contrast);
+		break;
+	default:
+		break;
+	}
+}
+
+/**
+ * \fn AfSearch::state()
+ * \brief Retrieve the search state
+ * \return The search state
+ */
+
+/**
+ * \fn AfSearch::position()
+ * \brief Retrieve the lens position to apply
+ * \return The lens position
+ */
+
+/**
+ * \fn AfSearch::peak()
+ * \brief Retrieve the highest contrast measured by the last completed search
+ * \return The peak contrast
+ */
+
+/**
+ * \fn AfSearch::frames()
+ * \brief Retrieve the number of frames spent in the current or last search
+ * \return The number of frames
+ */
+
+void AfSearch::start(int32_t position)
+{
+	state_ = State::Coarse;
+	samples_.clear();
+	best_ = 0;
+	step_ = config_.coarseStep;
+	direction_ = position >= config_.maxPosition ? -1 : 1;
+	reversed_ = false;
+	frames_ = 0;
+	rescanCount_ = 0;
+
+	moveTo(position);
+}
+
+void AfSearch::moveTo(int32_t position)
+{
+	position_ = position;
+	settle_ = config_.settleFrames;
+}
+
+bool AfSearch::advance()
+{
+	int32_t position = std::clamp(position_ + direction_ * step_,
+				      config_.minPosition, config_.maxPosition);
+	if (position == position_)
+		return false;
+
+	moveTo(position);
+	return true;
+}
+
+bool AfSearch::bracketed() const
+{
+	int32_t best = samples_[best_].position;
+	bool below = false;
+	bool above = false;
+
+	for (const Sample &sample : samples_) {
+		below |= sample.position < best;
+		above |= sample.position > best;
+	}
+
+	return below && above;
+}
+
+void AfSearch::processCoarse(double contrast)
+{
+	samples_.push_back({ position_, contrast });
+
+	if (samples_.size() == 1) {
+		best_ = 0;
+		if (!advance()) {
+			direction_ = -direction_;
+			reversed_ = true;
+			if (!advance())
+				finishCoarse();
+		}
+		return;
+	}
+
+	const Sample best = samples_[best_];
+
+	if (contrast >= best.contrast) {
+		double gain = best.contrast > 0.0
+			    ? (contrast - best.contrast) / best.contrast : 1.0;
+
+		best_ = samples_.size() - 1;
+
+		if (gain < kFlatGain)
+			step_ = std::min(step_ * 2, config_.coarseStep * kMaxStepScale);
+		else if (gain > kSteepGain)
+			step_ = config_.coarseStep;
+
+		if (!advance())
+			finishCoarse();
+		return;
+	}
+
+	/* Tolerate small contrast decreases caused by noise. */
+	if (contrast >= best.contrast * (1.0 - config_.dropThreshold)) {
+		if (!advance())
+			finishCoarse();
+		return;
+	}
+
+	/*
+	 * The contrast has dropped significantly. If the peak hasn't been
+	 * bracketed yet, the search went downhill from the start position, try
+	 * the other direction.
+	 */
+	if (!bracketed() && !reversed_) {
+		reversed_ = true;
+		direction_ = -direction_;
+		step_ = config_.coarseStep;
+		position_ = best.position;
+		if (advance())
+			return;
+	}
+
+	finishCoarse();
+}
+
+void AfSearch::finishCoarse()
+{
+	int32_t center = fitPeak();
+
+	LOG(AfSearch, Debug)
+		<< "Coarse search completed in " << frames_
+		<< " frames, peak estimated at " << center;
+
+	if (config_.coarseStep <= config_.fineStep) {
+		finishFine();
+		return;
+	}
+
+	int32_t step = std::max(config_.fineStep, config_.coarseStep / 2);
+
+	finePositions_.clear();
+	for (int32_t position : { center - step, center, center + step }) {
+		position = std::clamp(position, config_.minPosition,
+				      config_.maxPosition);
+		if (finePositions_.empty() || finePositions_.back() != position)
+			finePositions_.push_back(position);
+	}
+
+	state_ = State::Fine;
+	samples_.clear();
+	fineIndex_ = 0;
+
+	moveTo(finePositions_[0]);
+}
+
+void AfSearch::processFine(double contrast)
+{
+	samples_.push_back({ position_, contrast });
+
+	if (++fineIndex_ < finePositions_.size()) {
+		moveTo(finePositions_[fineIndex_]);
+		return;
+	}
+
+	finishFine();
+}
+
+void AfSearch::finishFine()
+{
+	int32_t position = fitPeak();
+
+	peak_ = 0.0;
+	for (const Sample &sample : samples_)
+		peak_ = std::max(peak_, sample.contrast);
+
+	state_ = State::Focused;
+	reference_ = 0.0;
+	rescanCount_ = 0;
+
+	LOG(AfSearch, Debug)
+		<< "Focused at position " << position << " in " << frames_
+		<< " frames";
+
+	moveTo(position);
+}
+
+void AfSearch::processFocused(double contrast)
+{
+	if (reference_ <= 0.0) {
+		reference_ = contrast;
+		return;
+	}
+
+	double change = std::abs(contrast - reference_) / reference_;
+	if (change <= config_.rescanThreshold) {
+		rescanCount_ = 0;
+		return;
+	}
+
+	if (++rescanCount_ < config_.rescanFrames)
+		return;
+
+	LOG(AfSearch, Debug)
+		<< "Contrast changed by " << change * 100 << "%, restarting search";
+
+	trigger();
+}
+
+/*
+ * Estimate the position of the contrast peak by fitting a parabola through the
+ * best sample and its closest neighbours on each side. Fall back to the best
+ * sample if the peak isn't bracketed or the samples don't form a maximum.
+ */
+int32_t AfSearch::fitPeak() const
+{
+	if (samples_.empty())
+		return position_;
+
+	auto best = std::max_element(samples_.begin(), samples_.end(),
+				     [](const Sample &a, const Sample &b) {
+					     return a.contrast < b.contrast;
+				     });
+
+	const Sample *below = nullptr;
+	const Sample *above = nullptr;
+
+	for (const Sample &sample : samples_) {
+		if (sample.position < best->position &&
+		    (!below || sample.position > below->position))
+			below = &sample;
+		if (sample.position > best->position &&
+		    (!above || sample.position < above->position))
+			above = &sample;
+	}
+
+	if (!below || !above)
+		return best->position;
+
+	double x0 = below->position, y0 = below->contrast;
+	double x1 = best->position, y1 = best->contrast;
+	double x2 = above->position, y2 = above->contrast;
+
+	double denom = (x0 - x1) * (x0 - x2) * (x1 - x2);
+	double a = (x2 * (y1 - y0) + x1 * (y0 - y2) + x0 * (y2 - y1)) / denom;
+	double b = (x2 * x2 * (y0 - y1) + x1 * x1 * (y2 - y0) + x0 * x0 * (y1 - y2)) / denom;
+
+	if (a >= 0.0)
+		return best->position;
+
+	double vertex = std::clamp(-b / (2 * a), x0, x2);
+
+	return static_cast<int32_t>(std::lround(vertex));
+}
+
+} /* namespace ipa */
+
+} /* namespace libcamera */
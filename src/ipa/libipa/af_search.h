@@ -0,0 +1,92 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+/*
+ * Copyright (C) 2022, Ideas On Board
+ *
+ * af_search.h - Contrast-based auto focus search engine
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+namespace libcamera {
+
+namespace ipa {
+
+class AfSearch
+{
+public:
+	enum class State {
+		Idle,
+		Coarse,
+		Fine,
+		Focused,
+	};
+
+	struct Config {
+		int32_t minPosition;
+		int32_t maxPosition;
+		int32_t coarseStep;
+		int32_t fineStep;
+		unsigned int settleFrames;
+		double dropThreshold;
+		double rescanThreshold;
+		unsigned int rescanFrames;
+	};
+
+	AfSearch();
+
+	void configure(const Config &config);
+	void reset();
+	void trigger();
+	void trigger(int32_t position);
+
+	void process(double contrast);
+
+	State state() const { return state_; }
+	int32_t position() const { return position_; }
+	double peak() const { return peak_; }
+	unsigned int frames() const { return frames_; }
+
+private:
+	struct Sample {
+		int32_t position;
+		double contrast;
+	};
+
+	void start(int32_t position);
+	void moveTo(int32_t position);
+	bool advance();
+	bool bracketed() const;
+	void processCoarse(double contrast);
+	void processFine(double contrast);
+	void processFocused(double contrast);
+	void finishCoarse();
+	void finishFine();
+	int32_t fitPeak() const;
+
+	Config config_;
+	State state_;
+
+	std::vector<Sample> samples_;
+	unsigned int best_;
+
+	int32_t position_;
+	int32_t step_;
+	int32_t direction_;
+	bool reversed_;
+	unsigned int settle_;
+
+	std::vector<int32_t> finePositions_;
+	unsigned int fineIndex_;
+
+	double peak_;
+	double reference_;
+	unsigned int frames_;
+	unsigned int rescanCount_;
+};
+
+} /* namespace ipa */
+
+} /* namespace libcamera */
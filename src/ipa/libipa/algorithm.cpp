@@ -133,6 +133,61 @@ namespace ipa {
  * such that the algorithms use up to date state as required.
  */
 
+/**
+ * \fn Algorithm::name()
+ * \brief Retrieve the algorithm name
+ *
+ * The name is the one used to instantiate the algorithm from the tuning data,
+ * and is set by the Module when creating the algorithm.
+ *
+ * \return The algorithm name
+ */
+
+/**
+ * \fn Algorithm::processDependencies()
+ * \brief Retrieve the algorithms that process() depends on
+ *
+ * \sa setProcessDependencies()
+ *
+ * \return The names of the algorithms that process() depends on, or
+ * std::nullopt if the algorithm hasn't declared its dependencies
+ */
+
+/**
+ * \fn Algorithm::setProcessDependencies()
+ * \brief Declare the algorithms that process() depends on
+ * \param[in] dependencies The names of the algorithms
+ *
+ * By default, the process() function of all algorithms is assumed to depend on
+ * the state produced by all previous algorithms, and to produce state consumed
+ * by all following algorithms. Algorithms are then processed sequentially, in
+ * the order in which they are listed in the tuning data.
+ *
+ * Algorithms whose process() function only interacts with a known set of other
+ * algorithms, through the IPA context or frame context, can declare them by
+ * calling this function, typically from their constructor. The \a dependencies
+ * list the names of algorithms whose state process() reads or writes, and may
+ * be empty. Dependencies are symmetric: an algorithm that reads state written
+ * by another algorithm only needs to be declared on one side.
+ *
+ * The Module may then run the process() function of two algorithms that have
+ * both declared their dependencies concurrently, unless one of them depends on
+ * the other. Algorithms that declare their dependencies shall thus only access
+ * the context data they own, or data owned by their dependencies, in
+ * process(). Relative ordering of dependent algorithms is preserved.
+ */
+
+/**
+ * \fn Algorithm::timings()
+ * \brief Retrieve the execution time statistics of the algorithm
+ *
+ * IPA modules record the execution time of each algorithm phase in the
+ * returned AlgorithmTimings, typically with a ScopedTiming. The statistics are
+ * reported by Module::logTimings().
+ *
+ * \return The algorithm execution time statistics
+ */
+
 /**
  * \class AlgorithmFactory
  * \brief Registration of Algorithm classes and creation of instances
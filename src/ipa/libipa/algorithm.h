@@ -7,11 +7,15 @@
 #pragma once
 
 #include <memory>
+#include <optional>
 #include <stdint.h>
 #include <string>
+#include <vector>
 
 #include <libcamera/controls.h>
 
+#include "timing.h"
+
 namespace libcamera {
 
 class YamlObject;
@@ -59,6 +63,29 @@ public:
 			     [[maybe_unused]] ControlList &metadata)
 	{
 	}
+
+	const std::string &name() const { return name_; }
+
+	const std::optional<std::vector<std::string>> &processDependencies() const
+	{
+		return processDependencies_;
+	}
+
+	AlgorithmTimings &timings() { return timings_; }
+	const AlgorithmTimings &timings() const { return timings_; }
+
+protected:
+	void setProcessDependencies(const std::vector<std::string> &dependencies)
+	{
+		processDependencies_ = dependencies;
+	}
+
+private:
+	friend Module;
+
+	std::string name_;
+	std::optional<std::vector<std::string>> processDependencies_;
+	AlgorithmTimings timings_;
 };
 
 template<typename _Module>
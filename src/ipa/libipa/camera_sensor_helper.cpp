@@ -45,7 +45,15 @@ namespace ipa {
  * CameraSensorHelper derived class instances shall never be constructed
  * manually but always through the CameraSensorHelperFactoryBase::create()
  * function.
+ *
+ * The exposure and gain delays default to 2 and 1 frames respectively, which
+ * match the behaviour of most sensors. Sensors with different delays shall
+ * override them in their constructor.
  */
+CameraSensorHelper::CameraSensorHelper()
+	: exposureDelay_(2), gainDelay_(1)
+{
+}
 
 /**
  * \brief Compute gain code from the analogue gain absolute value
@@ -111,6 +119,28 @@ double CameraSensorHelper::gain(uint32_t gainCode) const
 	}
 }
 
+/**
+ * \fn CameraSensorHelper::exposureDelay()
+ * \brief Retrieve the exposure delay of the sensor
+ *
+ * The exposure delay is the number of frames between the frame during which
+ * the exposure time control is written and the first frame captured with the
+ * new exposure time.
+ *
+ * \return The exposure delay in frames
+ */
+
+/**
+ * \fn CameraSensorHelper::gainDelay()
+ * \brief Retrieve the analogue gain delay of the sensor
+ *
+ * The gain delay is the number of frames between the frame during which the
+ * analogue gain control is written and the first frame captured with the new
+ * gain.
+ *
+ * \return The analogue gain delay in frames
+ */
+
 /**
  * \enum CameraSensorHelper::AnalogueGainType
  * \brief The gain calculation modes as defined by the MIPI CCS
@@ -209,6 +239,16 @@ double CameraSensorHelper::gain(uint32_t gainCode) const
  * \brief The analogue gain model type
  */
 
+/**
+ * \var CameraSensorHelper::exposureDelay_
+ * \brief The exposure delay in frames
+ */
+
+/**
+ * \var CameraSensorHelper::gainDelay_
+ * \brief The analogue gain delay in frames
+ */
+
 /**
  * \var CameraSensorHelper::gainConstants_
  * \brief The analogue gain parameters used for calculation
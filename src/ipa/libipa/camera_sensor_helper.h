@@ -22,12 +22,15 @@ namespace ipa {
 class CameraSensorHelper
 {
 public:
-	CameraSensorHelper() = default;
+	CameraSensorHelper();
 	virtual ~CameraSensorHelper() = default;
 
 	virtual uint32_t gainCode(double gain) const;
 	virtual double gain(uint32_t gainCode) const;
 
+	unsigned int exposureDelay() const { return exposureDelay_; }
+	unsigned int gainDelay() const { return gainDelay_; }
+
 protected:
 	enum AnalogueGainType {
 		AnalogueGainLinear,
@@ -54,6 +57,9 @@ protected:
 	AnalogueGainType gainType_;
 	AnalogueGainConstants gainConstants_;
 
+	unsigned int exposureDelay_;
+	unsigned int gainDelay_;
+
 private:
 	LIBCAMERA_DISABLE_COPY_AND_MOVE(CameraSensorHelper)
 };
@@ -0,0 +1,127 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+/*
+ * Copyright (C) 2022, Ideas On Board
+ *
+ * exposure_predictor.cpp - Delay-aware total exposure scheduling for AGC
+ */
+
+#include "exposure_predictor.h"
+
+#include <libcamera/base/log.h>
+
+/**
+ * \file exposure_predictor.h
+ * \brief Delay-aware total exposure scheduling for AGC algorithms
+ */
+
+namespace libcamera {
+
+LOG_DEFINE_CATEGORY(ExposurePredictor)
+
+namespace ipa {
+
+/*
+ * Relative difference between the target and requested exposures below which
+ * the requested exposure is kept, to avoid micro-adjustments.
+ */
+static constexpr double kDeadband = 0.05;
+
+/*
+ * Relative difference between the target and requested exposures above which
+ * the scene is considered to have changed while a new exposure is in flight.
+ */
+static constexpr double kSceneChange = 0.25;
+
+/**
+ * \class ExposurePredictor
+ * \brief Schedule total exposure changes according to the sensor delays
+ *
+ * AGC algorithms compute a target total exposure (the product of the shutter
+ * time and gain) from the statistics of a frame and the exposure that the
+ * sensor has applied to that frame. Exposure and gain changes only take effect
+ * a few frames after being requested, as reported by
+ * CameraSensorHelper::exposureDelay() and CameraSensorHelper::gainDelay(). A
+ * conventional AGC filters the target to avoid oscillations, at the expense of
+ * slow convergence.
+ *
+ * The ExposurePredictor class instead keeps track of the exposure in flight.
+ * A new target is applied immediately and in full, and is then held until the
+ * first frame captured with it is processed, as frames exposed before that
+ * point can't bring any new information about the effect of the change. The
+ * hold is released early if the target changes significantly, which indicates
+ * a scene change. Once settled, targets within a small deadband around the
+ * requested exposure are ignored.
+ *
+ * As the target is computed from the exposure really applied to the frame, an
+ * accurate brightness estimate results in convergence in delay + 1 frames,
+ * without overshoot.
+ */
+
+ExposurePredictor::ExposurePredictor()
+	: delay_(2)
+{
+	reset();
+}
+
+/**
+ * \brief Configure the predictor for a sensor
+ * \param[in] delay The number of frames before a requested exposure takes
+ * effect, typically the largest of the sensor exposure and gain delays
+ */
+void ExposurePredictor::configure(unsigned int delay)
+{
+	delay_ = delay;
+	reset();
+}
+
+/**
+ * \brief Reset the predictor state
+ *
+ * The next call to update() will apply the target unconditionally.
+ */
+void ExposurePredictor::reset()
+{
+	requested_ = {};
+	settledFrame_ = 0;
+	valid_ = false;
+}
+
+/**
+ * \brief Compute the total exposure to request after processing a frame
+ * \param[in] frame The sequence number of the processed frame
+ * \param[in] target The target total exposure computed for the frame
+ *
+ * \return The total exposure to request
+ */
+utils::Duration ExposurePredictor::update(uint32_t frame, utils::Duration target)
+{
+	if (valid_ && requested_) {
+		double error = utils::abs_diff(target.get<std::nano>(),
+					       requested_.get<std::nano>()) /
+			       requested_.get<std::nano>();
+
+		if (error < kDeadband)
+			return requested_;
+
+		if (frame < settledFrame_ && error < kSceneChange) {
+			LOG(ExposurePredictor, Debug)
+				<< "Holding exposure " << requested_
+				<< " until frame " << settledFrame_;
+			return requested_;
+		}
+	}
+
+	requested_ = target;
+	settledFrame_ = frame + delay_ + 1;
+	valid_ = true;
+
+	LOG(ExposurePredictor, Debug)
+		<< "Requesting exposure " << requested_ << " on frame " << frame
+		<< ", settled on frame " << settledFrame_;
+
+	return requested_;
+}
+
+} /* namespace ipa */
+
+} /* namespace libcamera */
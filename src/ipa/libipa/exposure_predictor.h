@@ -0,0 +1,38 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+/*
+ * Copyright (C) 2022, Ideas On Board
+ *
+ * exposure_predictor.h - Delay-aware total exposure scheduling for AGC
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#include <libcamera/base/utils.h>
+
+namespace libcamera {
+
+namespace ipa {
+
+class ExposurePredictor
+{
+public:
+	ExposurePredictor();
+
+	void configure(unsigned int delay);
+	void reset();
+
+	utils::Duration update(uint32_t frame, utils::Duration target);
+
+private:
+	unsigned int delay_;
+
+	utils::Duration requested_;
+	uint32_t settledFrame_;
+	bool valid_;
+};
+
+} /* namespace ipa */
+
+} /* namespace libcamera */
@@ -79,10 +79,25 @@ namespace ipa {
  * At its core, the queue uses a circular buffer to avoid dynamic memory
  * allocation at runtime. The buffer is pre-allocated with a maximum number of
  * entries when the FCQueue instance is constructed. Entries are initialized on
- * first use by alloc() or, in underrun conditions, get(). The queue is not
- * allowed to overflow, which must be ensured by pipeline handlers never
- * queuing more in-flight requests to the IPA module than the queue size. If an
- * overflow condition is detected, the queue will log a fatal error.
+ * first use by alloc() or, in underrun conditions, get().
+ *
+ * Each entry is tagged with the sequence number of the frame it currently
+ * stores. The tags are updated atomically, which allows alloc() and get() to be
+ * called concurrently from different threads without locking, for instance
+ * when requests are queued from a different thread than the one processing
+ * statistics. Concurrent calls for the same frame are safe, the context is
+ * initialized once only. The contents of the frame contexts are not protected,
+ * and users of the queue are responsible for synchronizing accesses to the same
+ * frame context from different threads.
+ *
+ * The queue is not allowed to overflow, which must be ensured by pipeline
+ * handlers never queuing more in-flight requests to the IPA module than the
+ * queue size. If a frame context is requested with get() after its entry has
+ * been recycled for a newer frame, the queue will log a fatal error.
+ *
+ * Frame contexts allocated ahead of the frame being processed, for instance
+ * for requests queued in advance, can be inspected with peek() without
+ * affecting the queue.
  *
  * IPA module-specific frame context implementations shall inherit from the
  * FrameContext base class to support the minimum required features for a
@@ -93,6 +108,10 @@ namespace ipa {
  * \fn FCQueue::FCQueue(unsigned int size)
  * \brief Construct a frame contexts queue of a specified size
  * \param[in] size The number of contexts in the queue
+ *
+ * The \a size is rounded up to the next power of two. It sets the maximum
+ * number of frames in flight in the IPA module, and shall thus be larger than
+ * the depth of the pipeline handler's request queue.
  */
 
 /**
@@ -106,6 +125,12 @@ namespace ipa {
  * started.
  */
 
+/**
+ * \fn FCQueue::size()
+ * \brief Retrieve the number of contexts in the queue
+ * \return The number of contexts in the queue
+ */
+
 /**
  * \fn FCQueue::alloc(uint32_t frame)
  * \brief Allocate and return a FrameContext for the \a frame
@@ -116,7 +141,10 @@ namespace ipa {
  * initialised already, and returned to the caller.
  *
  * If the FrameContext was already initialized for this \a frame, a warning will
- * be reported and the previously initialized FrameContext is returned.
+ * be reported and the previously initialized FrameContext is returned. If the
+ * entry has already been reused for a newer frame, which happens when the
+ * request is queued too late, a warning is reported and the newer FrameContext
+ * is returned unmodified.
  *
  * Frame contexts are expected to be initialised when a Request is first passed
  * to the IPA module in IPAModule::queueRequest().
@@ -130,11 +158,25 @@ namespace ipa {
  * \param[in] frame The frame context sequence number
  *
  * If the FrameContext is not correctly initialised for the \a frame, it will be
- * initialised.
+ * initialised. If the entry has already been reused for a newer frame, a fatal
+ * error is logged.
  *
  * \return A reference to the FrameContext for sequence \a frame
  */
 
+/**
+ * \fn FCQueue::peek(uint32_t frame)
+ * \brief Look up the FrameContext for the \a frame if it has been allocated
+ * \param[in] frame The frame context sequence number
+ *
+ * This function allows looking ahead at frame contexts already allocated with
+ * alloc(), typically for requests queued to the IPA module ahead of the frame
+ * currently being processed. Unlike get(), it never initialises the context.
+ *
+ * \return A pointer to the FrameContext for sequence \a frame, or nullptr if
+ * the context hasn't been allocated or has been recycled for a newer frame
+ */
+
 } /* namespace ipa */
 
 } /* namespace libcamera */
@@ -7,7 +7,9 @@
 
 #pragma once
 
+#include <atomic>
 #include <stdint.h>
+#include <thread>
 #include <vector>
 
 #include <libcamera/base/log.h>
@@ -32,78 +34,162 @@ class FCQueue
 {
 public:
 	FCQueue(unsigned int size)
-		: contexts_(size)
+		: contexts_(roundUpPow2(size)), tags_(contexts_.size()),
+		  mask_(contexts_.size() - 1)
 	{
+		clear();
 	}
 
 	void clear()
 	{
 		for (FrameContext &ctx : contexts_)
 			ctx.frame = 0;
+
+		for (std::atomic<uint64_t> &tag : tags_)
+			tag.store(kEmpty, std::memory_order_release);
 	}
 
+	unsigned int size() const { return contexts_.size(); }
+
 	FrameContext &alloc(const uint32_t frame)
 	{
-		FrameContext &frameContext = contexts_[frame % contexts_.size()];
-
-		/*
-		 * Do not re-initialise if a get() call has already fetched this
-		 * frame context to preseve the context.
-		 *
-		 * \todo If the the sequence number of the context to initialise
-		 * is smaller than the sequence number of the queue slot to use,
-		 * it means that we had a serious request underrun and more
-		 * frames than the queue size has been produced since the last
-		 * time the application has queued a request. Does this deserve
-		 * an error condition ?
-		 */
-		if (frame != 0 && frame <= frameContext.frame)
-			LOG(FCQueue, Warning)
-				<< "Frame " << frame << " already initialised";
-		else
-			init(frameContext, frame);
-
-		return frameContext;
+		const uint64_t tag = frame + 1ULL;
+		const unsigned int index = frame & mask_;
+		FrameContext &frameContext = contexts_[index];
+
+		while (true) {
+			uint64_t current = waitIdle(index);
+
+			if (current == tag) {
+				/*
+				 * Do not re-initialise if a get() call has
+				 * already fetched this frame context to preseve
+				 * the context.
+				 */
+				LOG(FCQueue, Warning)
+					<< "Frame " << frame << " already initialised";
+				return frameContext;
+			}
+
+			if (current > tag) {
+				/*
+				 * The slot has already been recycled for a newer
+				 * frame: we had a serious request underrun and
+				 * more frames than the queue size have been
+				 * produced since the last time the application
+				 * queued a request. Leave the newer frame
+				 * context untouched.
+				 */
+				LOG(FCQueue, Warning)
+					<< "Frame " << frame << " already superseded by "
+					<< current - 1;
+				return frameContext;
+			}
+
+			if (claim(index, current, tag))
+				return frameContext;
+		}
 	}
 
 	FrameContext &get(uint32_t frame)
 	{
-		FrameContext &frameContext = contexts_[frame % contexts_.size()];
-
-		/*
-		 * If the IPA algorithms try to access a frame context slot which
-		 * has been already overwritten by a newer context, it means the
-		 * frame context queue has overflowed and the desired context
-		 * has been forever lost. The pipeline handler shall avoid
-		 * queueing more requests to the IPA than the frame context
-		 * queue size.
-		 */
-		if (frame < frameContext.frame)
-			LOG(FCQueue, Fatal) << "Frame context for " << frame
-					    << " has been overwritten by "
-					    << frameContext.frame;
-
-		if (frame == frameContext.frame)
-			return frameContext;
-
-		/*
-		 * The frame context has been retrieved before it was
-		 * initialised through the initialise() call. This indicates an
-		 * algorithm attempted to access a Frame context before it was
-		 * queued to the IPA. Controls applied for this request may be
-		 * left unhandled.
-		 *
-		 * \todo Set an error flag for per-frame control errors.
-		 */
-		LOG(FCQueue, Warning)
-			<< "Obtained an uninitialised FrameContext for " << frame;
-
-		init(frameContext, frame);
-
-		return frameContext;
+		const uint64_t tag = frame + 1ULL;
+		const unsigned int index = frame & mask_;
+		FrameContext &frameContext = contexts_[index];
+
+		while (true) {
+			uint64_t current = waitIdle(index);
+
+			if (current == tag)
+				return frameContext;
+
+			/*
+			 * If the IPA algorithms try to access a frame context
+			 * slot which has been already overwritten by a newer
+			 * context, it means the frame context queue has
+			 * overflowed and the desired context has been forever
+			 * lost. The pipeline handler shall avoid queueing more
+			 * requests to the IPA than the frame context queue
+			 * size.
+			 */
+			if (current > tag) {
+				overflow(frame, current - 1);
+				return frameContext;
+			}
+
+			/*
+			 * The frame context has been retrieved before it was
+			 * initialised through the alloc() call. This indicates
+			 * an algorithm attempted to access a Frame context
+			 * before it was queued to the IPA. Controls applied for
+			 * this request may be left unhandled.
+			 *
+			 * \todo Set an error flag for per-frame control errors.
+			 */
+			if (claim(index, current, tag)) {
+				LOG(FCQueue, Warning)
+					<< "Obtained an uninitialised FrameContext for "
+					<< frame;
+				return frameContext;
+			}
+		}
+	}
+
+	FrameContext *peek(uint32_t frame)
+	{
+		const unsigned int index = frame & mask_;
+		if (waitIdle(index) != frame + 1ULL)
+			return nullptr;
+
+		return &contexts_[index];
 	}
 
 private:
+	/*
+	 * Each slot is tagged with the sequence number of the frame it stores,
+	 * plus one to reserve 0 for empty slots. The busy flag is set while the
+	 * slot is being initialised.
+	 */
+	static constexpr uint64_t kEmpty = 0;
+	static constexpr uint64_t kBusy = 1ULL << 63;
+
+	static unsigned int roundUpPow2(unsigned int size)
+	{
+		unsigned int pow2 = 1;
+		while (pow2 < size)
+			pow2 <<= 1;
+		return pow2;
+	}
+
+	uint64_t waitIdle(unsigned int index) const
+	{
+		uint64_t current = tags_[index].load(std::memory_order_acquire);
+		while (current & kBusy) {
+			std::this_thread::yield();
+			current = tags_[index].load(std::memory_order_acquire);
+		}
+
+		return current;
+	}
+
+	bool claim(unsigned int index, uint64_t current, uint64_t tag)
+	{
+		if (!tags_[index].compare_exchange_strong(current, tag | kBusy,
+							  std::memory_order_acquire))
+			return false;
+
+		init(contexts_[index], tag - 1);
+		tags_[index].store(tag, std::memory_order_release);
+		return true;
+	}
+
+	void overflow(uint32_t frame, uint64_t newer) const
+	{
+		LOG(FCQueue, Fatal)
+			<< "Frame context for " << frame
+			<< " has been overwritten by " << newer;
+	}
+
 	void init(FrameContext &frameContext, const uint32_t frame)
 	{
 		frameContext = {};
@@ -111,6 +197,8 @@ private:
 	}
 
 	std::vector<FrameContext> contexts_;
+	std::vector<std::atomic<uint64_t>> tags_;
+	const unsigned int mask_;
 };
 
 } /* namespace ipa */
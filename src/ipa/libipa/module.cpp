@@ -94,9 +94,71 @@ namespace ipa {
  * algorithms. The configuration data is expected to be correct, any error
  * causes the function to fail and return immediately.
  *
+ * Once all algorithms are created, they are organized in processing stages
+ * according to their process() dependencies, as declared through
+ * Algorithm::setProcessDependencies(). If the LIBCAMERA_IPA_ALGORITHM_THREADS
+ * environment variable is set, its value is passed to setProcessThreads().
+ *
  * \return 0 on success, or a negative error code on failure
  */
 
+/**
+ * \fn Module::setProcessThreads()
+ * \brief Set the number of threads used to process algorithms
+ * \param[in] threads The number of threads
+ *
+ * When \a threads is larger than 1, processAlgorithms() runs the process()
+ * function of independent algorithms concurrently on a pool of \a threads
+ * threads, including the calling thread. Otherwise, or if no algorithm can run
+ * concurrently with another one, algorithms are processed sequentially in the
+ * calling thread, which is the default.
+ */
+
+/**
+ * \fn Module::processAlgorithms()
+ * \brief Process ISP statistics with all algorithms
+ * \param[in] context The shared IPA context
+ * \param[in] frame The frame context sequence number
+ * \param[in] frameContext The current frame's context
+ * \param[in] stats The IPA statistics and ISP results
+ * \param[out] metadata Metadata for the frame, to be filled by the algorithms
+ * \param[in] filter Optional function to select the algorithms to process
+ *
+ * This function calls the process() function of all algorithms for which the
+ * \a filter returns true, or of all algorithms if no \a filter is given, and
+ * records their execution time.
+ *
+ * When processing with multiple threads has been enabled with
+ * setProcessThreads(), algorithms are processed in stages. All algorithms
+ * within a stage are independent and are processed concurrently, and a stage
+ * is only started once the previous stage has completed. The resulting
+ * \a metadata is identical to sequential processing.
+ */
+
+/**
+ * \fn Module::setTimingBudget()
+ * \brief Set the time budget for the per-frame phases of all algorithms
+ * \param[in] budget The time budget, typically the frame duration
+ *
+ * Executions of the queueRequest, prepare and process phases of an algorithm
+ * that exceed the \a budget are counted as overruns in the algorithm timing
+ * statistics.
+ */
+
+/**
+ * \fn Module::resetTimings()
+ * \brief Reset the execution time statistics of all algorithms
+ */
+
+/**
+ * \fn Module::logTimings()
+ * \brief Log the execution time statistics of all algorithms
+ *
+ * The minimum, average, 99th percentile and maximum execution time of each
+ * phase of each algorithm are logged with the Debug level. A warning is
+ * additionally logged for algorithms that have exceeded their time budget.
+ */
+
 /**
  * \fn Module::registerAlgorithm()
  * \brief Add an algorithm factory class to the list of available algorithms
@@ -7,17 +7,24 @@
 
 #pragma once
 
+#include <algorithm>
+#include <functional>
 #include <list>
 #include <memory>
+#include <stdlib.h>
 #include <string>
 #include <vector>
 
 #include <libcamera/base/log.h>
 #include <libcamera/base/utils.h>
 
+#include <libcamera/controls.h>
+
 #include "libcamera/internal/yaml_parser.h"
 
 #include "algorithm.h"
+#include "thread_pool.h"
+#include "timing.h"
 
 namespace libcamera {
 
@@ -62,9 +69,125 @@ public:
 			}
 		}
 
+		scheduleAlgorithms();
+
+		const char *threads = utils::secure_getenv("LIBCAMERA_IPA_ALGORITHM_THREADS");
+		if (threads)
+			setProcessThreads(strtoul(threads, nullptr, 10));
+
 		return 0;
 	}
 
+	void setProcessThreads(unsigned int threads)
+	{
+		/* The calling thread runs tasks too, don't count it as a worker. */
+		if (threads > 1 && stages_.size() < algorithms_.size())
+			threadPool_ = std::make_unique<ThreadPool>(threads - 1);
+		else
+			threadPool_.reset();
+
+		LOG(IPAModuleAlgo, Debug)
+			<< "Processing " << algorithms_.size() << " algorithms in "
+			<< stages_.size() << " stages with "
+			<< (threadPool_ ? threadPool_->size() + 1 : 1) << " threads";
+	}
+
+	void processAlgorithms(Context &context, const uint32_t frame,
+			       FrameContext &frameContext, const Stats *stats,
+			       ControlList &metadata,
+			       const std::function<bool(const Algorithm<Module> *)> &filter = {})
+	{
+		if (!threadPool_) {
+			for (auto const &algo : algorithms_) {
+				if (filter && !filter(algo.get()))
+					continue;
+
+				ScopedTiming timing(algo->timings().process);
+				algo->process(context, frame, frameContext, stats, metadata);
+			}
+
+			return;
+		}
+
+		/*
+		 * Concurrent algorithms store their metadata in private lists,
+		 * merged in the algorithms order once all stages complete to
+		 * produce the same result as sequential processing.
+		 */
+		if (stageMetadata_.size() != algorithms_.size()) {
+			ControlList list(metadata);
+			list.clear();
+			stageMetadata_.assign(algorithms_.size(), list);
+		}
+
+		ProcessArgs args{ context, frame, frameContext, stats, filter, nullptr };
+		std::function<void(unsigned int)> task = [this, &args](unsigned int i) {
+			const ScheduledAlgorithm &entry = (*args.stage)[i];
+			if (args.filter && !args.filter(entry.algorithm))
+				return;
+
+			ControlList &list = stageMetadata_[entry.index];
+			list.clear();
+
+			ScopedTiming timing(entry.algorithm->timings().process);
+			entry.algorithm->process(args.context, args.frame,
+						 args.frameContext, args.stats,
+						 list);
+		};
+
+		for (const std::vector<ScheduledAlgorithm> &stage : stages_) {
+			args.stage = &stage;
+			threadPool_->run(stage.size(), task);
+		}
+
+		for (auto const &[i, algo] : utils::enumerate(algorithms_)) {
+			if (filter && !filter(algo.get()))
+				continue;
+
+			for (const auto &[id, value] : stageMetadata_[i])
+				metadata.set(id, value);
+		}
+	}
+
+	void setTimingBudget(utils::Duration budget)
+	{
+		for (auto const &algo : algorithms_)
+			algo->timings().setBudget(budget);
+	}
+
+	void resetTimings()
+	{
+		for (auto const &algo : algorithms_)
+			algo->timings().reset();
+	}
+
+	void logTimings() const
+	{
+		for (auto const &algo : algorithms_) {
+			const AlgorithmTimings &timings = algo->timings();
+
+			LOG(IPAModuleAlgo, Debug)
+				<< "Algorithm '" << algo->name() << "' timings:";
+			LOG(IPAModuleAlgo, Debug)
+				<< "  configure:    " << timings.configure.toString();
+			LOG(IPAModuleAlgo, Debug)
+				<< "  queueRequest: " << timings.queueRequest.toString();
+			LOG(IPAModuleAlgo, Debug)
+				<< "  prepare:      " << timings.prepare.toString();
+			LOG(IPAModuleAlgo, Debug)
+				<< "  process:      " << timings.process.toString();
+
+			unsigned int overruns = timings.queueRequest.overruns()
+					      + timings.prepare.overruns()
+					      + timings.process.overruns();
+			if (overruns)
+				LOG(IPAModuleAlgo, Warning)
+					<< "Algorithm '" << algo->name() << "' exceeded the "
+					<< timings.process.budget() << " frame budget "
+					<< overruns << " times";
+		}
+	}
+
 	static void registerAlgorithm(AlgorithmFactoryBase<Module> *factory)
 	{
 		factories().push_back(factory);
@@ -91,6 +214,8 @@ private:
 		LOG(IPAModuleAlgo, Debug)
 			<< "Instantiated algorithm '" << name << "'";
 
+		algo->name_ = name;
+
 		algorithms_.push_back(std::move(algo));
 		return 0;
 	}
@@ -116,7 +241,77 @@ private:
 		return factories;
 	}
 
+	struct ScheduledAlgorithm {
+		Algorithm<Module> *algorithm;
+		unsigned int index;
+	};
+
+	struct ProcessArgs {
+		Context &context;
+		const uint32_t frame;
+		FrameContext &frameContext;
+		const Stats *stats;
+		const std::function<bool(const Algorithm<Module> *)> &filter;
+		const std::vector<ScheduledAlgorithm> *stage;
+	};
+
+	static bool dependsOn(const Algorithm<Module> *algo,
+			      const Algorithm<Module> *other)
+	{
+		const auto &dependencies = algo->processDependencies();
+		if (!dependencies)
+			return true;
+
+		return std::find(dependencies->begin(), dependencies->end(),
+				 other->name()) != dependencies->end();
+	}
+
+	void scheduleAlgorithms()
+	{
+		std::vector<Algorithm<Module> *> list;
+		std::vector<unsigned int> levels;
+
+		stages_.clear();
+
+		/*
+		 * Assign each algorithm to the first stage that follows all the
+		 * stages of the preceding algorithms it interacts with.
+		 */
+		for (auto const &algo : algorithms_) {
+			const auto &dependencies = algo->processDependencies();
+			for (const std::string &name : dependencies.value_or(std::vector<std::string>{})) {
+				if (std::none_of(algorithms_.begin(), algorithms_.end(),
+						 [&](auto const &a) { return a->name() == name; }))
+					LOG(IPAModuleAlgo, Debug)
+						<< "Algorithm '" << algo->name()
+						<< "' depends on unused algorithm '"
+						<< name << "'";
+			}
+
+			unsigned int level = 0;
+
+			for (auto const &[i, other] : utils::enumerate(list)) {
+				if (dependsOn(algo.get(), other) ||
+				    dependsOn(other, algo.get()))
+					level = std::max(level, levels[i] + 1);
+			}
+
+			if (level >= stages_.size())
+				stages_.resize(level + 1);
+
+			stages_[level].push_back({ algo.get(),
+						   static_cast<unsigned int>(list.size()) });
+
+			list.push_back(algo.get());
+			levels.push_back(level);
+		}
+	}
+
 	std::list<std::unique_ptr<Algorithm<Module>>> algorithms_;
+
+	std::vector<std::vector<ScheduledAlgorithm>> stages_;
+	std::vector<ControlList> stageMetadata_;
+	std::unique_ptr<ThreadPool> threadPool_;
 };
 
 } /* namespace ipa */
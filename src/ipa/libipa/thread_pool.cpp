@@ -0,0 +1,149 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+/*
+ * Copyright (C) 2022, Ideas On Board
+ *
+ * thread_pool.cpp - Pool of worker threads for IPA algorithms
+ */
+
+#include "thread_pool.h"
+
+/**
+ * \file thread_pool.h
+ * \brief Pool of worker threads for IPA algorithms
+ */
+
+namespace libcamera {
+
+namespace ipa {
+
+/**
+ * \class ThreadPool
+ * \brief Execute batches of independent tasks on a fixed set of threads
+ *
+ * The ThreadPool class runs batches of independent tasks concurrently on a
+ * fixed number of worker threads. It is meant to be used by IPA modules to run
+ * algorithms that don't depend on each other in parallel, within the time
+ * budget of a frame.
+ *
+ * Tasks are submitted in batches with run(), which blocks until all tasks of
+ * the batch have completed. The calling thread participates in the execution
+ * of the tasks, a pool of N threads thus runs up to N + 1 tasks concurrently.
+ * A pool without any worker thread runs all tasks sequentially in the calling
+ * thread.
+ *
+ * Worker threads are created when the pool is constructed and live until the
+ * pool is destroyed, submitting a batch doesn't create threads or allocate
+ * memory.
+ */
+
+/**
+ * \brief Construct a thread pool
+ * \param[in] threads The number of worker threads
+ */
+ThreadPool::ThreadPool(unsigned int threads)
+	: task_(nullptr), count_(0), next_(0), pending_(0), stop_(false)
+{
+	threads_.reserve(threads);
+	for (unsigned int i = 0; i < threads; ++i)
+		threads_.emplace_back(&ThreadPool::worker, this);
+}
+
+/**
+ * \brief Destroy the thread pool
+ *
+ * Wait for all worker threads to complete. The pool shall not be destroyed
+ * while a run() call is in progress.
+ */
+ThreadPool::~ThreadPool()
+{
+	{
+		MutexLocker locker(mutex_);
+		stop_ = true;
+	}
+
+	workCv_.notify_all();
+
+	for (std::thread &thread : threads_)
+		thread.join();
+}
+
+/**
+ * \fn ThreadPool::size()
+ * \brief Retrieve the number of worker threads in the pool
+ * \return The number of worker threads
+ */
+
+/**
+ * \brief Run a batch of tasks and wait for their completion
+ * \param[in] count The number of tasks in the batch
+ * \param[in] task The task function
+ *
+ * The \a task function is called \a count times, with the task index in the
+ * [0, \a count[ range as argument. Calls are distributed over the worker
+ * threads and the calling thread, in an unspecified order. The function
+ * returns when all calls have completed.
+ *
+ * The run() function isn't reentrant, and shall only be called from a single
+ * thread at a time.
+ */
+void ThreadPool::run(unsigned int count, const std::function<void(unsigned int)> &task)
+{
+	if (threads_.empty() || count <= 1) {
+		for (unsigned int i = 0; i < count; ++i)
+			task(i);
+		return;
+	}
+
+	MutexLocker locker(mutex_);
+
+	task_ = &task;
+	count_ = count;
+	next_ = 0;
+	pending_ = count;
+
+	workCv_.notify_all();
+
+	execute(locker);
+
+	doneCv_.wait(locker, [&]() LIBCAMERA_TSA_REQUIRES(mutex_) {
+		return pending_ == 0;
+	});
+
+	task_ = nullptr;
+	count_ = 0;
+}
+
+void ThreadPool::execute(MutexLocker &locker)
+{
+	while (next_ < count_) {
+		const std::function<void(unsigned int)> &task = *task_;
+		unsigned int index = next_++;
+
+		locker.unlock();
+		task(index);
+		locker.lock();
+
+		if (--pending_ == 0)
+			doneCv_.notify_one();
+	}
+}
+
+void ThreadPool::worker()
+{
+	MutexLocker locker(mutex_);
+
+	while (true) {
+		workCv_.wait(locker, [&]() LIBCAMERA_TSA_REQUIRES(mutex_) {
+			return stop_ || next_ < count_;
+		});
+
+		if (stop_)
+			return;
+
+		execute(locker);
+	}
+}
+
+} /* namespace ipa */
+
+} /* namespace libcamera */
@@ -0,0 +1,52 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+/*
+ * Copyright (C) 2022, Ideas On Board
+ *
+ * thread_pool.h - Pool of worker threads for IPA algorithms
+ */
+
+#pragma once
+
+#include <functional>
+#include <thread>
+#include <vector>
+
+#include <libcamera/base/class.h>
+#include <libcamera/base/mutex.h>
+
+namespace libcamera {
+
+namespace ipa {
+
+class ThreadPool
+{
+public:
+	ThreadPool(unsigned int threads);
+	~ThreadPool();
+
+	unsigned int size() const { return threads_.size(); }
+
+	void run(unsigned int count, const std::function<void(unsigned int)> &task);
+
+private:
+	LIBCAMERA_DISABLE_COPY_AND_MOVE(ThreadPool)
+
+	void worker();
+	void execute(MutexLocker &locker) LIBCAMERA_TSA_REQUIRES(mutex_);
+
+	std::vector<std::thread> threads_;
+
+	Mutex mutex_;
+	ConditionVariable workCv_;
+	ConditionVariable doneCv_;
+
+	const std::function<void(unsigned int)> *task_ LIBCAMERA_TSA_GUARDED_BY(mutex_);
+	unsigned int count_ LIBCAMERA_TSA_GUARDED_BY(mutex_);
+	unsigned int next_ LIBCAMERA_TSA_GUARDED_BY(mutex_);
+	unsigned int pending_ LIBCAMERA_TSA_GUARDED_BY(mutex_);
+	bool stop_ LIBCAMERA_TSA_GUARDED_BY(mutex_);
+};
+
+} /* namespace ipa */
+
+} /* namespace libcamera */
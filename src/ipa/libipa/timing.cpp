@@ -0,0 +1,251 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+/*
+ * Copyright (C) 2022, Ideas On Board
+ *
+ * timing.cpp - Execution time statistics for IPA algorithms
+ */
+
+#include "timing.h"
+
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+
+/**
+ * \file timing.h
+ * \brief Execution time statistics for IPA algorithms
+ */
+
+namespace libcamera {
+
+namespace ipa {
+
+/**
+ * \class TimingStats
+ * \brief Accumulate execution time statistics for an operation
+ *
+ * The TimingStats class records the duration of successive executions of an
+ * operation, such as one phase of an IPA algorithm, and computes the minimum,
+ * maximum, average and percentile durations. Percentiles are computed over a
+ * fixed-size window of the most recent samples, while all other statistics
+ * cover all samples recorded since the last reset().
+ *
+ * An optional time budget can be set with setBudget(). Every sample that
+ * exceeds the budget is counted as an overrun. IPA modules typically set the
+ * budget to the frame duration to detect algorithms that can't keep up with
+ * the frame rate.
+ *
+ * Recording a sample doesn't allocate memory, and is cheap enough to be
+ * performed for every frame.
+ */
+
+TimingStats::TimingStats()
+	: budget_{}
+{
+	reset();
+}
+
+/**
+ * \brief Reset all statistics
+ *
+ * The time budget is preserved.
+ */
+void TimingStats::reset()
+{
+	min_ = {};
+	max_ = {};
+	total_ = {};
+	count_ = 0;
+	overruns_ = 0;
+}
+
+/**
+ * \brief Record the duration of one execution of the operation
+ * \param[in] duration The execution duration
+ */
+void TimingStats::record(utils::Duration duration)
+{
+	history_[count_ % kHistorySize] = duration;
+
+	if (!count_ || duration < min_)
+		min_ = duration;
+	if (duration > max_)
+		max_ = duration;
+
+	total_ += duration;
+	count_++;
+
+	if (budget_ && duration > budget_)
+		overruns_++;
+}
+
+/**
+ * \fn TimingStats::setBudget()
+ * \brief Set the time budget for the operation
+ * \param[in] budget The time budget, or 0 to disable overrun detection
+ */
+
+/**
+ * \fn TimingStats::budget()
+ * \brief Retrieve the time budget for the operation
+ * \return The time budget, or 0 if overrun detection is disabled
+ */
+
+/**
+ * \fn TimingStats::count()
+ * \brief Retrieve the number of samples recorded since the last reset
+ * \return The number of samples
+ */
+
+/**
+ * \fn TimingStats::overruns()
+ * \brief Retrieve the number of samples that exceeded the time budget
+ * \return The number of overruns
+ */
+
+/**
+ * \fn TimingStats::min()
+ * \brief Retrieve the shortest recorded duration
+ * \return The minimum duration, or 0 if no sample has been recorded
+ */
+
+/**
+ * \fn TimingStats::max()
+ * \brief Retrieve the longest recorded duration
+ * \return The maximum duration, or 0 if no sample has been recorded
+ */
+
+/**
+ * \brief Retrieve the average duration
+ * \return The average duration, or 0 if no sample has been recorded
+ */
+utils::Duration TimingStats::average() const
+{
+	if (!count_)
+		return {};
+
+	return total_ / count_;
+}
+
+/**
+ * \brief Compute a percentile of the recent durations
+ * \param[in] p The percentile, in the [0, 100] range
+ *
+ * The percentile is computed over the last samples only, up to an
+ * implementation-defined window size.
+ *
+ * \return The \a p-th percentile duration, or 0 if no sample has been recorded
+ */
+utils::Duration TimingStats::percentile(double p) const
+{
+	unsigned int size = std::min(count_, kHistorySize);
+	if (!size)
+		return {};
+
+	std::array<utils::Duration, kHistorySize> samples;
+	std::copy(history_.begin(), history_.begin() + size, samples.begin());
+
+	unsigned int index = std::ceil(std::clamp(p, 0.0, 100.0) / 100.0 * size);
+	index = std::clamp(index, 1U, size) - 1;
+
+	std::nth_element(samples.begin(), samples.begin() + index,
+			 samples.begin() + size);
+	return samples[index];
+}
+
+/**
+ * \brief Assemble and return a string describing the statistics
+ * \return A string describing the statistics
+ */
+std::string TimingStats::toString() const
+{
+	std::stringstream ss;
+
+	ss << "count " << count_;
+
+	if (!count_)
+		return ss.str();
+
+	ss << " min " << min_
+	   << " avg " << average()
+	   << " p99 " << percentile(99)
+	   << " max " << max_;
+
+	if (budget_)
+		ss << " overruns " << overruns_;
+
+	return ss.str();
+}
+
+/**
+ * \struct AlgorithmTimings
+ * \brief Execution time statistics for all phases of an algorithm
+ *
+ * \var AlgorithmTimings::configure
+ * \brief Statistics for the Algorithm::configure() function
+ *
+ * \var AlgorithmTimings::queueRequest
+ * \brief Statistics for the Algorithm::queueRequest() function
+ *
+ * \var AlgorithmTimings::prepare
+ * \brief Statistics for the Algorithm::prepare() function
+ *
+ * \var AlgorithmTimings::process
+ * \brief Statistics for the Algorithm::process() function
+ */
+
+/**
+ * \brief Reset the statistics of all phases
+ */
+void AlgorithmTimings::reset()
+{
+	configure.reset();
+	queueRequest.reset();
+	prepare.reset();
+	process.reset();
+}
+
+/**
+ * \brief Set the time budget for the per-frame phases
+ * \param[in] budget The time budget
+ *
+ * Set the time budget of the queueRequest, prepare and process phases, which
+ * run once per frame. The configure phase has no budget.
+ */
+void AlgorithmTimings::setBudget(utils::Duration budget)
+{
+	queueRequest.setBudget(budget);
+	prepare.setBudget(budget);
+	process.setBudget(budget);
+}
+
+/**
+ * \class ScopedTiming
+ * \brief Measure the execution time of a scope
+ *
+ * The ScopedTiming class records in a TimingStats the time elapsed between its
+ * construction and destruction. It is meant to be instantiated on the stack
+ * around the code to be measured:
+ *
+ * \code{.cpp}
+ * for (auto const &algo : algorithms()) {
+ *	ScopedTiming timing(algo->timings().process);
+ *	algo->process(context_, frame, frameContext, stats, metadata);
+ * }
+ * \endcode
+ */
+
+/**
+ * \fn ScopedTiming::ScopedTiming()
+ * \brief Start measuring time
+ * \param[in] stats The statistics in which to record the elapsed time
+ */
+
+/**
+ * \fn ScopedTiming::~ScopedTiming()
+ * \brief Stop measuring time and record the elapsed time
+ */
+
+} /* namespace ipa */
+
+} /* namespace libcamera */
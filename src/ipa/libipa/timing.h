@@ -0,0 +1,83 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+/*
+ * Copyright (C) 2022, Ideas On Board
+ *
+ * timing.h - Execution time statistics for IPA algorithms
+ */
+
+#pragma once
+
+#include <array>
+#include <string>
+
+#include <libcamera/base/utils.h>
+
+namespace libcamera {
+
+namespace ipa {
+
+class TimingStats
+{
+public:
+	TimingStats();
+
+	void reset();
+	void record(utils::Duration duration);
+
+	void setBudget(utils::Duration budget) { budget_ = budget; }
+	utils::Duration budget() const { return budget_; }
+
+	unsigned int count() const { return count_; }
+	unsigned int overruns() const { return overruns_; }
+
+	utils::Duration min() const { return min_; }
+	utils::Duration max() const { return max_; }
+	utils::Duration average() const;
+	utils::Duration percentile(double p) const;
+
+	std::string toString() const;
+
+private:
+	static constexpr unsigned int kHistorySize = 128;
+
+	std::array<utils::Duration, kHistorySize> history_;
+
+	utils::Duration budget_;
+	utils::Duration min_;
+	utils::Duration max_;
+	utils::Duration total_;
+	unsigned int count_;
+	unsigned int overruns_;
+};
+
+struct AlgorithmTimings {
+	void reset();
+	void setBudget(utils::Duration budget);
+
+	TimingStats configure;
+	TimingStats queueRequest;
+	TimingStats prepare;
+	TimingStats process;
+};
+
+class ScopedTiming
+{
+public:
+	ScopedTiming(TimingStats &stats)
+		: stats_(stats), start_(utils::clock::now())
+	{
+	}
+
+	~ScopedTiming()
+	{
+		stats_.record(utils::clock::now() - start_);
+	}
+
+private:
+	TimingStats &stats_;
+	utils::time_point start_;
+};
+
+} /* namespace ipa */
+
+} /* namespace libcamera */
@@ -17,6 +17,9 @@
 
 using namespace RPiController;
 using namespace libcamera;
+using libcamera::ipa::AlgorithmTimings;
+using libcamera::ipa::ScopedTiming;
+using libcamera::utils::Duration;
 
 LOG_DEFINE_CATEGORY(RPiController)
 
@@ -88,6 +91,7 @@ int Controller::createAlgorithm(const std::string &name, const YamlObject &param
 		return ret;
 
 	algorithms_.push_back(AlgorithmPtr(algo));
+	timings_.emplace_back();
 	return 0;
 }
 
@@ -99,23 +103,38 @@ void Controller::initialise()
 
 void Controller::switchMode(CameraMode const &cameraMode, Metadata *metadata)
 {
-	for (auto &algo : algorithms_)
-		algo->switchMode(cameraMode, metadata);
+	/*
+	 * Per-frame algorithm execution times are accounted against the
+	 * shortest frame duration of the new mode.
+	 */
+	Duration frameDuration = cameraMode.minFrameLength * cameraMode.minLineLength;
+
+	for (unsigned int i = 0; i < algorithms_.size(); i++) {
+		timings_[i].reset();
+		timings_[i].setBudget(frameDuration);
+
+		ScopedTiming timing(timings_[i].configure);
+		algorithms_[i]->switchMode(cameraMode, metadata);
+	}
 	switchModeCalled_ = true;
 }
 
 void Controller::prepare(Metadata *imageMetadata)
 {
 	assert(switchModeCalled_);
-	for (auto &algo : algorithms_)
-		algo->prepare(imageMetadata);
+	for (unsigned int i = 0; i < algorithms_.size(); i++) {
+		ScopedTiming timing(timings_[i].prepare);
+		algorithms_[i]->prepare(imageMetadata);
+	}
 }
 
 void Controller::process(StatisticsPtr stats, Metadata *imageMetadata)
 {
 	assert(switchModeCalled_);
-	for (auto &algo : algorithms_)
-		algo->process(stats, imageMetadata);
+	for (unsigned int i = 0; i < algorithms_.size(); i++) {
+		ScopedTiming timing(timings_[i].process);
+		algorithms_[i]->process(stats, imageMetadata);
+	}
 }
 
 Metadata &Controller::getGlobalMetadata()
@@ -142,3 +161,27 @@ Algorithm *Controller::getAlgorithm(std::string const &name) const
 	}
 	return nullptr;
 }
+
+void Controller::logTimings() const
+{
+	for (unsigned int i = 0; i < algorithms_.size(); i++) {
+		const AlgorithmTimings &timings = timings_[i];
+
+		LOG(RPiController, Debug)
+			<< "Algorithm \"" << algorithms_[i]->name() << "\" timings:";
+		LOG(RPiController, Debug)
+			<< "  switchMode: " << timings.configure.toString();
+		LOG(RPiController, Debug)
+			<< "  prepare:    " << timings.prepare.toString();
+		LOG(RPiController, Debug)
+			<< "  process:    " << timings.process.toString();
+
+		unsigned int overruns = timings.prepare.overruns() +
+					timings.process.overruns();
+		if (overruns)
+			LOG(RPiController, Warning)
+				<< "Algorithm \"" << algorithms_[i]->name()
+				<< "\" exceeded the " << timings.process.budget()
+				<< " frame budget " << overruns << " times";
+	}
+}
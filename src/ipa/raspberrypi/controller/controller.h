@@ -19,6 +19,8 @@
 
 #include "libcamera/internal/yaml_parser.h"
 
+#include "libipa/timing.h"
+
 #include "camera_mode.h"
 #include "device_status.h"
 #include "metadata.h"
@@ -48,12 +50,15 @@ public:
 	void process(StatisticsPtr stats, Metadata *imageMetadata);
 	Metadata &getGlobalMetadata();
 	Algorithm *getAlgorithm(std::string const &name) const;
+	void logTimings() const;
 
 protected:
 	int createAlgorithm(const std::string &name, const libcamera::YamlObject &params);
 
 	Metadata globalMetadata_;
 	std::vector<AlgorithmPtr> algorithms_;
+	/* Execution time statistics, one entry per algorithm. */
+	std::vector<libcamera::ipa::AlgorithmTimings> timings_;
 	bool switchModeCalled_;
 };
 
@@ -117,7 +117,7 @@ public:
 
 	int init(const IPASettings &settings, IPAInitResult *result) override;
 	void start(const ControlList &controls, StartConfig *startConfig) override;
-	void stop() override {}
+	void stop() override;
 
 	int configure(const IPACameraSensorInfo &sensorInfo,
 		      const std::map<unsigned int, IPAStream> &streamConfig,
@@ -325,6 +325,11 @@ void IPARPi::start(const ControlList &controls, StartConfig *startConfig)
 	lastRunTimestamp_ = 0;
 }
 
+void IPARPi::stop()
+{
+	controller_.logTimings();
+}
+
 void IPARPi::setMode(const IPACameraSensorInfo &sensorInfo)
 {
 	mode_.bitdepth = sensorInfo.bitsPerPixel;
@@ -493,8 +498,14 @@ void IPARPi::mapBuffers(const std::vector<IPABuffer> &buffers)
 {
 	for (const IPABuffer &buffer : buffers) {
 		const FrameBuffer fb(buffer.planes);
+		/*
+		 * The pipeline handler keeps the stats and embedded data
+		 * buffers across mode switches, cache the mappings to avoid
+		 * remapping them every time the camera is reconfigured.
+		 */
 		buffers_.emplace(buffer.id,
-				 MappedFrameBuffer(&fb, MappedFrameBuffer::MapFlag::ReadWrite));
+				 MappedFrameBuffer(&fb, MappedFrameBuffer::MapFlag::ReadWrite |
+							MappedFrameBuffer::MapFlag::Cached));
 	}
 }
 
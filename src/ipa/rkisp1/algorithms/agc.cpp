@@ -17,6 +17,8 @@
 #include <libcamera/control_ids.h>
 #include <libcamera/ipa/core_ipa_interface.h>
 
+#include "libcamera/internal/yaml_parser.h"
+
 #include "libipa/histogram.h"
 
 /**
@@ -32,6 +34,11 @@ namespace ipa::rkisp1::algorithms {
 /**
  * \class Agc
  * \brief A mean-based auto-exposure algorithm
+ *
+ * By default, the target exposure is filtered to smooth changes. When the
+ * "predictive" tuning parameter is set, exposure changes are instead scheduled
+ * by an ExposurePredictor that accounts for the sensor exposure and gain
+ * delays, converging in a few frames.
  */
 
 LOG_DEFINE_CATEGORY(RkISP1Agc)
@@ -60,9 +67,21 @@ static constexpr double kEvGainTarget = 0.5;
 static constexpr double kRelativeLuminanceTarget = 0.4;
 
 Agc::Agc()
-	: frameCount_(0), numCells_(0), numHistBins_(0), filteredExposure_(0s)
+	: frameCount_(0), numCells_(0), numHistBins_(0), filteredExposure_(0s),
+	  predictive_(false)
 {
 	supportsRaw_ = true;
+	setProcessDependencies({});
+}
+
+/**
+ * \copydoc libcamera::ipa::Algorithm::init
+ */
+int Agc::init([[maybe_unused]] IPAContext &context, const YamlObject &tuningData)
+{
+	predictive_ = tuningData["predictive"].get<bool>(false);
+
+	return 0;
 }
 
 /**
@@ -106,6 +125,9 @@ int Agc::configure(IPAContext &context, const IPACameraSensorInfo &configInfo)
 	context.configuration.agc.measureWindow.h_size = 3 * configInfo.outputSize.width / 4;
 	context.configuration.agc.measureWindow.v_size = 3 * configInfo.outputSize.height / 4;
 
+	predictor_.configure(std::max(context.configuration.sensor.exposureDelay,
+				      context.configuration.sensor.gainDelay));
+
 	/*
 	 * \todo Use the upcoming per-frame context API that will provide a
 	 * frame index
@@ -239,11 +261,13 @@ utils::Duration Agc::filterExposure(utils::Duration exposureValue)
 /**
  * \brief Estimate the new exposure and gain values
  * \param[inout] context The shared IPA Context
+ * \param[in] frame The frame context sequence number
  * \param[in] frameContext The FrameContext for this frame
  * \param[in] yGain The gain calculated on the current brightness level
  * \param[in] iqMeanGain The gain calculated based on the relative luminance target
  */
-void Agc::computeExposure(IPAContext &context, IPAFrameContext &frameContext,
+void Agc::computeExposure(IPAContext &context, const uint32_t frame,
+			  IPAFrameContext &frameContext,
 			  double yGain, double iqMeanGain)
 {
 	IPASessionConfiguration &configuration = context.configuration;
@@ -298,12 +322,18 @@ void Agc::computeExposure(IPAContext &context, IPAFrameContext &frameContext,
 			      << ", maximum is " << maxTotalExposure;
 
 	/*
-	 * Divide the exposure value as new exposure and gain values.
+	 * Filter the exposure, or schedule it according to the sensor delays
+	 * in predictive mode.
 	 * \todo estimate if we need to desaturate
 	 */
-	exposureValue = filterExposure(exposureValue);
+	if (predictive_)
+		exposureValue = predictor_.update(frame, exposureValue);
+	else
+		exposureValue = filterExposure(exposureValue);
 
 	/*
+	 * Divide the exposure value as new exposure and gain values.
+	 *
 	 * Push the shutter time up to the maximum first, and only then
 	 * increase the gain.
 	 */
@@ -399,7 +429,7 @@ void Agc::fillMetadata(IPAContext &context, IPAFrameContext &frameContext,
  * Identify the current image brightness, and use that to estimate the optimal
  * new exposure and gain for the scene.
  */
-void Agc::process(IPAContext &context, [[maybe_unused]] const uint32_t frame,
+void Agc::process(IPAContext &context, const uint32_t frame,
 		  IPAFrameContext &frameContext, const rkisp1_stat_buffer *stats,
 		  ControlList &metadata)
 {
@@ -447,7 +477,7 @@ void Agc::process(IPAContext &context, [[maybe_unused]] const uint32_t frame,
 			break;
 	}
 
-	computeExposure(context, frameContext, yGain, iqMeanGain);
+	computeExposure(context, frame, frameContext, yGain, iqMeanGain);
 	frameCount_++;
 
 	fillMetadata(context, frameContext, metadata);
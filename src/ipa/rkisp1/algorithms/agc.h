@@ -13,6 +13,8 @@
 
 #include <libcamera/geometry.h>
 
+#include "libipa/exposure_predictor.h"
+
 #include "algorithm.h"
 
 namespace libcamera {
@@ -25,6 +27,7 @@ public:
 	Agc();
 	~Agc() = default;
 
+	int init(IPAContext &context, const YamlObject &tuningData) override;
 	int configure(IPAContext &context, const IPACameraSensorInfo &configInfo) override;
 	void queueRequest(IPAContext &context,
 			  const uint32_t frame,
@@ -39,7 +42,8 @@ public:
 		     ControlList &metadata) override;
 
 private:
-	void computeExposure(IPAContext &Context, IPAFrameContext &frameContext,
+	void computeExposure(IPAContext &Context, const uint32_t frame,
+			     IPAFrameContext &frameContext,
 			     double yGain, double iqMeanGain);
 	utils::Duration filterExposure(utils::Duration exposureValue);
 	double estimateLuminance(const rkisp1_cif_isp_ae_stat *ae, double gain);
@@ -53,6 +57,9 @@ private:
 	uint32_t numHistBins_;
 
 	utils::Duration filteredExposure_;
+
+	bool predictive_;
+	ExposurePredictor predictor_;
 };
 
 } /* namespace ipa::rkisp1::algorithms */
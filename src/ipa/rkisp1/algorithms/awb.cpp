@@ -37,6 +37,7 @@ constexpr double kMeanMinThreshold = 2.0;
 Awb::Awb()
 	: rgbMode_(false)
 {
+	setProcessDependencies({});
 }
 
 /**
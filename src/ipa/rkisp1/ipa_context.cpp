@@ -87,6 +87,12 @@ namespace libcamera::ipa::rkisp1 {
  *
  * \var IPASessionConfiguration::sensor.size
  * \brief Sensor output resolution
+ *
+ * \var IPASessionConfiguration::sensor.exposureDelay
+ * \brief Number of frames before an exposure time change takes effect
+ *
+ * \var IPASessionConfiguration::sensor.gainDelay
+ * \brief Number of frames before an analogue gain change takes effect
  */
 
 /**
@@ -43,6 +43,8 @@ struct IPASessionConfiguration {
 		int32_t defVBlank;
 		utils::Duration lineDuration;
 		Size size;
+		unsigned int exposureDelay;
+		unsigned int gainDelay;
 	} sensor;
 
 	struct {
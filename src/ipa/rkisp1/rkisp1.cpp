@@ -30,6 +30,7 @@
 
 #include "algorithms/algorithm.h"
 #include "libipa/camera_sensor_helper.h"
+#include "libipa/timing.h"
 
 #include "ipa_context.h"
 
@@ -207,6 +208,8 @@ int IPARkISP1::start()
 void IPARkISP1::stop()
 {
 	context_.frameContexts.clear();
+
+	logTimings();
 }
 
 int IPARkISP1::configure(const IPAConfigInfo &ipaConfig,
@@ -240,6 +243,8 @@ int IPARkISP1::configure(const IPAConfigInfo &ipaConfig,
 	context_.configuration.sensor.defVBlank = vBlank.def().get<int32_t>();
 	context_.configuration.sensor.size = info.outputSize;
 	context_.configuration.sensor.lineDuration = info.minLineLength * 1.0s / info.pixelRate;
+	context_.configuration.sensor.exposureDelay = camHelper_->exposureDelay();
+	context_.configuration.sensor.gainDelay = camHelper_->gainDelay();
 
 	/* Update the camera controls using the new sensor settings. */
 	updateControls(info, sensorControls_, ipaControls);
@@ -265,6 +270,14 @@ int IPARkISP1::configure(const IPAConfigInfo &ipaConfig,
 			return format.colourEncoding == PixelFormatInfo::ColourEncodingRAW;
 		});
 
+	/*
+	 * Account algorithm execution times against the shortest frame
+	 * duration of the sensor configuration.
+	 */
+	resetTimings();
+	setTimingBudget(info.minFrameLength *
+			context_.configuration.sensor.lineDuration);
+
 	for (auto const &a : algorithms()) {
 		Algorithm *algo = static_cast<Algorithm *>(a.get());
 
@@ -273,6 +286,7 @@ int IPARkISP1::configure(const IPAConfigInfo &ipaConfig,
 		if (algo->disabled_)
 			continue;
 
+		ScopedTiming timing(algo->timings().configure);
 		int ret = algo->configure(context_, info);
 		if (ret)
 			return ret;
@@ -289,7 +303,8 @@ void IPARkISP1::mapBuffers(const std::vector<IPABuffer> &buffers)
 					     std::forward_as_tuple(buffer.planes));
 		const FrameBuffer &fb = elem.first->second;
 
-		MappedFrameBuffer mappedBuffer(&fb, MappedFrameBuffer::MapFlag::ReadWrite);
+		MappedFrameBuffer mappedBuffer(&fb, MappedFrameBuffer::MapFlag::ReadWrite |
+						    MappedFrameBuffer::MapFlag::Cached);
 		if (!mappedBuffer.isValid()) {
 			LOG(IPARkISP1, Fatal) << "Failed to mmap buffer: "
 					      << strerror(mappedBuffer.error());
@@ -319,6 +334,8 @@ void IPARkISP1::queueRequest(const uint32_t frame, const ControlList &controls)
 		Algorithm *algo = static_cast<Algorithm *>(a.get());
 		if (algo->disabled_)
 			continue;
+
+		ScopedTiming timing(algo->timings().queueRequest);
 		algo->queueRequest(context_, frame, frameContext, controls);
 	}
 }
@@ -334,8 +351,10 @@ void IPARkISP1::fillParamsBuffer(const uint32_t frame, const uint32_t bufferId)
 	/* Prepare parameters buffer. */
 	memset(params, 0, sizeof(*params));
 
-	for (auto const &algo : algorithms())
+	for (auto const &algo : algorithms()) {
+		ScopedTiming timing(algo->timings().prepare);
 		algo->prepare(context_, frame, frameContext, params);
+	}
 
 	paramsBufferReady.emit(frame);
 }
@@ -361,12 +380,10 @@ void IPARkISP1::processStatsBuffer(const uint32_t frame, const uint32_t bufferId
 
 	ControlList metadata(controls::controls);
 
-	for (auto const &a : algorithms()) {
-		Algorithm *algo = static_cast<Algorithm *>(a.get());
-		if (algo->disabled_)
-			continue;
-		algo->process(context_, frame, frameContext, stats, metadata);
-	}
+	processAlgorithms(context_, frame, frameContext, stats, metadata,
+			  [](const auto *algo) {
+				  return !static_cast<const Algorithm *>(algo)->disabled_;
+			  });
 
 	setControls(frame);
 
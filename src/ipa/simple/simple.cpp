@@ -0,0 +1,292 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+/*
+ * Copyright (C) 2022, Google Inc.
+ *
+ * simple.cpp - Simple pipeline Image Processing Algorithm module
+ */
+
+#include <algorithm>
+#include <math.h>
+#include <memory>
+#include <stdint.h>
+
+#include <linux/v4l2-controls.h>
+
+#include <libcamera/base/log.h>
+
+#include <libcamera/controls.h>
+
+#include <libcamera/ipa/ipa_interface.h>
+#include <libcamera/ipa/ipa_module_info.h>
+#include <libcamera/ipa/simple_ipa_interface.h>
+
+#include "libipa/camera_sensor_helper.h"
+
+namespace libcamera {
+
+LOG_DEFINE_CATEGORY(IPASimple)
+
+namespace ipa::simple {
+
+/*
+ * The exposure is controlled to bring the mean sample value of the histogram,
+ * folded in five regions, to the middle of the range.
+ */
+static constexpr unsigned int kExposureRegions = 5;
+static constexpr double kExposureTarget = 2.5;
+static constexpr double kExposureTolerance = 0.2;
+
+/* Limit the exposure change per step to avoid oscillations. */
+static constexpr double kMaxExposureStep = 2.0;
+
+/* Zones with a saturated green average are ignored for white balance. */
+static constexpr uint64_t kSaturationLevel = 240;
+
+static constexpr double kMinColourGain = 0.25;
+static constexpr double kMaxColourGain = 4.0;
+
+class IPASimple : public IPASimpleInterface
+{
+public:
+	IPASimple();
+
+	int init(const IPASettings &settings,
+		 const ControlInfoMap &sensorControls) override;
+	int start() override;
+	void stop() override;
+
+	int configure(const ControlInfoMap &sensorControls) override;
+
+	void processStats(uint32_t frame, const SwStatistics &stats,
+			  const ControlList &sensorControls) override;
+
+private:
+	double gain(int32_t code) const;
+	int32_t gainCode(double gain) const;
+
+	void updateExposure(const SwStatistics &stats,
+			    const ControlList &sensorControls);
+	void updateWhiteBalance(const SwStatistics &stats);
+
+	std::unique_ptr<CameraSensorHelper> camHelper_;
+
+	int32_t minExposure_;
+	int32_t maxExposure_;
+	int32_t minGain_;
+	int32_t maxGain_;
+
+	/* Number of frames to skip until the last controls take effect. */
+	unsigned int settleFrames_;
+	unsigned int skipFrames_;
+};
+
+IPASimple::IPASimple()
+	: minExposure_(0), maxExposure_(0), minGain_(0), maxGain_(0),
+	  settleFrames_(0), skipFrames_(0)
+{
+}
+
+int IPASimple::init(const IPASettings &settings,
+		    const ControlInfoMap &sensorControls)
+{
+	/*
+	 * The sensor helper is optional, fall back to a linear gain model
+	 * when the sensor isn't known.
+	 */
+	camHelper_ = CameraSensorHelperFactoryBase::create(settings.sensorModel);
+	if (!camHelper_)
+		LOG(IPASimple, Warning)
+			<< "No camera sensor helper for " << settings.sensorModel
+			<< ", assuming linear gain";
+
+	if (sensorControls.find(V4L2_CID_EXPOSURE) == sensorControls.end() ||
+	    sensorControls.find(V4L2_CID_ANALOGUE_GAIN) == sensorControls.end()) {
+		LOG(IPASimple, Error) << "Sensor doesn't support exposure control";
+		return -EINVAL;
+	}
+
+	settleFrames_ = camHelper_
+		      ? std::max(camHelper_->exposureDelay(),
+				 camHelper_->gainDelay()) + 1
+		      : 3;
+
+	return 0;
+}
+
+int IPASimple::start()
+{
+	skipFrames_ = settleFrames_;
+	return 0;
+}
+
+void IPASimple::stop()
+{
+}
+
+int IPASimple::configure(const ControlInfoMap &sensorControls)
+{
+	const auto exposure = sensorControls.find(V4L2_CID_EXPOSURE);
+	const auto gain = sensorControls.find(V4L2_CID_ANALOGUE_GAIN);
+	if (exposure == sensorControls.end() || gain == sensorControls.end())
+		return -EINVAL;
+
+	minExposure_ = std::max(exposure->second.min().get<int32_t>(), 1);
+	maxExposure_ = exposure->second.max().get<int32_t>();
+	minGain_ = std::max(gain->second.min().get<int32_t>(), 1);
+	maxGain_ = gain->second.max().get<int32_t>();
+
+	LOG(IPASimple, Debug)
+		<< "Exposure " << minExposure_ << "-" << maxExposure_
+		<< ", gain " << minGain_ << "-" << maxGain_;
+
+	return 0;
+}
+
+double IPASimple::gain(int32_t code) const
+{
+	if (camHelper_)
+		return camHelper_->gain(code);
+
+	return static_cast<double>(code) / minGain_;
+}
+
+int32_t IPASimple::gainCode(double gain) const
+{
+	if (camHelper_)
+		return camHelper_->gainCode(gain);
+
+	return lround(gain * minGain_);
+}
+
+void IPASimple::updateExposure(const SwStatistics &stats,
+			       const ControlList &sensorControls)
+{
+	const unsigned int bins = stats.histogram.size();
+	uint64_t weighted = 0;
+	uint64_t total = 0;
+
+	for (unsigned int i = 0; i < bins; ++i) {
+		weighted += static_cast<uint64_t>(stats.histogram[i])
+			  * (i * kExposureRegions / bins + 1);
+		total += stats.histogram[i];
+	}
+
+	if (!total)
+		return;
+
+	double msv = static_cast<double>(weighted) / total;
+	if (std::abs(msv - kExposureTarget) <= kExposureTolerance)
+		return;
+
+	int32_t exposure = sensorControls.get(V4L2_CID_EXPOSURE).get<int32_t>();
+	int32_t code = sensorControls.get(V4L2_CID_ANALOGUE_GAIN).get<int32_t>();
+
+	/* Favour the exposure time over the gain to minimize noise. */
+	double step = std::clamp(kExposureTarget / msv,
+				 1.0 / kMaxExposureStep, kMaxExposureStep);
+	double target = exposure * gain(code) * step;
+
+	double minGain = gain(minGain_);
+	double maxGain = gain(maxGain_);
+
+	int32_t newExposure = std::clamp<int32_t>(lround(target / minGain),
+						  minExposure_, maxExposure_);
+	double newGain = std::clamp(target / newExposure, minGain, maxGain);
+	int32_t newCode = std::clamp(gainCode(newGain), minGain_, maxGain_);
+
+	if (newExposure == exposure && newCode == code)
+		return;
+
+	LOG(IPASimple, Debug)
+		<< "MSV " << msv << ", exposure " << exposure << " -> "
+		<< newExposure << ", gain " << code << " -> " << newCode;
+
+	ControlList ctrls(sensorControls);
+	ctrls.set(V4L2_CID_EXPOSURE, newExposure);
+	ctrls.set(V4L2_CID_ANALOGUE_GAIN, newCode);
+	setSensorControls.emit(ctrls);
+
+	skipFrames_ = settleFrames_;
+}
+
+void IPASimple::updateWhiteBalance(const SwStatistics &stats)
+{
+	uint64_t red = 0;
+	uint64_t green = 0;
+	uint64_t blue = 0;
+
+	/* Grey world assumption on the unsaturated zones. */
+	for (unsigned int i = 0; i < stats.zoneCount.size(); ++i) {
+		uint32_t count = stats.zoneCount[i];
+		if (!count || stats.zoneGreen[i] >= kSaturationLevel * count)
+			continue;
+
+		red += stats.zoneRed[i];
+		green += stats.zoneGreen[i];
+		blue += stats.zoneBlue[i];
+	}
+
+	if (!red || !green || !blue)
+		return;
+
+	double redGain = std::clamp(static_cast<double>(green) / red,
+				    kMinColourGain, kMaxColourGain);
+	double blueGain = std::clamp(static_cast<double>(green) / blue,
+				     kMinColourGain, kMaxColourGain);
+
+	setWhiteBalance.emit(redGain, blueGain);
+}
+
+void IPASimple::processStats(uint32_t frame, const SwStatistics &stats,
+			     const ControlList &sensorControls)
+{
+	LOG(IPASimple, Debug)
+		<< "Frame " << frame << " sharpness " << stats.sharpness;
+
+	updateWhiteBalance(stats);
+
+	/* Wait for the previous exposure settings to be applied. */
+	if (skipFrames_) {
+		skipFrames_--;
+		return;
+	}
+
+	if (!sensorControls.contains(V4L2_CID_EXPOSURE) ||
+	    !sensorControls.contains(V4L2_CID_ANALOGUE_GAIN))
+		return;
+
+	updateExposure(stats, sensorControls);
+}
+
+} /* namespace ipa::simple */
+
+/**
+ * \brief External IPA module interface
+ *
+ * The IPAModuleInfo is required to match an IPA module construction against the
+ * intented pipeline handler with the module. The API and pipeline handler
+ * versions must match the corresponding IPA interface and pipeline handler.
+ *
+ * \sa struct IPAModuleInfo
+ */
+extern "C" {
+const struct IPAModuleInfo ipaModuleInfo = {
+	IPA_MODULE_API_VERSION,
+	0,
+	"SimplePipelineHandler",
+	"simple",
+};
+
+/**
+ * \brief Create an instance of the IPA interface
+ *
+ * This function is the entry point of the IPA module. It is called by the IPA
+ * manager to create an instance of the IPA interface for each camera.
+ */
+IPAInterface *ipaCreate()
+{
+	return new ipa::simple::IPASimple();
+}
+}
+
+} /* namespace libcamera */
@@ -62,6 +62,16 @@ void SignalBase::disconnect(std::function<bool(SlotList::iterator &)> match)
 	}
 }
 
+/*
+ * Check if the signal has at least one connected slot. This allows signal
+ * sources to skip preparing data for signals that nobody listens to.
+ */
+bool SignalBase::connected()
+{
+	MutexLocker locker(signalsLock);
+	return !slots_.empty();
+}
+
 SignalBase::SlotList SignalBase::slots()
 {
 	MutexLocker locker(signalsLock);
@@ -7,11 +7,13 @@
 
 #include <libcamera/base/utils.h>
 
+#include <atomic>
 #include <iomanip>
 #include <locale.h>
 #include <sstream>
 #include <stdlib.h>
 #include <string.h>
+#include <thread>
 #include <unistd.h>
 
 /**
@@ -521,6 +523,42 @@ double strtod(const char *__restrict nptr, char **__restrict endptr)
 #endif
 }
 
+/**
+ * \brief Call a function concurrently for a range of indices
+ * \param[in] count The number of indices
+ * \param[in] func The function to call for each index in the [0, \a count[ range
+ * \param[in] maxThreads The maximum number of threads, 0 for the number of CPUs
+ *
+ * This function distributes calls to \a func across up to \a maxThreads
+ * threads, including the calling thread, and returns when all calls have
+ * completed. It is meant to parallelize independent blocking operations, such
+ * as device probing, and the threads don't run an event loop. \a func shall
+ * thus be thread-safe, and shall not create or use any Object.
+ */
+void parallelFor(unsigned int count, const std::function<void(unsigned int)> &func,
+		 unsigned int maxThreads)
+{
+	if (!maxThreads)
+		maxThreads = std::max(std::thread::hardware_concurrency(), 1U);
+
+	unsigned int threads = std::min(count, maxThreads);
+	std::atomic<unsigned int> next = 0;
+
+	auto worker = [&]() {
+		for (unsigned int i = next++; i < count; i = next++)
+			func(i);
+	};
+
+	std::vector<std::thread> pool;
+	for (unsigned int i = 1; i < threads; ++i)
+		pool.emplace_back(worker);
+
+	worker();
+
+	for (std::thread &thread : pool)
+		thread.join();
+}
+
 } /* namespace utils */
 
 #ifndef __DOXYGEN__
@@ -0,0 +1,346 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+/*
+ * Copyright (C) 2022, Google Inc.
+ *
+ * buffer_pool.cpp - Recycling pool of dma-heap frame buffers
+ */
+
+#include "libcamera/internal/buffer_pool.h"
+
+#include <algorithm>
+#include <errno.h>
+#include <unistd.h>
+
+#include <libcamera/base/log.h>
+#include <libcamera/base/utils.h>
+
+#include <libcamera/framebuffer.h>
+#include <libcamera/stream.h>
+
+#include "libcamera/internal/formats.h"
+#include "libcamera/internal/framebuffer.h"
+
+/**
+ * \file buffer_pool.h
+ * \brief Recycling pool of dma-heap frame buffers
+ */
+
+namespace libcamera {
+
+LOG_DEFINE_CATEGORY(BufferPool)
+
+namespace {
+
+constexpr size_t kDefaultMaxIdleSize = 256 * 1024 * 1024;
+
+} /* namespace */
+
+/*
+ * A frame buffer whose memory is returned to the pool when the buffer is
+ * destroyed. The pool is referenced weakly, buffers that outlive it release
+ * their memory to the system.
+ */
+class BufferPool::Buffer : public FrameBuffer::Private
+{
+public:
+	Buffer(const std::vector<FrameBuffer::Plane> &planes,
+	       std::weak_ptr<BufferPool> pool, UniqueFD fd, size_t size)
+		: FrameBuffer::Private(planes), pool_(pool), fd_(std::move(fd)),
+		  size_(size)
+	{
+	}
+
+	~Buffer()
+	{
+		std::shared_ptr<BufferPool> pool = pool_.lock();
+		if (pool)
+			pool->release(std::move(fd_), size_);
+	}
+
+private:
+	std::weak_ptr<BufferPool> pool_;
+	UniqueFD fd_;
+	size_t size_;
+};
+
+/**
+ * \class BufferPool
+ * \brief A pool of dma-heap memory to allocate frame buffers from
+ *
+ * Buffers exported by V4L2 video devices are tied to the device queue, and
+ * are freed and reallocated every time the camera is reconfigured. For large
+ * frames, the cost of allocating and zeroing the memory is significant and
+ * slows down mode switches.
+ *
+ * The BufferPool allocates frame buffers from a DmaHeap and, when the buffers
+ * are destroyed, keeps their memory in a set of free lists indexed by size
+ * class instead of releasing it. Subsequent allocations reuse the smallest idle
+ * buffer large enough to hold them, within a bounded overhead. As the pool is
+ * independent of the device queues, the memory survives stop and configure
+ * cycles, and is only released when the pool is trimmed or destroyed.
+ *
+ * Recycled memory is not cleared, and buffers allocated from idle memory
+ * contain stale data from the buffers previously allocated by the same pool.
+ * As each camera has its own pool, which is never shared between processes,
+ * this only exposes frames previously captured by the same application.
+ * Users that need cleared memory shall clear the buffers themselves.
+ *
+ * Size classes are computed by sizeClass() and round sizes up to an eighth of
+ * their power of two, which bounds the rounding overhead to 12.5% and limits
+ * the number of free lists. Streams whose size changes slightly between
+ * configurations can thus share memory.
+ *
+ * The amount of idle memory kept by the pool is bounded, and is set with
+ * setMaxIdleSize(). When the limit is exceeded, idle memory is released
+ * starting with the largest size classes.
+ *
+ * The BufferPool must be managed through a std::shared_ptr. Its functions are
+ * thread-safe, and buffers can be destroyed from any thread.
+ */
+
+/**
+ * \struct BufferPool::Statistics
+ * \brief Usage statistics of the pool
+ *
+ * \var BufferPool::Statistics::hits
+ * \brief Number of buffer allocations that reused idle memory
+ *
+ * \var BufferPool::Statistics::misses
+ * \brief Number of buffer allocations that allocated memory from the heap
+ *
+ * \var BufferPool::Statistics::evictions
+ * \brief Number of idle buffers released to the system
+ *
+ * \var BufferPool::Statistics::idle
+ * \brief Number of idle buffers currently kept in the pool
+ *
+ * \var BufferPool::Statistics::idleSize
+ * \brief Total size in bytes of the idle buffers currently kept in the pool
+ */
+
+/**
+ * \brief Construct a BufferPool allocating memory from a dma-heap
+ * \param[in] type The type(s) of the dma-heap(s) to allocate from
+ */
+BufferPool::BufferPool(DmaHeap::DmaHeapFlags type)
+	: heap_(type), maxIdleSize_(kDefaultMaxIdleSize), stats_({})
+{
+}
+
+BufferPool::~BufferPool() = default;
+
+/**
+ * \fn BufferPool::isValid()
+ * \brief Check if the pool has a valid dma-heap to allocate memory from
+ * \return True if the pool is valid, false otherwise
+ */
+
+/**
+ * \brief Allocate frame buffers for a stream configuration
+ * \param[in] config The stream configuration
+ * \param[out] buffers Array of buffers successfully allocated
+ *
+ * Allocate config.bufferCount frame buffers suitable for the pixel format,
+ * size and stride of \a config. The planes of each buffer are stored
+ * contiguously in a single dmabuf. For formats without a plane layout, such as
+ * compressed formats, a single plane of config.frameSize bytes is allocated.
+ *
+ * The memory of the buffers is returned to the pool when they are destroyed.
+ *
+ * \return The number of allocated buffers on success or a negative error code
+ * otherwise
+ */
+int BufferPool::allocate(const StreamConfiguration &config,
+			 std::vector<std::unique_ptr<FrameBuffer>> *buffers)
+{
+	const PixelFormatInfo &info = PixelFormatInfo::info(config.pixelFormat);
+
+	std::vector<FrameBuffer::Plane> planes;
+	size_t frameSize = 0;
+
+	if (info.isValid() && config.stride) {
+		planes.resize(info.numPlanes());
+
+		for (auto [i, plane] : utils::enumerate(planes)) {
+			/* Same plane layout as V4L2 single-planar buffers. */
+			unsigned int stride = config.stride
+					    * info.planes[i].bytesPerGroup
+					    / info.planes[0].bytesPerGroup;
+
+			plane.offset = frameSize;
+			plane.length = info.planeSize(config.size.height, i, stride);
+			frameSize += plane.length;
+		}
+	}
+
+	if (planes.empty()) {
+		planes.resize(1);
+		planes[0].offset = 0;
+		planes[0].length = config.frameSize;
+		frameSize = config.frameSize;
+	}
+
+	/* Honour any padding the pipeline handler reported in the frame size. */
+	if (config.frameSize > frameSize) {
+		planes.back().length += config.frameSize - frameSize;
+		frameSize = config.frameSize;
+	}
+
+	if (!frameSize) {
+		LOG(BufferPool, Error)
+			<< "Can't allocate buffers for " << config.toString();
+		return -EINVAL;
+	}
+
+	for (unsigned int i = 0; i < config.bufferCount; ++i) {
+		size_t size = sizeClass(frameSize);
+		UniqueFD fd = acquire(&size);
+		if (!fd.isValid()) {
+			buffers->clear();
+			return -ENOMEM;
+		}
+
+		/*
+		 * Duplicate the file descriptor for the planes, the pool keeps
+		 * ownership of the original to recycle it.
+		 */
+		const int dmabuf = fd.get();
+		SharedFD shared(dmabuf);
+		for (FrameBuffer::Plane &plane : planes)
+			plane.fd = shared;
+
+		auto d = std::make_unique<Buffer>(planes, weak_from_this(),
+						  std::move(fd), size);
+		buffers->push_back(std::make_unique<FrameBuffer>(std::move(d)));
+	}
+
+	return config.bufferCount;
+}
+
+/**
+ * \brief Set the maximum size of idle memory kept by the pool
+ * \param[in] size The maximum size in bytes
+ *
+ * Idle memory exceeding \a size is released immediately.
+ */
+void BufferPool::setMaxIdleSize(size_t size)
+{
+	MutexLocker locker(mutex_);
+
+	maxIdleSize_ = size;
+	trimLocked(size);
+}
+
+/**
+ * \brief Release idle memory to the system
+ * \param[in] maxIdleSize The maximum size in bytes of idle memory to keep
+ *
+ * Buffers in use are not affected. By default all idle memory is released.
+ */
+void BufferPool::trim(size_t maxIdleSize)
+{
+	MutexLocker locker(mutex_);
+
+	trimLocked(maxIdleSize);
+}
+
+/**
+ * \brief Retrieve the pool usage statistics
+ * \return The pool usage statistics
+ */
+BufferPool::Statistics BufferPool::statistics() const
+{
+	MutexLocker locker(mutex_);
+
+	return stats_;
+}
+
+/**
+ * \brief Compute the size class of a buffer
+ * \param[in] size The buffer size in bytes
+ *
+ * The size is rounded up to the page size, and then to a multiple of an eighth
+ * of the largest power of two not greater than the size.
+ *
+ * \return The size of the memory allocated for a buffer of \a size bytes
+ */
+size_t BufferPool::sizeClass(size_t size)
+{
+	static const size_t pageSize = sysconf(_SC_PAGESIZE);
+
+	size = std::max<size_t>(size, 1);
+	size = (size + pageSize - 1) / pageSize * pageSize;
+
+	size_t power = pageSize;
+	while (power <= size / 2)
+		power *= 2;
+
+	size_t granularity = std::max(power / 8, pageSize);
+	return (size + granularity - 1) / granularity * granularity;
+}
+
+UniqueFD BufferPool::acquire(size_t *size)
+{
+	{
+		MutexLocker locker(mutex_);
+
+		/*
+		 * Reuse the smallest idle buffer large enough for the request,
+		 * bounding the memory waste to a quarter of the requested size.
+		 */
+		for (auto it = idle_.lower_bound(*size);
+		     it != idle_.end() && it->first <= *size + *size / 4; ++it) {
+			if (it->second.empty())
+				continue;
+
+			UniqueFD fd = std::move(it->second.back());
+			it->second.pop_back();
+
+			*size = it->first;
+			stats_.hits++;
+			stats_.idle--;
+			stats_.idleSize -= *size;
+			return fd;
+		}
+
+		stats_.misses++;
+	}
+
+	/* Allocate outside of the lock, the heap may need to clear memory. */
+	UniqueFD fd = heap_.alloc("libcamera-frame", *size);
+	if (!fd.isValid())
+		LOG(BufferPool, Error) << "Failed to allocate " << *size << " bytes";
+
+	return fd;
+}
+
+void BufferPool::release(UniqueFD fd, size_t size)
+{
+	MutexLocker locker(mutex_);
+
+	idle_[size].push_back(std::move(fd));
+	stats_.idle++;
+	stats_.idleSize += size;
+
+	trimLocked(maxIdleSize_);
+}
+
+void BufferPool::trimLocked(size_t maxIdleSize)
+{
+	/* Release the largest buffers first to free memory quickly. */
+	for (auto it = idle_.rbegin(); it != idle_.rend(); ++it) {
+		std::vector<UniqueFD> &fds = it->second;
+
+		while (stats_.idleSize > maxIdleSize && !fds.empty()) {
+			fds.pop_back();
+			stats_.evictions++;
+			stats_.idle--;
+			stats_.idleSize -= it->first;
+		}
+
+		if (stats_.idleSize <= maxIdleSize)
+			break;
+	}
+}
+
+} /* namespace libcamera */
@@ -19,8 +19,10 @@
 #include <libcamera/request.h>
 #include <libcamera/stream.h>
 
+#include "libcamera/internal/buffer_pool.h"
 #include "libcamera/internal/camera.h"
 #include "libcamera/internal/camera_controls.h"
+#include "libcamera/internal/fence_waiter.h"
 #include "libcamera/internal/formats.h"
 #include "libcamera/internal/pipeline_handler.h"
 #include "libcamera/internal/request.h"
@@ -434,6 +436,10 @@ Camera::Private::~Private()
 {
 	if (state_.load(std::memory_order_acquire) != Private::CameraAvailable)
 		LOG(Camera, Error) << "Removing camera while still in use";
+
+	/* The fence waiter must be destroyed in the thread it is bound to. */
+	if (fenceWaiter_)
+		fenceWaiter_.release()->deleteLater();
 }
 
 /**
@@ -448,6 +454,49 @@ Camera::Private::~Private()
  * \return The control validator associated with this camera
  */
 
+/**
+ * \brief Retrieve the fence waiter related to this camera
+ *
+ * The fence waiter is shared by all requests of the camera to wait for the
+ * acquire fences of their buffers. It is created on first use, and is bound to
+ * the thread of the pipeline handler. This function shall thus only be called
+ * from the pipeline handler thread.
+ *
+ * \return The fence waiter associated with this camera
+ */
+FenceWaiter *Camera::Private::fenceWaiter()
+{
+	if (!fenceWaiter_)
+		fenceWaiter_ = std::make_unique<FenceWaiter>();
+
+	return fenceWaiter_.get();
+}
+
+/**
+ * \brief Retrieve the buffer pool related to this camera
+ *
+ * \param[in] heaps The dma-heaps to allocate from
+ *
+ * The buffer pool allocates frame buffers for streams whose pipeline handler
+ * supports it, from the \a heaps reported by
+ * PipelineHandler::bufferPoolHeaps(). The pool is created on first use and
+ * lives as long as the camera, allowing memory to be reused across stop and
+ * configure cycles. It is recreated if a pipeline handler later requests
+ * different heaps. Idle memory is released when the camera is released.
+ *
+ * \return The buffer pool associated with this camera, or nullptr if no
+ * suitable dma-heap is available
+ */
+BufferPool *Camera::Private::bufferPool(DmaHeap::DmaHeapFlags heaps)
+{
+	if (!bufferPool_ || bufferPoolHeaps_ != heaps) {
+		bufferPool_ = std::make_shared<BufferPool>(heaps);
+		bufferPoolHeaps_ = heaps;
+	}
+
+	return bufferPool_->isValid() ? bufferPool_.get() : nullptr;
+}
+
 /**
  * \var Camera::Private::queuedRequests_
  * \brief The list of queued and not yet completed requests
@@ -491,6 +540,24 @@ Camera::Private::~Private()
  * over a single capture session.
  */
 
+/**
+ * \var Camera::Private::completedRequests_
+ * \brief The requests completed since the last Camera::requestsCompleted signal
+ *
+ * The pipeline handler collects the requests completed during an event loop
+ * iteration in this vector, and reports them through the
+ * Camera::requestsCompleted signal when control returns to the event loop.
+ */
+
+/**
+ * \var Camera::Private::completedBatch_
+ * \brief The last batch reported through the Camera::requestsCompleted signal
+ *
+ * The batch is reused to collect the next completed requests once all the
+ * receivers of the signal have released it, to avoid allocating memory for
+ * every batch.
+ */
+
 static const char *const camera_state_names[] = {
 	"Available",
 	"Acquired",
@@ -509,6 +576,31 @@ bool Camera::Private::isRunning() const
 	return state_.load(std::memory_order_acquire) == CameraRunning;
 }
 
+int Camera::Private::validateRequest(const Request *request) const
+{
+	/* Requests can only be queued to the camera that created them. */
+	if (request->_d()->camera() != _o<Camera>()) {
+		LOG(Camera, Error) << "Request was not created by this camera";
+		return -EXDEV;
+	}
+
+	if (request->buffers().empty()) {
+		LOG(Camera, Error) << "Request contains no buffers";
+		return -EINVAL;
+	}
+
+	for (auto const &it : request->buffers()) {
+		const Stream *stream = it.first;
+
+		if (activeStreams_.find(stream) == activeStreams_.end()) {
+			LOG(Camera, Error) << "Invalid request";
+			return -EINVAL;
+		}
+	}
+
+	return 0;
+}
+
 int Camera::Private::isAccessAllowed(State state, bool allowDisconnected,
 				     const char *from) const
 {
@@ -734,6 +826,29 @@ const std::string &Camera::id() const
  * \brief Signal emitted when a request queued to the camera has completed
  */
 
+/**
+ * \var Camera::requestsCompleted
+ * \brief Signal emitted when a batch of requests queued to the camera has
+ * completed
+ *
+ * This signal is emitted once for all the requests that complete during the
+ * same iteration of the pipeline handler event loop, in submission order. All
+ * pending batches are reported before stop() returns. Applications that queue requests
+ * in batches with queueRequests(), or that run at high frame rates, may connect
+ * to this signal instead of requestCompleted to reduce the number of
+ * cross-thread notifications.
+ *
+ * The requests are passed through a shared pointer, to avoid copying the
+ * vector for every connected receiver.
+ *
+ * Requests are only batched when this signal has receivers. In that case, the
+ * requestCompleted signal is deferred and emitted for each request of the
+ * batch right after this signal, from the same event loop iteration. The
+ * requests in the batch are thus guaranteed not to have been returned to the
+ * application when this signal is emitted. Applications that connect to both
+ * signals shall only reuse or free requests in their requestCompleted handler.
+ */
+
 /**
  * \var Camera::disconnected
  * \brief Signal emitted when the camera is disconnected from the system
@@ -794,6 +909,13 @@ int Camera::exportFrameBuffers(Stream *stream,
 	if (d->activeStreams_.find(stream) == d->activeStreams_.end())
 		return -EINVAL;
 
+	DmaHeap::DmaHeapFlags heaps = d->pipe_->bufferPoolHeaps(this, stream);
+	if (heaps) {
+		BufferPool *pool = d->bufferPool(heaps);
+		if (pool)
+			return pool->allocate(stream->configuration(), buffers);
+	}
+
 	return d->pipe_->invokeMethod(&PipelineHandler::exportFrameBuffers,
 				      ConnectionTypeBlocking, this, stream,
 				      buffers);
@@ -835,7 +957,7 @@ int Camera::acquire()
 	if (ret < 0)
 		return ret == -EACCES ? -EBUSY : ret;
 
-	if (!d->pipe_->acquire()) {
+	if (!d->pipe_->acquire(this)) {
 		LOG(Camera, Info)
 			<< "Pipeline handler in use by another process";
 		return -EBUSY;
@@ -872,6 +994,9 @@ int Camera::release()
 	if (d->isAcquired())
 		d->pipe_->release(this);
 
+	if (d->bufferPool_)
+		d->bufferPool_->trim();
+
 	d->setState(Private::CameraAvailable);
 
 	return 0;
@@ -1118,34 +1243,64 @@ int Camera::queueRequest(Request *request)
 	if (ret < 0)
 		return ret;
 
-	/* Requests can only be queued to the camera that created them. */
-	if (request->_d()->camera() != this) {
-		LOG(Camera, Error) << "Request was not created by this camera";
-		return -EXDEV;
-	}
-
 	/*
 	 * The camera state may change until the end of the function. No locking
 	 * is however needed as PipelineHandler::queueRequest() will handle
 	 * this.
 	 */
 
-	if (request->buffers().empty()) {
-		LOG(Camera, Error) << "Request contains no buffers";
-		return -EINVAL;
-	}
+	ret = d->validateRequest(request);
+	if (ret < 0)
+		return ret;
 
-	for (auto const &it : request->buffers()) {
-		const Stream *stream = it.first;
+	d->pipe_->invokeMethod(&PipelineHandler::queueRequest,
+			       ConnectionTypeQueued, request);
 
-		if (d->activeStreams_.find(stream) == d->activeStreams_.end()) {
-			LOG(Camera, Error) << "Invalid request";
-			return -EINVAL;
-		}
+	return 0;
+}
+
+/**
+ * \brief Queue a batch of requests to the camera
+ * \param[in] requests The requests to queue to the camera
+ *
+ * This function queues multiple \a requests to the camera for capture, in
+ * order. It is equivalent to calling queueRequest() for each request, but
+ * crosses into the pipeline handler thread once for the whole batch, and
+ * allows the pipeline handler to program the device for all the requests at
+ * once. This lowers the per-request overhead at high frame rates.
+ *
+ * All requests are validated before any of them is queued. If any request is
+ * invalid, none of them is queued and an error is returned.
+ *
+ * \context This function is \threadsafe. It may only be called when the camera
+ * is in the Running state as defined in \ref camera_operation.
+ *
+ * \return 0 on success or a negative error code otherwise
+ * \retval -ENODEV The camera has been disconnected from the system
+ * \retval -EACCES The camera is not running so requests can't be queued
+ * \retval -EXDEV A request does not belong to this camera
+ * \retval -EINVAL A request is invalid
+ */
+int Camera::queueRequests(Span<Request *const> requests)
+{
+	Private *const d = _d();
+
+	int ret = d->isAccessAllowed(Private::CameraRunning);
+	if (ret < 0)
+		return ret;
+
+	for (const Request *request : requests) {
+		ret = d->validateRequest(request);
+		if (ret < 0)
+			return ret;
 	}
 
-	d->pipe_->invokeMethod(&PipelineHandler::queueRequest,
-			       ConnectionTypeQueued, request);
+	if (requests.empty())
+		return 0;
+
+	d->pipe_->invokeMethod(&PipelineHandler::queueRequests,
+			       ConnectionTypeQueued,
+			       std::vector<Request *>(requests.begin(), requests.end()));
 
 	return 0;
 }
@@ -1251,4 +1406,17 @@ void Camera::requestComplete(Request *request)
 	requestCompleted.emit(request);
 }
 
+/**
+ * \brief Notify application of the completion of a batch of requests
+ * \param[in] requests The requests that have completed
+ *
+ * This function is called by the pipeline handler before notifying the camera
+ * of the completion of each request in \a requests with requestComplete(). It
+ * emits the requestsCompleted signal.
+ */
+void Camera::requestsComplete(std::shared_ptr<const std::vector<Request *>> requests)
+{
+	requestsCompleted.emit(std::move(requests));
+}
+
 } /* namespace libcamera */
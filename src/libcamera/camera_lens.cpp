@@ -139,6 +139,16 @@ std::string CameraLens::logPrefix() const
 	return "'" + entity_->name() + "'";
 }
 
+/**
+ * \fn CameraLens::device()
+ * \brief Retrieve the lens device
+ *
+ * The device is exposed to let pipeline handlers write the lens controls in
+ * the same V4L2ControlTransaction as the sensor controls.
+ *
+ * \return The lens device
+ */
+
 /**
  * \fn CameraLens::controls()
  * \brief Retrieve the V4L2 controls of the lens' subdev
@@ -126,12 +126,25 @@ void CameraManager::Private::run()
 
 int CameraManager::Private::init()
 {
+	utils::time_point start = utils::clock::now();
+
 	enumerator_ = DeviceEnumerator::create();
 	if (!enumerator_ || enumerator_->enumerate())
 		return -ENODEV;
 
+	utils::Duration enumeration = utils::clock::now() - start;
+
 	createPipelineHandlers();
 
+	enumerator_->devicesAdded.connect(this, &Private::createPipelineHandlers);
+
+	utils::Duration total = utils::clock::now() - start;
+
+	LOG(Camera, Debug)
+		<< "Device enumeration took "
+		<< enumeration.get<std::milli>() << "ms, startup took "
+		<< total.get<std::milli>() << "ms";
+
 	return 0;
 }
 
@@ -148,6 +161,13 @@ void CameraManager::Private::createPipelineHandlers()
 		PipelineHandlerFactoryBase::factories();
 
 	for (const PipelineHandlerFactoryBase *factory : factories) {
+		/*
+		 * Skip the remaining pipeline handlers once all the media
+		 * devices added since the last pass are in use.
+		 */
+		if (!enumerator_->hasNewDevices())
+			break;
+
 		LOG(Camera, Debug)
 			<< "Found registered pipeline handler '"
 			<< factory->name() << "'";
@@ -155,6 +175,9 @@ void CameraManager::Private::createPipelineHandlers()
 		 * Try each pipeline handler until it exhaust
 		 * all pipelines it can provide.
 		 */
+		utils::time_point start = utils::clock::now();
+		unsigned int matches = 0;
+
 		while (1) {
 			std::shared_ptr<PipelineHandler> pipe = factory->create(o);
 			if (!pipe->match(enumerator_.get()))
@@ -163,10 +186,17 @@ void CameraManager::Private::createPipelineHandlers()
 			LOG(Camera, Debug)
 				<< "Pipeline handler \"" << factory->name()
 				<< "\" matched";
+			matches++;
 		}
+
+		utils::Duration duration = utils::clock::now() - start;
+		LOG(Camera, Debug)
+			<< "Pipeline handler \"" << factory->name() << "\": "
+			<< matches << " match(es) in "
+			<< duration.get<std::milli>() << "ms";
 	}
 
-	enumerator_->devicesAdded.connect(this, &Private::createPipelineHandlers);
+	enumerator_->clearNewDevices();
 }
 
 void CameraManager::Private::cleanup()
@@ -13,6 +13,7 @@
 #include <iomanip>
 #include <limits.h>
 #include <math.h>
+#include <sstream>
 #include <string.h>
 
 #include <libcamera/property_ids.h>
@@ -22,6 +23,7 @@
 #include "libcamera/internal/bayer_format.h"
 #include "libcamera/internal/camera_lens.h"
 #include "libcamera/internal/camera_sensor_properties.h"
+#include "libcamera/internal/discovery_cache.h"
 #include "libcamera/internal/formats.h"
 #include "libcamera/internal/sysfs.h"
 
@@ -119,7 +121,7 @@ int CameraSensor::init()
 	subdev_->setControls(&ctrls);
 
 	/* Enumerate, sort and cache media bus codes and sizes. */
-	formats_ = subdev_->formats(pad_);
+	formats_ = enumerateFormats();
 	if (formats_.empty()) {
 		LOG(CameraSensor, Error) << "No image format found";
 		return -EINVAL;
@@ -140,6 +142,8 @@ int CameraSensor::init()
 	auto last = std::unique(sizes_.begin(), sizes_.end());
 	sizes_.erase(last, sizes_.end());
 
+	initModes();
+
 	/*
 	 * VIMC is a bit special, as it does not yet support all the mandatory
 	 * requirements regular sensors have to respect.
@@ -210,6 +214,70 @@ int CameraSensor::init()
 	return applyTestPatternMode(controls::draft::TestPatternModeEnum::TestPatternModeOff);
 }
 
+V4L2Subdevice::Formats CameraSensor::enumerateFormats()
+{
+	DiscoveryCache *cache = entity_->device()->discoveryCache();
+	if (!cache)
+		return subdev_->formats(pad_);
+
+	/*
+	 * Enumerating the sensor formats takes one ioctl per media bus code
+	 * and frame size. Store the formats in the discovery cache as a list
+	 * of media bus codes, each followed by its number of size ranges and
+	 * the size ranges.
+	 */
+	const std::string key = "sensor-formats:" + entity_->name() + ":" +
+				std::to_string(pad_);
+
+	std::optional<std::string> value = cache->value(key);
+	if (value) {
+		std::istringstream ss(*value);
+		V4L2Subdevice::Formats formats;
+		unsigned int code, count;
+		bool valid = true;
+
+		while (valid && ss >> code >> count) {
+			std::vector<SizeRange> &ranges = formats[code];
+
+			for (unsigned int i = 0; i < count; ++i) {
+				SizeRange range;
+				if (!(ss >> range.min.width >> range.min.height
+				      >> range.max.width >> range.max.height
+				      >> range.hStep >> range.vStep)) {
+					valid = false;
+					break;
+				}
+
+				ranges.push_back(range);
+			}
+		}
+
+		if (valid && ss.eof() && !formats.empty())
+			return formats;
+
+		LOG(CameraSensor, Debug) << "Ignoring invalid cached formats";
+	}
+
+	V4L2Subdevice::Formats formats = subdev_->formats(pad_);
+	if (formats.empty())
+		return formats;
+
+	std::ostringstream ss;
+	for (const auto &[code, ranges] : formats) {
+		ss << code << " " << ranges.size();
+		for (const SizeRange &range : ranges)
+			ss << " " << range.min.width << " " << range.min.height
+			   << " " << range.max.width << " " << range.max.height
+			   << " " << range.hStep << " " << range.vStep;
+		ss << " ";
+	}
+
+	cache->setValue(key, ss.str());
+	cache->save();
+
+	return formats;
+}
+
 int CameraSensor::validateSensorDriver()
 {
 	int err = 0;
@@ -689,6 +757,67 @@ int CameraSensor::applyTestPatternMode(controls::draft::TestPatternModeEnum mode
  */
 V4L2SubdeviceFormat CameraSensor::getFormat(const std::vector<unsigned int> &mbusCodes,
 					    const Size &size) const
+{
+	/*
+	 * Pipeline handlers call this function for every configuration
+	 * validation, often with the same arguments. Cache the results, the
+	 * sensor formats never change after initialization. The media bus
+	 * codes are only copied when adding an entry to the cache.
+	 */
+	{
+		MutexLocker locker(formatCacheMutex_);
+		auto it = formatCache_.find(FormatCacheLookup{ mbusCodes, size });
+		if (it != formatCache_.end())
+			return it->second;
+	}
+
+	V4L2SubdeviceFormat format = findFormat(mbusCodes, size);
+
+	MutexLocker locker(formatCacheMutex_);
+	if (formatCache_.size() >= kFormatCacheSize)
+		formatCache_.clear();
+	formatCache_.emplace(FormatCacheKey{ mbusCodes, size }, format);
+
+	return format;
+}
+
+/*
+ * \brief Build the table of sensor modes
+ *
+ * Store the maximum size of every size range supported by the sensor in a flat
+ * table, grouped by media bus code, along with the area and aspect ratio used
+ * by the format selection heuristics.
+ */
+void CameraSensor::initModes()
+{
+	modes_.clear();
+	modeRanges_.clear();
+
+	for (const auto &[code, ranges] : formats_) {
+		unsigned int begin = modes_.size();
+
+		for (const SizeRange &range : ranges) {
+			const Size &sz = range.max;
+			modes_.push_back({ sz, sz.width * sz.height,
+					   static_cast<float>(sz.width) / sz.height });
+		}
+
+		modeRanges_.push_back({ code, begin,
+					static_cast<unsigned int>(modes_.size()) });
+	}
+}
+
+/*
+ * \brief Find the best sensor format for the media bus codes and size
+ * \param[in] mbusCodes The list of acceptable media bus codes
+ * \param[in] size The desired size
+ *
+ * This function implements the getFormat() heuristics without caching.
+ *
+ * \return The best sensor output format, or an empty format if none is found
+ */
+V4L2SubdeviceFormat CameraSensor::findFormat(const std::vector<unsigned int> &mbusCodes,
+					     const Size &size) const
 {
 	unsigned int desiredArea = size.width * size.height;
 	unsigned int bestArea = UINT_MAX;
@@ -698,20 +827,23 @@ V4L2SubdeviceFormat CameraSensor::getFormat(const std::vector<unsigned int> &mbu
 	uint32_t bestCode = 0;
 
 	for (unsigned int code : mbusCodes) {
-		const auto formats = formats_.find(code);
-		if (formats == formats_.end())
+		/* The mode ranges are sorted by media bus code. */
+		auto range = std::lower_bound(modeRanges_.begin(), modeRanges_.end(), code,
+					      [](const ModeRange &r, unsigned int value) {
+						      return r.code < value;
+					      });
+		if (range == modeRanges_.end() || range->code != code)
 			continue;
 
-		for (const SizeRange &range : formats->second) {
-			const Size &sz = range.max;
+		for (unsigned int i = range->begin; i < range->end; ++i) {
+			const Mode &mode = modes_[i];
 
-			if (sz.width < size.width || sz.height < size.height)
+			if (mode.size.width < size.width ||
+			    mode.size.height < size.height)
 				continue;
 
-			float ratio = static_cast<float>(sz.width) / sz.height;
-			float ratioDiff = fabsf(ratio - desiredRatio);
-			unsigned int area = sz.width * sz.height;
-			unsigned int areaDiff = area - desiredArea;
+			float ratioDiff = fabsf(mode.ratio - desiredRatio);
+			unsigned int areaDiff = mode.area - desiredArea;
 
 			if (ratioDiff > bestRatio)
 				continue;
@@ -719,7 +851,7 @@ V4L2SubdeviceFormat CameraSensor::getFormat(const std::vector<unsigned int> &mbu
 			if (ratioDiff < bestRatio || areaDiff < bestArea) {
 				bestRatio = ratioDiff;
 				bestArea = areaDiff;
-				bestSize = &sz;
+				bestSize = &mode.size;
 				bestCode = code;
 			}
 		}
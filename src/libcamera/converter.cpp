@@ -42,9 +42,14 @@ LOG_DEFINE_CATEGORY(Converter)
  *
  * This searches for the entity implementing the data streaming function in the
  * media graph entities and use its device node as the converter device node.
+ * Converters that are not backed by a device, such as software converters,
+ * pass a null \a media, and have no device node.
  */
 Converter::Converter(MediaDevice *media)
 {
+	if (!media)
+		return;
+
 	const std::vector<MediaEntity *> &entities = media->entities();
 	auto it = std::find_if(entities.begin(), entities.end(),
 			       [](MediaEntity *entity) {
@@ -233,6 +238,39 @@ std::unique_ptr<Converter> ConverterFactoryBase::create(MediaDevice *media)
 	return nullptr;
 }
 
+/**
+ * \brief Create an instance of the converter registered with a given name
+ * \param[in] name Name of the factory or one of its compatibles
+ *
+ * This function creates converters that are not backed by a media device, such
+ * as software implementations, which can't be matched by driver name. The
+ * converter instance is constructed with a null media device.
+ *
+ * \return A unique pointer to a new instance of the converter subclass
+ * corresponding to the named factory or one of its alias. Otherwise a null
+ * pointer if no such factory exists
+ */
+std::unique_ptr<Converter> ConverterFactoryBase::create(const std::string &name)
+{
+	const std::vector<ConverterFactoryBase *> &factories =
+		ConverterFactoryBase::factories();
+
+	for (const ConverterFactoryBase *factory : factories) {
+		const std::vector<std::string> &compatibles = factory->compatibles();
+		auto it = std::find(compatibles.begin(), compatibles.end(), name);
+
+		if (it == compatibles.end() && name != factory->name_)
+			continue;
+
+		LOG(Converter, Debug)
+			<< "Creating converter from " << factory->name_ << " factory";
+
+		return factory->createInstance(nullptr);
+	}
+
+	return nullptr;
+}
+
 /**
  * \brief Add a converter class to the registry
  * \param[in] factory Factory to use to construct the converter class
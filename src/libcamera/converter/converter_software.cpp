@@ -0,0 +1,1002 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+/*
+ * Copyright (C) 2022, Google Inc.
+ *
+ * converter_software.cpp - CPU-based Bayer format converter
+ */
+
+#include "libcamera/internal/converter/converter_software.h"
+
+#include <algorithm>
+#include <cmath>
+#include <string.h>
+#include <thread>
+
+#include <libcamera/base/log.h>
+#include <libcamera/base/utils.h>
+
+#include <libcamera/formats.h>
+#include <libcamera/framebuffer.h>
+#include <libcamera/geometry.h>
+#include <libcamera/stream.h>
+
+#include "libcamera/internal/buffer_pool.h"
+#include "libcamera/internal/formats.h"
+#include "libcamera/internal/framebuffer.h"
+#include "libcamera/internal/mapped_framebuffer.h"
+
+/**
+ * \file internal/converter/converter_software.h
+ * \brief CPU-based Bayer format converter
+ */
+
+namespace libcamera {
+
+LOG_DECLARE_CATEGORY(Converter)
+
+namespace {
+
+/* Output formats, in order of preference. */
+const std::vector<PixelFormat> outputFormats = {
+	formats::RGB888,
+	formats::BGR888,
+	formats::XRGB8888,
+	formats::XBGR8888,
+	formats::NV12,
+	formats::YUV420,
+};
+
+/* Number of columns replicated on each side of the unpacked lines. */
+constexpr unsigned int kPadding = 2;
+
+/* Maximum number of worker threads. */
+constexpr unsigned int kMaxWorkers = 4;
+
+/* Statistics are gathered on one line pair out of kStatsSampling. */
+constexpr unsigned int kStatsSampling = 4;
+
+/*
+ * Unpack a line of Bayer samples to 8 bits per pixel, keeping the most
+ * significant bits. The loops are kept free of data-dependent branches to let
+ * the compiler vectorize them.
+ */
+void unpackLine(const BayerFormat &format, const uint8_t *src, uint8_t *dst,
+		unsigned int width)
+{
+	if (format.packing == BayerFormat::Packing::CSI2) {
+		if (format.bitDepth == 10) {
+			/* Four pixels in five bytes, MSBs first. */
+			for (unsigned int x = 0; x < width; x += 4, src += 5) {
+				dst[x + 0] = src[0];
+				dst[x + 1] = src[1];
+				dst[x + 2] = src[2];
+				dst[x + 3] = src[3];
+			}
+		} else {
+			/* Two pixels in three bytes, MSBs first. */
+			for (unsigned int x = 0; x < width; x += 2, src += 3) {
+				dst[x + 0] = src[0];
+				dst[x + 1] = src[1];
+			}
+		}
+
+		return;
+	}
+
+	if (format.bitDepth == 8) {
+		memcpy(dst, src, width);
+		return;
+	}
+
+	/* Little-endian 16-bit containers. */
+	unsigned int shift = format.bitDepth - 8;
+	for (unsigned int x = 0; x < width; ++x)
+		dst[x] = (src[2 * x] | src[2 * x + 1] << 8) >> shift;
+}
+
+/*
+ * Interpolate the RGB values of a line with a bilinear demosaicing filter.
+ * The current line contains red (or blue) samples at columns of parity
+ * \a phase, and green samples at the other columns. The previous and next
+ * lines contain the other colour component above and below the red (or blue)
+ * samples.
+ */
+template<bool Scaled>
+void demosaicLine(const uint8_t *prev, const uint8_t *curr, const uint8_t *next,
+		  bool redLine, unsigned int phase, const unsigned int *xMap,
+		  unsigned int width, uint8_t *rgb)
+{
+	for (unsigned int i = 0; i < width; ++i, rgb += 3) {
+		const int x = Scaled ? xMap[i] : i;
+
+		unsigned int horz = curr[x - 1] + curr[x + 1];
+		unsigned int vert = prev[x] + next[x];
+		unsigned int diag = prev[x - 1] + prev[x + 1]
+				  + next[x - 1] + next[x + 1];
+
+		bool colour = (x & 1) == phase;
+
+		unsigned int g = colour ? (horz + vert + 2) >> 2 : curr[x];
+		unsigned int own = colour ? curr[x] : (horz + 1) >> 1;
+		unsigned int other = colour ? (diag + 2) >> 2 : (vert + 1) >> 1;
+
+		rgb[0] = redLine ? own : other;
+		rgb[1] = g;
+		rgb[2] = redLine ? other : own;
+	}
+}
+
+/* Store a line of RGB values in a packed RGB format, in memory order. */
+template<unsigned int Bpp, unsigned int R, unsigned int G, unsigned int B>
+void storeRGB(const uint8_t *rgb, uint8_t *dst, unsigned int width)
+{
+	for (unsigned int x = 0; x < width; ++x, rgb += 3, dst += Bpp) {
+		dst[R] = rgb[0];
+		dst[G] = rgb[1];
+		dst[B] = rgb[2];
+		if (Bpp == 4)
+			dst[3] = 0xff;
+	}
+}
+
+/* BT.601 limited range conversion. */
+uint8_t rgbToY(int r, int g, int b)
+{
+	return ((66 * r + 129 * g + 25 * b + 128) >> 8) + 16;
+}
+
+uint8_t rgbToU(int r, int g, int b)
+{
+	return ((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128;
+}
+
+uint8_t rgbToV(int r, int g, int b)
+{
+	return ((112 * r - 94 * g - 18 * b + 128) >> 8) + 128;
+}
+
+/*
+ * Store two lines of RGB values in a YUV 4:2:0 format. Chroma is computed from
+ * the average of each 2x2 block. For semi-planar formats the V pointer follows
+ * the U pointer, and the step is 2.
+ */
+void storeYUV420(const uint8_t *rgb0, const uint8_t *rgb1, uint8_t *y0,
+		 uint8_t *y1, uint8_t *u, uint8_t *v, unsigned int step,
+		 unsigned int width)
+{
+	for (unsigned int x = 0; x < width; ++x) {
+		y0[x] = rgbToY(rgb0[3 * x], rgb0[3 * x + 1], rgb0[3 * x + 2]);
+		y1[x] = rgbToY(rgb1[3 * x], rgb1[3 * x + 1], rgb1[3 * x + 2]);
+	}
+
+	for (unsigned int x = 0; x < width / 2; ++x) {
+		const uint8_t *a = &rgb0[6 * x];
+		const uint8_t *b = &rgb1[6 * x];
+
+		int r = (a[0] + a[3] + b[0] + b[3] + 2) >> 2;
+		int g = (a[1] + a[4] + b[1] + b[4] + 2) >> 2;
+		int bl = (a[2] + a[5] + b[2] + b[5] + 2) >> 2;
+
+		u[x * step] = rgbToU(r, g, bl);
+		v[x * step] = rgbToV(r, g, bl);
+	}
+}
+
+} /* namespace */
+
+/* -----------------------------------------------------------------------------
+ * SoftwareConverter::Worker
+ */
+
+class SoftwareConverter::Worker : public Object
+{
+public:
+	Worker(SoftwareConverter *converter);
+
+	void process(Frame *frame, unsigned int band);
+
+private:
+	struct Line {
+		int row;
+		std::vector<uint8_t> data;
+	};
+
+	void statistics(const uint8_t *input, unsigned int start,
+			unsigned int end, Statistics *stats);
+
+	const uint8_t *line(const uint8_t *input, int row);
+	void demosaic(const Output &output, const uint8_t *input,
+		      unsigned int y, uint8_t *rgb);
+	void convert(const Output &output, const uint8_t *input,
+		     const MappedFrameBuffer &map, unsigned int start,
+		     unsigned int end);
+
+	SoftwareConverter *converter_;
+	const Frame *frame_;
+
+	/* Position of the red sample in the 2x2 Bayer pattern. */
+	unsigned int redX_;
+	unsigned int redY_;
+
+	std::array<Line, 4> lines_;
+	unsigned int nextLine_;
+
+	std::array<std::vector<uint8_t>, 2> rgb_;
+
+	std::array<std::vector<uint8_t>, 2> statsLines_;
+	/* Statistics grid column of each 2x2 block. */
+	std::vector<unsigned int> zoneMap_;
+};
+
+SoftwareConverter::Worker::Worker(SoftwareConverter *converter)
+	: converter_(converter), frame_(nullptr), nextLine_(0)
+{
+	const BayerFormat::Order order = converter->inputFormat_.order;
+	unsigned int width = converter->inputSize_.width;
+
+	redX_ = order == BayerFormat::GRBG || order == BayerFormat::BGGR;
+	redY_ = order == BayerFormat::GBRG || order == BayerFormat::BGGR;
+
+	/*
+	 * Unpacking processes groups of up to four pixels, and may write past
+	 * the end of the line when the width isn't a multiple of four.
+	 */
+	for (Line &line : lines_) {
+		line.row = -1;
+		line.data.resize(utils::alignUp(width, 4) + 2 * kPadding);
+	}
+
+	unsigned int maxWidth = 0;
+	for (const Output &output : converter->outputs_)
+		maxWidth = std::max(maxWidth, output.size.width);
+
+	for (std::vector<uint8_t> &rgb : rgb_)
+		rgb.resize(maxWidth * 3);
+
+	/* Unpacking processes groups of up to four pixels. */
+	for (std::vector<uint8_t> &line : statsLines_)
+		line.resize(utils::alignUp(width, 4));
+
+	zoneMap_.resize(width / 2);
+	for (unsigned int x = 0; x < width / 2; ++x)
+		zoneMap_[x] = x * Statistics::kGridWidth / (width / 2);
+}
+
+/*
+ * Gather the statistics of the input lines in the [start, end[ range from the
+ * raw Bayer samples, before white balance gains. Only one pair of lines out of
+ * kStatsSampling is sampled, which is enough for exposure and white balance
+ * control and keeps the cost low compared to the demosaicing.
+ */
+void SoftwareConverter::Worker::statistics(const uint8_t *input,
+					   unsigned int start, unsigned int end,
+					   Statistics *stats)
+{
+	const unsigned int width = converter_->inputSize_.width;
+	const unsigned int height = converter_->inputSize_.height;
+	const unsigned int blocks = width / 2;
+
+	*stats = {};
+
+	for (unsigned int y = start; y + 1 < end; y += 2 * kStatsSampling) {
+		for (unsigned int i = 0; i < 2; ++i)
+			unpackLine(converter_->inputFormat_,
+				   input + (y + i) * converter_->inputStride_,
+				   statsLines_[i].data(), width);
+
+		const uint8_t *red = statsLines_[redY_].data() + redX_;
+		const uint8_t *green0 = statsLines_[redY_].data() + !redX_;
+		const uint8_t *green1 = statsLines_[!redY_].data() + redX_;
+		const uint8_t *blue = statsLines_[!redY_].data() + !redX_;
+
+		Statistics::Zone *zones = &stats->zones[y * Statistics::kGridHeight / height
+							* Statistics::kGridWidth];
+
+		for (unsigned int x = 0; x < blocks; ++x) {
+			unsigned int r = red[2 * x];
+			unsigned int g = (green0[2 * x] + green1[2 * x] + 1) / 2;
+			unsigned int b = blue[2 * x];
+
+			/* BT.601 luminance, quantized to the histogram bins. */
+			unsigned int luma = (77 * r + 150 * g + 29 * b) >> 8;
+			stats->histogram[luma * Statistics::kHistogramBins / 256]++;
+
+			Statistics::Zone &zone = zones[zoneMap_[x]];
+			zone.red += r;
+			zone.green += g;
+			zone.blue += b;
+			zone.count++;
+		}
+
+		/* Horizontal gradient of the green samples as a focus measure. */
+		unsigned int sharpness = 0;
+		for (unsigned int x = 0; x + 1 < blocks; ++x)
+			sharpness += std::abs(green0[2 * x] - green0[2 * x + 2]);
+
+		stats->sharpness += sharpness;
+	}
+}
+
+/*
+ * Retrieve an unpacked input line, mirroring the lines and columns outside of
+ * the image by two to preserve the Bayer pattern. The last four lines are
+ * cached, as consecutive output lines share two of their three input lines.
+ */
+const uint8_t *SoftwareConverter::Worker::line(const uint8_t *input, int row)
+{
+	const int height = converter_->inputSize_.height;
+
+	if (row < 0)
+		row = -row;
+	else if (row >= height)
+		row = 2 * (height - 1) - row;
+
+	for (const Line &line : lines_) {
+		if (line.row == row)
+			return line.data.data() + kPadding;
+	}
+
+	Line &line = lines_[nextLine_];
+	nextLine_ = (nextLine_ + 1) % lines_.size();
+
+	const unsigned int width = converter_->inputSize_.width;
+	uint8_t *data = line.data.data() + kPadding;
+
+	unpackLine(converter_->inputFormat_,
+		   input + row * converter_->inputStride_, data, width);
+
+	if (frame_->gains) {
+		const std::array<Lut, 3> &gains = *frame_->gains;
+		bool redLine = static_cast<unsigned int>(row & 1) == redY_;
+
+		/* Red and blue samples are on columns of opposite parities. */
+		const Lut &colour = redLine ? gains[0] : gains[2];
+		unsigned int phase = redLine ? redX_ : !redX_;
+		const Lut &even = phase ? gains[1] : colour;
+		const Lut &odd = phase ? colour : gains[1];
+
+		for (unsigned int x = 0; x + 1 < width; x += 2) {
+			data[x] = even[data[x]];
+			data[x + 1] = odd[data[x + 1]];
+		}
+	}
+
+	data[-2] = data[2];
+	data[-1] = data[1];
+	data[width] = data[width - 2];
+	data[width + 1] = data[width - 1];
+
+	line.row = row;
+
+	return data;
+}
+
+void SoftwareConverter::Worker::demosaic(const Output &output,
+					 const uint8_t *input, unsigned int y,
+					 uint8_t *rgb)
+{
+	int row = output.yMap[y];
+
+	const uint8_t *prev = line(input, row - 1);
+	const uint8_t *curr = line(input, row);
+	const uint8_t *next = line(input, row + 1);
+
+	bool redLine = static_cast<unsigned int>(row & 1) == redY_;
+	unsigned int phase = redLine ? redX_ : !redX_;
+
+	if (output.size.width == converter_->inputSize_.width)
+		demosaicLine<false>(prev, curr, next, redLine, phase, nullptr,
+				    output.size.width, rgb);
+	else
+		demosaicLine<true>(prev, curr, next, redLine, phase,
+				   output.xMap.data(), output.size.width, rgb);
+}
+
+void SoftwareConverter::Worker::convert(const Output &output,
+					const uint8_t *input,
+					const MappedFrameBuffer &map,
+					unsigned int start, unsigned int end)
+{
+	const PixelFormatInfo &info = PixelFormatInfo::info(output.pixelFormat);
+	const unsigned int width = output.size.width;
+
+	/*
+	 * Locate the planes. Buffers that store all planes in a single
+	 * FrameBuffer plane use the same layout as V4L2 single-planar formats.
+	 */
+	std::array<uint8_t *, 3> planes{};
+	for (unsigned int i = 0; i < info.numPlanes(); ++i) {
+		if (i < map.planes().size()) {
+			planes[i] = map.planes()[i].data();
+		} else {
+			unsigned int height = output.size.height
+					    / info.planes[i - 1].verticalSubSampling;
+			planes[i] = planes[i - 1] + output.strides[i - 1] * height;
+		}
+	}
+
+	/* Invalidate the line cache, the input changes with every frame. */
+	for (Line &line : lines_)
+		line.row = -1;
+
+	if (info.colourEncoding == PixelFormatInfo::ColourEncodingYUV) {
+		const bool semiPlanar = info.numPlanes() == 2;
+
+		for (unsigned int y = start; y < end; y += 2) {
+			demosaic(output, input, y, rgb_[0].data());
+			demosaic(output, input, y + 1, rgb_[1].data());
+
+			uint8_t *y0 = planes[0] + y * output.strides[0];
+			uint8_t *u = planes[1] + y / 2 * output.strides[1];
+			uint8_t *v = semiPlanar ? u + 1
+						: planes[2] + y / 2 * output.strides[2];
+
+			storeYUV420(rgb_[0].data(), rgb_[1].data(), y0,
+				    y0 + output.strides[0], u, v,
+				    semiPlanar ? 2 : 1, width);
+		}
+
+		return;
+	}
+
+	for (unsigned int y = start; y < end; ++y) {
+		uint8_t *dst = planes[0] + y * output.strides[0];
+		const uint8_t *rgb = rgb_[0].data();
+
+		demosaic(output, input, y, rgb_[0].data());
+
+		/* DRM formats are named in little-endian word order. */
+		switch (output.pixelFormat) {
+		case formats::RGB888:
+			storeRGB<3, 2, 1, 0>(rgb, dst, width);
+			break;
+		case formats::BGR888:
+			storeRGB<3, 0, 1, 2>(rgb, dst, width);
+			break;
+		case formats::XRGB8888:
+			storeRGB<4, 2, 1, 0>(rgb, dst, width);
+			break;
+		case formats::XBGR8888:
+			storeRGB<4, 0, 1, 2>(rgb, dst, width);
+			break;
+		default:
+			break;
+		}
+	}
+}
+
+void SoftwareConverter::Worker::process(Frame *frame, unsigned int band)
+{
+	const unsigned int bands = converter_->workers_.size();
+	const uint8_t *input = frame->inputMap->planes()[0].data();
+
+	frame_ = frame;
+
+	if (!frame->stats.empty()) {
+		unsigned int height = converter_->inputSize_.height;
+		unsigned int lines = utils::alignUp((height + bands - 1) / bands, 2);
+		unsigned int start = std::min(band * lines, height);
+		unsigned int end = std::min(start + lines, height);
+
+		statistics(input, start, end, &frame->stats[band]);
+	}
+
+	for (const auto &[index, buffer] : frame->outputs) {
+		const Output &output = converter_->outputs_[index];
+
+		/* Split the output in bands of an even number of lines. */
+		unsigned int height = output.size.height;
+		unsigned int lines = utils::alignUp((height + bands - 1) / bands, 2);
+		unsigned int start = std::min(band * lines, height);
+		unsigned int end = std::min(start + lines, height);
+
+		convert(output, input, *frame->outputMaps.at(index), start, end);
+	}
+
+	frame_ = nullptr;
+
+	if (--frame->pending)
+		return;
+
+	converter_->invokeMethod(&SoftwareConverter::frameDone,
+				 ConnectionTypeQueued);
+
+	MutexLocker locker(converter_->mutex_);
+	converter_->framesInFlight_--;
+	converter_->idle_.notify_all();
+}
+
+/* -----------------------------------------------------------------------------
+ * SoftwareConverter
+ */
+
+/**
+ * \class libcamera::SoftwareConverter
+ * \brief Converter implementation that debayers frames on the CPU
+ *
+ * The SoftwareConverter implements the Converter interface for platforms that
+ * have no hardware converter. It converts raw Bayer frames, either 8-bit or
+ * 10-bit and 12-bit in CSI-2 packed or unpacked layouts, to RGB and YUV
+ * formats, with an optional downscaling.
+ *
+ * Demosaicing uses a bilinear filter on 8-bit samples, and scaling samples the
+ * demosaiced image at the nearest input pixel. Each frame is split in bands of
+ * lines processed concurrently by a pool of worker threads, and completion is
+ * signalled in the thread the converter is bound to.
+ *
+ * Output buffers are allocated from a BufferPool, preferring dma-heaps to let
+ * applications share them with other devices.
+ *
+ * As the platforms that rely on software conversion have no ISP, the converter
+ * can also produce the statistics needed by image processing algorithms, and
+ * apply white balance gains. When enabled with setStatisticsEnabled(), the
+ * statistics are computed by the worker threads from the raw input samples
+ * and emitted with the statisticsReady signal before the frame completes.
+ */
+
+/**
+ * \struct libcamera::SoftwareConverter::Statistics
+ * \brief Image statistics computed from the raw Bayer samples
+ *
+ * The statistics are gathered on a subsampled set of lines, and cover the
+ * whole image. The red, green and blue values of each 2x2 Bayer block are
+ * accumulated in the zones of a kGridWidth x kGridHeight grid, and the
+ * luminance of each block is recorded in a histogram. The sum of the
+ * horizontal gradients of the green samples provides a focus measure.
+ *
+ * All values are expressed on 8 bits, regardless of the input bit depth.
+ *
+ * \var libcamera::SoftwareConverter::Statistics::kHistogramBins
+ * \brief Number of bins of the luminance histogram
+ *
+ * \var libcamera::SoftwareConverter::Statistics::kGridWidth
+ * \brief Number of zone columns
+ *
+ * \var libcamera::SoftwareConverter::Statistics::kGridHeight
+ * \brief Number of zone rows
+ *
+ * \var libcamera::SoftwareConverter::Statistics::histogram
+ * \brief Luminance histogram of the sampled Bayer blocks
+ *
+ * \var libcamera::SoftwareConverter::Statistics::zones
+ * \brief Per-zone colour sums, in raster order
+ *
+ * \var libcamera::SoftwareConverter::Statistics::sharpness
+ * \brief Sum of the absolute horizontal green gradients
+ */
+
+/**
+ * \struct libcamera::SoftwareConverter::Statistics::Zone
+ * \brief Colour sums of a statistics zone
+ *
+ * \var libcamera::SoftwareConverter::Statistics::Zone::red
+ * \brief Sum of the red samples
+ *
+ * \var libcamera::SoftwareConverter::Statistics::Zone::green
+ * \brief Sum of the average of the two green samples of each block
+ *
+ * \var libcamera::SoftwareConverter::Statistics::Zone::blue
+ * \brief Sum of the blue samples
+ *
+ * \var libcamera::SoftwareConverter::Statistics::Zone::count
+ * \brief Number of Bayer blocks accumulated in the zone
+ */
+
+/**
+ * \brief Accumulate statistics gathered on a different part of the image
+ * \param[in] other The statistics to accumulate
+ */
+void SoftwareConverter::Statistics::merge(const Statistics &other)
+{
+	for (unsigned int i = 0; i < histogram.size(); ++i)
+		histogram[i] += other.histogram[i];
+
+	for (unsigned int i = 0; i < zones.size(); ++i) {
+		zones[i].red += other.zones[i].red;
+		zones[i].green += other.zones[i].green;
+		zones[i].blue += other.zones[i].blue;
+		zones[i].count += other.zones[i].count;
+	}
+
+	sharpness += other.sharpness;
+}
+
+/**
+ * \brief Construct a SoftwareConverter instance
+ * \param[in] media Unused, the software converter isn't backed by a device
+ */
+SoftwareConverter::SoftwareConverter(MediaDevice *media)
+	: Converter(media), inputStride_(0), statsEnabled_(false),
+	  framesInFlight_(0)
+{
+}
+
+SoftwareConverter::~SoftwareConverter()
+{
+	stop();
+}
+
+/**
+ * \fn libcamera::SoftwareConverter::loadConfiguration
+ * \details \copydetails libcamera::Converter::loadConfiguration
+ */
+
+/**
+ * \fn libcamera::SoftwareConverter::isValid
+ * \details \copydetails libcamera::Converter::isValid
+ */
+
+/**
+ * \fn libcamera::SoftwareConverter::setStatisticsEnabled
+ * \brief Enable or disable statistics computation
+ * \param[in] enable True to compute statistics for the frames queued next
+ */
+
+/**
+ * \brief Set the white balance gains applied to the frames queued next
+ * \param[in] red The red gain
+ * \param[in] blue The blue gain
+ *
+ * The gains are applied to the raw samples before demosaicing, and are
+ * relative to the green samples. Unity gains disable white balance.
+ */
+void SoftwareConverter::setColourGains(double red, double blue)
+{
+	if (red == 1.0 && blue == 1.0) {
+		gains_.reset();
+		return;
+	}
+
+	std::array<Lut, 3> &gains = gains_.emplace();
+
+	for (unsigned int i = 0; i < 256; ++i) {
+		gains[0][i] = std::min<unsigned int>(std::lround(i * red), 255);
+		gains[1][i] = i;
+		gains[2][i] = std::min<unsigned int>(std::lround(i * blue), 255);
+	}
+}
+
+/**
+ * \var libcamera::SoftwareConverter::statisticsReady
+ * \brief A signal emitted when the statistics of a frame are available
+ *
+ * The signal is emitted with the sequence number of the input buffer, before
+ * the buffers of the frame complete. The statistics are only valid for the
+ * duration of the signal emission.
+ */
+
+/**
+ * \brief Check if the converter supports an input format
+ * \param[in] input The input pixel format
+ * \return True if \a input can be converted, false otherwise
+ */
+bool SoftwareConverter::isSupported(PixelFormat input)
+{
+	BayerFormat format = BayerFormat::fromPixelFormat(input);
+	if (!format.isValid() || format.order == BayerFormat::MONO)
+		return false;
+
+	switch (format.packing) {
+	case BayerFormat::Packing::None:
+		return format.bitDepth == 8 || format.bitDepth == 10 ||
+		       format.bitDepth == 12 || format.bitDepth == 16;
+	case BayerFormat::Packing::CSI2:
+		return format.bitDepth == 10 || format.bitDepth == 12;
+	default:
+		return false;
+	}
+}
+
+/**
+ * \fn libcamera::SoftwareConverter::formats
+ * \details \copydetails libcamera::Converter::formats
+ */
+std::vector<PixelFormat> SoftwareConverter::formats(PixelFormat input)
+{
+	if (!isSupported(input))
+		return {};
+
+	return outputFormats;
+}
+
+/**
+ * \copydoc libcamera::Converter::sizes
+ */
+SizeRange SoftwareConverter::sizes(const Size &input)
+{
+	/* Outputs are downscaled only, with even dimensions for YUV 4:2:0. */
+	Size min = Size(2, 2).boundedTo(input);
+	Size max = input.alignedDownTo(2, 2);
+
+	return SizeRange(min, max, 2, 2);
+}
+
+/**
+ * \copydoc libcamera::Converter::strideAndFrameSize
+ */
+std::tuple<unsigned int, unsigned int>
+SoftwareConverter::strideAndFrameSize(const PixelFormat &pixelFormat,
+				      const Size &size)
+{
+	if (std::find(outputFormats.begin(), outputFormats.end(), pixelFormat) ==
+	    outputFormats.end())
+		return std::make_tuple(0, 0);
+
+	const PixelFormatInfo &info = PixelFormatInfo::info(pixelFormat);
+
+	return std::make_tuple(info.stride(size.width, 0),
+			       info.frameSize(size));
+}
+
+/**
+ * \copydoc libcamera::Converter::configure
+ */
+int SoftwareConverter::configure(const StreamConfiguration &inputCfg,
+				 const std::vector<std::reference_wrapper<StreamConfiguration>> &outputCfgs)
+{
+	if (!workers_.empty()) {
+		LOG(Converter, Error) << "Can't configure a running converter";
+		return -EBUSY;
+	}
+
+	outputs_.clear();
+
+	if (!isSupported(inputCfg.pixelFormat)) {
+		LOG(Converter, Error)
+			<< "Input format " << inputCfg.pixelFormat
+			<< " not supported";
+		return -EINVAL;
+	}
+
+	const PixelFormatInfo &inputInfo = PixelFormatInfo::info(inputCfg.pixelFormat);
+
+	inputFormat_ = BayerFormat::fromPixelFormat(inputCfg.pixelFormat);
+	inputSize_ = inputCfg.size;
+	inputStride_ = inputCfg.stride ? inputCfg.stride
+				       : inputInfo.stride(inputSize_.width, 0);
+
+	if (inputSize_.width < 4 || inputSize_.height < 2) {
+		LOG(Converter, Error) << "Input size " << inputSize_ << " too small";
+		return -EINVAL;
+	}
+
+	SizeRange range = sizes(inputSize_);
+
+	for (const StreamConfiguration &cfg : outputCfgs) {
+		if (std::find(outputFormats.begin(), outputFormats.end(),
+			      cfg.pixelFormat) == outputFormats.end() ||
+		    !range.contains(cfg.size)) {
+			LOG(Converter, Error)
+				<< "Output " << cfg.toString() << " not supported";
+			outputs_.clear();
+			return -EINVAL;
+		}
+
+		const PixelFormatInfo &info = PixelFormatInfo::info(cfg.pixelFormat);
+		Output &output = outputs_.emplace_back();
+
+		output.pixelFormat = cfg.pixelFormat;
+		output.size = cfg.size;
+
+		/* Same plane layout as V4L2 single-planar buffers. */
+		unsigned int stride = cfg.stride ? cfg.stride
+						 : info.stride(cfg.size.width, 0);
+		for (unsigned int i = 0; i < output.strides.size(); ++i)
+			output.strides[i] = stride * info.planes[i].bytesPerGroup
+					  / info.planes[0].bytesPerGroup;
+
+		/* Sample the centre of the input area covered by each pixel. */
+		output.xMap.resize(cfg.size.width);
+		for (unsigned int x = 0; x < cfg.size.width; ++x)
+			output.xMap[x] = (2 * x + 1) * inputSize_.width
+				       / (2 * cfg.size.width);
+
+		output.yMap.resize(cfg.size.height);
+		for (unsigned int y = 0; y < cfg.size.height; ++y)
+			output.yMap[y] = (2 * y + 1) * inputSize_.height
+				       / (2 * cfg.size.height);
+	}
+
+	return 0;
+}
+
+/**
+ * \copydoc libcamera::Converter::exportBuffers
+ */
+int SoftwareConverter::exportBuffers(unsigned int output, unsigned int count,
+				     std::vector<std::unique_ptr<FrameBuffer>> *buffers)
+{
+	if (output >= outputs_.size())
+		return -EINVAL;
+
+	if (!pool_) {
+		pool_ = std::make_shared<BufferPool>(DmaHeap::DmaHeapFlag::System |
+						     DmaHeap::DmaHeapFlag::UDmaBuf |
+						     DmaHeap::DmaHeapFlag::MemFd);
+		if (!pool_->isValid()) {
+			pool_.reset();
+			return -ENODEV;
+		}
+	}
+
+	StreamConfiguration cfg;
+	cfg.pixelFormat = outputs_[output].pixelFormat;
+	cfg.size = outputs_[output].size;
+	cfg.stride = outputs_[output].strides[0];
+	cfg.bufferCount = count;
+
+	return pool_->allocate(cfg, buffers);
+}
+
+/**
+ * \copydoc libcamera::Converter::start
+ */
+int SoftwareConverter::start()
+{
+	if (outputs_.empty())
+		return -EINVAL;
+
+	unsigned int count = std::clamp(std::thread::hardware_concurrency(),
+					1U, kMaxWorkers);
+
+	for (unsigned int i = 0; i < count; ++i) {
+		std::unique_ptr<Thread> thread = std::make_unique<Thread>();
+		std::unique_ptr<Worker> worker = std::make_unique<Worker>(this);
+
+		worker->moveToThread(thread.get());
+		thread->start();
+
+		threads_.push_back(std::move(thread));
+		workers_.push_back(std::move(worker));
+	}
+
+	LOG(Converter, Debug)
+		<< "Converting " << inputSize_ << "-" << inputFormat_
+		<< " with " << count << " threads";
+
+	return 0;
+}
+
+/**
+ * \copydoc libcamera::Converter::stop
+ */
+void SoftwareConverter::stop()
+{
+	if (workers_.empty())
+		return;
+
+	/* Wait for the frames being converted. */
+	{
+		MutexLocker locker(mutex_);
+		idle_.wait(locker, [&]() LIBCAMERA_TSA_REQUIRES(mutex_) {
+			return framesInFlight_ == 0;
+		});
+	}
+
+	for (std::unique_ptr<Thread> &thread : threads_) {
+		thread->exit();
+		thread->wait();
+	}
+
+	workers_.clear();
+	threads_.clear();
+
+	/* Complete the remaining frames synchronously. */
+	while (!frames_.empty()) {
+		std::unique_ptr<Frame> frame = std::move(frames_.front());
+		frames_.pop_front();
+		completeFrame(frame.get());
+	}
+}
+
+/**
+ * \copydoc libcamera::Converter::queueBuffers
+ */
+int SoftwareConverter::queueBuffers(FrameBuffer *input,
+				    const std::map<unsigned int, FrameBuffer *> &outputs)
+{
+	if (workers_.empty())
+		return -EBUSY;
+
+	if (outputs.empty())
+		return -EINVAL;
+
+	for (auto [index, buffer] : outputs) {
+		if (!buffer || index >= outputs_.size())
+			return -EINVAL;
+	}
+
+	std::unique_ptr<Frame> frame = std::make_unique<Frame>();
+	frame->input = input;
+	frame->outputs = outputs;
+
+	/* Cached mappings avoid mapping the buffers for every frame. */
+	frame->inputMap = std::make_unique<MappedFrameBuffer>(
+		input, MappedFrameBuffer::MapFlag::Read |
+		       MappedFrameBuffer::MapFlag::Cached);
+	if (!frame->inputMap->isValid()) {
+		LOG(Converter, Error) << "Failed to map input buffer";
+		return -EINVAL;
+	}
+
+	for (auto [index, buffer] : outputs) {
+		auto map = std::make_unique<MappedFrameBuffer>(
+			buffer, MappedFrameBuffer::MapFlag::Write |
+				MappedFrameBuffer::MapFlag::Cached);
+		if (!map->isValid()) {
+			LOG(Converter, Error) << "Failed to map output buffer";
+			return -EINVAL;
+		}
+
+		frame->outputMaps[index] = std::move(map);
+	}
+
+	frame->gains = gains_;
+	if (statsEnabled_)
+		frame->stats.resize(workers_.size());
+
+	frame->pending = workers_.size();
+
+	{
+		MutexLocker locker(mutex_);
+		framesInFlight_++;
+	}
+
+	Frame *f = frame.get();
+	frames_.push_back(std::move(frame));
+
+	for (unsigned int i = 0; i < workers_.size(); ++i)
+		workers_[i]->invokeMethod(&Worker::process,
+					  ConnectionTypeQueued, f, i);
+
+	return 0;
+}
+
+/* Complete the converted frames, in queuing order. */
+void SoftwareConverter::frameDone()
+{
+	while (!frames_.empty() && !frames_.front()->pending) {
+		std::unique_ptr<Frame> frame = std::move(frames_.front());
+		frames_.pop_front();
+		completeFrame(frame.get());
+	}
+}
+
+void SoftwareConverter::completeFrame(Frame *frame)
+{
+	const FrameMetadata &metadata = frame->input->metadata();
+
+	/* Release the mappings before handing the buffers back. */
+	frame->inputMap.reset();
+	frame->outputMaps.clear();
+
+	if (!frame->stats.empty()) {
+		Statistics &stats = frame->stats[0];
+		for (unsigned int i = 1; i < frame->stats.size(); ++i)
+			stats.merge(frame->stats[i]);
+
+		statisticsReady.emit(metadata.sequence, stats);
+	}
+
+	for (auto [index, buffer] : frame->outputs) {
+		FrameMetadata &outMetadata = buffer->_d()->metadata();
+
+		outMetadata.status = FrameMetadata::FrameSuccess;
+		outMetadata.sequence = metadata.sequence;
+		outMetadata.timestamp = metadata.timestamp;
+
+		Span<FrameMetadata::Plane> planes = outMetadata.planes();
+		for (auto [i, plane] : utils::enumerate(planes))
+			plane.bytesused = buffer->planes()[i].length;
+
+		outputBufferReady.emit(buffer);
+	}
+
+	inputBufferReady.emit(frame->input);
+}
+
+static std::initializer_list<std::string> compatibles = {};
+
+REGISTER_CONVERTER("software", SoftwareConverter, compatibles)
+
+} /* namespace libcamera */
@@ -31,6 +31,18 @@ namespace libcamera {
 
 LOG_DECLARE_CATEGORY(Converter)
 
+namespace {
+
+/*
+ * Applications may queue buffers they have allocated themselves, in larger
+ * numbers than the configured buffer count. Reserve enough V4L2 buffer slots
+ * for them to stay attached to the device, instead of being remapped when a
+ * slot is reused for a different buffer.
+ */
+constexpr unsigned int kMinImportedBuffers = 16;
+
+} /* namespace */
+
 /* -----------------------------------------------------------------------------
  * V4L2M2MConverter::Stream
  */
@@ -113,7 +125,8 @@ int V4L2M2MConverter::Stream::start()
 	if (ret < 0)
 		return ret;
 
-	ret = m2m_->capture()->importBuffers(outputBufferCount_);
+	ret = m2m_->capture()->importBuffers(std::max(outputBufferCount_,
+						      kMinImportedBuffers));
 	if (ret < 0) {
 		stop();
 		return ret;
@@ -7,10 +7,13 @@
 
 #include "libcamera/internal/delayed_controls.h"
 
+#include <algorithm>
+
 #include <libcamera/base/log.h>
 
 #include <libcamera/controls.h>
 
+#include "libcamera/internal/v4l2_control_transaction.h"
 #include "libcamera/internal/v4l2_device.h"
 
 /**
@@ -36,6 +39,26 @@ LOG_DEFINE_CATEGORY(DelayedControls)
  * control depth the controls are guaranteed to take effect for the correct
  * request. The control depth is determined by the control with the greatest
  * delay.
+ *
+ * Controls must be written between the start of a frame and the point where
+ * the sensor latches them for the next frame, typically during vertical
+ * blanking. Controls written too late take effect one frame later than
+ * intended. To minimize the latency, pipeline handlers should call
+ * applyControls() from the frame start event of the device that captures the
+ * frames, either by connecting it to the V4L2Device::frameStart signal, or by
+ * letting the DelayedControls instance handle the events with
+ * enableFrameStart(). The latter also measures the latency between the frame
+ * start event and the completion of the control writes, and counts the late
+ * writes based on the limit set with setLatencyLimit().
+ *
+ * The statistics() report the number of frames handled, and the frames for
+ * which controls may not have been applied as intended: skipped frame start
+ * events, frames for which no controls had been pushed in time (underruns),
+ * and late writes.
+ *
+ * Each set of controls can be associated with a cookie when pushed, which is
+ * returned along with the controls by get(). Pipeline handlers can use the
+ * cookie to identify the IPA context the controls have been computed for.
  */
 
 /**
@@ -57,11 +80,45 @@ LOG_DEFINE_CATEGORY(DelayedControls)
  * blanking bounds.
  */
 
+/**
+ * \struct DelayedControls::Statistics
+ * \brief Control scheduling statistics
+ *
+ * \var DelayedControls::Statistics::frames
+ * \brief Number of frames for which controls have been applied
+ *
+ * \var DelayedControls::Statistics::skipped
+ * \brief Number of frames for which no frame start has been signalled
+ *
+ * \var DelayedControls::Statistics::underruns
+ * \brief Number of frames started before controls have been pushed for them
+ *
+ * \var DelayedControls::Statistics::late
+ * \brief Number of frames for which the control write latency exceeded the
+ * latency limit
+ *
+ * \var DelayedControls::Statistics::lastLatency
+ * \brief Latency between the last frame start and the end of the control
+ * writes
+ *
+ * \var DelayedControls::Statistics::maxLatency
+ * \brief Maximum latency between a frame start and the end of the control
+ * writes
+ *
+ * \var DelayedControls::Statistics::totalLatency
+ * \brief Sum of the latencies between frame starts and the end of the control
+ * writes
+ *
+ * The latencies are only measured when the frame start events are handled by
+ * the DelayedControls instance, see enableFrameStart().
+ */
+
 /**
  * \brief Construct a DelayedControls instance
  * \param[in] device The V4L2 device the controls have to be applied to
  * \param[in] controlParams Map of the numerical V4L2 control ids to their
  * associated control parameters.
+ * \param[in] transaction The control transaction to write the controls with
  *
  * The control parameters comprise of delays (in frames) and a priority write
  * flag. If this flag is set, the relevant control is written separately from,
@@ -70,16 +127,31 @@ LOG_DEFINE_CATEGORY(DelayedControls)
  * Only controls specified in \a controlParams are handled. If it's desired to
  * mix delayed controls and controls that take effect immediately the immediate
  * controls must be listed in the \a controlParams map with a delay value of 0.
+ *
+ * The controls are written with a V4L2ControlTransaction. Pipeline handlers
+ * that write controls to other devices at frame start, such as the lens, can
+ * share a \a transaction with the DelayedControls instance to write all the
+ * controls of the camera in one go from applyControls(). The \a transaction
+ * must outlive the DelayedControls instance. If no \a transaction is
+ * specified, an internal one is used.
  */
 DelayedControls::DelayedControls(V4L2Device *device,
-				 const std::unordered_map<uint32_t, ControlParams> &controlParams)
-	: device_(device), maxDelay_(0)
+				 const std::unordered_map<uint32_t, ControlParams> &controlParams,
+				 V4L2ControlTransaction *transaction)
+	: device_(device), transaction_(transaction),
+	  effectiveControls_(device->controls()), maxDelay_(0),
+	  frameStartSource_(nullptr), latencyLimit_(0)
 {
 	const ControlInfoMap &controls = device_->controls();
 
+	if (!transaction_) {
+		ownTransaction_ = std::make_unique<V4L2ControlTransaction>();
+		transaction_ = ownTransaction_.get();
+	}
+
 	/*
-	 * Create a map of control ids to delays for controls exposed by the
-	 * device.
+	 * Create a table of the controls exposed by the device, each with its
+	 * parameters and its ring buffer of values.
 	 */
 	for (auto const &param : controlParams) {
 		auto it = controls.find(param.first);
@@ -94,92 +166,105 @@ DelayedControls::DelayedControls(V4L2Device *device,
 
 		const ControlId *id = it->first;
 
-		controlParams_[id] = param.second;
+		controls_.push_back({ id, param.second, {} });
 
 		LOG(DelayedControls, Debug)
-			<< "Set a delay of " << controlParams_[id].delay
-			<< " and priority write flag " << controlParams_[id].priorityWrite
+			<< "Set a delay of " << param.second.delay
+			<< " and priority write flag " << param.second.priorityWrite
 			<< " for " << id->name();
 
-		maxDelay_ = std::max(maxDelay_, controlParams_[id].delay);
+		maxDelay_ = std::max(maxDelay_, param.second.delay);
+
+		transaction_->addControl(device_, id->id(),
+					 param.second.priorityWrite);
 	}
 
+	/* Sort the controls by id to speed up lookups in push(). */
+	std::sort(controls_.begin(), controls_.end(),
+		  [](const Control &a, const Control &b) {
+			  return a.id->id() < b.id->id();
+		  });
+
+	for (const Control &ctrl : controls_)
+		ids_.push_back(ctrl.id->id());
+
 	reset();
 }
 
+DelayedControls::~DelayedControls()
+{
+	disableFrameStart();
+}
+
 /**
  * \brief Reset state machine
+ * \param[in] cookie Cookie associated with the controls reported by the device
  *
  * Resets the state machine to a starting position based on control values
  * retrieved from the device.
  */
-void DelayedControls::reset()
+void DelayedControls::reset(unsigned int cookie)
 {
 	queueCount_ = 1;
 	writeCount_ = 0;
+	cookies_[0] = cookie;
+	effectiveControls_.clear();
 
 	/* Retrieve control as reported by the device. */
-	std::vector<uint32_t> ids;
-	for (auto const &param : controlParams_)
-		ids.push_back(param.first->id());
-
-	ControlList controls = device_->getControls(ids);
+	ControlList controls = device_->getControls(ids_);
 
 	/* Seed the control queue with the controls reported by the device. */
-	values_.clear();
-	for (const auto &ctrl : controls) {
-		const ControlId *id = device_->controls().idmap().at(ctrl.first);
+	for (Control &ctrl : controls_) {
+		ctrl.values = {};
+
 		/*
 		 * Do not mark this control value as updated, it does not need
 		 * to be written to to device on startup.
 		 */
-		values_[id][0] = Info(ctrl.second, false);
+		if (controls.contains(ctrl.id->id()))
+			ctrl.values[0] = Info(controls.get(ctrl.id->id()), false);
 	}
 }
 
 /**
  * \brief Push a set of controls on the queue
  * \param[in] controls List of controls to add to the device queue
+ * \param[in] cookie Cookie to associate with the controls
  *
  * Push a set of controls to the control queue. This increases the control queue
  * depth by one.
  *
  * \returns true if \a controls are accepted, or false otherwise
  */
-bool DelayedControls::push(const ControlList &controls)
+bool DelayedControls::push(const ControlList &controls, unsigned int cookie)
 {
 	/* Copy state from previous frame. */
-	for (auto &ctrl : values_) {
-		Info &info = ctrl.second[queueCount_];
-		info = values_[ctrl.first][queueCount_ - 1];
+	for (Control &ctrl : controls_) {
+		Info &info = ctrl.values[queueCount_];
+		info = ctrl.values[queueCount_ - 1];
 		info.updated = false;
 	}
 
 	/* Update with new controls. */
-	const ControlIdMap &idmap = device_->controls().idmap();
 	for (const auto &control : controls) {
-		const auto &it = idmap.find(control.first);
-		if (it == idmap.end()) {
+		Control *ctrl = findControl(control.first);
+		if (!ctrl) {
 			LOG(DelayedControls, Warning)
 				<< "Unknown control " << control.first;
 			return false;
 		}
 
-		const ControlId *id = it->second;
-
-		if (controlParams_.find(id) == controlParams_.end())
-			return false;
-
-		Info &info = values_[id][queueCount_];
+		Info &info = ctrl->values[queueCount_];
 
 		info = Info(control.second);
 
 		LOG(DelayedControls, Debug)
-			<< "Queuing " << id->name()
+			<< "Queuing " << ctrl->id->name()
 			<< " to " << info.toString()
 			<< " at index " << queueCount_;
 	}
 
+	cookies_[queueCount_] = cookie;
 	queueCount_++;
 
 	return true;
@@ -198,26 +283,47 @@ bool DelayedControls::push(const ControlList &controls)
  * push(). The max history from the current sequence number that yields valid
  * values are thus 16 minus number of controls pushed.
  *
- * \return The controls at \a sequence number
+ * The returned control list is owned by the DelayedControls instance, and is
+ * updated in place by the next call to this function, to avoid allocating a new
+ * list for every frame. Callers that need to keep the controls shall copy the
+ * list.
+ *
+ * \return The controls at \a sequence number and the cookie associated with
+ * them
  */
-ControlList DelayedControls::get(uint32_t sequence)
+std::pair<const ControlList &, unsigned int> DelayedControls::get(uint32_t sequence)
 {
 	unsigned int index = std::max<int>(0, sequence - maxDelay_);
 
-	ControlList out(device_->controls());
-	for (const auto &ctrl : values_) {
-		const ControlId *id = ctrl.first;
-		const Info &info = ctrl.second[index];
+	/*
+	 * Controls that couldn't be read from the device are not reported, and
+	 * can't be removed individually from the list. Rebuild the list in the
+	 * unlikely case one of them was reported for another sequence.
+	 */
+	for (const Control &ctrl : controls_) {
+		if (ctrl.values[index].isNone() &&
+		    effectiveControls_.contains(ctrl.id->id())) {
+			effectiveControls_.clear();
+			break;
+		}
+	}
+
+	for (const Control &ctrl : controls_) {
+		const Info &info = ctrl.values[index];
+
+		/* Skip controls that couldn't be read from the device. */
+		if (info.isNone())
+			continue;
 
-		out.set(id->id(), info);
+		effectiveControls_.set(ctrl.id->id(), info);
 
 		LOG(DelayedControls, Debug)
-			<< "Reading " << id->name()
+			<< "Reading " << ctrl.id->name()
 			<< " to " << info.toString()
 			<< " at index " << index;
 	}
 
-	return out;
+	return { effectiveControls_, cookies_[index] };
 }
 
 /**
@@ -228,41 +334,39 @@ ControlList DelayedControls::get(uint32_t sequence)
  * number. Any user of these helpers is responsible to inform the helper about
  * the start of any frame. This can be connected with ease to the start of a
  * exposure (SOE) V4L2 event.
+ *
+ * The control values due for the frame are written with a single commit of the
+ * transaction, together with the other controls pending in the transaction if
+ * it is shared with the pipeline handler.
  */
 void DelayedControls::applyControls(uint32_t sequence)
 {
 	LOG(DelayedControls, Debug) << "frame " << sequence << " started";
 
 	/*
-	 * Create control list peeking ahead in the value queue to ensure
-	 * values are set in time to satisfy the sensor delay.
+	 * Frame start events may be lost, in which case the controls of the
+	 * skipped frames have been written late.
 	 */
-	ControlList out(device_->controls());
-	for (auto &ctrl : values_) {
-		const ControlId *id = ctrl.first;
-		unsigned int delayDiff = maxDelay_ - controlParams_[id].delay;
+	if (writeCount_ && sequence > writeCount_)
+		stats_.skipped += sequence - writeCount_;
+	stats_.frames++;
+
+	/*
+	 * Set the control values in the transaction, peeking ahead in the
+	 * value queue to ensure values are set in time to satisfy the sensor
+	 * delay. Priority controls are written ahead of the other controls by
+	 * the transaction.
+	 */
+	for (Control &ctrl : controls_) {
+		unsigned int delayDiff = maxDelay_ - ctrl.params.delay;
 		unsigned int index = std::max<int>(0, writeCount_ - delayDiff);
-		Info &info = ctrl.second[index];
+		Info &info = ctrl.values[index];
 
 		if (info.updated) {
-			if (controlParams_[id].priorityWrite) {
-				/*
-				 * This control must be written now, it could
-				 * affect validity of the other controls.
-				 */
-				ControlList priority(device_->controls());
-				priority.set(id->id(), info);
-				device_->setControls(&priority);
-			} else {
-				/*
-				 * Batch up the list of controls and write them
-				 * at the end of the function.
-				 */
-				out.set(id->id(), info);
-			}
+			transaction_->set(device_, ctrl.id->id(), info);
 
 			LOG(DelayedControls, Debug)
-				<< "Setting " << id->name()
+				<< "Setting " << ctrl.id->name()
 				<< " to " << info.toString()
 				<< " at index " << index;
 
@@ -276,10 +380,113 @@ void DelayedControls::applyControls(uint32_t sequence)
 	while (writeCount_ > queueCount_) {
 		LOG(DelayedControls, Debug)
 			<< "Queue is empty, auto queue no-op.";
-		push({});
+		push({}, cookies_[queueCount_ - 1]);
+		stats_.underruns++;
 	}
 
-	device_->setControls(&out);
+	transaction_->commit();
+}
+
+/**
+ * \brief Apply controls from the frame start events of a device
+ * \param[in] source The device that signals the frame start events
+ *
+ * Enable the frame start events on \a source and apply the controls when they
+ * are signalled. The pipeline handler shall not call applyControls() directly
+ * while the frame start events are enabled. The events are typically enabled
+ * when starting the camera, after calling reset().
+ *
+ * \return 0 on success or a negative error code if \a source doesn't support
+ * frame start events
+ */
+int DelayedControls::enableFrameStart(V4L2Device *source)
+{
+	if (frameStartSource_ == source)
+		return 0;
+
+	disableFrameStart();
+
+	int ret = source->setFrameStartEnabled(true);
+	if (ret)
+		return ret;
+
+	source->frameStart.connect(this, &DelayedControls::frameStarted);
+	frameStartSource_ = source;
+
+	return 0;
+}
+
+/**
+ * \brief Stop applying controls from frame start events
+ */
+void DelayedControls::disableFrameStart()
+{
+	if (!frameStartSource_)
+		return;
+
+	frameStartSource_->frameStart.disconnect(this, &DelayedControls::frameStarted);
+	frameStartSource_->setFrameStartEnabled(false);
+	frameStartSource_ = nullptr;
+}
+
+/**
+ * \fn DelayedControls::frameStartEnabled()
+ * \brief Check if controls are applied from frame start events
+ * \return True if the frame start events are enabled with enableFrameStart(),
+ * false otherwise
+ */
+
+/**
+ * \fn DelayedControls::setLatencyLimit()
+ * \brief Set the maximum latency of control writes
+ * \param[in] limit The latency limit
+ *
+ * Control writes that complete later than \a limit after the frame start are
+ * accounted for as late in the statistics. The limit is typically set to the
+ * vertical blanking duration. A zero limit, the default, disables the late
+ * writes accounting.
+ */
+
+/**
+ * \fn DelayedControls::statistics()
+ * \brief Retrieve the control scheduling statistics
+ * \return The control scheduling statistics
+ */
+
+/**
+ * \fn DelayedControls::resetStatistics()
+ * \brief Reset the control scheduling statistics
+ */
+
+DelayedControls::Control *DelayedControls::findControl(unsigned int id)
+{
+	auto it = std::lower_bound(controls_.begin(), controls_.end(), id,
+				   [](const Control &ctrl, unsigned int value) {
+					   return ctrl.id->id() < value;
+				   });
+	if (it == controls_.end() || it->id->id() != id)
+		return nullptr;
+
+	return &*it;
+}
+
+void DelayedControls::frameStarted(uint32_t sequence)
+{
+	applyControls(sequence);
+
+	utils::Duration latency = utils::clock::now() - frameStartSource_->frameStartTime();
+
+	stats_.lastLatency = latency;
+	stats_.maxLatency = std::max(stats_.maxLatency, latency);
+	stats_.totalLatency += latency;
+
+	if (latencyLimit_ && latency > latencyLimit_) {
+		stats_.late++;
+
+		LOG(DelayedControls, Debug)
+			<< "Controls for frame " << sequence << " written "
+			<< latency << " after frame start";
+	}
 }
 
 } /* namespace libcamera */
@@ -7,9 +7,12 @@
 
 #include "libcamera/internal/device_enumerator.h"
 
+#include <algorithm>
+#include <stdlib.h>
 #include <string.h>
 
 #include <libcamera/base/log.h>
+#include <libcamera/base/utils.h>
 
 #include "libcamera/internal/device_enumerator_sysfs.h"
 #include "libcamera/internal/device_enumerator_udev.h"
@@ -124,6 +127,13 @@ bool DeviceMatch::match(const MediaDevice *device) const
  * then be searched using DeviceMatch search patterns.
  *
  * The enumerator also associates media device entities with device node paths.
+ *
+ * Hotplugging a device often creates multiple media devices in a short time.
+ * To avoid matching pipeline handlers for every media device, the enumerator
+ * coalesces the additions and emits the devicesAdded signal once the devices
+ * have stopped appearing for the duration of the hotplug delay. The delay
+ * defaults to 100ms, and can be overridden with the LIBCAMERA_HOTPLUG_DELAY
+ * environment variable, expressed in milliseconds, or with setHotplugDelay().
  */
 
 /**
@@ -159,6 +169,19 @@ std::unique_ptr<DeviceEnumerator> DeviceEnumerator::create()
 	return nullptr;
 }
 
+/**
+ * \brief Construct a DeviceEnumerator
+ */
+DeviceEnumerator::DeviceEnumerator()
+	: hotplugDelay_(kDefaultHotplugDelay)
+{
+	const char *delay = utils::secure_getenv("LIBCAMERA_HOTPLUG_DELAY");
+	if (delay && delay[0] != '\0')
+		hotplugDelay_ = std::chrono::milliseconds(strtoul(delay, nullptr, 10));
+
+	hotplugTimer_.timeout.connect(this, &DeviceEnumerator::hotplugTimeout);
+}
+
 DeviceEnumerator::~DeviceEnumerator()
 {
 	for (const std::shared_ptr<MediaDevice> &media : devices_) {
@@ -228,16 +251,78 @@ std::unique_ptr<MediaDevice> DeviceEnumerator::createDevice(const std::string &d
 	return media;
 }
 
+/**
+ * \brief Create and populate media devices concurrently
+ * \param[in] deviceNodes Paths to the media device nodes
+ *
+ * Populating a media device requires several ioctls on the device node, whose
+ * latency adds up on systems with many media devices. This function creates
+ * the media devices for all \a deviceNodes with createDevice(), spreading the
+ * work across multiple threads.
+ *
+ * \return The media devices, in the order of \a deviceNodes, with a null
+ * pointer for each device that couldn't be created
+ */
+std::vector<std::unique_ptr<MediaDevice>>
+DeviceEnumerator::createDevices(const std::vector<std::string> &deviceNodes)
+{
+	std::vector<std::unique_ptr<MediaDevice>> media(deviceNodes.size());
+
+	utils::parallelFor(deviceNodes.size(), [&](unsigned int i) {
+		media[i] = createDevice(deviceNodes[i]);
+	});
+
+	return media;
+}
+
 /**
 * \var DeviceEnumerator::devicesAdded
 * \brief Notify of new media devices being found
 *
 * This signal is emitted when the device enumerator finds new media devices in
-* the system. It may be emitted for every newly detected device, or once for
-* multiple devices, at the discretion of the device enumerator. Not all device
-* enumerator types may support dynamic detection of new devices.
+* the system. Additions are coalesced, the signal is emitted once for all the
+* devices added within the hotplug delay. Not all device enumerator types may
+* support dynamic detection of new devices.
 */
 
+/**
+ * \fn DeviceEnumerator::setHotplugDelay()
+ * \brief Set the delay used to coalesce media device additions
+ * \param[in] delay The hotplug delay
+ *
+ * The devicesAdded signal is emitted when no media device has been added for
+ * \a delay. A zero delay emits the signal synchronously for every media device
+ * added.
+ */
+
+/**
+ * \brief Check if new media devices are available for matching
+ *
+ * Media devices added to the enumerator are considered new until
+ * clearNewDevices() is called. This function allows skipping pipeline handler
+ * matching when all the new media devices have been acquired.
+ *
+ * \return True if at least one new media device is not in use, false otherwise
+ */
+bool DeviceEnumerator::hasNewDevices() const
+{
+	return std::any_of(newDevices_.begin(), newDevices_.end(),
+			   [](const MediaDevice *media) { return !media->busy(); });
+}
+
+/**
+ * \fn DeviceEnumerator::clearNewDevices()
+ * \brief Mark all media devices as not new
+ *
+ * This function shall be called after a pipeline handler matching pass, to
+ * restrict the next pass to the media devices added after this call.
+ */
+
+void DeviceEnumerator::hotplugTimeout()
+{
+	devicesAdded.emit();
+}
+
 /**
  * \brief Add a media device to the enumerator
  * \param[in] media media device instance to add
@@ -252,10 +337,16 @@ void DeviceEnumerator::addDevice(std::unique_ptr<MediaDevice> media)
 	LOG(DeviceEnumerator, Debug)
 		<< "Added device " << media->deviceNode() << ": " << media->driver();
 
+	newDevices_.push_back(media.get());
 	devices_.push_back(std::move(media));
 
-	/* \todo To batch multiple additions, emit with a small delay here. */
-	devicesAdded.emit();
+	if (!hotplugDelay_.count()) {
+		devicesAdded.emit();
+		return;
+	}
+
+	/* Restart the timer to wait until the devices stop appearing. */
+	hotplugTimer_.start(hotplugDelay_);
 }
 
 /**
@@ -285,6 +376,10 @@ void DeviceEnumerator::removeDevice(const std::string &deviceNode)
 		return;
 	}
 
+	auto it = std::find(newDevices_.begin(), newDevices_.end(), media.get());
+	if (it != newDevices_.end())
+		newDevices_.erase(it);
+
 	LOG(DeviceEnumerator, Debug)
 		<< "Media device for node " << deviceNode << " removed.";
 
@@ -32,6 +32,7 @@ int DeviceEnumeratorSysfs::init()
 
 int DeviceEnumeratorSysfs::enumerate()
 {
+	std::vector<std::string> devnodes;
 	struct dirent *ent;
 	DIR *dir;
 
@@ -73,7 +74,12 @@ int DeviceEnumeratorSysfs::enumerate()
 			continue;
 		}
 
-		std::unique_ptr<MediaDevice> media = createDevice(devnode);
+		devnodes.push_back(devnode);
+	}
+
+	closedir(dir);
+
+	for (std::unique_ptr<MediaDevice> &media : createDevices(devnodes)) {
 		if (!media)
 			continue;
 
@@ -88,8 +94,6 @@ int DeviceEnumeratorSysfs::enumerate()
 		addDevice(std::move(media));
 	}
 
-	closedir(dir);
-
 	return 0;
 }
 
@@ -0,0 +1,232 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+/*
+ * Copyright (C) 2022, Google Inc.
+ *
+ * discovery_cache.cpp - Persistent cache of device discovery results
+ */
+
+#include "libcamera/internal/discovery_cache.h"
+
+#include <errno.h>
+#include <fstream>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <libcamera/base/log.h>
+#include <libcamera/base/utils.h>
+
+/**
+ * \file discovery_cache.h
+ * \brief Persistent cache of device discovery results
+ */
+
+namespace libcamera {
+
+LOG_DEFINE_CATEGORY(DiscoveryCache)
+
+namespace {
+
+/* Increase when the format of the cache entries changes. */
+constexpr unsigned int kCacheVersion = 1;
+
+int createDirectories(const std::string &path)
+{
+	std::string::size_type pos = 0;
+
+	do {
+		pos = path.find('/', pos + 1);
+
+		std::string dir = path.substr(0, pos);
+		if (mkdir(dir.c_str(), 0755) < 0 && errno != EEXIST)
+			return -errno;
+	} while (pos != std::string::npos);
+
+	return 0;
+}
+
+} /* namespace */
+
+/**
+ * \class DiscoveryCache
+ * \brief Key-value store of discovery results persisted across processes
+ *
+ * Discovering the capabilities of camera devices requires a large number of
+ * ioctls, whose results rarely change as long as the hardware and the kernel
+ * stay the same. The DiscoveryCache stores such results in a file, to let
+ * short-lived processes skip the expensive parts of the discovery.
+ *
+ * Each cache file is tagged with a signature that identifies the device and
+ * the kernel it has been created with. The signature is validated when the
+ * cache is loaded, and a mismatch discards all the entries. Users of the cache
+ * are responsible for including in the signature all the information that may
+ * invalidate the cached results.
+ *
+ * Entries are stored as strings indexed by a key. Keys shall not contain tab
+ * characters, and neither keys nor values shall contain new line characters.
+ *
+ * The cache is saved atomically, concurrent processes thus always see either
+ * the previous or the new version of the file.
+ */
+
+/**
+ * \brief Construct a DiscoveryCache
+ * \param[in] path The path to the cache file
+ * \param[in] signature The signature the cache file shall match
+ *
+ * The cache is constructed empty, call load() to read the cache file.
+ */
+DiscoveryCache::DiscoveryCache(const std::string &path, const std::string &signature)
+	: path_(path), signature_(signature)
+{
+}
+
+/**
+ * \brief Retrieve the directory that stores the cache files
+ *
+ * Caching is disabled by default, to avoid writing to the file system from the
+ * library behind the back of applications. It is enabled by setting the
+ * LIBCAMERA_CACHE_DIR environment variable to the directory that stores the
+ * cache files.
+ *
+ * \return The path to the cache directory, or an empty string if caching is
+ * disabled
+ */
+std::string DiscoveryCache::directory()
+{
+	const char *dir = utils::secure_getenv("LIBCAMERA_CACHE_DIR");
+	if (dir && dir[0] != '\0')
+		return dir;
+
+	return {};
+}
+
+/**
+ * \fn DiscoveryCache::path()
+ * \brief Retrieve the path to the cache file
+ * \return The path to the cache file
+ */
+
+/**
+ * \brief Load the cache entries from the cache file
+ *
+ * All entries are discarded if the cache file doesn't exist, can't be parsed,
+ * or doesn't match the cache signature.
+ *
+ * \return 0 on success, -ENOENT if the cache file doesn't exist, -ESTALE if it
+ * doesn't match the signature, or -EINVAL if it is malformed
+ */
+int DiscoveryCache::load()
+{
+	entries_.clear();
+
+	std::ifstream file(path_);
+	if (!file)
+		return -ENOENT;
+
+	std::string line;
+	if (!std::getline(file, line) || line != header()) {
+		LOG(DiscoveryCache, Debug) << "Discarding stale cache " << path_;
+		return -ESTALE;
+	}
+
+	while (std::getline(file, line)) {
+		std::string::size_type pos = line.find('\t');
+		if (pos == std::string::npos) {
+			LOG(DiscoveryCache, Warning)
+				<< "Discarding malformed cache " << path_;
+			entries_.clear();
+			return -EINVAL;
+		}
+
+		entries_[line.substr(0, pos)] = line.substr(pos + 1);
+	}
+
+	LOG(DiscoveryCache, Debug)
+		<< "Loaded " << entries_.size() << " entries from " << path_;
+
+	return 0;
+}
+
+/**
+ * \brief Write the cache entries to the cache file
+ *
+ * The cache file and its parent directories are created if needed. The file
+ * is written to a temporary location and renamed, to replace the previous
+ * version atomically.
+ *
+ * \return 0 on success or a negative error code otherwise
+ */
+int DiscoveryCache::save()
+{
+	std::string::size_type pos = path_.rfind('/');
+	if (pos != std::string::npos && pos != 0) {
+		int ret = createDirectories(path_.substr(0, pos));
+		if (ret < 0) {
+			LOG(DiscoveryCache, Debug)
+				<< "Failed to create cache directory: "
+				<< strerror(-ret);
+			return ret;
+		}
+	}
+
+	std::string tmpPath = path_ + ".tmp" + std::to_string(getpid());
+
+	std::ofstream file(tmpPath, std::ios::trunc);
+	file << header() << '\n';
+	for (const auto &[key, value] : entries_)
+		file << key << '\t' << value << '\n';
+	file.close();
+
+	if (!file) {
+		unlink(tmpPath.c_str());
+		LOG(DiscoveryCache, Debug) << "Failed to write " << tmpPath;
+		return -EIO;
+	}
+
+	if (rename(tmpPath.c_str(), path_.c_str()) < 0) {
+		int ret = -errno;
+		unlink(tmpPath.c_str());
+		LOG(DiscoveryCache, Debug)
+			<< "Failed to update " << path_ << ": " << strerror(-ret);
+		return ret;
+	}
+
+	return 0;
+}
+
+/**
+ * \brief Retrieve the value of a cache entry
+ * \param[in] key The entry key
+ * \return The entry value, or std::nullopt if no entry exists for \a key
+ */
+std::optional<std::string> DiscoveryCache::value(const std::string &key) const
+{
+	auto it = entries_.find(key);
+	if (it == entries_.end())
+		return std::nullopt;
+
+	return it->second;
+}
+
+/**
+ * \brief Set the value of a cache entry
+ * \param[in] key The entry key
+ * \param[in] value The entry value
+ *
+ * The entry is only stored in memory, call save() to update the cache file.
+ */
+void DiscoveryCache::setValue(const std::string &key, const std::string &value)
+{
+	entries_[key] = value;
+}
+
+std::string DiscoveryCache::header() const
+{
+	return "libcamera-discovery-cache " + std::to_string(kCacheVersion) +
+	       '\t' + signature_;
+}
+
+} /* namespace libcamera */
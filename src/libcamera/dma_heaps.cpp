@@ -0,0 +1,271 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+/*
+ * Copyright (C) 2020, Raspberry Pi Ltd
+ *
+ * dma_heaps.cpp - Helper class for dma-heap allocations.
+ */
+
+#include "libcamera/internal/dma_heaps.h"
+
+#include <array>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <linux/dma-buf.h>
+#include <linux/dma-heap.h>
+#include <linux/udmabuf.h>
+
+#include <libcamera/base/log.h>
+
+/**
+ * \file dma_heaps.h
+ * \brief dma-heap allocator
+ */
+
+namespace libcamera {
+
+/*
+ * /dev/dma-heap/linux,cma is the dma-heap allocator, which allows dmaheap-cma
+ * to only have to worry about importing.
+ *
+ * Annoyingly, should the cma heap size be specified on the kernel command line
+ * instead of DT, the heap gets named "reserved" instead.
+ */
+
+#ifndef __DOXYGEN__
+struct DmaHeapInfo {
+	DmaHeap::DmaHeapFlag type;
+	const char *deviceNodeName;
+};
+#endif
+
+static constexpr std::array<DmaHeapInfo, 4> heapInfos = { {
+	{ DmaHeap::DmaHeapFlag::Cma, "/dev/dma_heap/linux,cma" },
+	{ DmaHeap::DmaHeapFlag::Cma, "/dev/dma_heap/reserved" },
+	{ DmaHeap::DmaHeapFlag::System, "/dev/dma_heap/system" },
+	{ DmaHeap::DmaHeapFlag::UDmaBuf, "/dev/udmabuf" },
+} };
+
+LOG_DEFINE_CATEGORY(DmaHeap)
+
+/**
+ * \class DmaHeap
+ * \brief Helper class for dma-heap allocations
+ *
+ * DMA heaps are kernel devices that provide an API to allocate memory from
+ * different pools called "heaps", wrap each allocated piece of memory in a
+ * dmabuf object, and return the dmabuf file descriptor to userspace. Multiple
+ * heaps can be provided by the system, with different properties for the
+ * underlying memory.
+ *
+ * This class wraps a DMA heap selected at construction time, and exposes
+ * functions to manage memory allocation.
+ *
+ * On systems without a suitable DMA heap, such as development machines and
+ * test environments, memory can be allocated from a memfd, either wrapped in a
+ * dmabuf through the udmabuf driver, or used directly. The latter doesn't
+ * produce a dmabuf and is thus only suitable for CPU access.
+ */
+
+/**
+ * \enum DmaHeap::DmaHeapFlag
+ * \brief Type of the dma-heap
+ * \var DmaHeap::DmaHeapFlag::Cma
+ * \brief Allocate from a CMA dma-heap, providing physically-contiguous memory
+ * \var DmaHeap::DmaHeapFlag::System
+ * \brief Allocate from the system dma-heap, using the page allocator
+ * \var DmaHeap::DmaHeapFlag::UDmaBuf
+ * \brief Allocate from a memfd and wrap it in a dmabuf with the udmabuf driver
+ * \var DmaHeap::DmaHeapFlag::MemFd
+ * \brief Allocate from a memfd, without creating a dmabuf
+ */
+
+/**
+ * \typedef DmaHeap::DmaHeapFlags
+ * \brief A bitwise combination of DmaHeap::DmaHeapFlag values
+ */
+
+/**
+ * \brief Construct a DmaHeap that owns a CMA, system or memfd based allocator
+ * \param[in] type The type(s) of the dma-heap(s) to allocate from
+ *
+ * By default \a type is set to DmaHeapFlag::Cma. The DmaHeap will try to open
+ * the first heap matching \a type, in the order of the DmaHeapFlag
+ * enumeration, and fall back to the next types if the open fails. MemFd is
+ * always available when requested.
+ *
+ * Use isValid() to check if a heap has been successfully opened.
+ */
+DmaHeap::DmaHeap(DmaHeapFlags type)
+{
+	for (const auto &info : heapInfos) {
+		if (!(type & info.type))
+			continue;
+
+		int ret = ::open(info.deviceNodeName, O_RDWR | O_CLOEXEC, 0);
+		if (ret < 0) {
+			ret = errno;
+			LOG(DmaHeap, Debug)
+				<< "Failed to open " << info.deviceNodeName << ": "
+				<< strerror(ret);
+			continue;
+		}
+
+		LOG(DmaHeap, Debug) << "Using " << info.deviceNodeName;
+		dmaHeapHandle_ = UniqueFD(ret);
+		type_ = info.type;
+		return;
+	}
+
+	if (type & DmaHeapFlag::MemFd) {
+		LOG(DmaHeap, Debug) << "Using memfd";
+		type_ = DmaHeapFlag::MemFd;
+		return;
+	}
+
+	LOG(DmaHeap, Error) << "Could not open any dmaHeap device";
+}
+
+/**
+ * \brief Destroy the DmaHeap instance
+ */
+DmaHeap::~DmaHeap() = default;
+
+/**
+ * \fn DmaHeap::isValid()
+ * \brief Check if the DmaHeap instance is valid
+ * \return True if the DmaHeap is valid, false otherwise
+ */
+
+/**
+ * \fn DmaHeap::type()
+ * \brief Retrieve the type of the allocator selected at construction time
+ * \return The DmaHeapFlag of the allocator, or no flag if the DmaHeap is
+ * invalid
+ */
+
+/**
+ * \brief Allocate a dma-buf from the DmaHeap
+ * \param [in] name The name to set for the allocated buffer
+ * \param [in] size The size of the buffer to allocate
+ *
+ * Allocates a dma-buf with read/write access.
+ *
+ * If the allocation fails, return an invalid UniqueFD.
+ *
+ * \return The UniqueFD of the allocated buffer
+ */
+UniqueFD DmaHeap::alloc(const char *name, std::size_t size)
+{
+	if (!name)
+		return {};
+
+	if (type_ & DmaHeapFlag::UDmaBuf)
+		return allocFromUDmaBuf(name, size);
+	else if (type_ & DmaHeapFlag::MemFd)
+		return allocFromMemFd(name, size);
+	else if (type_)
+		return allocFromHeap(name, size);
+
+	return {};
+}
+
+UniqueFD DmaHeap::allocFromHeap(const char *name, std::size_t size)
+{
+	int ret;
+
+	struct dma_heap_allocation_data alloc = {};
+
+	alloc.len = size;
+	alloc.fd_flags = O_CLOEXEC | O_RDWR;
+
+	ret = ::ioctl(dmaHeapHandle_.get(), DMA_HEAP_IOCTL_ALLOC, &alloc);
+	if (ret < 0) {
+		LOG(DmaHeap, Error) << "dmaHeap allocation failure for "
+				    << name;
+		return {};
+	}
+
+	UniqueFD allocFd(alloc.fd);
+	ret = ::ioctl(allocFd.get(), DMA_BUF_SET_NAME, name);
+	if (ret < 0) {
+		LOG(DmaHeap, Error) << "dmaHeap naming failure for "
+				    << name;
+		return {};
+	}
+
+	return allocFd;
+}
+
+UniqueFD DmaHeap::allocFromUDmaBuf(const char *name, std::size_t size)
+{
+	/* udmabuf requires the size to be a multiple of the page size. */
+	long pageSize = sysconf(_SC_PAGESIZE);
+	size = (size + pageSize - 1) / pageSize * pageSize;
+
+	UniqueFD memfd = allocFromMemFd(name, size);
+	if (!memfd.isValid())
+		return {};
+
+	/* The udmabuf driver requires the memfd to be sealed against shrinking. */
+	int ret = fcntl(memfd.get(), F_ADD_SEALS, F_SEAL_SHRINK);
+	if (ret < 0) {
+		ret = errno;
+		LOG(DmaHeap, Error)
+			<< "Failed to seal memfd for " << name << ": "
+			<< strerror(ret);
+		return {};
+	}
+
+	struct udmabuf_create create = {};
+
+	create.memfd = memfd.get();
+	create.flags = UDMABUF_FLAGS_CLOEXEC;
+	create.offset = 0;
+	create.size = size;
+
+	ret = ::ioctl(dmaHeapHandle_.get(), UDMABUF_CREATE, &create);
+	if (ret < 0) {
+		ret = errno;
+		LOG(DmaHeap, Error)
+			<< "udmabuf allocation failure for " << name << ": "
+			<< strerror(ret);
+		return {};
+	}
+
+	/* The dmabuf holds a reference to the memfd, which can be closed. */
+	UniqueFD allocFd(ret);
+	ret = ::ioctl(allocFd.get(), DMA_BUF_SET_NAME, name);
+	if (ret < 0)
+		LOG(DmaHeap, Debug) << "udmabuf naming failure for " << name;
+
+	return allocFd;
+}
+
+UniqueFD DmaHeap::allocFromMemFd(const char *name, std::size_t size)
+{
+	UniqueFD memfd(memfd_create(name, MFD_CLOEXEC | MFD_ALLOW_SEALING));
+	if (!memfd.isValid()) {
+		int ret = errno;
+		LOG(DmaHeap, Error)
+			<< "Failed to create memfd for " << name << ": "
+			<< strerror(ret);
+		return {};
+	}
+
+	int ret = ftruncate(memfd.get(), size);
+	if (ret < 0) {
+		ret = errno;
+		LOG(DmaHeap, Error)
+			<< "Failed to allocate memfd storage for " << name
+			<< ": " << strerror(ret);
+		return {};
+	}
+
+	return memfd;
+}
+
+} /* namespace libcamera */
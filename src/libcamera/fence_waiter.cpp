@@ -0,0 +1,312 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+/*
+ * Copyright (C) 2022, Google Inc.
+ *
+ * fence_waiter.cpp - Multiplexed wait on synchronization fences
+ */
+
+#include "libcamera/internal/fence_waiter.h"
+
+#include <algorithm>
+#include <array>
+#include <errno.h>
+#include <string.h>
+#include <sys/epoll.h>
+
+#include <libcamera/base/log.h>
+#include <libcamera/base/utils.h>
+
+/**
+ * \file fence_waiter.h
+ * \brief Multiplexed wait on synchronization fences
+ */
+
+namespace libcamera {
+
+LOG_DEFINE_CATEGORY(FenceWaiter)
+
+/**
+ * \class FenceWaiter
+ * \brief Wait for multiple synchronization fences with a single event notifier
+ *
+ * Requests that contain buffers with acquire fences need to wait for all the
+ * fences to be signalled before being queued to the device. Creating an
+ * EventNotifier for each fence and a Timer for each request would allocate and
+ * register objects with the event dispatcher at frame rate for every stream.
+ *
+ * The FenceWaiter class instead multiplexes all fences of a camera on a single
+ * epoll file descriptor, monitored by a single EventNotifier, and handles the
+ * timeouts of all requests with a single Timer. Fences are added with wait()
+ * and are reported to their Listener through Listener::fenceSignalled(). The
+ * wait entries are pooled and reused, making the steady state free of memory
+ * allocations.
+ *
+ * A timeout can be associated with each listener with setTimeout(). If not all
+ * the fences of the listener are signalled before the timeout expires, the
+ * pending waits are cancelled and the listener is notified through
+ * Listener::fenceTimeout().
+ *
+ * The FenceWaiter is bound to the thread it is created in, and all its
+ * functions shall be called from that thread.
+ */
+
+/**
+ * \class FenceWaiter::Listener
+ * \brief Interface to receive notifications from a FenceWaiter
+ *
+ * \fn FenceWaiter::Listener::fenceSignalled()
+ * \brief Notify the listener that the fence of a buffer has been signalled
+ * \param[in] buffer The buffer passed to FenceWaiter::wait()
+ *
+ * \fn FenceWaiter::Listener::fenceTimeout()
+ * \brief Notify the listener that its timeout has expired
+ *
+ * All pending waits of the listener have been cancelled when this function is
+ * called.
+ */
+
+/**
+ * \brief Construct a FenceWaiter
+ * \param[in] parent The parent object
+ */
+FenceWaiter::FenceWaiter(Object *parent)
+	: Object(parent), notifier_(nullptr), timer_(this), dispatching_(false)
+{
+	epollFd_ = UniqueFD(epoll_create1(EPOLL_CLOEXEC));
+	if (!epollFd_.isValid()) {
+		int ret = errno;
+		LOG(FenceWaiter, Error)
+			<< "Failed to create epoll instance: " << strerror(ret);
+		return;
+	}
+
+	notifier_ = new EventNotifier(epollFd_.get(), EventNotifier::Read, this);
+	notifier_->activated.connect(this, &FenceWaiter::eventsReady);
+
+	timer_.timeout.connect(this, &FenceWaiter::timerExpired);
+}
+
+FenceWaiter::~FenceWaiter()
+{
+	delete notifier_;
+}
+
+/**
+ * \fn FenceWaiter::isValid()
+ * \brief Check if the FenceWaiter has been successfully initialized
+ * \return True if the FenceWaiter is valid, false otherwise
+ */
+
+/**
+ * \brief Wait for a fence to be signalled
+ * \param[in] listener The listener to notify
+ * \param[in] buffer The buffer the fence is associated with
+ * \param[in] fd The fence file descriptor
+ *
+ * Add the fence \a fd to the set of monitored fences. When the fence is
+ * signalled, the \a listener is notified with the \a buffer, and the fence is
+ * removed from the set. The caller shall keep the \a fd open until the fence is
+ * signalled or the wait is cancelled.
+ *
+ * \return 0 on success or a negative error code otherwise
+ */
+int FenceWaiter::wait(Listener *listener, FrameBuffer *buffer, int fd)
+{
+	if (!isValid())
+		return -ENODEV;
+
+	Entry *entry;
+	if (free_.empty()) {
+		entry = &entries_.emplace_back();
+	} else {
+		entry = free_.back();
+		free_.pop_back();
+	}
+
+	entry->listener = listener;
+	entry->buffer = buffer;
+	entry->fd = fd;
+
+	struct epoll_event event = {};
+	event.events = EPOLLIN;
+	event.data.ptr = entry;
+
+	int ret = epoll_ctl(epollFd_.get(), EPOLL_CTL_ADD, fd, &event);
+	if (ret < 0) {
+		ret = -errno;
+		LOG(FenceWaiter, Error)
+			<< "Failed to wait on fence " << fd << ": " << strerror(-ret);
+		entry->listener = nullptr;
+		free_.push_back(entry);
+		return ret;
+	}
+
+	active_.push_back(entry);
+
+	return 0;
+}
+
+/**
+ * \brief Set the timeout for a listener
+ * \param[in] listener The listener
+ * \param[in] timeout The timeout duration, relative to the current time
+ *
+ * If not all fences waited for by \a listener are signalled within \a timeout,
+ * the waits are cancelled and the \a listener is notified with
+ * Listener::fenceTimeout(). The timeout is cancelled automatically when all
+ * the fences of the listener have been signalled, or when cancel() is called.
+ */
+void FenceWaiter::setTimeout(Listener *listener, std::chrono::milliseconds timeout)
+{
+	auto deadline = utils::clock::now() + timeout;
+
+	auto it = std::find_if(deadlines_.begin(), deadlines_.end(),
+			       [&](const Deadline &d) { return d.listener == listener; });
+	if (it != deadlines_.end())
+		it->time = deadline;
+	else
+		deadlines_.push_back({ listener, deadline });
+
+	updateTimer();
+}
+
+/**
+ * \brief Cancel all pending waits and the timeout of a listener
+ * \param[in] listener The listener
+ *
+ * The listener isn't notified of the cancellation.
+ */
+void FenceWaiter::cancel(Listener *listener)
+{
+	for (auto it = active_.begin(); it != active_.end();) {
+		Entry *entry = *it;
+		if (entry->listener != listener) {
+			++it;
+			continue;
+		}
+
+		it = active_.erase(it);
+		release(entry);
+	}
+
+	auto it = std::find_if(deadlines_.begin(), deadlines_.end(),
+			       [&](const Deadline &d) { return d.listener == listener; });
+	if (it != deadlines_.end()) {
+		deadlines_.erase(it);
+		updateTimer();
+	}
+}
+
+/**
+ * \fn FenceWaiter::pending()
+ * \brief Retrieve the number of fences being waited for
+ * \return The number of pending fences
+ */
+
+/**
+ * \fn FenceWaiter::capacity()
+ * \brief Retrieve the number of wait entries allocated in the pool
+ * \return The number of wait entries
+ */
+
+void FenceWaiter::release(Entry *entry)
+{
+	epoll_ctl(epollFd_.get(), EPOLL_CTL_DEL, entry->fd, nullptr);
+	entry->listener = nullptr;
+
+	/*
+	 * Events for the entry may still be pending in the batch being
+	 * dispatched, defer its reuse until the batch completes.
+	 */
+	if (dispatching_)
+		released_.push_back(entry);
+	else
+		free_.push_back(entry);
+}
+
+void FenceWaiter::updateTimer()
+{
+	if (deadlines_.empty()) {
+		timer_.stop();
+		return;
+	}
+
+	auto earliest = std::min_element(deadlines_.begin(), deadlines_.end(),
+					 [](const Deadline &a, const Deadline &b) {
+						 return a.time < b.time;
+					 });
+
+	if (!timer_.isRunning() || timer_.deadline() != earliest->time)
+		timer_.start(earliest->time);
+}
+
+void FenceWaiter::eventsReady()
+{
+	std::array<struct epoll_event, 16> events;
+
+	int count = epoll_wait(epollFd_.get(), events.data(), events.size(), 0);
+	if (count <= 0)
+		return;
+
+	dispatching_ = true;
+
+	for (int i = 0; i < count; ++i) {
+		Entry *entry = static_cast<Entry *>(events[i].data.ptr);
+
+		/* Skip entries cancelled by a previous notification. */
+		Listener *listener = entry->listener;
+		if (!listener)
+			continue;
+
+		FrameBuffer *buffer = entry->buffer;
+
+		auto it = std::find(active_.begin(), active_.end(), entry);
+		active_.erase(it);
+		release(entry);
+
+		/* Cancel the timeout if this was the last fence of the listener. */
+		bool last = std::none_of(active_.begin(), active_.end(),
+					 [&](const Entry *e) { return e->listener == listener; });
+		if (last) {
+			auto dl = std::find_if(deadlines_.begin(), deadlines_.end(),
+					       [&](const Deadline &d) { return d.listener == listener; });
+			if (dl != deadlines_.end()) {
+				deadlines_.erase(dl);
+				updateTimer();
+			}
+		}
+
+		listener->fenceSignalled(buffer);
+	}
+
+	dispatching_ = false;
+
+	free_.insert(free_.end(), released_.begin(), released_.end());
+	released_.clear();
+}
+
+void FenceWaiter::timerExpired()
+{
+	auto now = utils::clock::now();
+
+	for (auto it = deadlines_.begin(); it != deadlines_.end();) {
+		if (it->time > now) {
+			++it;
+			continue;
+		}
+
+		expired_.push_back(it->listener);
+		it = deadlines_.erase(it);
+	}
+
+	updateTimer();
+
+	for (Listener *listener : expired_) {
+		cancel(listener);
+		listener->fenceTimeout();
+	}
+
+	expired_.clear();
+}
+
+} /* namespace libcamera */
@@ -0,0 +1,221 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+/*
+ * Copyright (C) 2022, Google Inc.
+ *
+ * frame_matcher.cpp - Match buffers from multiple video nodes by frame sequence
+ */
+
+#include "libcamera/internal/frame_matcher.h"
+
+/**
+ * \file frame_matcher.h
+ * \brief Match buffers from multiple video nodes by frame sequence
+ */
+
+namespace libcamera {
+
+/**
+ * \class SequenceRing
+ * \brief Fixed-capacity container of entries indexed by frame sequence
+ * \tparam T The entry type
+ * \tparam N The capacity of the ring
+ *
+ * The SequenceRing stores up to \a N entries in a fixed array, indexed by their
+ * frame sequence number modulo \a N. Insertion, lookup and removal are O(1),
+ * and no memory is allocated after construction.
+ *
+ * The ring covers a window of \a N consecutive sequence numbers starting at the
+ * oldest entry. Entries don't need to be pushed in sequence order, but an entry
+ * that would extend the window past \a N sequences evicts the oldest entries.
+ * Once entries have been consumed with take() or dropBefore(), entries older
+ * than the consumed sequence are considered late and are dropped immediately.
+ *
+ * Entries that are dropped or evicted are passed to a drop function provided
+ * by the caller, to allow recycling of the resources they hold.
+ *
+ * Sequence numbers are compared with wrap-around semantics.
+ */
+
+/**
+ * \fn SequenceRing::empty()
+ * \brief Check if the ring contains no entry
+ * \return True if the ring is empty, false otherwise
+ */
+
+/**
+ * \fn SequenceRing::size()
+ * \brief Retrieve the number of entries in the ring
+ * \return The number of entries
+ */
+
+/**
+ * \fn SequenceRing::front()
+ * \brief Retrieve the sequence of the oldest entry
+ *
+ * This function shall only be called when the ring is not empty.
+ *
+ * \return The sequence number of the oldest entry
+ */
+
+/**
+ * \fn SequenceRing::back()
+ * \brief Retrieve the sequence of the newest entry
+ *
+ * This function shall only be called when the ring is not empty.
+ *
+ * \return The sequence number of the newest entry
+ */
+
+/**
+ * \fn SequenceRing::contains()
+ * \brief Check if the ring contains an entry for a sequence
+ * \param[in] sequence The sequence number
+ * \return True if an entry for \a sequence is stored, false otherwise
+ */
+
+/**
+ * \fn SequenceRing::push()
+ * \brief Insert an entry in the ring
+ * \param[in] sequence The sequence number of the entry
+ * \param[in] value The entry
+ * \param[in] drop Function called with the entries dropped by the insertion
+ *
+ * Insert \a value for \a sequence. Late entries are passed to \a drop, as well
+ * as the oldest entries evicted to make room for \a value, and any previous
+ * entry with the same sequence number.
+ */
+
+/**
+ * \fn SequenceRing::take()
+ * \brief Remove the entry for a sequence from the ring
+ * \param[in] sequence The sequence number
+ * \param[out] value The entry
+ * \return True if an entry was found for \a sequence, false otherwise
+ */
+
+/**
+ * \fn SequenceRing::dropBefore()
+ * \brief Drop all entries older than a sequence
+ * \param[in] sequence The sequence number
+ * \param[in] drop Function called with the dropped entries
+ */
+
+/**
+ * \fn SequenceRing::clear()
+ * \brief Drop all entries and reset the ring
+ * \param[in] drop Function called with the dropped entries
+ */
+
+/**
+ * \class FrameMatcher
+ * \brief Match buffers produced for the same frame by multiple video nodes
+ * \tparam Primary The type of the primary entries
+ * \tparam Secondary The type of the secondary entries
+ * \tparam N The maximum number of pending entries of each type
+ *
+ * Devices that produce multiple buffers for each frame on separate video
+ * nodes, such as image data and sensor embedded data, complete the buffers
+ * independently, and not necessarily in order. The FrameMatcher collects the
+ * entries for both nodes in two SequenceRing instances, and matches them by
+ * frame sequence number in constant time.
+ *
+ * Primary entries are released in sequence order by match(), together with
+ * the secondary entry of the same sequence if available. Secondary entries
+ * older than the released primary entry can't be matched anymore and are
+ * dropped. When secondary entries are required, match() waits for the
+ * secondary entry as long as it may still arrive, that is until a secondary
+ * entry newer by more than a configurable delay has been received.
+ *
+ * All dropped entries are accounted for in the statistics(), to help
+ * diagnosing frame drops.
+ */
+
+/**
+ * \struct FrameMatcher::Statistics
+ * \brief Matching statistics
+ *
+ * \var FrameMatcher::Statistics::matched
+ * \brief Number of primary entries released with a matching secondary entry
+ *
+ * \var FrameMatcher::Statistics::unmatched
+ * \brief Number of primary entries released without a secondary entry
+ *
+ * \var FrameMatcher::Statistics::primaryDropped
+ * \brief Number of primary entries dropped because they were late or evicted
+ *
+ * \var FrameMatcher::Statistics::secondaryDropped
+ * \brief Number of secondary entries dropped because they were late, stale or
+ * evicted
+ */
+
+/**
+ * \fn FrameMatcher::setSecondaryRequired()
+ * \brief Set whether primary entries must wait for their secondary entry
+ * \param[in] required True to wait for secondary entries
+ * \param[in] maxDelay The maximum number of frames a secondary entry can be
+ * delayed by, relative to the secondary entries of later frames
+ *
+ * A secondary entry is considered lost, and its primary entry is released
+ * alone, once a secondary entry for a frame more than \a maxDelay frames
+ * later has been received. Larger delays tolerate more reordering between
+ * the video nodes, at the expense of latency when secondary entries are lost.
+ */
+
+/**
+ * \fn FrameMatcher::pushPrimary()
+ * \brief Add a primary entry
+ * \param[in] sequence The frame sequence number
+ * \param[in] primary The entry
+ * \param[in] drop Function called with the primary entries dropped
+ */
+
+/**
+ * \fn FrameMatcher::pushSecondary()
+ * \brief Add a secondary entry
+ * \param[in] sequence The frame sequence number
+ * \param[in] secondary The entry
+ * \param[in] drop Function called with the secondary entries dropped
+ */
+
+/**
+ * \fn FrameMatcher::match()
+ * \brief Release the oldest primary entry with its matching secondary entry
+ * \param[out] primary The oldest primary entry
+ * \param[out] secondary The matching secondary entry, if any
+ * \param[in] dropSecondary Function called with the stale secondary entries
+ * \return True if a primary entry has been released, false otherwise
+ */
+
+/**
+ * \fn FrameMatcher::clear()
+ * \brief Drop all pending entries
+ * \param[in] dropPrimary Function called with the dropped primary entries
+ * \param[in] dropSecondary Function called with the dropped secondary entries
+ *
+ * Entries dropped by this function are not accounted for in the statistics.
+ */
+
+/**
+ * \fn FrameMatcher::primaryPending()
+ * \brief Retrieve the number of pending primary entries
+ * \return The number of pending primary entries
+ */
+
+/**
+ * \fn FrameMatcher::secondaryPending()
+ * \brief Retrieve the number of pending secondary entries
+ * \return The number of pending secondary entries
+ */
+
+/**
+ * \fn FrameMatcher::statistics()
+ * \brief Retrieve the matching statistics
+ * \return The matching statistics
+ */
+
+/**
+ * \fn FrameMatcher::resetStatistics()
+ * \brief Reset the matching statistics
+ */
+
+} /* namespace libcamera */
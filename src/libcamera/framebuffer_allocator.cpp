@@ -15,6 +15,7 @@
 #include <libcamera/framebuffer.h>
 #include <libcamera/stream.h>
 
+#include "libcamera/internal/mapped_framebuffer.h"
 #include "libcamera/internal/pipeline_handler.h"
 
 /**
@@ -50,6 +51,12 @@ LOG_DEFINE_CATEGORY(Allocator)
  * buffers are not deleted while they are in use (part of a Request that has
  * been queued and hasn't completed yet).
  *
+ * Depending on the pipeline handler, buffers are either exported by the devices
+ * of the camera, or allocated from a dma-heap through a pool associated with
+ * the camera. Pooled memory is recycled when buffers are freed, and is reused
+ * by subsequent allocations after the camera is stopped and reconfigured. It
+ * is released to the system when the camera is released.
+ *
  * Usage of the FrameBufferAllocator is optional, if all buffers for a camera
  * are provided externally applications shall not use this class.
  */
@@ -65,7 +72,8 @@ FrameBufferAllocator::FrameBufferAllocator(std::shared_ptr<Camera> camera)
 
 FrameBufferAllocator::~FrameBufferAllocator()
 {
-	buffers_.clear();
+	while (!buffers_.empty())
+		free(buffers_.begin()->first);
 }
 
 /**
@@ -122,6 +130,8 @@ int FrameBufferAllocator::free(Stream *stream)
 		return -EINVAL;
 
 	std::vector<std::unique_ptr<FrameBuffer>> &buffers = iter->second;
+	for (const std::unique_ptr<FrameBuffer> &buffer : buffers)
+		MappingCache::instance()->release(buffer.get());
 	buffers.clear();
 	buffers_.erase(iter);
 
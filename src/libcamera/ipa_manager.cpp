@@ -8,14 +8,20 @@
 #include "libcamera/internal/ipa_manager.h"
 
 #include <algorithm>
+#include <ctype.h>
 #include <dirent.h>
+#include <dlfcn.h>
+#include <iomanip>
+#include <sstream>
 #include <string.h>
+#include <sys/stat.h>
 #include <sys/types.h>
 
 #include <libcamera/base/file.h>
 #include <libcamera/base/log.h>
 #include <libcamera/base/utils.h>
 
+#include "libcamera/internal/discovery_cache.h"
 #include "libcamera/internal/ipa_module.h"
 #include "libcamera/internal/ipa_proxy.h"
 #include "libcamera/internal/pipeline_handler.h"
@@ -29,6 +35,45 @@ namespace libcamera {
 
 LOG_DEFINE_CATEGORY(IPAManager)
 
+namespace {
+
+/*
+ * Identify the version of a file by its inode number, size and modification
+ * time, or return an empty string if the file doesn't exist.
+ */
+std::string fileStamp(const std::string &path)
+{
+	struct stat st;
+	if (stat(path.c_str(), &st) < 0)
+		return {};
+
+	std::ostringstream ss;
+	ss << st.st_ino << "/" << st.st_size << "/" << st.st_mtim.tv_sec
+	   << "." << std::setw(9) << std::setfill('0') << st.st_mtim.tv_nsec;
+	return ss.str();
+}
+
+std::string moduleKey(const std::string &file)
+{
+	return "module:" + file;
+}
+
+/*
+ * The interpretation of the module information depends on the libcamera
+ * version, tie the cache to the libcamera library file.
+ */
+std::string libcameraStamp()
+{
+	Dl_info info;
+
+	if (!dladdr(reinterpret_cast<void *>(&libcameraStamp), &info))
+		return {};
+
+	return fileStamp(info.dli_fname);
+}
+
+} /* namespace */
+
 /**
  * \class IPAManager
  * \brief Manager for IPA modules
@@ -93,6 +138,17 @@ LOG_DEFINE_CATEGORY(IPAManager)
  * serialized to Plain Old Data, either for the purpose of passing it to the IPA
  * context plain C API, or to transmit the data to the isolated process through
  * IPC.
+ *
+ * Discovering IPA modules requires parsing the ELF headers of all shared
+ * objects in the IPA directories. To speed up startup, the manager stores the
+ * module information in a DiscoveryCache, validated against the inode number,
+ * size and modification time of the files. As the cache is stored in a
+ * location writable by the user, the cached information is checked against the
+ * module shared object before the module gets used, and the result of
+ * signature verification is never cached, as a stale result would lead to
+ * running an unverified module without isolation. Pipeline handlers can
+ * instead call preload() to verify and load the IPA module in the background
+ * while they probe the hardware.
  */
 
 IPAManager *IPAManager::self_ = nullptr;
@@ -104,11 +160,22 @@ IPAManager *IPAManager::self_ = nullptr;
  * CameraManager.
  */
 IPAManager::IPAManager()
+	: cacheDirty_(false)
 {
 	if (self_)
 		LOG(IPAManager, Fatal)
 			<< "Multiple IPAManager objects are not allowed";
 
+	std::string cacheDir = DiscoveryCache::directory();
+	std::string stamp = libcameraStamp();
+	if (!cacheDir.empty() && !stamp.empty()) {
+		std::string signature = std::to_string(IPA_MODULE_API_VERSION) +
+					"|" + stamp;
+		cache_ = std::make_unique<DiscoveryCache>(cacheDir + "/ipa-modules",
+							  signature);
+		cache_->load();
+	}
+
 #if HAVE_IPA_PUBKEY
 	if (!pubKey_.isValid())
 		LOG(IPAManager, Warning) << "Public key not valid";
@@ -154,11 +221,19 @@ IPAManager::IPAManager()
 		LOG(IPAManager, Warning)
 			<< "No IPA found in '" IPA_MODULE_DIR "'";
 
+	if (cache_ && cacheDirty_) {
+		cache_->save();
+		cacheDirty_ = false;
+	}
+
 	self_ = this;
 }
 
 IPAManager::~IPAManager()
 {
+	/* Wait for the preloads to complete before deleting the modules. */
+	preloads_.clear();
+
 	for (IPAModule *module : modules_)
 		delete module;
 
@@ -236,7 +311,7 @@ unsigned int IPAManager::addDir(const char *libDir, unsigned int maxDepth)
 
 	unsigned int count = 0;
 	for (const std::string &file : files) {
-		IPAModule *ipaModule = new IPAModule(file);
+		IPAModule *ipaModule = createModule(file);
 		if (!ipaModule->isValid()) {
 			delete ipaModule;
 			continue;
@@ -251,6 +326,65 @@ unsigned int IPAManager::addDir(const char *libDir, unsigned int maxDepth)
 	return count;
 }
 
+/**
+ * \brief Create an IPA module, using the cached module information if valid
+ * \param[in] file The path to the IPA module shared object
+ *
+ * The cache entry for the module stores the file stamp followed by the module
+ * information. Cache entries are only created for modules whose pipeline and
+ * module names don't contain whitespace, to keep parsing trivial. As the cache
+ * is writable by the user, the information of modules created from the cache
+ * is verified by module() before they get used.
+ *
+ * \return The IPA module, which may be invalid
+ */
+IPAModule *IPAManager::createModule(const std::string &file)
+{
+	if (!cache_)
+		return new IPAModule(file);
+
+	const std::string key = moduleKey(file);
+	const std::string stamp = fileStamp(file);
+
+	std::optional<std::string> value = cache_->value(key);
+	if (value && value->compare(0, stamp.size() + 1, stamp + " ") == 0) {
+		std::istringstream ss(value->substr(stamp.size() + 1));
+		std::string pipelineName, name;
+		uint32_t pipelineVersion;
+		struct IPAModuleInfo info = {};
+
+		if (ss >> pipelineVersion >> pipelineName >> name &&
+		    pipelineName.size() < sizeof(info.pipelineName) &&
+		    name.size() < sizeof(info.name)) {
+			info.moduleAPIVersion = IPA_MODULE_API_VERSION;
+			info.pipelineVersion = pipelineVersion;
+			pipelineName.copy(info.pipelineName, pipelineName.size());
+			name.copy(info.name, name.size());
+			return new IPAModule(file, info);
+		}
+	}
+
+	IPAModule *ipaModule = new IPAModule(file);
+	if (!ipaModule->isValid())
+		return ipaModule;
+
+	const struct IPAModuleInfo &info = ipaModule->info();
+	std::string pipelineName = info.pipelineName;
+	std::string name = info.name;
+
+	auto isSpace = [](unsigned char c) { return isspace(c); };
+	if (pipelineName.empty() || name.empty() ||
+	    std::any_of(pipelineName.begin(), pipelineName.end(), isSpace) ||
+	    std::any_of(name.begin(), name.end(), isSpace))
+		return ipaModule;
+
+	cache_->setValue(key, stamp + " " + std::to_string(info.pipelineVersion) +
+			      " " + pipelineName + " " + name);
+	cacheDirty_ = true;
+
+	return ipaModule;
+}
+
 /**
  * \brief Retrieve an IPA module that matches a given pipeline handler
  * \param[in] pipe The pipeline handler
@@ -261,7 +395,26 @@ IPAModule *IPAManager::module(PipelineHandler *pipe, uint32_t minVersion,
 			      uint32_t maxVersion)
 {
 	for (IPAModule *module : modules_) {
-		if (module->match(pipe, minVersion, maxVersion))
+		if (!module->match(pipe, minVersion, maxVersion))
+			continue;
+
+		if (module->verifyInfo())
+			return module;
+
+		/*
+		 * The cached information was stale or tampered with. Drop the
+		 * cache entry, and use the module only if its actual
+		 * information matches.
+		 */
+		{
+			MutexLocker locker(mutex_);
+			if (cache_) {
+				cache_->setValue(moduleKey(module->path()), {});
+				cache_->save();
+			}
+		}
+
+		if (module->isValid() && module->match(pipe, minVersion, maxVersion))
 			return module;
 	}
 
@@ -279,7 +432,49 @@ IPAModule *IPAManager::module(PipelineHandler *pipe, uint32_t minVersion,
  * found or if the IPA proxy fails to initialize
  */
 
-bool IPAManager::isSignatureValid([[maybe_unused]] IPAModule *ipa) const
+/**
+ * \brief Prepare the IPA module that matches a pipeline handler in the background
+ * \param[in] pipe The pipeline handler
+ * \param[in] minVersion Minimum acceptable version of IPA module
+ * \param[in] maxVersion Maximum acceptable version of IPA module
+ *
+ * Verifying the signature of an IPA module and loading it take time. This
+ * function starts both operations in a background thread, to let the pipeline
+ * handler probe the hardware in the meantime. A subsequent createIPA() call
+ * for the same module waits for the background operations to complete.
+ *
+ * Calling this function is optional, and has no effect when modules are
+ * always isolated.
+ */
+void IPAManager::preload([[maybe_unused]] PipelineHandler *pipe,
+			 [[maybe_unused]] uint32_t minVersion,
+			 [[maybe_unused]] uint32_t maxVersion)
+{
+#if HAVE_IPA_PUBKEY
+	/* Isolated modules are neither verified nor loaded in-process. */
+	char *force = utils::secure_getenv("LIBCAMERA_IPA_FORCE_ISOLATION");
+	if (force && force[0] != '\0')
+		return;
+
+	IPAModule *m = self_->module(pipe, minVersion, maxVersion);
+	if (!m)
+		return;
+
+	MutexLocker locker(self_->mutex_);
+
+	if (self_->preloads_.count(m))
+		return;
+
+	self_->preloads_[m] = std::async(std::launch::async, [m]() {
+		bool valid = self_->verifySignature(m);
+		if (valid)
+			m->load();
+		return valid;
+	}).share();
+#endif
+}
+
+bool IPAManager::isSignatureValid([[maybe_unused]] IPAModule *ipa)
 {
 #if HAVE_IPA_PUBKEY
 	char *force = utils::secure_getenv("LIBCAMERA_IPA_FORCE_ISOLATION");
@@ -290,6 +485,30 @@ bool IPAManager::isSignatureValid([[maybe_unused]] IPAModule *ipa) const
 		return false;
 	}
 
+	std::shared_future<bool> preload;
+
+	{
+		MutexLocker locker(mutex_);
+
+		auto it = preloads_.find(ipa);
+		if (it != preloads_.end()) {
+			preload = std::move(it->second);
+			preloads_.erase(it);
+		}
+	}
+
+	if (preload.valid())
+		return preload.get();
+
+	return verifySignature(ipa);
+#else
+	return false;
+#endif
+}
+
+bool IPAManager::verifySignature([[maybe_unused]] IPAModule *ipa)
+{
+#if HAVE_IPA_PUBKEY
 	File file{ ipa->path() };
 	if (!file.open(File::OpenModeFlag::ReadOnly))
 		return false;
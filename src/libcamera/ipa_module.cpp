@@ -256,15 +256,36 @@ Span<const uint8_t> elfLoadSymbol(Span<const uint8_t> elf, const char *symbol)
  * IPAModule instance to verify the validity of the IPAModule.
  */
 IPAModule::IPAModule(const std::string &libPath)
-	: libPath_(libPath), valid_(false), loaded_(false),
+	: libPath_(libPath), valid_(false), verified_(true), loaded_(false),
 	  dlHandle_(nullptr), ipaCreate_(nullptr)
 {
 	if (loadIPAModuleInfo() < 0)
 		return;
 
+	loadSignature();
+
 	valid_ = true;
 }
 
+/**
+ * \brief Construct an IPAModule instance from known module information
+ * \param[in] libPath path to IPA module shared object
+ * \param[in] info The IPA module information
+ *
+ * This constructor skips parsing the IPA module shared object, and uses the
+ * IPAModuleInfo \a info instead. It shall only be used with information
+ * previously retrieved from the same shared object, for instance from a cache
+ * validated against the modification time of the file. As such information
+ * can't be trusted, it shall be checked with verifyInfo() before the module is
+ * used.
+ */
+IPAModule::IPAModule(const std::string &libPath, const struct IPAModuleInfo &info)
+	: info_(info), libPath_(libPath), valid_(true), verified_(false),
+	  loaded_(false), dlHandle_(nullptr), ipaCreate_(nullptr)
+{
+	loadSignature();
+}
+
 IPAModule::~IPAModule()
 {
 	if (dlHandle_)
@@ -314,21 +335,24 @@ int IPAModule::loadIPAModuleInfo()
 		return -EINVAL;
 	}
 
+	return 0;
+}
+
+void IPAModule::loadSignature()
+{
 	/* Load the signature. Failures are not fatal. */
 	File sign{ libPath_ + ".sign" };
 	if (!sign.open(File::OpenModeFlag::ReadOnly)) {
 		LOG(IPAModule, Debug)
 			<< "IPA module " << libPath_ << " is not signed";
-		return 0;
+		return;
 	}
 
-	data = sign.map(0, -1, File::MapFlag::Private);
+	Span<const uint8_t> data = sign.map(0, -1, File::MapFlag::Private);
 	signature_.resize(data.size());
 	memcpy(signature_.data(), data.data(), data.size());
 
 	LOG(IPAModule, Debug) << "IPA module " << libPath_ << " is signed";
-
-	return 0;
 }
 
 /**
@@ -345,6 +369,47 @@ bool IPAModule::isValid() const
 	return valid_;
 }
 
+/**
+ * \brief Verify the IPA module information against the shared object
+ *
+ * IPA modules constructed from known module information haven't parsed the
+ * shared object. This function loads the IPA module information from the shared
+ * object and compares it with the known information, which it replaces. The
+ * module is invalidated if the information can't be loaded.
+ *
+ * The shared object is only parsed the first time this function is called,
+ * and never for modules constructed from the shared object only.
+ *
+ * \return True if the known IPA module information matched the shared object,
+ * false otherwise
+ */
+bool IPAModule::verifyInfo()
+{
+	if (verified_)
+		return valid_;
+
+	verified_ = true;
+
+	const struct IPAModuleInfo known = info_;
+
+	if (loadIPAModuleInfo() < 0) {
+		valid_ = false;
+		return false;
+	}
+
+	if (known.moduleAPIVersion != info_.moduleAPIVersion ||
+	    known.pipelineVersion != info_.pipelineVersion ||
+	    strncmp(known.pipelineName, info_.pipelineName,
+		    sizeof(info_.pipelineName)) ||
+	    strncmp(known.name, info_.name, sizeof(info_.name))) {
+		LOG(IPAModule, Warning)
+			<< "IPA module information doesn't match the shared object";
+		return false;
+	}
+
+	return true;
+}
+
 /**
  * \brief Retrieve the IPA module information
  *
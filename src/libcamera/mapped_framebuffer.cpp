@@ -11,6 +11,8 @@
 #include <errno.h>
 #include <map>
 #include <sys/mman.h>
+#include <sys/stat.h>
+#include <tuple>
 #include <unistd.h>
 
 #include <libcamera/base/log.h>
@@ -84,6 +86,7 @@ MappedBuffer &MappedBuffer::operator=(MappedBuffer &&other)
 	error_ = other.error_;
 	planes_ = std::move(other.planes_);
 	maps_ = std::move(other.maps_);
+	cachedMaps_ = std::move(other.cachedMaps_);
 	other.error_ = -ENOENT;
 
 	return *this;
@@ -93,6 +96,9 @@ MappedBuffer::~MappedBuffer()
 {
 	for (Plane &map : maps_)
 		munmap(map.data(), map.size());
+
+	for (Plane &map : cachedMaps_)
+		MappingCache::instance()->unmap(map);
 }
 
 /**
@@ -147,6 +153,15 @@ MappedBuffer::~MappedBuffer()
  * completed successfully.
  */
 
+/**
+ * \var MappedBuffer::cachedMaps_
+ * \brief Stores the mappings acquired from the MappingCache
+ *
+ * MappedBuffer derived classes shall store the mappings they acquire from the
+ * MappingCache in this vector, which is parsed during destruction to release
+ * them to the cache.
+ */
+
 /**
  * \class MappedFrameBuffer
  * \brief Map a FrameBuffer using the MappedBuffer interface
@@ -161,6 +176,12 @@ MappedBuffer::~MappedBuffer()
  * \brief Create a write-only mapping
  * \var MappedFrameBuffer::ReadWrite
  * \brief Create a mapping that can be both read and written
+ * \var MappedFrameBuffer::Cached
+ * \brief Acquire the mapping from the process-wide MappingCache
+ *
+ * Cached mappings are reused across MappedFrameBuffer instances that map the
+ * same dmabufs with the same protection flags, avoiding the cost of mapping
+ * and unmapping buffers repeatedly.
  */
 
 /**
@@ -176,6 +197,10 @@ MappedBuffer::~MappedBuffer()
  * Construct an object to map a frame buffer for CPU access. The mapping can be
  * made as Read only, Write only or support Read and Write operations by setting
  * the MapFlag flags accordingly.
+ *
+ * When the MapFlag::Cached flag is set, the mappings are acquired from the
+ * MappingCache and released to it on destruction instead of being unmapped.
+ * This is recommended for callers that map the same buffers for every frame.
  */
 MappedFrameBuffer::MappedFrameBuffer(const FrameBuffer *buffer, MapFlags flags)
 {
@@ -222,7 +247,18 @@ MappedFrameBuffer::MappedFrameBuffer(const FrameBuffer *buffer, MapFlags flags)
 	for (const FrameBuffer::Plane &plane : buffer->planes()) {
 		const int fd = plane.fd.get();
 		auto &info = mappedBuffers[fd];
-		if (!info.address) {
+		if (!info.address && flags & MapFlag::Cached) {
+			Plane map;
+			int ret = MappingCache::instance()->map(fd, info.mapLength,
+								mmapFlags, &map);
+			if (ret < 0) {
+				error_ = ret;
+				return;
+			}
+
+			info.address = map.data();
+			cachedMaps_.push_back(map);
+		} else if (!info.address) {
 			void *address = mmap(nullptr, info.mapLength, mmapFlags,
 					     MAP_SHARED, fd, 0);
 			if (address == MAP_FAILED) {
@@ -240,4 +276,311 @@ MappedFrameBuffer::MappedFrameBuffer(const FrameBuffer *buffer, MapFlags flags)
 	}
 }
 
+/**
+ * \class MappingCache
+ * \brief Process-wide cache of memory mappings of dmabufs
+ *
+ * Mapping a buffer in the process address space and unmapping it is costly, as
+ * it requires setting up and tearing down page tables, and faulting pages in
+ * on first access. Callers that map the same buffers for every frame, such as
+ * post-processors, pay this cost repeatedly.
+ *
+ * The MappingCache class keeps mappings alive after their last user releases
+ * them, and hands them out again when the same buffer is mapped. Buffers are
+ * identified by the device and inode numbers of their file descriptor, which
+ * are stable across file descriptor duplication and passing between
+ * processes, along with the mapping length and protection flags.
+ *
+ * Mappings are reference-counted. Mappings that are not used anymore are kept
+ * in a least recently used list, and are unmapped when the number of idle
+ * mappings exceeds a limit set by setMaxIdle(). As a cached mapping keeps a
+ * reference to the underlying buffer, this limit bounds the amount of memory
+ * that can be kept alive by the cache. Idle mappings can also be unmapped
+ * explicitly with trim().
+ *
+ * To avoid keeping the memory of freed buffers alive, the owner of the buffer
+ * memory shall drop its mappings from the cache with release() when freeing the
+ * buffer. This isn't performed when a FrameBuffer is destroyed, as FrameBuffer
+ * instances are often temporary wrappers around memory owned by someone else,
+ * for instance in IPA modules, whose mappings must survive the wrapper to be
+ * reused.
+ *
+ * The cache is a process-wide singleton, available through instance(). All
+ * its functions are thread-safe.
+ */
+
+/**
+ * \struct MappingCache::Statistics
+ * \brief Mapping cache usage statistics
+ *
+ * \var MappingCache::Statistics::hits
+ * \brief The number of map requests satisfied by a cached mapping
+ *
+ * \var MappingCache::Statistics::misses
+ * \brief The number of map requests that created a new mapping
+ *
+ * \var MappingCache::Statistics::evictions
+ * \brief The number of idle mappings unmapped
+ *
+ * \var MappingCache::Statistics::entries
+ * \brief The number of mappings currently in the cache
+ *
+ * \var MappingCache::Statistics::idle
+ * \brief The number of mappings in the cache not currently in use
+ *
+ * \var MappingCache::Statistics::size
+ * \brief The total size in bytes of the mappings in the cache
+ */
+
+bool MappingCache::Key::operator<(const Key &other) const
+{
+	return std::tie(dev, ino, length, prot) <
+	       std::tie(other.dev, other.ino, other.length, other.prot);
+}
+
+MappingCache::MappingCache()
+	: maxIdle_(kDefaultMaxIdle), stats_{}
+{
+}
+
+MappingCache::~MappingCache()
+{
+	MutexLocker locker(mutex_);
+
+	for (auto &[key, entry] : entries_)
+		munmap(entry.address, entry.length);
+}
+
+/**
+ * \brief Retrieve the mapping cache instance
+ * \return The process-wide mapping cache
+ */
+MappingCache *MappingCache::instance()
+{
+	static MappingCache cache;
+	return &cache;
+}
+
+/**
+ * \brief Map a buffer through the cache
+ * \param[in] fd The buffer file descriptor
+ * \param[in] length The length of the mapping, starting at offset 0
+ * \param[in] prot The memory protection flags, as for mmap()
+ * \param[out] mapping The mapped memory
+ *
+ * Retrieve a mapping of the first \a length bytes of the buffer referenced by
+ * \a fd with protection flags \a prot, creating it if no such mapping exists
+ * in the cache. Every successful call shall be balanced by a call to unmap().
+ *
+ * \return 0 on success or a negative error code otherwise
+ */
+int MappingCache::map(int fd, size_t length, int prot, Span<uint8_t> *mapping)
+{
+	struct stat st;
+	int ret = fstat(fd, &st);
+	if (ret < 0) {
+		ret = -errno;
+		LOG(Buffer, Error) << "Failed to stat buffer: " << strerror(-ret);
+		return ret;
+	}
+
+	Key key{ st.st_dev, st.st_ino, length, prot };
+
+	MutexLocker locker(mutex_);
+
+	auto it = entries_.find(key);
+	if (it != entries_.end()) {
+		Entry &entry = it->second;
+
+		if (!entry.refs++) {
+			idle_.erase(entry.idle);
+			stats_.idle--;
+		}
+
+		stats_.hits++;
+		*mapping = { entry.address, entry.length };
+		return 0;
+	}
+
+	void *address = mmap(nullptr, length, prot, MAP_SHARED, fd, 0);
+	if (address == MAP_FAILED) {
+		ret = -errno;
+		LOG(Buffer, Error) << "Failed to mmap buffer: " << strerror(-ret);
+		return ret;
+	}
+
+	Entry &entry = entries_[key];
+	entry.key = key;
+	entry.address = static_cast<uint8_t *>(address);
+	entry.length = length;
+	entry.refs = 1;
+	entry.released = false;
+	entry.idle = idle_.end();
+
+	addresses_[entry.address] = &entry;
+
+	stats_.misses++;
+	stats_.entries++;
+	stats_.size += length;
+
+	*mapping = { entry.address, entry.length };
+	return 0;
+}
+
+/**
+ * \brief Release a mapping acquired from the cache
+ * \param[in] mapping The mapping returned by map()
+ *
+ * The mapping is kept in the cache for reuse, and is unmapped only when the
+ * number of idle mappings exceeds the limit.
+ */
+void MappingCache::unmap(Span<uint8_t> mapping)
+{
+	MutexLocker locker(mutex_);
+
+	auto it = addresses_.find(mapping.data());
+	if (it == addresses_.end()) {
+		LOG(Buffer, Error) << "Releasing unknown mapping";
+		return;
+	}
+
+	Entry *entry = it->second;
+	ASSERT(entry->refs);
+
+	if (--entry->refs)
+		return;
+
+	if (entry->released) {
+		evictLocked(entry);
+		return;
+	}
+
+	entry->idle = idle_.insert(idle_.end(), entry);
+	stats_.idle++;
+
+	trimLocked(maxIdle_);
+}
+
+/**
+ * \brief Drop the mappings of a buffer from the cache
+ * \param[in] fd The buffer file descriptor
+ *
+ * Unmap all idle mappings of the buffer referenced by \a fd, and mark the
+ * mappings in use to be unmapped when they are released instead of being kept
+ * in the cache. This function shall be called when the buffer is freed, to
+ * avoid the cache keeping its memory alive.
+ */
+void MappingCache::release(int fd)
+{
+	{
+		MutexLocker locker(mutex_);
+		if (entries_.empty())
+			return;
+	}
+
+	struct stat st;
+	if (fstat(fd, &st) < 0)
+		return;
+
+	MutexLocker locker(mutex_);
+
+	auto it = entries_.lower_bound({ st.st_dev, st.st_ino, 0, 0 });
+	while (it != entries_.end() && it->first.dev == st.st_dev &&
+	       it->first.ino == st.st_ino) {
+		Entry *entry = &(it++)->second;
+
+		if (entry->refs) {
+			entry->released = true;
+			continue;
+		}
+
+		idle_.erase(entry->idle);
+		stats_.idle--;
+		evictLocked(entry);
+	}
+}
+
+/**
+ * \brief Drop the mappings of all planes of a buffer from the cache
+ * \param[in] buffer The buffer
+ *
+ * This function is a convenience helper that calls release(int fd) for each
+ * distinct dmabuf of the \a buffer planes.
+ */
+void MappingCache::release(const FrameBuffer *buffer)
+{
+	const SharedFD *last = nullptr;
+
+	for (const FrameBuffer::Plane &plane : buffer->planes()) {
+		if (!plane.fd.isValid() || (last && plane.fd == *last))
+			continue;
+
+		last = &plane.fd;
+		release(plane.fd.get());
+	}
+}
+
+/**
+ * \brief Set the maximum number of idle mappings kept in the cache
+ * \param[in] maxIdle The maximum number of idle mappings
+ *
+ * Idle mappings in excess of \a maxIdle are unmapped immediately, least
+ * recently used first.
+ */
+void MappingCache::setMaxIdle(unsigned int maxIdle)
+{
+	MutexLocker locker(mutex_);
+
+	maxIdle_ = maxIdle;
+	trimLocked(maxIdle_);
+}
+
+/**
+ * \brief Unmap idle mappings
+ * \param[in] maxIdle The number of idle mappings to keep
+ *
+ * Unmap the least recently used idle mappings until at most \a maxIdle idle
+ * mappings are left in the cache. Mappings in use are not affected.
+ */
+void MappingCache::trim(unsigned int maxIdle)
+{
+	MutexLocker locker(mutex_);
+
+	trimLocked(maxIdle);
+}
+
+void MappingCache::trimLocked(unsigned int maxIdle)
+{
+	while (idle_.size() > maxIdle) {
+		Entry *entry = idle_.front();
+		idle_.pop_front();
+		stats_.idle--;
+
+		evictLocked(entry);
+	}
+}
+
+void MappingCache::evictLocked(Entry *entry)
+{
+	munmap(entry->address, entry->length);
+
+	stats_.evictions++;
+	stats_.entries--;
+	stats_.size -= entry->length;
+
+	addresses_.erase(entry->address);
+	entries_.erase(entry->key);
+}
+
+/**
+ * \brief Retrieve the cache usage statistics
+ * \return The cache statistics
+ */
+MappingCache::Statistics MappingCache::statistics() const
+{
+	MutexLocker locker(mutex_);
+
+	return stats_;
+}
+
 } /* namespace libcamera */
@@ -7,12 +7,14 @@
 
 #include "libcamera/internal/media_device.h"
 
+#include <ctype.h>
 #include <errno.h>
 #include <fcntl.h>
 #include <stdint.h>
 #include <string>
 #include <string.h>
 #include <sys/ioctl.h>
+#include <sys/utsname.h>
 #include <unistd.h>
 #include <vector>
 
@@ -20,6 +22,8 @@
 
 #include <libcamera/base/log.h>
 
+#include "libcamera/internal/discovery_cache.h"
+
 /**
  * \file media_device.h
  * \brief Provide a representation of a Linux kernel Media Controller device
@@ -261,6 +265,9 @@ int MediaDevice::populate()
 	    populateLinks(topology))
 		valid_ = true;
 
+	if (valid_)
+		loadDiscoveryCache(info);
+
 	ret = 0;
 done:
 	close();
@@ -320,6 +327,19 @@ done:
  * \return The MediaDevice hardware revision
  */
 
+/**
+ * \fn MediaDevice::discoveryCache()
+ * \brief Retrieve the discovery cache associated with the media device
+ *
+ * The discovery cache is loaded when the media device is populated. It is
+ * tagged with the identity of the media device and the kernel version, and
+ * can be used to store the results of expensive queries on the devices
+ * associated with the media graph entities, such as the formats supported by
+ * camera sensors.
+ *
+ * \return The discovery cache, or nullptr if caching is disabled
+ */
+
 /**
  * \fn MediaDevice::entities()
  * \brief Retrieve the list of entities in the media graph
@@ -566,9 +586,42 @@ void MediaDevice::clear()
 
 	objects_.clear();
 	entities_.clear();
+	cache_.reset();
 	valid_ = false;
 }
 
+/**
+ * \brief Load the discovery cache for the media device
+ * \param[in] info The media device information
+ */
+void MediaDevice::loadDiscoveryCache(const struct media_device_info &info)
+{
+	std::string dir = DiscoveryCache::directory();
+	if (dir.empty())
+		return;
+
+	struct utsname uts;
+	if (uname(&uts) < 0)
+		return;
+
+	std::ostringstream signature;
+	signature << info.driver << "|" << info.model << "|" << info.serial
+		  << "|" << info.bus_info << "|" << info.hw_revision << "|"
+		  << info.driver_version << "|" << info.media_version << "|"
+		  << uts.release;
+
+	/* Identify the cache file by the driver and bus of the device. */
+	std::string name = std::string(info.driver) + "-" + info.bus_info;
+	for (char &c : name) {
+		if (!isalnum(static_cast<unsigned char>(c)) && c != '-' && c != '.')
+			c = '_';
+	}
+
+	cache_ = std::make_unique<DiscoveryCache>(dir + "/discovery/" + name,
+						  signature.str());
+	cache_->load();
+}
+
 /**
  * \var MediaDevice::entities_
  * \brief Global list of media entities in the media graph
@@ -7,6 +7,8 @@
 
 #include "frames.h"
 
+#include <algorithm>
+
 #include <libcamera/framebuffer.h>
 #include <libcamera/request.h>
 
@@ -25,68 +27,88 @@ IPU3Frames::IPU3Frames()
 void IPU3Frames::init(const std::vector<std::unique_ptr<FrameBuffer>> &paramBuffers,
 		      const std::vector<std::unique_ptr<FrameBuffer>> &statBuffers)
 {
-	for (const std::unique_ptr<FrameBuffer> &buffer : paramBuffers)
-		availableParamBuffers_.push(buffer.get());
+	/*
+	 * Pre-allocate one frame slot per parameters and statistics buffers
+	 * pair, so that no memory is allocated while streaming.
+	 */
+	unsigned int count = std::min(paramBuffers.size(), statBuffers.size());
+
+	infos_.clear();
+	infos_.resize(count);
+
+	availableInfos_.clear();
+	availableInfos_.reserve(count);
+
+	for (unsigned int i = count; i > 0; --i) {
+		Info &info = infos_[i - 1];
+
+		info.paramBuffer = paramBuffers[i - 1].get();
+		info.statBuffer = statBuffers[i - 1].get();
+
+		availableInfos_.push_back(&info);
+	}
 
-	for (const std::unique_ptr<FrameBuffer> &buffer : statBuffers)
-		availableStatBuffers_.push(buffer.get());
+	/*
+	 * Index the frames in flight by sequence number in a power of two
+	 * sized table. Sizing it with twice the number of slots leaves room
+	 * for frames completing out of order.
+	 */
+	unsigned int size = 1;
+	while (size < count * 2)
+		size <<= 1;
 
-	frameInfo_.clear();
+	frames_.assign(size, nullptr);
 }
 
 void IPU3Frames::clear()
 {
-	availableParamBuffers_ = {};
-	availableStatBuffers_ = {};
+	availableInfos_.clear();
+	frames_.clear();
+	infos_.clear();
 }
 
 IPU3Frames::Info *IPU3Frames::create(Request *request)
 {
 	unsigned int id = request->sequence();
 
-	if (availableParamBuffers_.empty()) {
-		LOG(IPU3, Debug) << "Parameters buffer underrun";
+	if (availableInfos_.empty()) {
+		LOG(IPU3, Debug) << "Parameters and statistics buffers underrun";
 		return nullptr;
 	}
 
-	if (availableStatBuffers_.empty()) {
-		LOG(IPU3, Debug) << "Statistics buffer underrun";
+	Info *&entry = slot(id);
+	if (entry) {
+		LOG(IPU3, Debug)
+			<< "Frame " << entry->id << " still in flight, delaying frame "
+			<< id;
 		return nullptr;
 	}
 
-	FrameBuffer *paramBuffer = availableParamBuffers_.front();
-	FrameBuffer *statBuffer = availableStatBuffers_.front();
+	Info *info = availableInfos_.back();
+	availableInfos_.pop_back();
 
-	paramBuffer->_d()->setRequest(request);
-	statBuffer->_d()->setRequest(request);
-
-	availableParamBuffers_.pop();
-	availableStatBuffers_.pop();
-
-	/* \todo Remove the dynamic allocation of Info */
-	std::unique_ptr<Info> info = std::make_unique<Info>();
+	info->paramBuffer->_d()->setRequest(request);
+	info->statBuffer->_d()->setRequest(request);
 
 	info->id = id;
 	info->request = request;
 	info->rawBuffer = nullptr;
-	info->paramBuffer = paramBuffer;
-	info->statBuffer = statBuffer;
+	info->effectiveSensorControls.clear();
 	info->paramDequeued = false;
 	info->metadataProcessed = false;
 
-	frameInfo_[id] = std::move(info);
+	entry = info;
 
-	return frameInfo_[id].get();
+	return info;
 }
 
 void IPU3Frames::remove(IPU3Frames::Info *info)
 {
-	/* Return params and stat buffer for reuse. */
-	availableParamBuffers_.push(info->paramBuffer);
-	availableStatBuffers_.push(info->statBuffer);
+	/* Return the slot, with its params and stat buffers, for reuse. */
+	slot(info->id) = nullptr;
 
-	/* Delete the extended frame information. */
-	frameInfo_.erase(info->id);
+	info->request = nullptr;
+	availableInfos_.push_back(info);
 }
 
 bool IPU3Frames::tryComplete(IPU3Frames::Info *info)
@@ -111,10 +133,11 @@ bool IPU3Frames::tryComplete(IPU3Frames::Info *info)
 
 IPU3Frames::Info *IPU3Frames::find(unsigned int id)
 {
-	const auto &itInfo = frameInfo_.find(id);
-
-	if (itInfo != frameInfo_.end())
-		return itInfo->second.get();
+	if (!frames_.empty()) {
+		Info *info = slot(id);
+		if (info && info->id == id)
+			return info;
+	}
 
 	LOG(IPU3, Fatal) << "Can't find tracking information for frame " << id;
 
@@ -123,15 +146,15 @@ IPU3Frames::Info *IPU3Frames::find(unsigned int id)
 
 IPU3Frames::Info *IPU3Frames::find(FrameBuffer *buffer)
 {
-	for (auto const &itInfo : frameInfo_) {
-		Info *info = itInfo.second.get();
-
-		for (auto const itBuffers : info->request->buffers())
-			if (itBuffers.second == buffer)
-				return info;
-
-		if (info->rawBuffer == buffer || info->paramBuffer == buffer ||
-		    info->statBuffer == buffer)
+	/*
+	 * All buffers queued for a frame, including the internal raw,
+	 * parameters and statistics buffers, are associated with the request
+	 * of the frame, whose sequence number indexes the frames table.
+	 */
+	Request *request = buffer->request();
+	if (request && !frames_.empty()) {
+		Info *info = slot(request->sequence());
+		if (info && info->request == request)
 			return info;
 	}
 
@@ -7,9 +7,7 @@
 
 #pragma once
 
-#include <map>
 #include <memory>
-#include <queue>
 #include <vector>
 
 #include <libcamera/base/signal.h>
@@ -58,10 +56,12 @@ public:
 	Signal<> bufferAvailable;
 
 private:
-	std::queue<FrameBuffer *> availableParamBuffers_;
-	std::queue<FrameBuffer *> availableStatBuffers_;
+	Info *&slot(unsigned int id) { return frames_[id & (frames_.size() - 1)]; }
 
-	std::map<unsigned int, std::unique_ptr<Info>> frameInfo_;
+	std::vector<Info> infos_;
+	std::vector<Info *> availableInfos_;
+
+	std::vector<Info *> frames_;
 };
 
 } /* namespace libcamera */
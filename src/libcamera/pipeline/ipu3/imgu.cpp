@@ -19,6 +19,7 @@
 #include <libcamera/formats.h>
 #include <libcamera/stream.h>
 
+#include "libcamera/internal/mapped_framebuffer.h"
 #include "libcamera/internal/media_device.h"
 
 namespace libcamera {
@@ -629,6 +630,11 @@ void ImgUDevice::freeBuffers()
 {
 	int ret;
 
+	for (const std::unique_ptr<FrameBuffer> &buffer : paramBuffers_)
+		MappingCache::instance()->release(buffer.get());
+	for (const std::unique_ptr<FrameBuffer> &buffer : statBuffers_)
+		MappingCache::instance()->release(buffer.get());
+
 	paramBuffers_.clear();
 	statBuffers_.clear();
 
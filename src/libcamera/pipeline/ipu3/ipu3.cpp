@@ -34,6 +34,7 @@
 #include "libcamera/internal/ipa_manager.h"
 #include "libcamera/internal/media_device.h"
 #include "libcamera/internal/pipeline_handler.h"
+#include "libcamera/internal/v4l2_control_transaction.h"
 
 #include "cio2.h"
 #include "frames.h"
@@ -76,6 +77,7 @@ public:
 	bool supportsFlips_;
 	Transform rotationTransform_;
 
+	V4L2ControlTransaction controlTransaction_;
 	std::unique_ptr<DelayedControls> delayedCtrls_;
 	IPU3Frames frameInfos_;
 
@@ -790,6 +792,7 @@ int PipelineHandlerIPU3::start(Camera *camera, [[maybe_unused]] const ControlLis
 		goto error;
 
 	data->delayedCtrls_->reset();
+	data->controlTransaction_.resetStatistics();
 
 	/*
 	 * Start the ImgU video devices, buffers will be queued to the
@@ -829,6 +832,18 @@ void PipelineHandlerIPU3::stopDevice(Camera *camera)
 	if (ret)
 		LOG(IPU3, Warning) << "Failed to stop camera " << camera->id();
 
+	const V4L2ControlTransaction::Statistics &stats =
+		data->controlTransaction_.statistics();
+	if (stats.commits)
+		LOG(IPU3, Debug)
+			<< "Wrote " << stats.controls << " controls with "
+			<< stats.ioctls << " ioctls in " << stats.commits
+			<< " frames, average " << stats.total / stats.commits
+			<< ", max " << stats.max;
+
+	/* Drop the lens position queued for a frame that will never start. */
+	data->controlTransaction_.reset();
+
 	freeBuffers(camera);
 }
 
@@ -1142,7 +1157,17 @@ int PipelineHandlerIPU3::registerCameras()
 
 		data->delayedCtrls_ =
 			std::make_unique<DelayedControls>(cio2->sensor()->device(),
-							  params);
+							  params,
+							  &data->controlTransaction_);
+
+		/*
+		 * Write the lens position along with the sensor controls at
+		 * frame start.
+		 */
+		CameraLens *lens = cio2->sensor()->focusLens();
+		if (lens)
+			data->controlTransaction_.addControl(lens->device(),
+							     V4L2_CID_FOCUS_ABSOLUTE);
 		data->cio2_.frameStart().connect(data.get(),
 						 &IPU3CameraData::frameStart);
 
@@ -1280,7 +1305,9 @@ void IPU3CameraData::setSensorControls([[maybe_unused]] unsigned int id,
 
 	const ControlValue &focusValue = lensControls.get(V4L2_CID_FOCUS_ABSOLUTE);
 
-	focusLens->setFocusPosition(focusValue.get<int32_t>());
+	/* The lens position is written by the next frame start. */
+	controlTransaction_.set(focusLens->device(), V4L2_CID_FOCUS_ABSOLUTE,
+				focusValue);
 }
 
 void IPU3CameraData::paramsBufferReady(unsigned int id)
@@ -1389,7 +1416,7 @@ void IPU3CameraData::cio2BufferReady(FrameBuffer *buffer)
 	request->metadata().set(controls::SensorTimestamp,
 				buffer->metadata().timestamp);
 
-	info->effectiveSensorControls = delayedCtrls_->get(buffer->metadata().sequence);
+	info->effectiveSensorControls = delayedCtrls_->get(buffer->metadata().sequence).first;
 
 	if (request->findBuffer(&rawStream_))
 		pipe()->completeBuffer(request, buffer);
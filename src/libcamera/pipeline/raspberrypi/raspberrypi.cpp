@@ -10,6 +10,7 @@
 #include <fcntl.h>
 #include <memory>
 #include <mutex>
+#include <optional>
 #include <queue>
 #include <unordered_set>
 #include <utility>
@@ -33,15 +34,17 @@
 #include "libcamera/internal/bayer_format.h"
 #include "libcamera/internal/camera.h"
 #include "libcamera/internal/camera_sensor.h"
+#include "libcamera/internal/delayed_controls.h"
 #include "libcamera/internal/device_enumerator.h"
+#include "libcamera/internal/dma_heaps.h"
+#include "libcamera/internal/frame_matcher.h"
 #include "libcamera/internal/framebuffer.h"
 #include "libcamera/internal/ipa_manager.h"
 #include "libcamera/internal/media_device.h"
 #include "libcamera/internal/pipeline_handler.h"
+#include "libcamera/internal/tracepoints.h"
 #include "libcamera/internal/v4l2_videodevice.h"
 
-#include "delayed_controls.h"
-#include "dma_heaps.h"
 #include "rpi_stream.h"
 
 using namespace std::chrono_literals;
@@ -185,7 +188,8 @@ public:
 	RPiCameraData(PipelineHandler *pipe)
 		: Camera::Private(pipe), state_(State::Stopped),
 		  supportsFlips_(false), flipsAlterBayerOrder_(false),
-		  dropFrameCount_(0), buffersAllocated_(false), ispOutputCount_(0)
+		  dropFrameCount_(0), buffersAllocated_(false),
+		  switchReusedBuffers_(0), ispOutputCount_(0)
 	{
 	}
 
@@ -195,6 +199,8 @@ public:
 	}
 
 	void freeBuffers();
+	void stashBuffers();
+	bool dropStashedBuffers();
 	void frameStarted(uint32_t sequence);
 
 	int loadIPA(ipa::RPi::IPAInitResult *result);
@@ -240,10 +246,10 @@ public:
 	std::vector<std::pair<std::unique_ptr<V4L2Subdevice>, MediaLink *>> bridgeDevices_;
 
 	/* DMAHEAP allocation helper. */
-	RPi::DmaHeap dmaHeap_;
+	DmaHeap dmaHeap_;
 	SharedFD lsTable_;
 
-	std::unique_ptr<RPi::DelayedControls> delayedCtrls_;
+	std::unique_ptr<DelayedControls> delayedCtrls_;
 	bool sensorMetadata_;
 
 	/*
@@ -265,8 +271,21 @@ public:
 		unsigned int delayContext;
 	};
 
-	std::queue<BayerFrame> bayerQueue_;
-	std::queue<FrameBuffer *> embeddedQueue_;
+	/*
+	 * Bayer and embedded data buffers waiting to be matched by sequence
+	 * number. The capacity covers all the Unicam buffers that can be in
+	 * flight.
+	 */
+	static constexpr unsigned int kMaxPendingFrames = 16;
+	using BufferMatcher = FrameMatcher<BayerFrame, FrameBuffer *, kMaxPendingFrames>;
+	BufferMatcher frameMatcher_;
+
+	/* Bayer and embedded data matching statistics since the last start. */
+	const BufferMatcher::Statistics &matchStatistics() const
+	{
+		return frameMatcher_.statistics();
+	}
+
 	std::deque<Request *> requestQueue_;
 
 	/*
@@ -295,12 +314,26 @@ public:
 	/* Have internal buffers been allocated? */
 	bool buffersAllocated_;
 
+	/*
+	 * Mode switch instrumentation. The switch starts when configure() is
+	 * called (or start() when restarting without reconfiguring), and ends
+	 * when the first frame is received.
+	 */
+	std::optional<utils::time_point> switchStart_;
+	utils::Duration switchStartDuration_;
+	unsigned int switchReusedBuffers_;
+
 private:
+	void unmapBuffers();
+	void completeModeSwitch();
+
 	void checkRequestCompleted();
 	void fillRequestMetadata(const ControlList &bufferControls,
 				 Request *request);
 	void tryRunPipeline();
 	bool findMatchingBuffers(BayerFrame &bayerFrame, FrameBuffer *&embeddedBuffer);
+	void dropBayerFrame(BayerFrame &&bayerFrame);
+	void dropEmbeddedBuffer(FrameBuffer *buffer);
 
 	unsigned int ispOutputCount_;
 };
@@ -699,8 +732,14 @@ int PipelineHandlerRPi::configure(Camera *camera, CameraConfiguration *config)
 	RPiCameraData *data = cameraData(camera);
 	int ret;
 
-	/* Start by freeing all buffers and reset the Unicam and ISP stream states. */
-	data->freeBuffers();
+	data->switchStart_ = utils::clock::now();
+
+	/*
+	 * Start by releasing all buffers and reset the Unicam and ISP stream
+	 * states. The memory of the internal buffers is kept to be reused if
+	 * the streams are configured with the same formats.
+	 */
+	data->stashBuffers();
 	for (auto const stream : data->streams_)
 		stream->setExternal(false);
 
@@ -1021,6 +1060,9 @@ int PipelineHandlerRPi::start(Camera *camera, const ControlList *controls)
 	RPiCameraData *data = cameraData(camera);
 	int ret;
 
+	if (!data->switchStart_)
+		data->switchStart_ = utils::clock::now();
+
 	for (auto const stream : data->streams_)
 		stream->resetBuffers();
 
@@ -1069,6 +1111,13 @@ int PipelineHandlerRPi::start(Camera *camera, const ControlList *controls)
 	 */
 	data->delayedCtrls_->reset(0);
 
+	/*
+	 * Tolerate embedded data buffers completing up to one frame after the
+	 * next frame's buffer before giving up on them.
+	 */
+	data->frameMatcher_.setSecondaryRequired(data->sensorMetadata_, 1);
+	data->frameMatcher_.resetStatistics();
+
 	data->state_ = RPiCameraData::State::Idle;
 
 	/* Start all streams. */
@@ -1088,6 +1137,8 @@ int PipelineHandlerRPi::start(Camera *camera, const ControlList *controls)
 		std::max<utils::Duration>(1s, 2 * startConfig.maxSensorFrameLengthMs * 1ms);
 	data->unicam_[Unicam::Image].dev()->setDequeueTimeout(timeout);
 
+	data->switchStartDuration_ = utils::clock::now() - *data->switchStart_;
+
 	return 0;
 }
 
@@ -1104,8 +1155,22 @@ void PipelineHandlerRPi::stopDevice(Camera *camera)
 		stream->dev()->streamOff();
 
 	data->clearIncompleteRequests();
-	data->bayerQueue_ = {};
-	data->embeddedQueue_ = {};
+	data->frameMatcher_.clear([](RPiCameraData::BayerFrame &&) {},
+				  [](FrameBuffer *) {});
+	data->switchStart_.reset();
+
+	const RPiCameraData::BufferMatcher::Statistics &stats = data->matchStatistics();
+	LOG(RPI, Debug)
+		<< "Frame matching: " << stats.matched << " matched, "
+		<< stats.unmatched << " without embedded data, "
+		<< stats.primaryDropped << " bayer and "
+		<< stats.secondaryDropped << " embedded buffers dropped";
+
+	/* Frame drops caused by matching failures are visible to users. */
+	if (stats.primaryDropped)
+		LOG(RPI, Warning)
+			<< stats.primaryDropped
+			<< " frames dropped by bayer and embedded data matching";
 
 	/* Stop the IPA. */
 	data->ipa_->stop();
@@ -1303,13 +1368,13 @@ int PipelineHandlerRPi::registerCamera(MediaDevice *unicam, MediaDevice *isp, Me
 	 * Setup our delayed control writer with the sensor default
 	 * gain and exposure delays. Mark VBLANK for priority write.
 	 */
-	std::unordered_map<uint32_t, RPi::DelayedControls::ControlParams> params = {
+	std::unordered_map<uint32_t, DelayedControls::ControlParams> params = {
 		{ V4L2_CID_ANALOGUE_GAIN, { result.sensorConfig.gainDelay, false } },
 		{ V4L2_CID_EXPOSURE, { result.sensorConfig.exposureDelay, false } },
 		{ V4L2_CID_HBLANK, { result.sensorConfig.hblankDelay, false } },
 		{ V4L2_CID_VBLANK, { result.sensorConfig.vblankDelay, true } }
 	};
-	data->delayedCtrls_ = std::make_unique<RPi::DelayedControls>(data->sensor_->device(), params);
+	data->delayedCtrls_ = std::make_unique<DelayedControls>(data->sensor_->device(), params);
 	data->sensorMetadata_ = result.sensorConfig.sensorMetadata;
 
 	/* Register initial controls that the Raspberry Pi IPA can handle. */
@@ -1436,6 +1501,8 @@ int PipelineHandlerRPi::prepareBuffers(Camera *camera)
 		}
 	}
 
+	data->switchReusedBuffers_ = 0;
+
 	/* Decide how many internal buffers to allocate. */
 	for (auto const stream : data->streams_) {
 		unsigned int numBuffers;
@@ -1477,8 +1544,20 @@ int PipelineHandlerRPi::prepareBuffers(Camera *camera)
 		}
 
 		ret = stream->prepareBuffers(numBuffers);
+		if (ret == -ENOMEM && data->dropStashedBuffers()) {
+			/*
+			 * Stashed buffers of other configurations hold memory
+			 * from the same CMA pool, free them and retry once.
+			 */
+			LOG(RPI, Warning)
+				<< "Out of memory, retrying without stashed buffers";
+			ret = stream->prepareBuffers(numBuffers);
+		}
 		if (ret < 0)
 			return ret;
+
+		if (stream->buffersReused())
+			data->switchReusedBuffers_++;
 	}
 
 	/*
@@ -1515,16 +1594,7 @@ void PipelineHandlerRPi::mapBuffers(Camera *camera, const RPi::BufferMap &buffer
 
 void RPiCameraData::freeBuffers()
 {
-	if (ipa_) {
-		/*
-		 * Copy the buffer ids from the unordered_set to a vector to
-		 * pass to the IPA.
-		 */
-		std::vector<unsigned int> ipaBuffers(ipaBuffers_.begin(),
-						     ipaBuffers_.end());
-		ipa_->unmapBuffers(ipaBuffers);
-		ipaBuffers_.clear();
-	}
+	unmapBuffers();
 
 	for (auto const stream : streams_)
 		stream->releaseBuffers();
@@ -1532,6 +1602,51 @@ void RPiCameraData::freeBuffers()
 	buffersAllocated_ = false;
 }
 
+/*
+ * Release all buffers like freeBuffers(), but keep the memory of the internal
+ * buffers to reuse it when the streams are configured with the same formats
+ * again. This makes switching between a set of previously used configurations,
+ * such as preview and still capture modes, free of buffer allocations.
+ */
+void RPiCameraData::stashBuffers()
+{
+	unmapBuffers();
+
+	for (auto const stream : streams_)
+		stream->stashBuffers();
+
+	buffersAllocated_ = false;
+}
+
+/*
+ * Free the internal buffers stashed by all streams, to make their memory
+ * available to new allocations. Return true if any buffer has been freed.
+ */
+bool RPiCameraData::dropStashedBuffers()
+{
+	bool dropped = false;
+
+	for (auto const stream : streams_)
+		dropped |= stream->dropStashedBuffers();
+
+	return dropped;
+}
+
+void RPiCameraData::unmapBuffers()
+{
+	if (!ipa_)
+		return;
+
+	/*
+	 * Copy the buffer ids from the unordered_set to a vector to
+	 * pass to the IPA.
+	 */
+	std::vector<unsigned int> ipaBuffers(ipaBuffers_.begin(),
+					     ipaBuffers_.end());
+	ipa_->unmapBuffers(ipaBuffers);
+	ipaBuffers_.clear();
+}
+
 void RPiCameraData::frameStarted(uint32_t sequence)
 {
 	LOG(RPI, Debug) << "frame start " << sequence;
@@ -1872,24 +1987,48 @@ void RPiCameraData::unicamBufferDequeue(FrameBuffer *buffer)
 			<< ", timestamp: " << buffer->metadata().timestamp;
 
 	if (stream == &unicam_[Unicam::Image]) {
+		if (switchStart_)
+			completeModeSwitch();
+
 		/*
 		 * Lookup the sensor controls used for this frame sequence from
 		 * DelayedControl and queue them along with the frame buffer.
 		 */
-		auto [ctrl, delayContext] = delayedCtrls_->get(buffer->metadata().sequence);
+		auto [sensorCtrls, delayContext] = delayedCtrls_->get(buffer->metadata().sequence);
+		ControlList ctrl = sensorCtrls;
 		/*
 		 * Add the frame timestamp to the ControlList for the IPA to use
 		 * as it does not receive the FrameBuffer object.
 		 */
 		ctrl.set(controls::SensorTimestamp, buffer->metadata().timestamp);
-		bayerQueue_.push({ buffer, std::move(ctrl), delayContext });
+		frameMatcher_.pushPrimary(buffer->metadata().sequence,
+					  { buffer, std::move(ctrl), delayContext },
+					  [this](BayerFrame &&f) { dropBayerFrame(std::move(f)); });
 	} else {
-		embeddedQueue_.push(buffer);
+		frameMatcher_.pushSecondary(buffer->metadata().sequence, std::move(buffer),
+					    [this](FrameBuffer *b) { dropEmbeddedBuffer(b); });
 	}
 
 	handleState();
 }
 
+void RPiCameraData::completeModeSwitch()
+{
+	utils::Duration latency = utils::clock::now() - *switchStart_;
+	switchStart_.reset();
+
+	LOG(RPI, Debug)
+		<< "Mode switch completed in " << latency.get<std::milli>()
+		<< "ms (" << switchStartDuration_.get<std::milli>()
+		<< "ms to start), " << switchReusedBuffers_ << "/"
+		<< streams_.size() << " streams reused internal buffers";
+
+	LIBCAMERA_TRACEPOINT(pipeline_mode_switch, pipe()->name(),
+			     static_cast<uint64_t>(switchStartDuration_.get<std::micro>()),
+			     static_cast<uint64_t>(latency.get<std::micro>()),
+			     switchReusedBuffers_);
+}
+
 void RPiCameraData::ispInputDequeue(FrameBuffer *buffer)
 {
 	if (!isRunning())
@@ -2138,9 +2277,8 @@ void RPiCameraData::tryRunPipeline()
 	FrameBuffer *embeddedBuffer;
 	BayerFrame bayerFrame;
 
-	/* If any of our request or buffer queues are empty, we cannot proceed. */
-	if (state_ != State::Idle || requestQueue_.empty() ||
-	    bayerQueue_.empty() || (embeddedQueue_.empty() && sensorMetadata_))
+	/* If the pipeline is busy or no request is queued, we cannot proceed. */
+	if (state_ != State::Idle || requestQueue_.empty())
 		return;
 
 	if (!findMatchingBuffers(bayerFrame, embeddedBuffer))
@@ -2196,54 +2334,43 @@ void RPiCameraData::tryRunPipeline()
 
 bool RPiCameraData::findMatchingBuffers(BayerFrame &bayerFrame, FrameBuffer *&embeddedBuffer)
 {
-	if (bayerQueue_.empty())
-		return false;
-
 	/*
-	 * Find the embedded data buffer with a matching timestamp to pass to
-	 * the IPA. Any embedded buffers with a timestamp lower than the
-	 * current bayer buffer will be removed and re-queued to the driver.
+	 * Find the embedded data buffer with a matching sequence to pass to
+	 * the IPA. Any embedded buffers older than the current bayer buffer
+	 * are dropped and re-queued to the driver. If the embedded buffer has
+	 * not been dequeued yet, wait for it, as dequeue ordering may send the
+	 * image buffer first.
 	 */
-	uint64_t ts = bayerQueue_.front().buffer->metadata().timestamp;
-	embeddedBuffer = nullptr;
-	while (!embeddedQueue_.empty()) {
-		FrameBuffer *b = embeddedQueue_.front();
-		if (b->metadata().timestamp < ts) {
-			embeddedQueue_.pop();
-			unicam_[Unicam::Embedded].returnBuffer(b);
-			LOG(RPI, Debug) << "Dropping unmatched input frame in stream "
-					<< unicam_[Unicam::Embedded].name();
-		} else if (b->metadata().timestamp == ts) {
-			/* Found a match! */
-			embeddedBuffer = b;
-			embeddedQueue_.pop();
-			break;
-		} else {
-			break; /* Only higher timestamps from here. */
-		}
-	}
+	std::optional<FrameBuffer *> embedded;
+	if (!frameMatcher_.match(&bayerFrame, &embedded,
+				 [this](FrameBuffer *b) { dropEmbeddedBuffer(b); }))
+		return false;
 
-	if (!embeddedBuffer && sensorMetadata_) {
-		if (embeddedQueue_.empty()) {
-			/*
-			 * If the embedded buffer queue is empty, wait for the next
-			 * buffer to arrive - dequeue ordering may send the image
-			 * buffer first.
-			 */
-			LOG(RPI, Debug) << "Waiting for next embedded buffer.";
-			return false;
-		}
+	embeddedBuffer = embedded.value_or(nullptr);
 
-		/* Log if there is no matching embedded data buffer found. */
+	/* Log if there is no matching embedded data buffer found. */
+	if (!embeddedBuffer && sensorMetadata_)
 		LOG(RPI, Debug) << "Returning bayer frame without a matching embedded buffer.";
-	}
-
-	bayerFrame = std::move(bayerQueue_.front());
-	bayerQueue_.pop();
 
 	return true;
 }
 
+void RPiCameraData::dropBayerFrame(BayerFrame &&bayerFrame)
+{
+	LOG(RPI, Debug) << "Dropping unmatched input frame in stream "
+			<< unicam_[Unicam::Image].name();
+
+	handleStreamBuffer(bayerFrame.buffer, &unicam_[Unicam::Image]);
+}
+
+void RPiCameraData::dropEmbeddedBuffer(FrameBuffer *buffer)
+{
+	LOG(RPI, Debug) << "Dropping unmatched input frame in stream "
+			<< unicam_[Unicam::Embedded].name();
+
+	unicam_[Unicam::Embedded].returnBuffer(buffer);
+}
+
 REGISTER_PIPELINE_HANDLER(PipelineHandlerRPi)
 
 } /* namespace libcamera */
@@ -6,14 +6,37 @@
  */
 #include "rpi_stream.h"
 
+#include <algorithm>
+
 #include <libcamera/base/log.h>
 
+#include "libcamera/internal/mapped_framebuffer.h"
+
 namespace libcamera {
 
 LOG_DEFINE_CATEGORY(RPISTREAM)
 
 namespace RPi {
 
+namespace {
+
+bool sameLayout(const V4L2DeviceFormat &a, const V4L2DeviceFormat &b)
+{
+	if (a.fourcc != b.fourcc || a.size != b.size ||
+	    a.planesCount != b.planesCount)
+		return false;
+
+	for (unsigned int i = 0; i < a.planesCount; i++) {
+		if (a.planes[i].size != b.planes[i].size ||
+		    a.planes[i].bpl != b.planes[i].bpl)
+			return false;
+	}
+
+	return true;
+}
+
+} /* namespace */
+
 V4L2VideoDevice *Stream::dev() const
 {
 	return dev_.get();
@@ -88,13 +111,35 @@ int Stream::prepareBuffers(unsigned int count)
 {
 	int ret;
 
+	buffersReused_ = false;
+
 	if (!importOnly_) {
 		if (count) {
-			/* Export some frame buffers for internal use. */
-			ret = dev_->exportBuffers(count, &internalBuffers_);
+			ret = dev_->getFormat(&internalFormat_);
 			if (ret < 0)
 				return ret;
 
+			/* Reuse a set of buffers allocated for the same format. */
+			auto it = std::find_if(bufferSets_.begin(), bufferSets_.end(),
+					       [&](const BufferSet &set) {
+						       return set.buffers.size() == count &&
+							      sameLayout(set.format, internalFormat_);
+					       });
+			if (it != bufferSets_.end()) {
+				LOG(RPISTREAM, Debug)
+					<< "Reusing " << count << " buffers for "
+					<< name_ << " format " << internalFormat_;
+
+				internalBuffers_ = std::move(it->buffers);
+				bufferSets_.erase(it);
+				buffersReused_ = true;
+			} else {
+				/* Export some frame buffers for internal use. */
+				ret = dev_->exportBuffers(count, &internalBuffers_);
+				if (ret < 0)
+					return ret;
+			}
+
 			/* Add these exported buffers to the internal/external buffer list. */
 			setExportedBuffers(&internalBuffers_);
 			resetBuffers();
@@ -222,17 +267,63 @@ void Stream::releaseBuffers()
 {
 	dev_->releaseBuffers();
 	clearBuffers();
+	dropStashedBuffers();
+}
+
+void Stream::stashBuffers()
+{
+	/*
+	 * Release the device buffers but keep the memory of the internal
+	 * buffers, which can be reused if the stream is later configured with
+	 * the same format. Only the most recent sets are kept to bound memory
+	 * usage.
+	 */
+	if (!internalBuffers_.empty()) {
+		bufferSets_.push_front({ internalFormat_, std::move(internalBuffers_) });
+		if (bufferSets_.size() > kMaxBufferSets) {
+			releaseMappings(bufferSets_.back().buffers);
+			bufferSets_.pop_back();
+		}
+	}
+
+	dev_->releaseBuffers();
+	clearBuffers();
+}
+
+bool Stream::dropStashedBuffers()
+{
+	if (bufferSets_.empty())
+		return false;
+
+	for (const BufferSet &set : bufferSets_)
+		releaseMappings(set.buffers);
+	bufferSets_.clear();
+
+	return true;
+}
+
+bool Stream::buffersReused() const
+{
+	return buffersReused_;
 }
 
 void Stream::clearBuffers()
 {
 	availableBuffers_ = std::queue<FrameBuffer *>{};
 	requestBuffers_ = std::queue<FrameBuffer *>{};
+	releaseMappings(internalBuffers_);
 	internalBuffers_.clear();
 	bufferMap_.clear();
 	id_.reset();
 }
 
+void Stream::releaseMappings(const std::vector<std::unique_ptr<FrameBuffer>> &buffers)
+{
+	/* The buffers are about to be freed, drop their cached mappings. */
+	for (const std::unique_ptr<FrameBuffer> &buffer : buffers)
+		MappingCache::instance()->release(buffer.get());
+}
+
 int Stream::queueToDevice(FrameBuffer *buffer)
 {
 	LOG(RPISTREAM, Debug) << "Queuing buffer " << getBufferId(buffer)
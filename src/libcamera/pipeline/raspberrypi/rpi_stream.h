@@ -7,6 +7,7 @@
 
 #pragma once
 
+#include <deque>
 #include <queue>
 #include <string>
 #include <unordered_map>
@@ -44,7 +45,8 @@ public:
 
 	Stream(const char *name, MediaEntity *dev, bool importOnly = false)
 		: external_(false), importOnly_(importOnly), name_(name),
-		  dev_(std::make_unique<V4L2VideoDevice>(dev)), id_(BufferMask::MaskID)
+		  dev_(std::make_unique<V4L2VideoDevice>(dev)), id_(BufferMask::MaskID),
+		  buffersReused_(false)
 	{
 	}
 
@@ -69,6 +71,10 @@ public:
 
 	int queueAllBuffers();
 	void releaseBuffers();
+	void stashBuffers();
+	bool dropStashedBuffers();
+
+	bool buffersReused() const;
 
 private:
 	class IdGenerator
@@ -109,7 +115,17 @@ private:
 		std::queue<int> recycle_;
 	};
 
+	/* A set of internal buffers kept for a device format. */
+	struct BufferSet {
+		V4L2DeviceFormat format;
+		std::vector<std::unique_ptr<FrameBuffer>> buffers;
+	};
+
+	/* Maximum number of stashed internal buffer sets. */
+	static constexpr unsigned int kMaxBufferSets = 2;
+
 	void clearBuffers();
+	void releaseMappings(const std::vector<std::unique_ptr<FrameBuffer>> &buffers);
 	int queueToDevice(FrameBuffer *buffer);
 
 	/*
@@ -155,6 +171,19 @@ private:
 	 * as the stream needs to maintain ownership of these buffers.
 	 */
 	std::vector<std::unique_ptr<FrameBuffer>> internalBuffers_;
+
+	/* The device format the internal buffers have been allocated for. */
+	V4L2DeviceFormat internalFormat_;
+
+	/*
+	 * Internal buffers allocated for previous configurations, most recently
+	 * used first. They are reused when the stream is configured with the
+	 * same device format again, to avoid reallocation on mode switches.
+	 */
+	std::deque<BufferSet> bufferSets_;
+
+	/* Indicates that the internal buffers have been reused from a set. */
+	bool buffersReused_;
 };
 
 /*
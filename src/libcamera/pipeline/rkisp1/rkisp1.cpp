@@ -36,6 +36,7 @@
 #include "libcamera/internal/device_enumerator.h"
 #include "libcamera/internal/framebuffer.h"
 #include "libcamera/internal/ipa_manager.h"
+#include "libcamera/internal/mapped_framebuffer.h"
 #include "libcamera/internal/media_device.h"
 #include "libcamera/internal/pipeline_handler.h"
 #include "libcamera/internal/v4l2_subdevice.h"
@@ -885,6 +886,11 @@ int PipelineHandlerRkISP1::freeBuffers(Camera *camera)
 	while (!availableParamBuffers_.empty())
 		availableParamBuffers_.pop();
 
+	for (const std::unique_ptr<FrameBuffer> &buffer : paramBuffers_)
+		MappingCache::instance()->release(buffer.get());
+	for (const std::unique_ptr<FrameBuffer> &buffer : statBuffers_)
+		MappingCache::instance()->release(buffer.get());
+
 	paramBuffers_.clear();
 	statBuffers_.clear();
 
@@ -1262,7 +1268,7 @@ void PipelineHandlerRkISP1::bufferReady(FrameBuffer *buffer)
 
 		if (isRaw_) {
 			const ControlList &ctrls =
-				data->delayedCtrls_->get(metadata.sequence);
+				data->delayedCtrls_->get(metadata.sequence).first;
 			data->ipa_->processStatsBuffer(info->frame, 0, ctrls);
 		}
 	} else {
@@ -1306,7 +1312,7 @@ void PipelineHandlerRkISP1::statReady(FrameBuffer *buffer)
 		data->frame_ = buffer->metadata().sequence + 1;
 
 	data->ipa_->processStatsBuffer(info->frame, info->statBuffer->cookie(),
-				       data->delayedCtrls_->get(buffer->metadata().sequence));
+				       data->delayedCtrls_->get(buffer->metadata().sequence).first);
 }
 
 REGISTER_PIPELINE_HANDLER(PipelineHandlerRkISP1)
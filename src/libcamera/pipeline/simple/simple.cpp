@@ -11,6 +11,7 @@
 #include <list>
 #include <map>
 #include <memory>
+#include <optional>
 #include <queue>
 #include <set>
 #include <string>
@@ -20,23 +21,35 @@
 #include <vector>
 
 #include <linux/media-bus-format.h>
+#include <linux/v4l2-controls.h>
 
 #include <libcamera/base/log.h>
+#include <libcamera/base/mutex.h>
 
 #include <libcamera/camera.h>
 #include <libcamera/control_ids.h>
 #include <libcamera/request.h>
 #include <libcamera/stream.h>
 
+#include <libcamera/ipa/simple_ipa_interface.h>
+#include <libcamera/ipa/simple_ipa_proxy.h>
+
 #include "libcamera/internal/camera.h"
 #include "libcamera/internal/camera_sensor.h"
 #include "libcamera/internal/converter.h"
+#include "libcamera/internal/converter/converter_software.h"
+#include "libcamera/internal/delayed_controls.h"
 #include "libcamera/internal/device_enumerator.h"
+#include "libcamera/internal/formats.h"
+#include "libcamera/internal/framebuffer.h"
+#include "libcamera/internal/ipa_manager.h"
+#include "libcamera/internal/mapped_framebuffer.h"
 #include "libcamera/internal/media_device.h"
 #include "libcamera/internal/pipeline_handler.h"
 #include "libcamera/internal/v4l2_subdevice.h"
 #include "libcamera/internal/v4l2_videodevice.h"
 
+using namespace std::chrono_literals;
 
 namespace libcamera {
 
@@ -153,6 +166,28 @@ LOG_DEFINE_CATEGORY(SimplePipeline)
  * the capture video node, and stores the information in the outputFormats and
  * outputSizes of the SimpleCameraData::Configuration structure.
  *
+ * When multiple streams are configured, a stream whose format and size match
+ * the capture format and size bypasses the converter. Its buffers are captured
+ * to directly and fed to the converter to produce the other streams, avoiding
+ * a copy through the converter for that stream.
+ *
+ * When no memory-to-memory converter is available and the capture video node
+ * produces raw Bayer formats, the pipeline handler falls back to the
+ * SoftwareConverter to debayer the images on the CPU. Capture formats that the
+ * converter can't process are exposed without conversion. The raw capture
+ * formats are exposed as well, at the capture size only, to allow capturing
+ * raw frames, alone or as the passthrough stream alongside converted streams.
+ *
+ * Image Processing Algorithms
+ * ---------------------------
+ *
+ * Platforms without an ISP produce no statistics for the image processing
+ * algorithms. When the SoftwareConverter is in use, the pipeline handler
+ * enables its statistics and loads the simple IPA module, if available, to
+ * control the sensor exposure time and analogue gain, and the white balance
+ * gains applied by the converter. Cameras are still usable without the IPA
+ * module, with fixed sensor controls.
+ *
  * Concurrent Access to Cameras
  * ----------------------------
  *
@@ -209,6 +244,7 @@ public:
 	SimplePipelineHandler *pipe();
 
 	int init();
+	void loadIPA();
 	int setupLinks();
 	int setupFormats(V4L2SubdeviceFormat *format,
 			 V4L2Subdevice::Whence whence);
@@ -219,6 +255,20 @@ public:
 		return stream - &streams_.front();
 	}
 
+	/* The passthrough stream isn't configured on the converter. */
+	unsigned int converterIndex(const Stream *stream) const
+	{
+		unsigned int index = streamIndex(stream);
+		if (passthroughStream_ && stream > passthroughStream_)
+			index--;
+		return index;
+	}
+
+	void queueInternalBuffers();
+
+	void startDelayedControls();
+	void stopDelayedControls();
+
 	struct Entity {
 		/* The media entity, always valid. */
 		MediaEntity *entity;
@@ -251,8 +301,43 @@ public:
 		Size captureSize;
 		std::vector<PixelFormat> outputFormats;
 		SizeRange outputSizes;
+
+		/*
+		 * The capture format is listed in the output formats but can't
+		 * be produced by the converter, and is only available at the
+		 * capture size, without conversion.
+		 */
+		bool captureOnly;
+
+		SizeRange sizes(const PixelFormat &format) const
+		{
+			if (captureOnly && format == captureFormat)
+				return SizeRange(captureSize);
+			return outputSizes;
+		}
+	};
+
+	struct Validation {
+		struct StreamFormat {
+			PixelFormat pixelFormat;
+			Size size;
+			unsigned int stride;
+			unsigned int frameSize;
+			unsigned int bufferCount;
+		};
+
+		CameraConfiguration::Status status;
+		std::vector<StreamFormat> streams;
+		const Configuration *pipeConfig;
+		bool needConversion;
+		std::optional<unsigned int> passthroughStream;
 	};
 
+	using ValidationKey = std::vector<std::pair<PixelFormat, Size>>;
+
+	std::optional<Validation> cachedValidation(const ValidationKey &key);
+	void cacheValidation(ValidationKey key, const Validation &validation);
+
 	std::vector<Stream> streams_;
 
 	/*
@@ -271,12 +356,54 @@ public:
 	bool useConverter_;
 	std::queue<std::map<unsigned int, FrameBuffer *>> converterQueue_;
 
+	/*
+	 * The stream captured without conversion, if any. Internal buffers are
+	 * then only queued for requests that have no buffer for that stream,
+	 * instead of being captured to continuously.
+	 */
+	Stream *passthroughStream_;
+	std::queue<FrameBuffer *> availableBuffers_;
+	unsigned int queuedBuffers_;
+	/* Capture metadata of the passthrough buffers being converted. */
+	std::map<FrameBuffer *, FrameMetadata> passthroughMetadata_;
+
+	/* The software converter, when used, and its IPA module. */
+	SoftwareConverter *softwareConverter_;
+	std::unique_ptr<ipa::simple::IPAProxySimple> ipa_;
+	bool ipaLoaded_;
+	std::unique_ptr<DelayedControls> delayedCtrls_;
+
+	/*
+	 * Frame start events emitted by a subdevice may not be numbered like
+	 * the captured buffers. The offset between the two is measured on the
+	 * first captured buffer.
+	 */
+	V4L2Subdevice *frameStartSubdev_;
+	std::optional<uint32_t> frameStartSequence_;
+	std::optional<uint32_t> frameStartOffset_;
+
 private:
+	static constexpr unsigned int kValidationCacheSize = 16;
+
 	void tryPipeline(unsigned int code, const Size &size);
 	static std::vector<const MediaPad *> routedSourcePads(MediaPad *sink);
 
+	int initIPA();
+
+	void passthroughBufferReady(FrameBuffer *buffer);
+	void recycleBuffer(FrameBuffer *buffer);
+
 	void converterInputDone(FrameBuffer *buffer);
 	void converterOutputDone(FrameBuffer *buffer);
+	void statisticsReady(uint32_t frame,
+			     const SoftwareConverter::Statistics &stats);
+	void frameStarted(uint32_t sequence);
+	void setSensorControls(const ControlList &sensorControls);
+	void setWhiteBalance(float redGain, float blueGain);
+
+	Mutex validationMutex_;
+	std::map<ValidationKey, Validation> validationCache_
+		LIBCAMERA_TSA_GUARDED_BY(validationMutex_);
 };
 
 class SimpleCameraConfiguration : public CameraConfiguration
@@ -292,8 +419,14 @@ public:
 	}
 
 	bool needConversion() const { return needConversion_; }
+	std::optional<unsigned int> passthroughStream() const
+	{
+		return passthroughStream_;
+	}
 
 private:
+	Status validateStreams();
+
 	/*
 	 * The SimpleCameraData instance is guaranteed to be valid as long as
 	 * the corresponding Camera instance is valid. In order to borrow a
@@ -304,6 +437,7 @@ private:
 
 	const SimpleCameraData::Configuration *pipeConfig_;
 	bool needConversion_;
+	std::optional<unsigned int> passthroughStream_;
 };
 
 class SimplePipelineHandler : public PipelineHandler
@@ -329,6 +463,7 @@ public:
 
 protected:
 	int queueRequestDevice(Camera *camera, Request *request) override;
+	bool acquireDevice(Camera *camera) override;
 
 private:
 	static constexpr unsigned int kNumInternalBuffers = 3;
@@ -350,6 +485,8 @@ private:
 	const MediaPad *acquirePipeline(SimpleCameraData *data);
 	void releasePipeline(SimpleCameraData *data);
 
+	void prewarmCamera(std::weak_ptr<Camera> camera);
+
 	MediaDevice *media_;
 	std::map<const MediaEntity *, EntityData> entities_;
 
@@ -363,7 +500,10 @@ private:
 SimpleCameraData::SimpleCameraData(SimplePipelineHandler *pipe,
 				   unsigned int numStreams,
 				   MediaEntity *sensor)
-	: Camera::Private(pipe), streams_(numStreams)
+	: Camera::Private(pipe), streams_(numStreams),
+	  passthroughStream_(nullptr), queuedBuffers_(0),
+	  softwareConverter_(nullptr), ipaLoaded_(false),
+	  frameStartSubdev_(nullptr)
 {
 	int ret;
 
@@ -489,7 +629,13 @@ int SimpleCameraData::init()
 	SimplePipelineHandler *pipe = SimpleCameraData::pipe();
 	int ret;
 
-	/* Open the converter, if any. */
+	video_ = pipe->video(entities_.back().entity);
+	ASSERT(video_);
+
+	/*
+	 * Open the converter, if any. Fall back to the software converter if
+	 * the video node can capture raw Bayer formats.
+	 */
 	MediaDevice *converter = pipe->converter();
 	if (converter) {
 		converter_ = ConverterFactoryBase::create(converter);
@@ -497,14 +643,31 @@ int SimpleCameraData::init()
 			LOG(SimplePipeline, Warning)
 				<< "Failed to create converter, disabling format conversion";
 			converter_.reset();
-		} else {
-			converter_->inputBufferReady.connect(this, &SimpleCameraData::converterInputDone);
-			converter_->outputBufferReady.connect(this, &SimpleCameraData::converterOutputDone);
+		}
+	} else {
+		for (const auto &format : video_->formats()) {
+			if (SoftwareConverter::isSupported(format.first.toPixelFormat())) {
+				LOG(SimplePipeline, Debug)
+					<< "Using software converter";
+				converter_ = ConverterFactoryBase::create("software");
+				softwareConverter_ = static_cast<SoftwareConverter *>(converter_.get());
+				break;
+			}
 		}
 	}
 
-	video_ = pipe->video(entities_.back().entity);
-	ASSERT(video_);
+	if (converter_) {
+		converter_->inputBufferReady.connect(this, &SimpleCameraData::converterInputDone);
+		converter_->outputBufferReady.connect(this, &SimpleCameraData::converterOutputDone);
+	}
+
+	/*
+	 * Loading the IPA module is expensive, defer it until the camera is
+	 * acquired when initializing cameras lazily. Otherwise, prepare the
+	 * module in the background while probing the pipeline configurations.
+	 */
+	if (softwareConverter_ && !pipe->lazyInit())
+		IPAManager::preload(pipe, 0, 0);
 
 	/*
 	 * Setup links first as some subdev drivers take active links into
@@ -536,6 +699,9 @@ int SimpleCameraData::init()
 			formats_[fmt].push_back(&config);
 	}
 
+	if (!pipe->lazyInit())
+		loadIPA();
+
 	properties_ = sensor_->properties();
 
 	return 0;
@@ -592,13 +758,25 @@ void SimpleCameraData::tryPipeline(unsigned int code, const Size &size)
 		config.sensorSize = size;
 		config.captureFormat = pixelFormat;
 		config.captureSize = format.size;
+		config.captureOnly = false;
 
-		if (!converter_) {
+		if (converter_)
+			config.outputFormats = converter_->formats(pixelFormat);
+
+		if (config.outputFormats.empty()) {
 			config.outputFormats = { pixelFormat };
 			config.outputSizes = config.captureSize;
 		} else {
-			config.outputFormats = converter_->formats(pixelFormat);
 			config.outputSizes = converter_->sizes(format.size);
+
+			/*
+			 * The software converter only produces processed
+			 * formats, expose the raw capture format as well.
+			 */
+			if (softwareConverter_) {
+				config.outputFormats.push_back(pixelFormat);
+				config.captureOnly = true;
+			}
 		}
 
 		configs_.push_back(config);
@@ -724,10 +902,58 @@ int SimpleCameraData::setupFormats(V4L2SubdeviceFormat *format,
 	return 0;
 }
 
+std::optional<SimpleCameraData::Validation>
+SimpleCameraData::cachedValidation(const ValidationKey &key)
+{
+	MutexLocker locker(validationMutex_);
+
+	auto it = validationCache_.find(key);
+	if (it == validationCache_.end())
+		return std::nullopt;
+
+	return it->second;
+}
+
+void SimpleCameraData::cacheValidation(ValidationKey key,
+				       const Validation &validation)
+{
+	MutexLocker locker(validationMutex_);
+
+	if (validationCache_.size() >= kValidationCacheSize)
+		validationCache_.clear();
+
+	validationCache_.emplace(std::move(key), validation);
+}
+
 void SimpleCameraData::bufferReady(FrameBuffer *buffer)
 {
 	SimplePipelineHandler *pipe = SimpleCameraData::pipe();
 
+	/*
+	 * The first captured buffer is dequeued after the start of its frame,
+	 * and before the start of the next one given the vertical blanking.
+	 */
+	if (frameStartSequence_ && !frameStartOffset_ &&
+	    buffer->metadata().status == FrameMetadata::FrameSuccess) {
+		frameStartOffset_ = *frameStartSequence_ - buffer->metadata().sequence;
+
+		LOG(SimplePipeline, Debug)
+			<< "Frame start sequence offset is "
+			<< static_cast<int32_t>(*frameStartOffset_);
+	}
+
+	/*
+	 * Internal buffers have no request associated with them, buffers that
+	 * have a request belong to the passthrough stream.
+	 */
+	if (useConverter_ && buffer->request()) {
+		passthroughBufferReady(buffer);
+		return;
+	}
+
+	if (passthroughStream_)
+		queuedBuffers_--;
+
 	/*
 	 * If an error occurred during capture, or if the buffer was cancelled,
 	 * complete the request, even if the converter is in use as there's no
@@ -748,7 +974,9 @@ void SimpleCameraData::bufferReady(FrameBuffer *buffer)
 		 * the request with all the user-facing buffers.
 		 */
 		if (buffer->metadata().status != FrameMetadata::FrameCancelled)
-			video_->queueBuffer(buffer);
+			recycleBuffer(buffer);
+		else if (passthroughStream_)
+			availableBuffers_.push(buffer);
 
 		if (converterQueue_.empty())
 			return;
@@ -797,7 +1025,7 @@ void SimpleCameraData::bufferReady(FrameBuffer *buffer)
 	 */
 	if (useConverter_) {
 		if (converterQueue_.empty()) {
-			video_->queueBuffer(buffer);
+			recycleBuffer(buffer);
 			return;
 		}
 
@@ -811,10 +1039,91 @@ void SimpleCameraData::bufferReady(FrameBuffer *buffer)
 	pipe->completeRequest(request);
 }
 
+/*
+ * Convert the other streams of the request from a passthrough stream buffer,
+ * and complete the passthrough buffer when the converter releases it.
+ */
+void SimpleCameraData::passthroughBufferReady(FrameBuffer *buffer)
+{
+	SimplePipelineHandler *pipe = SimpleCameraData::pipe();
+	Request *request = buffer->request();
+
+	std::map<unsigned int, FrameBuffer *> outputs;
+	for (const auto &[stream, outputBuffer] : request->buffers()) {
+		if (stream != passthroughStream_)
+			outputs[converterIndex(stream)] = outputBuffer;
+	}
+
+	if (buffer->metadata().status != FrameMetadata::FrameSuccess) {
+		for (const auto &[index, outputBuffer] : outputs)
+			pipe->completeBuffer(request, outputBuffer);
+
+		pipe->completeBuffer(request, buffer);
+		pipe->completeRequest(request);
+		return;
+	}
+
+	request->metadata().set(controls::SensorTimestamp,
+				buffer->metadata().timestamp);
+
+	if (outputs.empty()) {
+		pipe->completeBuffer(request, buffer);
+		pipe->completeRequest(request);
+		return;
+	}
+
+	/* The converter may overwrite the metadata, save it. */
+	passthroughMetadata_[buffer] = buffer->metadata();
+
+	converter_->queueBuffers(buffer, outputs);
+}
+
+/* Make an internal buffer available for capture again. */
+void SimpleCameraData::recycleBuffer(FrameBuffer *buffer)
+{
+	if (!passthroughStream_) {
+		video_->queueBuffer(buffer);
+		return;
+	}
+
+	availableBuffers_.push(buffer);
+	queueInternalBuffers();
+}
+
+/*
+ * When a passthrough stream is configured, queue internal buffers for the
+ * requests waiting to be captured to an internal buffer only.
+ */
+void SimpleCameraData::queueInternalBuffers()
+{
+	while (queuedBuffers_ < converterQueue_.size() &&
+	       !availableBuffers_.empty()) {
+		video_->queueBuffer(availableBuffers_.front());
+		availableBuffers_.pop();
+		queuedBuffers_++;
+	}
+}
+
 void SimpleCameraData::converterInputDone(FrameBuffer *buffer)
 {
+	Request *request = buffer->request();
+
+	/* Complete passthrough buffers with their capture metadata. */
+	if (request) {
+		auto it = passthroughMetadata_.find(buffer);
+		if (it != passthroughMetadata_.end()) {
+			buffer->_d()->metadata() = it->second;
+			passthroughMetadata_.erase(it);
+		}
+
+		SimplePipelineHandler *pipe = SimpleCameraData::pipe();
+		if (pipe->completeBuffer(request, buffer))
+			pipe->completeRequest(request);
+		return;
+	}
+
 	/* Queue the input buffer back for capture. */
-	video_->queueBuffer(buffer);
+	recycleBuffer(buffer);
 }
 
 void SimpleCameraData::converterOutputDone(FrameBuffer *buffer)
@@ -827,6 +1136,190 @@ void SimpleCameraData::converterOutputDone(FrameBuffer *buffer)
 		pipe->completeRequest(request);
 }
 
+/*
+ * Load and initialize the IPA module when the software converter is used. The
+ * function can be called multiple times, only the first call has an effect.
+ */
+void SimpleCameraData::loadIPA()
+{
+	if (!softwareConverter_ || ipaLoaded_)
+		return;
+
+	ipaLoaded_ = true;
+
+	int ret = initIPA();
+	if (ret < 0) {
+		LOG(SimplePipeline, Warning)
+			<< "Failed to initialize IPA, disabling 3A";
+		ipa_.reset();
+	}
+}
+
+int SimpleCameraData::initIPA()
+{
+	ipa_ = IPAManager::createIPA<ipa::simple::IPAProxySimple>(pipe(), 0, 0);
+	if (!ipa_)
+		return -ENOENT;
+
+	ipa_->setSensorControls.connect(this, &SimpleCameraData::setSensorControls);
+	ipa_->setWhiteBalance.connect(this, &SimpleCameraData::setWhiteBalance);
+
+	int ret = ipa_->init(IPASettings{ "", sensor_->model() },
+			     sensor_->controls());
+	if (ret)
+		return ret;
+
+	softwareConverter_->statisticsReady.connect(this, &SimpleCameraData::statisticsReady);
+	softwareConverter_->setStatisticsEnabled(true);
+
+	/*
+	 * \todo Read delay values from the sensor itself or from a sensor
+	 * database. For now use the generic values of the other pipelines.
+	 */
+	std::unordered_map<uint32_t, DelayedControls::ControlParams> params = {
+		{ V4L2_CID_ANALOGUE_GAIN, { 1, false } },
+		{ V4L2_CID_EXPOSURE, { 2, false } },
+	};
+
+	delayedCtrls_ = std::make_unique<DelayedControls>(sensor_->device(), params);
+
+	return 0;
+}
+
+/*
+ * Apply the sensor controls from the frame start events when the platform
+ * provides them, to ensure that the controls computed by the IPA are applied
+ * to the intended frame. Otherwise the controls are written as soon as the IPA
+ * provides them.
+ */
+void SimpleCameraData::startDelayedControls()
+{
+	if (!delayedCtrls_)
+		return;
+
+	delayedCtrls_->reset();
+	delayedCtrls_->resetStatistics();
+	delayedCtrls_->setLatencyLimit({});
+
+	frameStartSequence_.reset();
+	frameStartOffset_.reset();
+
+	/*
+	 * Frame start events are emitted by the video node or the CSI-2
+	 * receiver, depending on the platform.
+	 */
+	int ret = delayedCtrls_->enableFrameStart(video_);
+	for (const Entity &e : entities_) {
+		if (!ret)
+			break;
+
+		V4L2Subdevice *subdev = pipe()->subdev(e.entity);
+		if (subdev && subdev != sensor_->device()) {
+			ret = delayedCtrls_->enableFrameStart(subdev);
+			if (!ret)
+				frameStartSubdev_ = subdev;
+		}
+	}
+
+	if (ret) {
+		LOG(SimplePipeline, Debug)
+			<< "Frame start events not supported, sensor controls will be applied immediately";
+		return;
+	}
+
+	/*
+	 * Track the subdevice frame start sequence to translate the captured
+	 * buffers sequence numbers when looking up the sensor controls.
+	 */
+	if (frameStartSubdev_)
+		frameStartSubdev_->frameStart.connect(this, &SimpleCameraData::frameStarted);
+
+	/* Writes must complete within the vertical blanking to be on time. */
+	IPACameraSensorInfo info{};
+	ControlList ctrls = sensor_->getControls({ V4L2_CID_VBLANK });
+	if (!ctrls.empty() && !sensor_->sensorInfo(&info) && info.pixelRate) {
+		int32_t vblank = ctrls.get(V4L2_CID_VBLANK).get<int32_t>();
+		delayedCtrls_->setLatencyLimit(vblank * info.minLineLength * 1.0s /
+					       info.pixelRate);
+	}
+}
+
+void SimpleCameraData::stopDelayedControls()
+{
+	if (!delayedCtrls_ || !delayedCtrls_->frameStartEnabled())
+		return;
+
+	delayedCtrls_->disableFrameStart();
+
+	if (frameStartSubdev_) {
+		frameStartSubdev_->frameStart.disconnect(this, &SimpleCameraData::frameStarted);
+		frameStartSubdev_ = nullptr;
+	}
+
+	const DelayedControls::Statistics &stats = delayedCtrls_->statistics();
+	if (!stats.frames)
+		return;
+
+	LOG(SimplePipeline, Debug)
+		<< "Sensor controls applied for " << stats.frames << " frames, "
+		<< stats.skipped << " skipped, " << stats.underruns
+		<< " underruns, " << stats.late << " late, average latency "
+		<< stats.totalLatency / stats.frames << ", max "
+		<< stats.maxLatency;
+}
+
+void SimpleCameraData::statisticsReady(uint32_t frame,
+				       const SoftwareConverter::Statistics &stats)
+{
+	ipa::simple::SwStatistics swStats;
+
+	swStats.histogram.assign(stats.histogram.begin(), stats.histogram.end());
+
+	for (const SoftwareConverter::Statistics::Zone &zone : stats.zones) {
+		swStats.zoneRed.push_back(zone.red);
+		swStats.zoneGreen.push_back(zone.green);
+		swStats.zoneBlue.push_back(zone.blue);
+		swStats.zoneCount.push_back(zone.count);
+	}
+
+	swStats.sharpness = stats.sharpness;
+
+	/*
+	 * When the sensor controls are applied at frame start, report the
+	 * controls the frame has been captured with. Otherwise the controls
+	 * read from the sensor may not be the ones of the frame.
+	 */
+	ControlList sensorControls;
+	if (delayedCtrls_ && delayedCtrls_->frameStartEnabled())
+		sensorControls = delayedCtrls_->get(frame + frameStartOffset_.value_or(0)).first;
+	else
+		sensorControls = sensor_->getControls({ V4L2_CID_EXPOSURE,
+							V4L2_CID_ANALOGUE_GAIN });
+
+	ipa_->processStats(frame, swStats, sensorControls);
+}
+
+void SimpleCameraData::frameStarted(uint32_t sequence)
+{
+	frameStartSequence_ = sequence;
+}
+
+void SimpleCameraData::setSensorControls(const ControlList &sensorControls)
+{
+	if (delayedCtrls_ && delayedCtrls_->frameStartEnabled()) {
+		delayedCtrls_->push(sensorControls);
+		return;
+	}
+
+	ControlList ctrls(sensorControls);
+	sensor_->setControls(&ctrls);
+}
+
+void SimpleCameraData::setWhiteBalance(float redGain, float blueGain)
+{
+	softwareConverter_->setColourGains(redGain, blueGain);
+}
+
 /* Retrieve all source pads connected to a sink pad through active routes. */
 std::vector<const MediaPad *> SimpleCameraData::routedSourcePads(MediaPad *sink)
 {
@@ -893,6 +1386,63 @@ CameraConfiguration::Status SimpleCameraConfiguration::validate()
 		status = Adjusted;
 	}
 
+	/*
+	 * Applications commonly validate the same stream configurations
+	 * repeatedly, and validation involves format negotiation with the
+	 * video device. Reuse the result of a previous validation when the
+	 * requested formats and sizes are identical.
+	 */
+	SimpleCameraData::ValidationKey key;
+	for (const StreamConfiguration &cfg : config_)
+		key.emplace_back(cfg.pixelFormat, cfg.size);
+
+	std::optional<SimpleCameraData::Validation> validation =
+		data_->cachedValidation(key);
+
+	if (!validation) {
+		Status ret = validateStreams();
+		if (ret == Invalid)
+			return Invalid;
+
+		validation.emplace();
+		validation->status = ret;
+		validation->pipeConfig = pipeConfig_;
+		validation->needConversion = needConversion_;
+		validation->passthroughStream = passthroughStream_;
+
+		for (const StreamConfiguration &cfg : config_)
+			validation->streams.push_back({ cfg.pixelFormat, cfg.size,
+							cfg.stride, cfg.frameSize,
+							cfg.bufferCount });
+
+		data_->cacheValidation(std::move(key), *validation);
+	} else {
+		pipeConfig_ = validation->pipeConfig;
+		needConversion_ = validation->needConversion;
+		passthroughStream_ = validation->passthroughStream;
+
+		for (unsigned int i = 0; i < config_.size(); ++i) {
+			StreamConfiguration &cfg = config_[i];
+			const auto &stream = validation->streams[i];
+
+			cfg.pixelFormat = stream.pixelFormat;
+			cfg.size = stream.size;
+			cfg.stride = stream.stride;
+			cfg.frameSize = stream.frameSize;
+			cfg.bufferCount = stream.bufferCount;
+		}
+	}
+
+	if (validation->status == Adjusted)
+		status = Adjusted;
+
+	return status;
+}
+
+CameraConfiguration::Status SimpleCameraConfiguration::validateStreams()
+{
+	Status status = Valid;
+
 	/* Find the largest stream size. */
 	Size maxStreamSize;
 	for (const StreamConfiguration &cfg : config_)
@@ -963,23 +1513,29 @@ CameraConfiguration::Status SimpleCameraConfiguration::validate()
 	 * Enable usage of the converter when producing multiple streams, as
 	 * the video capture device can't capture to multiple buffers.
 	 *
-	 * It is possible to produce up to one stream without conversion
-	 * (provided the format and size match), at the expense of more complex
-	 * buffer handling (including allocation of internal buffers to be used
-	 * when a request doesn't contain a buffer for the stream that doesn't
-	 * require any conversion, similar to raw capture use cases). This is
-	 * left as a future improvement.
+	 * Up to one stream can be produced without conversion, provided its
+	 * format and size match the capture format and size. Its buffers are
+	 * then captured to directly, and used as the converter input for the
+	 * other streams. Requests that don't contain a buffer for that stream
+	 * are captured to internal buffers.
 	 */
 	needConversion_ = config_.size() > 1;
+	passthroughStream_.reset();
 
 	for (unsigned int i = 0; i < config_.size(); ++i) {
 		StreamConfiguration &cfg = config_[i];
 
-		/* Adjust the pixel format and size. */
+		/*
+		 * Adjust the pixel format and size. A format that can't be
+		 * converted can only be produced by a single passthrough
+		 * stream.
+		 */
 		auto it = std::find(pipeConfig_->outputFormats.begin(),
 				    pipeConfig_->outputFormats.end(),
 				    cfg.pixelFormat);
-		if (it == pipeConfig_->outputFormats.end())
+		if (it == pipeConfig_->outputFormats.end() ||
+		    (pipeConfig_->captureOnly && *it == pipeConfig_->captureFormat &&
+		     passthroughStream_))
 			it = pipeConfig_->outputFormats.begin();
 
 		PixelFormat pixelFormat = *it;
@@ -989,7 +1545,7 @@ CameraConfiguration::Status SimpleCameraConfiguration::validate()
 			status = Adjusted;
 		}
 
-		if (!pipeConfig_->outputSizes.contains(cfg.size)) {
+		if (!pipeConfig_->sizes(cfg.pixelFormat).contains(cfg.size)) {
 			LOG(SimplePipeline, Debug)
 				<< "Adjusting size from " << cfg.size
 				<< " to " << pipeConfig_->captureSize;
@@ -1001,9 +1557,18 @@ CameraConfiguration::Status SimpleCameraConfiguration::validate()
 		if (cfg.pixelFormat != pipeConfig_->captureFormat ||
 		    cfg.size != pipeConfig_->captureSize)
 			needConversion_ = true;
+		else if (!passthroughStream_)
+			passthroughStream_ = i;
+	}
+
+	if (!needConversion_)
+		passthroughStream_.reset();
+
+	for (unsigned int i = 0; i < config_.size(); ++i) {
+		StreamConfiguration &cfg = config_[i];
 
 		/* Set the stride, frameSize and bufferCount. */
-		if (needConversion_) {
+		if (needConversion_ && passthroughStream_ != i) {
 			std::tie(cfg.stride, cfg.frameSize) =
 				data_->converter_->strideAndFrameSize(cfg.pixelFormat,
 								      cfg.size);
@@ -1052,7 +1617,7 @@ SimplePipelineHandler::generateConfiguration(Camera *camera, const StreamRoles &
 
 	for (const SimpleCameraData::Configuration &cfg : data->configs_) {
 		for (PixelFormat format : cfg.outputFormats)
-			formats[format].push_back(cfg.outputSizes);
+			formats[format].push_back(cfg.sizes(format));
 	}
 
 	/* Sort the sizes and merge any consecutive overlapping ranges. */
@@ -1077,15 +1642,26 @@ SimplePipelineHandler::generateConfiguration(Camera *camera, const StreamRoles &
 	}
 
 	/*
-	 * Create the stream configurations. Take the first entry in the formats
-	 * map as the default, for lack of a better option.
+	 * Create the stream configurations. Take the first processed format in
+	 * the formats map as the default, for lack of a better option, or the
+	 * first format if all formats are raw.
 	 *
 	 * \todo Implement a better way to pick the default format
 	 */
+	auto defaultFormat = std::find_if(formats.begin(), formats.end(),
+					  [](const auto &format) {
+						  const PixelFormatInfo &info =
+							  PixelFormatInfo::info(format.first);
+						  return info.colourEncoding !=
+							 PixelFormatInfo::ColourEncodingRAW;
+					  });
+	if (defaultFormat == formats.end())
+		defaultFormat = formats.begin();
+
 	for ([[maybe_unused]] StreamRole role : roles) {
 		StreamConfiguration cfg{ StreamFormats{ formats } };
-		cfg.pixelFormat = formats.begin()->first;
-		cfg.size = formats.begin()->second[0].max;
+		cfg.pixelFormat = defaultFormat->first;
+		cfg.size = defaultFormat->second[0].max;
 
 		config->addConfiguration(cfg);
 	}
@@ -1149,12 +1725,27 @@ int SimplePipelineHandler::configure(Camera *camera, CameraConfiguration *c)
 	/* Configure the converter if needed. */
 	std::vector<std::reference_wrapper<StreamConfiguration>> outputCfgs;
 	data->useConverter_ = config->needConversion();
+	data->passthroughStream_ = nullptr;
+
+	/*
+	 * The converter input buffers are the internal buffers and the
+	 * buffers of the passthrough stream, if any.
+	 */
+	unsigned int inputBufferCount = kNumInternalBuffers;
 
 	for (unsigned int i = 0; i < config->size(); ++i) {
 		StreamConfiguration &cfg = config->at(i);
 
 		cfg.setStream(&data->streams_[i]);
 
+		if (config->passthroughStream() == i) {
+			LOG(SimplePipeline, Debug)
+				<< "Stream " << i << " captured without conversion";
+			data->passthroughStream_ = &data->streams_[i];
+			inputBufferCount += cfg.bufferCount;
+			continue;
+		}
+
 		if (data->useConverter_)
 			outputCfgs.push_back(cfg);
 	}
@@ -1166,9 +1757,16 @@ int SimplePipelineHandler::configure(Camera *camera, CameraConfiguration *c)
 	inputCfg.pixelFormat = pipeConfig->captureFormat;
 	inputCfg.size = pipeConfig->captureSize;
 	inputCfg.stride = captureFormat.planes[0].bpl;
-	inputCfg.bufferCount = kNumInternalBuffers;
+	inputCfg.bufferCount = inputBufferCount;
+
+	ret = data->converter_->configure(inputCfg, outputCfgs);
+	if (ret < 0)
+		return ret;
+
+	if (data->ipa_)
+		return data->ipa_->configure(data->sensor_->controls());
 
-	return data->converter_->configure(inputCfg, outputCfgs);
+	return 0;
 }
 
 int SimplePipelineHandler::exportFrameBuffers(Camera *camera, Stream *stream,
@@ -1179,10 +1777,10 @@ int SimplePipelineHandler::exportFrameBuffers(Camera *camera, Stream *stream,
 
 	/*
 	 * Export buffers on the converter or capture video node, depending on
-	 * whether the converter is used or not.
+	 * whether the converter is used for the stream or not.
 	 */
-	if (data->useConverter_)
-		return data->converter_->exportBuffers(data->streamIndex(stream),
+	if (data->useConverter_ && stream != data->passthroughStream_)
+		return data->converter_->exportBuffers(data->converterIndex(stream),
 						       count, buffers);
 	else
 		return data->video_->exportBuffers(count, buffers);
@@ -1202,7 +1800,18 @@ int SimplePipelineHandler::start(Camera *camera, [[maybe_unused]] const ControlL
 		return -EBUSY;
 	}
 
-	if (data->useConverter_) {
+	if (data->passthroughStream_) {
+		/*
+		 * Internal buffers and passthrough stream buffers are captured
+		 * to alternately, import them all.
+		 */
+		Stream *stream = data->passthroughStream_;
+		ret = video->exportBuffers(kNumInternalBuffers,
+					   &data->converterBuffers_);
+		if (ret >= 0)
+			ret = video->importBuffers(kNumInternalBuffers +
+						   stream->configuration().bufferCount);
+	} else if (data->useConverter_) {
 		/*
 		 * When using the converter allocate a fixed number of internal
 		 * buffers.
@@ -1234,9 +1843,29 @@ int SimplePipelineHandler::start(Camera *camera, [[maybe_unused]] const ControlL
 			return ret;
 		}
 
-		/* Queue all internal buffers for capture. */
-		for (std::unique_ptr<FrameBuffer> &buffer : data->converterBuffers_)
-			video->queueBuffer(buffer.get());
+		if (data->ipa_) {
+			ret = data->ipa_->start();
+			if (ret < 0) {
+				stop(camera);
+				return ret;
+			}
+
+			data->startDelayedControls();
+		}
+
+		/*
+		 * Queue all internal buffers for capture, or make them
+		 * available for the requests that need them in passthrough
+		 * mode.
+		 */
+		for (std::unique_ptr<FrameBuffer> &buffer : data->converterBuffers_) {
+			if (data->passthroughStream_)
+				data->availableBuffers_.push(buffer.get());
+			else
+				video->queueBuffer(buffer.get());
+		}
+
+		data->queueInternalBuffers();
 	}
 
 	return 0;
@@ -1247,14 +1876,45 @@ void SimplePipelineHandler::stopDevice(Camera *camera)
 	SimpleCameraData *data = cameraData(camera);
 	V4L2VideoDevice *video = data->video_;
 
-	if (data->useConverter_)
+	if (data->useConverter_) {
 		data->converter_->stop();
 
+		/* Stop the IPA after the statistics of the last frames. */
+		if (data->ipa_) {
+			data->ipa_->stop();
+			data->stopDelayedControls();
+		}
+	}
+
 	video->streamOff();
 	video->releaseBuffers();
 
 	video->bufferReady.disconnect(data, &SimpleCameraData::bufferReady);
 
+	/*
+	 * Requests may still wait for an internal buffer to be captured to,
+	 * cancel them.
+	 */
+	while (!data->converterQueue_.empty()) {
+		Request *request = nullptr;
+		for (auto &item : data->converterQueue_.front()) {
+			FrameBuffer *buffer = item.second;
+			request = buffer->request();
+			buffer->_d()->cancel();
+			completeBuffer(request, buffer);
+		}
+		data->converterQueue_.pop();
+
+		if (request)
+			completeRequest(request);
+	}
+
+	data->availableBuffers_ = {};
+	data->queuedBuffers_ = 0;
+	data->passthroughMetadata_.clear();
+
+	for (const std::unique_ptr<FrameBuffer> &buffer : data->converterBuffers_)
+		MappingCache::instance()->release(buffer.get());
 	data->converterBuffers_.clear();
 
 	releasePipeline(data);
@@ -1266,28 +1926,52 @@ int SimplePipelineHandler::queueRequestDevice(Camera *camera, Request *request)
 	int ret;
 
 	std::map<unsigned int, FrameBuffer *> buffers;
+	bool passthrough = false;
 
 	for (auto &[stream, buffer] : request->buffers()) {
 		/*
 		 * If conversion is needed, push the buffer to the converter
 		 * queue, it will be handed to the converter in the capture
-		 * completion handler.
+		 * completion handler. The passthrough stream buffer is
+		 * captured to directly, and the other buffers of the request
+		 * are retrieved from the request when the capture completes.
 		 */
-		if (data->useConverter_) {
-			buffers.emplace(data->streamIndex(stream), buffer);
+		if (data->useConverter_ && stream != data->passthroughStream_) {
+			buffers.emplace(data->converterIndex(stream), buffer);
 		} else {
 			ret = data->video_->queueBuffer(buffer);
 			if (ret < 0)
 				return ret;
+
+			passthrough = data->useConverter_;
 		}
 	}
 
-	if (data->useConverter_)
+	if (data->useConverter_ && !passthrough) {
 		data->converterQueue_.push(std::move(buffers));
+		data->queueInternalBuffers();
+	}
 
 	return 0;
 }
 
+bool SimplePipelineHandler::acquireDevice(Camera *camera)
+{
+	cameraData(camera)->loadIPA();
+	return true;
+}
+
+void SimplePipelineHandler::prewarmCamera(std::weak_ptr<Camera> camera)
+{
+	std::shared_ptr<Camera> cam = camera.lock();
+	if (!cam)
+		return;
+
+	LOG(SimplePipeline, Debug) << "Preparing camera " << cam->id();
+
+	cameraData(cam.get())->loadIPA();
+}
+
 /* -----------------------------------------------------------------------------
  * Match and Setup
  */
@@ -1518,6 +2202,15 @@ bool SimplePipelineHandler::match(DeviceEnumerator *enumerator)
 		const std::string &id = data->sensor_->id();
 		std::shared_ptr<Camera> camera =
 			Camera::create(std::move(data), id, streams);
+
+		/*
+		 * Prepare the camera once the camera manager has started, to
+		 * avoid delaying the enumeration of the other cameras.
+		 */
+		if (lazyInit() && prewarm(camera->id()))
+			invokeMethod(&SimplePipelineHandler::prewarmCamera,
+				     ConnectionTypeQueued, std::weak_ptr<Camera>(camera));
+
 		registerCamera(std::move(camera));
 		registered = true;
 	}
@@ -80,6 +80,8 @@ public:
 
 	int exportFrameBuffers(Camera *camera, Stream *stream,
 			       std::vector<std::unique_ptr<FrameBuffer>> *buffers) override;
+	DmaHeap::DmaHeapFlags bufferPoolHeaps(Camera *camera,
+					      Stream *stream) const override;
 
 	int start(Camera *camera, const ControlList *controls) override;
 	void stopDevice(Camera *camera) override;
@@ -235,6 +237,17 @@ int PipelineHandlerUVC::exportFrameBuffers(Camera *camera, Stream *stream,
 	return data->video_->exportBuffers(count, buffers);
 }
 
+DmaHeap::DmaHeapFlags PipelineHandlerUVC::bufferPoolHeaps([[maybe_unused]] Camera *camera,
+							  [[maybe_unused]] Stream *stream) const
+{
+	/*
+	 * Application buffers are imported on the single capture video node.
+	 * The UVC driver copies frames with the CPU and doesn't need
+	 * physically contiguous memory.
+	 */
+	return DmaHeap::DmaHeapFlag::System | DmaHeap::DmaHeapFlag::UDmaBuf;
+}
+
 int PipelineHandlerUVC::start(Camera *camera, [[maybe_unused]] const ControlList *controls)
 {
 	UVCCameraData *data = cameraData(camera);
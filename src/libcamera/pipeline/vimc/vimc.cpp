@@ -90,6 +90,8 @@ public:
 
 	int exportFrameBuffers(Camera *camera, Stream *stream,
 			       std::vector<std::unique_ptr<FrameBuffer>> *buffers) override;
+	DmaHeap::DmaHeapFlags bufferPoolHeaps(Camera *camera,
+					      Stream *stream) const override;
 
 	int start(Camera *camera, const ControlList *controls) override;
 	void stopDevice(Camera *camera) override;
@@ -329,6 +331,17 @@ int PipelineHandlerVimc::exportFrameBuffers(Camera *camera, Stream *stream,
 	return data->video_->exportBuffers(count, buffers);
 }
 
+DmaHeap::DmaHeapFlags PipelineHandlerVimc::bufferPoolHeaps([[maybe_unused]] Camera *camera,
+							   [[maybe_unused]] Stream *stream) const
+{
+	/*
+	 * Application buffers are imported on the single capture video node.
+	 * The vimc driver uses vmalloc-backed videobuf2 queues and doesn't need
+	 * physically contiguous memory.
+	 */
+	return DmaHeap::DmaHeapFlag::System | DmaHeap::DmaHeapFlag::UDmaBuf;
+}
+
 int PipelineHandlerVimc::start(Camera *camera, [[maybe_unused]] const ControlList *controls)
 {
 	VimcCameraData *data = cameraData(camera);
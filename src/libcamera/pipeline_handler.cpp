@@ -7,6 +7,7 @@
 
 #include "libcamera/internal/pipeline_handler.h"
 
+#include <algorithm>
 #include <chrono>
 #include <sys/sysmacros.h>
 
@@ -67,8 +68,20 @@ LOG_DEFINE_CATEGORY(Pipeline)
  * through the PipelineHandlerFactoryBase::create() function.
  */
 PipelineHandler::PipelineHandler(CameraManager *manager)
-	: manager_(manager), useCount_(0)
+	: manager_(manager), deferQueueing_(false), lazyInit_(false),
+	  useCount_(0)
 {
+	const char *lazy = utils::secure_getenv("LIBCAMERA_LAZY_INIT");
+	if (lazy && lazy[0] != '\0')
+		lazyInit_ = true;
+
+	const char *prewarm = utils::secure_getenv("LIBCAMERA_PREWARM_CAMERAS");
+	if (lazyInit_ && prewarm) {
+		for (const auto &id : utils::split(prewarm, ",")) {
+			if (!id.empty())
+				prewarmIds_.push_back(id);
+		}
+	}
 }
 
 PipelineHandler::~PipelineHandler()
@@ -143,9 +156,11 @@ MediaDevice *PipelineHandler::acquireMediaDevice(DeviceEnumerator *enumerator,
 
 /**
  * \brief Acquire exclusive access to the pipeline handler for the process
+ * \param[in] camera The camera being acquired
  *
  * This function locks all the media devices used by the pipeline to ensure
- * that no other process can access them concurrently.
+ * that no other process can access them concurrently, and then prepares the
+ * \a camera for use with acquireDevice().
  *
  * Access to a pipeline handler may be acquired recursively from within the
  * same process. Every successful acquire() call shall be matched with a
@@ -158,26 +173,48 @@ MediaDevice *PipelineHandler::acquireMediaDevice(DeviceEnumerator *enumerator,
  * \context This function is \threadsafe.
  *
  * \return True if the pipeline handler was acquired, false if another process
- * has already acquired it
+ * has already acquired it or if the camera couldn't be prepared
  * \sa release()
  */
-bool PipelineHandler::acquire()
+bool PipelineHandler::acquire(Camera *camera)
 {
-	MutexLocker locker(lock_);
+	{
+		MutexLocker locker(lock_);
+
+		if (!useCount_) {
+			for (std::shared_ptr<MediaDevice> &media : mediaDevices_) {
+				if (!media->lock()) {
+					unlockMediaDevices();
+					return false;
+				}
+			}
+		}
 
-	if (useCount_) {
 		++useCount_;
-		return true;
 	}
 
-	for (std::shared_ptr<MediaDevice> &media : mediaDevices_) {
-		if (!media->lock()) {
+	/*
+	 * Without lazy initialization there's nothing to prepare, skip the
+	 * round trip to the pipeline handler thread.
+	 */
+	if (!lazyInit_)
+		return true;
+
+	/*
+	 * Prepare the camera in the pipeline handler thread, as it may create
+	 * objects bound to the thread they're created in.
+	 */
+	bool ret = invokeMethod(&PipelineHandler::acquireDevice,
+				ConnectionTypeBlocking, camera);
+	if (!ret) {
+		MutexLocker locker(lock_);
+
+		if (!--useCount_)
 			unlockMediaDevices();
-			return false;
-		}
+
+		return false;
 	}
 
-	++useCount_;
 	return true;
 }
 
@@ -210,6 +247,29 @@ void PipelineHandler::release(Camera *camera)
 	--useCount_;
 }
 
+/**
+ * \brief Prepare a camera for use when it is acquired
+ * \param[in] camera The camera being acquired
+ *
+ * Pipeline handlers may override this function to perform the parts of the
+ * camera initialization they have deferred until the camera is used, such as
+ * loading the IPA module. The function is only called when lazyInit() is
+ * enabled, in the pipeline handler thread, every time the \a camera is
+ * acquired, and shall thus return immediately if the camera has already been
+ * prepared.
+ *
+ * Only the initialization steps that don't affect the camera properties and
+ * controls can be deferred, as applications can query them before acquiring
+ * the camera. This excludes IPA modules whose init() function reports the
+ * controls supported by the camera.
+ *
+ * \return True if the camera is ready for use, false otherwise
+ */
+bool PipelineHandler::acquireDevice([[maybe_unused]] Camera *camera)
+{
+	return true;
+}
+
 /**
  * \brief Release resources associated with this camera
  * \param[in] camera The camera for which to release resources
@@ -221,6 +281,41 @@ void PipelineHandler::releaseDevice([[maybe_unused]] Camera *camera)
 {
 }
 
+/**
+ * \fn PipelineHandler::lazyInit()
+ * \brief Check if cameras should be initialized lazily
+ *
+ * Lazy initialization is enabled by setting the LIBCAMERA_LAZY_INIT environment
+ * variable to a non-empty string. When enabled, pipeline handlers that support
+ * it register cameras with the information required to enumerate them and
+ * report their properties, and defer the rest of the initialization to
+ * acquireDevice(). This lowers the cost of starting the camera manager when
+ * applications only use a subset of the cameras.
+ *
+ * \return True if lazy initialization is enabled, false otherwise
+ */
+
+/**
+ * \brief Check if a lazily initialized camera should be prepared in advance
+ * \param[in] id The camera ID
+ *
+ * When lazy initialization is enabled, the cameras listed in the comma-separated
+ * LIBCAMERA_PREWARM_CAMERAS environment variable, or all cameras if the
+ * variable contains '*', should be prepared in the background once the camera
+ * manager has started, to avoid the initialization latency when they're
+ * acquired.
+ *
+ * \return True if the camera \a id should be prepared in advance, false
+ * otherwise
+ */
+bool PipelineHandler::prewarm(const std::string &id) const
+{
+	return std::any_of(prewarmIds_.begin(), prewarmIds_.end(),
+			   [&](const std::string &prewarmId) {
+				   return prewarmId == "*" || prewarmId == id;
+			   });
+}
+
 void PipelineHandler::unlockMediaDevices()
 {
 	for (std::shared_ptr<MediaDevice> &media : mediaDevices_)
@@ -299,6 +394,41 @@ void PipelineHandler::unlockMediaDevices()
  * otherwise
  */
 
+/**
+ * \brief Retrieve the dma-heaps to allocate buffers for a stream from
+ * \param[in] camera The camera
+ * \param[in] stream The stream
+ *
+ * When this function returns a non-empty set of heaps,
+ * Camera::exportFrameBuffers() allocates the buffers for \a stream from the
+ * camera's BufferPool instead of calling exportFrameBuffers(). Pooled buffers
+ * are dma-heap allocations that survive stop and configure cycles, avoiding
+ * reallocation of the buffers on every configuration change. The pool uses the
+ * first available heap among the returned ones, in the order of the
+ * DmaHeap::DmaHeapFlag enumeration.
+ *
+ * Pipeline handlers shall only return heaps for streams whose buffers are
+ * imported with V4L2VideoDevice::importBuffers(), and whose device accepts
+ * all colour planes stored contiguously in a single dmabuf, laid out
+ * according to the StreamConfiguration pixel format, size and stride. The
+ * scarce CMA heap shall only be requested by pipeline handlers whose device
+ * requires physically contiguous memory.
+ *
+ * The default implementation returns no heap, disabling the buffer pool.
+ *
+ * \context This function is called from the application thread, and shall
+ * not access state modified by the CameraManager thread other than the stream
+ * configuration.
+ *
+ * \return The dma-heaps suitable for \a stream, or an empty set if the buffer
+ * pool can't be used for \a stream
+ */
+DmaHeap::DmaHeapFlags PipelineHandler::bufferPoolHeaps([[maybe_unused]] Camera *camera,
+						       [[maybe_unused]] Stream *stream) const
+{
+	return {};
+}
+
 /**
  * \fn PipelineHandler::start()
  * \brief Start capturing from a group of streams
@@ -338,6 +468,9 @@ void PipelineHandler::stop(Camera *camera)
 		completeRequest(request);
 	}
 
+	/* Report the completed requests before returning to the application. */
+	flushCompletedRequests(camera->shared_from_this());
+
 	/* Make sure no requests are pending. */
 	Camera::Private *data = camera->_d();
 	ASSERT(data->queuedRequests_.empty());
@@ -418,9 +551,43 @@ void PipelineHandler::queueRequest(Request *request)
 }
 
 /**
- * \brief Queue one requests to the device
+ * \brief Queue a batch of requests
+ * \param[in] requests The requests to queue
+ *
+ * This function queues multiple capture requests to the pipeline handler, in
+ * order, as queueRequest() does for a single request. Requests that are
+ * prepared synchronously are passed to the pipeline handler together through a
+ * single call to queueRequestsDevice(), allowing the pipeline handler to
+ * program the device for several frames at once.
+ *
+ * \context This function is called from the CameraManager thread.
+ */
+void PipelineHandler::queueRequests(const std::vector<Request *> &requests)
+{
+	/*
+	 * Defer queuing to the device until all requests have been prepared,
+	 * to queue them in as few batches as possible.
+	 */
+	deferQueueing_ = true;
+
+	for (Request *request : requests)
+		queueRequest(request);
+
+	deferQueueing_ = false;
+
+	doQueueRequests();
+}
+
+/**
+ * \brief Prepare one request for queuing to the device
+ *
+ * Add the request to the camera queued requests list and assign it a sequence
+ * number. Requests that have been cancelled during preparation are completed
+ * immediately.
+ *
+ * \return True if the request shall be queued to the device, false otherwise
  */
-void PipelineHandler::doQueueRequest(Request *request)
+bool PipelineHandler::doQueueRequest(Request *request)
 {
 	LIBCAMERA_TRACEPOINT(request_device_queue, request);
 
@@ -432,31 +599,49 @@ void PipelineHandler::doQueueRequest(Request *request)
 
 	if (request->_d()->cancelled_) {
 		completeRequest(request);
-		return;
+		return false;
 	}
 
-	int ret = queueRequestDevice(camera, request);
-	if (ret) {
-		request->_d()->cancel();
-		completeRequest(request);
-	}
+	return true;
 }
 
 /**
  * \brief Queue prepared requests to the device
  *
- * Iterate the list of waiting requests and queue them to the device one
- * by one if they have been prepared.
+ * Iterate the list of waiting requests and queue them to the device if they
+ * have been prepared. Consecutive prepared requests for the same camera are
+ * queued together with queueRequestsDevice().
  */
 void PipelineHandler::doQueueRequests()
 {
+	if (deferQueueing_)
+		return;
+
+	std::vector<Request *> batch;
+
 	while (!waitingRequests_.empty()) {
-		Request *request = waitingRequests_.front();
-		if (!request->_d()->prepared_)
-			break;
+		Camera *camera = waitingRequests_.front()->_d()->camera();
 
-		doQueueRequest(request);
-		waitingRequests_.pop();
+		batch.clear();
+
+		while (!waitingRequests_.empty()) {
+			Request *request = waitingRequests_.front();
+			if (!request->_d()->prepared_ ||
+			    request->_d()->camera() != camera)
+				break;
+
+			waitingRequests_.pop();
+
+			if (doQueueRequest(request))
+				batch.push_back(request);
+		}
+
+		if (!batch.empty())
+			queueRequestsDevice(camera, batch);
+
+		if (!waitingRequests_.empty() &&
+		    !waitingRequests_.front()->_d()->prepared_)
+			break;
 	}
 }
 
@@ -477,6 +662,34 @@ void PipelineHandler::doQueueRequests()
  * \return 0 on success or a negative error code otherwise
  */
 
+/**
+ * \brief Queue a batch of requests to the device
+ * \param[in] camera The camera to queue the requests to
+ * \param[in] requests The requests to queue, in submission order
+ *
+ * This function queues multiple capture requests to the device for processing.
+ * It is called with all the consecutive requests that are ready to be queued
+ * to the same camera, which allows pipeline handlers to program the device for
+ * several frames at once.
+ *
+ * The default implementation calls queueRequestDevice() for each request, and
+ * cancels and completes the requests that fail to be queued. Pipeline handlers
+ * that override this function shall handle queuing errors in the same way.
+ *
+ * \context This function is called from the CameraManager thread.
+ */
+void PipelineHandler::queueRequestsDevice(Camera *camera,
+					  Span<Request *const> requests)
+{
+	for (Request *request : requests) {
+		int ret = queueRequestDevice(camera, request);
+		if (ret) {
+			request->_d()->cancel();
+			completeRequest(request);
+		}
+	}
+}
+
 /**
  * \brief Complete a buffer for a request
  * \param[in] request The request the buffer belongs to
@@ -513,6 +726,11 @@ bool PipelineHandler::completeBuffer(Request *request, FrameBuffer *buffer)
  * submission order, the pipeline handler may call it on any complete request
  * without any ordering constraint.
  *
+ * If the requestsCompleted signal of the \a camera has no receiver, the
+ * requestCompleted signal is emitted immediately. Otherwise, the requests
+ * completed during the same event loop iteration are collected and reported
+ * together when control returns to the event loop.
+ *
  * \context This function shall be called from the CameraManager thread.
  */
 void PipelineHandler::completeRequest(Request *request)
@@ -530,10 +748,58 @@ void PipelineHandler::completeRequest(Request *request)
 
 		ASSERT(!req->hasPendingBuffers());
 		data->queuedRequests_.pop_front();
-		camera->requestComplete(req);
+
+		/*
+		 * Collect the completed requests until control returns to the
+		 * event loop, to report all the requests completed by the
+		 * pipeline handler in a single requestsCompleted signal. Once
+		 * a batch has been started, keep adding to it to preserve the
+		 * completion order.
+		 */
+		if (!data->completedRequests_ &&
+		    !camera->requestsCompleted.connected()) {
+			camera->requestComplete(req);
+			continue;
+		}
+
+		/* Reuse the previous batch if no receiver holds it anymore. */
+		if (!data->completedRequests_) {
+			if (data->completedBatch_ && data->completedBatch_.use_count() == 1) {
+				data->completedRequests_ = std::move(data->completedBatch_);
+				data->completedRequests_->clear();
+			} else {
+				data->completedRequests_ = std::make_shared<std::vector<Request *>>();
+			}
+
+			invokeMethod(&PipelineHandler::flushCompletedRequests,
+				     ConnectionTypeQueued, camera->shared_from_this());
+		}
+
+		data->completedRequests_->push_back(req);
 	}
 }
 
+/*
+ * Report the requests completed since the last call through the
+ * requestsCompleted signal of the \a camera, and then through the
+ * requestCompleted signal for each request. The requests are returned to the
+ * application by the latter only, which guarantees they are valid when the
+ * batch is reported.
+ */
+void PipelineHandler::flushCompletedRequests(std::shared_ptr<Camera> camera)
+{
+	Camera::Private *data = camera->_d();
+
+	if (!data->completedRequests_)
+		return;
+
+	data->completedBatch_ = std::move(data->completedRequests_);
+	camera->requestsComplete(data->completedBatch_);
+
+	for (Request *request : *data->completedBatch_)
+		camera->requestComplete(request);
+}
+
 /**
  * \brief Register a camera to the camera manager and pipeline handler
  * \param[in] camera The camera to be added
@@ -135,8 +135,7 @@ void Request::Private::doCancelRequest()
 
 	cancelled_ = true;
 	pending_.clear();
-	notifiers_.clear();
-	timer_.reset();
+	cancelFences();
 }
 
 /**
@@ -169,8 +168,27 @@ void Request::Private::reset()
 	cancelled_ = false;
 	prepared_ = false;
 	pending_.clear();
-	notifiers_.clear();
-	timer_.reset();
+	cancelFences();
+}
+
+/*
+ * Cancel the wait on all pending fences, and the associated timeout. The fences
+ * stay attached to their buffers.
+ *
+ * This function may be called from the application thread when the request is
+ * reused or destroyed, while the fence waiter is bound to the pipeline handler
+ * thread. Cancel the waits synchronously in that thread, which also guarantees
+ * that no fence notification is delivered after this function returns.
+ */
+void Request::Private::cancelFences()
+{
+	if (!pendingFences_)
+		return;
+
+	FenceWaiter *waiter = camera_->_d()->fenceWaiter();
+	waiter->invokeMethod(&FenceWaiter::cancel, ConnectionTypeBlocking,
+			     static_cast<FenceWaiter::Listener *>(this));
+	pendingFences_ = 0;
 }
 
 /*
@@ -215,39 +233,39 @@ void Request::Private::emitPrepareCompleted()
  */
 void Request::Private::prepare(std::chrono::milliseconds timeout)
 {
-	/* Create and connect one notifier for each synchronization fence. */
+	FenceWaiter *waiter = nullptr;
+
+	/*
+	 * Wait on each synchronization fence through the camera fence waiter,
+	 * which must be retrieved here instead of in the Request constructor,
+	 * in order to be bound to the pipeline handler thread.
+	 */
 	for (FrameBuffer *buffer : pending_) {
 		const Fence *fence = buffer->_d()->fence();
 		if (!fence)
 			continue;
 
-		std::unique_ptr<EventNotifier> notifier =
-			std::make_unique<EventNotifier>(fence->fd().get(),
-							EventNotifier::Read);
+		if (!waiter)
+			waiter = camera_->_d()->fenceWaiter();
 
-		notifier->activated.connect(this, [this, buffer] {
-							notifierActivated(buffer);
-					    });
+		int ret = waiter->wait(this, buffer, fence->fd().get());
+		if (ret < 0) {
+			cancel();
+			emitPrepareCompleted();
+			return;
+		}
 
-		notifiers_[buffer] = std::move(notifier);
+		pendingFences_++;
 	}
 
-	if (notifiers_.empty()) {
+	if (!pendingFences_) {
 		emitPrepareCompleted();
 		return;
 	}
 
-	/*
-	 * In case a timeout is specified, create a timer and set it up.
-	 *
-	 * The timer must be created here instead of in the Request constructor,
-	 * in order to be bound to the pipeline handler thread.
-	 */
-	if (timeout != 0ms) {
-		timer_ = std::make_unique<Timer>();
-		timer_->timeout.connect(this, &Request::Private::timeout);
-		timer_->start(timeout);
-	}
+	/* In case a timeout is specified, set it up. */
+	if (timeout != 0ms)
+		waiter->setTimeout(this, timeout);
 }
 
 /**
@@ -263,35 +281,35 @@ void Request::Private::prepare(std::chrono::milliseconds timeout)
  * if they have failed preparing.
  */
 
-void Request::Private::notifierActivated(FrameBuffer *buffer)
+void Request::Private::fenceSignalled(FrameBuffer *buffer)
 {
 	/* Close the fence if successfully signalled. */
 	ASSERT(buffer);
 	buffer->releaseFence();
 
-	/* Remove the entry from the map and check if other fences are pending. */
-	auto it = notifiers_.find(buffer);
-	ASSERT(it != notifiers_.end());
-	notifiers_.erase(it);
+	ASSERT(pendingFences_);
+	pendingFences_--;
 
 	Request *request = _o<Request>();
 	LOG(Request, Debug)
 		<< "Request " << request->cookie() << " buffer " << buffer
 		<< " fence signalled";
 
-	if (!notifiers_.empty())
+	if (pendingFences_)
 		return;
 
-	/* All fences completed, delete the timer and emit the prepared signal. */
-	timer_.reset();
+	/*
+	 * All fences completed, the timeout has been cancelled by the fence
+	 * waiter, emit the prepared signal.
+	 */
 	emitPrepareCompleted();
 }
 
-void Request::Private::timeout()
+void Request::Private::fenceTimeout()
 {
 	/* A timeout can only happen if there are fences not yet signalled. */
-	ASSERT(!notifiers_.empty());
-	notifiers_.clear();
+	ASSERT(pendingFences_);
+	pendingFences_ = 0;
 
 	Request *request = _o<Request>();
 	LOG(Request, Debug) << "Request prepare timeout: " << request->cookie();
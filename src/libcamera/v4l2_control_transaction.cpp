@@ -0,0 +1,294 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+/*
+ * Copyright (C) 2022, Google Inc.
+ *
+ * v4l2_control_transaction.cpp - Batched V4L2 control writes across devices
+ */
+
+#include "libcamera/internal/v4l2_control_transaction.h"
+
+#include <algorithm>
+#include <errno.h>
+
+#include <libcamera/base/log.h>
+
+#include "libcamera/internal/v4l2_device.h"
+
+/**
+ * \file v4l2_control_transaction.h
+ * \brief Batched V4L2 control writes across devices
+ */
+
+namespace libcamera {
+
+LOG_DECLARE_CATEGORY(V4L2)
+
+/**
+ * \class V4L2ControlTransaction
+ * \brief Collect the V4L2 controls of multiple devices and write them at once
+ *
+ * Pipeline handlers update controls on several V4L2 devices for every frame,
+ * typically the camera sensor and the lens, from the frame start event. The
+ * time available to write the controls is limited by the vertical blanking
+ * period, and building a ControlList and issuing one ioctl per device and per
+ * caller in that context is wasteful.
+ *
+ * The V4L2ControlTransaction groups the controls by device. The set of
+ * controls is registered once with addControl(), usually when the camera is
+ * created or configured, which resolves the control types and reserves the
+ * v4l2_ext_control storage. For every frame, control values are then stored
+ * with set() and written with commit(), which issues a single
+ * VIDIOC_S_EXT_CTRLS ioctl per device that has pending controls. Controls
+ * registered with the priority flag are written first, each with a separate
+ * ioctl, as they may affect the validity of the other controls.
+ *
+ * The time spent in commit() is recorded in the statistics(), to help
+ * identifying when the control writes don't fit in the blanking period.
+ *
+ * \todo Use the V4L2 request API to write all controls atomically when the
+ * devices support it. Sensor and lens subdevice drivers don't support requests
+ * at the moment.
+ */
+
+/**
+ * \struct V4L2ControlTransaction::Statistics
+ * \brief Control write statistics
+ *
+ * \var V4L2ControlTransaction::Statistics::commits
+ * \brief Number of commit() calls that wrote at least one control
+ *
+ * \var V4L2ControlTransaction::Statistics::ioctls
+ * \brief Number of VIDIOC_S_EXT_CTRLS ioctls issued
+ *
+ * \var V4L2ControlTransaction::Statistics::controls
+ * \brief Number of controls written
+ *
+ * \var V4L2ControlTransaction::Statistics::last
+ * \brief Duration of the last commit
+ *
+ * \var V4L2ControlTransaction::Statistics::max
+ * \brief Maximum duration of a commit
+ *
+ * \var V4L2ControlTransaction::Statistics::total
+ * \brief Total duration of all commits
+ */
+
+/**
+ * \fn V4L2ControlTransaction::V4L2ControlTransaction()
+ * \brief Construct an empty V4L2ControlTransaction
+ */
+
+/**
+ * \brief Add a control to the transaction
+ * \param[in] device The V4L2 device the control belongs to
+ * \param[in] id The V4L2 control id
+ * \param[in] priority Write the control ahead of, and separately from, the
+ * other controls
+ *
+ * Adding a control that is already part of the transaction is a no-op.
+ *
+ * \return 0 on success or -EINVAL if the control isn't exposed by \a device
+ */
+int V4L2ControlTransaction::addControl(V4L2Device *device, uint32_t id,
+				       bool priority)
+{
+	if (find(device, id))
+		return 0;
+
+	const V4L2Device::ControlTableEntry *control = device->findControl(id);
+	if (!control || !control->registered) {
+		LOG(V4L2, Error)
+			<< "Control " << utils::hex(id) << " not found on "
+			<< device->deviceNode();
+		return -EINVAL;
+	}
+
+	Entry entry{ id, control->type, false, {} };
+
+	/*
+	 * Keep the priority batches, one per control, ahead of the batches
+	 * grouping the other controls per device.
+	 */
+	auto pos = std::find_if(batches_.begin(), batches_.end(),
+				[](const Batch &batch) { return !batch.priority; });
+
+	if (priority) {
+		batches_.insert(pos, { device, true, { entry } });
+	} else {
+		auto batch = std::find_if(pos, batches_.end(),
+					  [&](const Batch &b) { return b.device == device; });
+		if (batch == batches_.end())
+			batches_.push_back({ device, false, { entry } });
+		else
+			batch->entries.push_back(entry);
+	}
+
+	unsigned int count = 0;
+	for (const Batch &batch : batches_)
+		count = std::max<unsigned int>(count, batch.entries.size());
+	v4l2Ctrls_.reserve(count);
+
+	return 0;
+}
+
+/**
+ * \brief Remove all controls from the transaction
+ *
+ * The statistics are not reset.
+ */
+void V4L2ControlTransaction::clear()
+{
+	batches_.clear();
+	v4l2Ctrls_.clear();
+}
+
+/**
+ * \brief Set the value of a control for the next commit
+ * \param[in] device The V4L2 device the control belongs to
+ * \param[in] id The V4L2 control id
+ * \param[in] value The control value
+ *
+ * Setting a control multiple times before commit() overrides the previous
+ * value.
+ *
+ * \return 0 on success or -ENOENT if the control hasn't been added to the
+ * transaction
+ */
+int V4L2ControlTransaction::set(V4L2Device *device, uint32_t id,
+				const ControlValue &value)
+{
+	Entry *entry = find(device, id);
+	if (!entry) {
+		LOG(V4L2, Error)
+			<< "Control " << utils::hex(id)
+			<< " not part of the transaction";
+		return -ENOENT;
+	}
+
+	entry->value = value;
+	entry->pending = true;
+
+	return 0;
+}
+
+/**
+ * \brief Check if any control value is waiting to be written
+ * \return True if commit() has controls to write, false otherwise
+ */
+bool V4L2ControlTransaction::pending() const
+{
+	for (const Batch &batch : batches_) {
+		for (const Entry &entry : batch.entries) {
+			if (entry.pending)
+				return true;
+		}
+	}
+
+	return false;
+}
+
+/**
+ * \brief Write all pending control values to their devices
+ *
+ * Priority controls are written first, followed by the other controls with
+ * one ioctl per device. A failure to write the controls of one device doesn't
+ * prevent writing the controls of the other devices. All pending values are
+ * consumed, whether they have been written successfully or not.
+ *
+ * \return 0 on success or a negative error code if any control couldn't be
+ * written
+ */
+int V4L2ControlTransaction::commit()
+{
+	utils::time_point start = utils::clock::now();
+	unsigned int ioctls = 0;
+	int ret = 0;
+
+	for (Batch &batch : batches_) {
+		v4l2Ctrls_.clear();
+
+		for (Entry &entry : batch.entries) {
+			if (!entry.pending)
+				continue;
+
+			entry.pending = false;
+
+			struct v4l2_ext_control &v4l2Ctrl = v4l2Ctrls_.emplace_back();
+			v4l2Ctrl.id = entry.id;
+
+			int err = batch.device->setControlValue(&v4l2Ctrl, entry.type,
+								entry.value);
+			if (err) {
+				v4l2Ctrls_.pop_back();
+				ret = err;
+			}
+		}
+
+		if (v4l2Ctrls_.empty())
+			continue;
+
+		int err = batch.device->writeControls(v4l2Ctrls_);
+		if (err)
+			ret = -EINVAL;
+
+		stats_.controls += v4l2Ctrls_.size();
+		ioctls++;
+	}
+
+	if (!ioctls)
+		return ret;
+
+	utils::Duration duration = utils::clock::now() - start;
+
+	stats_.commits++;
+	stats_.ioctls += ioctls;
+	stats_.last = duration;
+	stats_.max = std::max(stats_.max, duration);
+	stats_.total += duration;
+
+	return ret;
+}
+
+/**
+ * \brief Discard all pending control values
+ *
+ * Pipeline handlers shall call this function when stopping the camera, to
+ * avoid writing stale values when the camera is restarted. The controls stay
+ * part of the transaction, unlike with clear().
+ */
+void V4L2ControlTransaction::reset()
+{
+	for (Batch &batch : batches_) {
+		for (Entry &entry : batch.entries)
+			entry.pending = false;
+	}
+}
+
+/**
+ * \fn V4L2ControlTransaction::statistics()
+ * \brief Retrieve the control write statistics
+ * \return The control write statistics
+ */
+
+/**
+ * \fn V4L2ControlTransaction::resetStatistics()
+ * \brief Reset the control write statistics
+ */
+
+V4L2ControlTransaction::Entry *V4L2ControlTransaction::find(V4L2Device *device,
+							    uint32_t id)
+{
+	for (Batch &batch : batches_) {
+		if (batch.device != device)
+			continue;
+
+		for (Entry &entry : batch.entries) {
+			if (entry.id == id)
+				return &entry;
+		}
+	}
+
+	return nullptr;
+}
+
+} /* namespace libcamera */
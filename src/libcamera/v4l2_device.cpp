@@ -7,6 +7,7 @@
 
 #include "libcamera/internal/v4l2_device.h"
 
+#include <algorithm>
 #include <fcntl.h>
 #include <iomanip>
 #include <limits.h>
@@ -182,8 +183,8 @@ ControlList V4L2Device::getControls(const std::vector<uint32_t> &ids)
 	ControlList ctrls{ controls_ };
 
 	for (uint32_t id : ids) {
-		const auto iter = controls_.find(id);
-		if (iter == controls_.end()) {
+		const ControlTableEntry *entry = findControl(id);
+		if (!entry || !entry->registered) {
 			LOG(V4L2, Error)
 				<< "Control " << utils::hex(id) << " not found";
 			return {};
@@ -192,38 +193,30 @@ ControlList V4L2Device::getControls(const std::vector<uint32_t> &ids)
 		ctrls.set(id, {});
 	}
 
-	std::vector<v4l2_ext_control> v4l2Ctrls(ids.size());
-	memset(v4l2Ctrls.data(), 0, sizeof(v4l2_ext_control) * ctrls.size());
+	std::vector<v4l2_ext_control> &v4l2Ctrls = v4l2Ctrls_;
+	v4l2Ctrls.assign(ctrls.size(), {});
 
 	unsigned int i = 0;
 	for (auto &ctrl : ctrls) {
 		unsigned int id = ctrl.first;
-		const struct v4l2_query_ext_ctrl &info = controlInfo_[id];
+		const ControlTableEntry *entry = findControl(id);
 
 		v4l2_ext_control &v4l2Ctrl = v4l2Ctrls[i++];
 		v4l2Ctrl.id = id;
 
-		if (info.flags & V4L2_CTRL_FLAG_HAS_PAYLOAD) {
-			ControlType type;
-
-			switch (info.type) {
-			case V4L2_CTRL_TYPE_U8:
-				type = ControlTypeByte;
-				break;
-
-			default:
+		if (entry->payloadSize) {
+			if (entry->type != ControlTypeByte) {
 				LOG(V4L2, Error)
 					<< "Unsupported payload control type "
-					<< info.type;
+					<< entry->info.type;
 				return {};
 			}
 
 			ControlValue &value = ctrl.second;
-			value.reserve(type, true, info.elems);
-			Span<uint8_t> data = value.data();
+			value.reserve(entry->type, true, entry->info.elems);
 
-			v4l2Ctrl.p_u8 = data.data();
-			v4l2Ctrl.size = data.size();
+			v4l2Ctrl.p_u8 = value.data().data();
+			v4l2Ctrl.size = entry->payloadSize;
 		}
 	}
 
@@ -283,13 +276,13 @@ int V4L2Device::setControls(ControlList *ctrls)
 	if (ctrls->empty())
 		return 0;
 
-	std::vector<v4l2_ext_control> v4l2Ctrls(ctrls->size());
-	memset(v4l2Ctrls.data(), 0, sizeof(v4l2_ext_control) * ctrls->size());
+	std::vector<v4l2_ext_control> &v4l2Ctrls = v4l2Ctrls_;
+	v4l2Ctrls.assign(ctrls->size(), {});
 
 	for (auto [ctrl, i] = std::pair(ctrls->begin(), 0u); i < ctrls->size(); ctrl++, i++) {
 		const unsigned int id = ctrl->first;
-		const auto iter = controls_.find(id);
-		if (iter == controls_.end()) {
+		const ControlTableEntry *entry = findControl(id);
+		if (!entry || !entry->registered) {
 			LOG(V4L2, Error)
 				<< "Control " << utils::hex(id) << " not found";
 			return -EINVAL;
@@ -298,74 +291,108 @@ int V4L2Device::setControls(ControlList *ctrls)
 		v4l2Ctrl.id = id;
 
 		/* Set the v4l2_ext_control value for the write operation. */
-		ControlValue &value = ctrl->second;
-		switch (iter->first->type()) {
-		case ControlTypeInteger32: {
-			if (value.isArray()) {
-				Span<uint8_t> data = value.data();
-				v4l2Ctrl.p_u32 = reinterpret_cast<uint32_t *>(data.data());
-				v4l2Ctrl.size = data.size();
-			} else {
-				v4l2Ctrl.value = value.get<int32_t>();
-			}
+		int ret = setControlValue(&v4l2Ctrl, entry->type, ctrl->second);
+		if (ret)
+			return ret;
+	}
 
-			break;
-		}
+	int ret = writeControls(v4l2Ctrls);
+	if (ret < 0)
+		return ret;
 
-		case ControlTypeInteger64:
-			v4l2Ctrl.value64 = value.get<int64_t>();
-			break;
+	updateControls(ctrls, Span<const v4l2_ext_control>(v4l2Ctrls)
+				      .first(ret ? ret : v4l2Ctrls.size()));
 
-		case ControlTypeByte: {
-			if (!value.isArray()) {
-				LOG(V4L2, Error)
-					<< "Control " << utils::hex(id)
-					<< " requires an array value";
-				return -EINVAL;
-			}
+	return ret;
+}
 
+/*
+ * \brief Store a control value in a v4l2_ext_control for a write operation
+ * \param[inout] v4l2Ctrl The V4L2 extended control, with its id set
+ * \param[in] type The control type
+ * \param[in] value The control value
+ *
+ * Array values are not copied, \a v4l2Ctrl points to the \a value storage.
+ *
+ * \return 0 on success or -EINVAL if the value isn't valid for the control
+ */
+int V4L2Device::setControlValue(struct v4l2_ext_control *v4l2Ctrl,
+				ControlType type, ControlValue &value) const
+{
+	switch (type) {
+	case ControlTypeInteger32: {
+		if (value.isArray()) {
 			Span<uint8_t> data = value.data();
-			v4l2Ctrl.p_u8 = data.data();
-			v4l2Ctrl.size = data.size();
-
-			break;
+			v4l2Ctrl->p_u32 = reinterpret_cast<uint32_t *>(data.data());
+			v4l2Ctrl->size = data.size();
+		} else {
+			v4l2Ctrl->value = value.get<int32_t>();
 		}
 
-		default:
-			/* \todo To be changed to support strings. */
-			v4l2Ctrl.value = value.get<int32_t>();
-			break;
+		break;
+	}
+
+	case ControlTypeInteger64:
+		v4l2Ctrl->value64 = value.get<int64_t>();
+		break;
+
+	case ControlTypeByte: {
+		if (!value.isArray()) {
+			LOG(V4L2, Error)
+				<< "Control " << utils::hex(v4l2Ctrl->id)
+				<< " requires an array value";
+			return -EINVAL;
 		}
+
+		Span<uint8_t> data = value.data();
+		v4l2Ctrl->p_u8 = data.data();
+		v4l2Ctrl->size = data.size();
+
+		break;
 	}
 
+	default:
+		/* \todo To be changed to support strings. */
+		v4l2Ctrl->value = value.get<int32_t>();
+		break;
+	}
+
+	return 0;
+}
+
+/*
+ * \brief Write V4L2 extended controls to the device with a single ioctl
+ * \param[in] v4l2Ctrls The V4L2 extended controls, with their values set
+ *
+ * \return 0 on success, -EINVAL if the controls failed validation, or the
+ * index of the first control that couldn't be written
+ */
+int V4L2Device::writeControls(Span<struct v4l2_ext_control> v4l2Ctrls)
+{
 	struct v4l2_ext_controls v4l2ExtCtrls = {};
 	v4l2ExtCtrls.which = V4L2_CTRL_WHICH_CUR_VAL;
 	v4l2ExtCtrls.controls = v4l2Ctrls.data();
 	v4l2ExtCtrls.count = v4l2Ctrls.size();
 
 	int ret = ioctl(VIDIOC_S_EXT_CTRLS, &v4l2ExtCtrls);
-	if (ret) {
-		unsigned int errorIdx = v4l2ExtCtrls.error_idx;
-
-		/* Generic validation error. */
-		if (errorIdx == 0 || errorIdx >= v4l2Ctrls.size()) {
-			LOG(V4L2, Error) << "Unable to set controls: "
-					 << strerror(-ret);
-			return -EINVAL;
-		}
+	if (!ret)
+		return 0;
 
-		/* A specific control failed. */
-		const unsigned int id = v4l2Ctrls[errorIdx].id;
-		LOG(V4L2, Error) << "Unable to set control " << utils::hex(id)
-				 << ": " << strerror(-ret);
+	unsigned int errorIdx = v4l2ExtCtrls.error_idx;
 
-		v4l2Ctrls.resize(errorIdx);
-		ret = errorIdx;
+	/* Generic validation error. */
+	if (errorIdx == 0 || errorIdx >= v4l2Ctrls.size()) {
+		LOG(V4L2, Error) << "Unable to set controls: "
+				 << strerror(-ret);
+		return -EINVAL;
 	}
 
-	updateControls(ctrls, v4l2Ctrls);
+	/* A specific control failed. */
+	const unsigned int id = v4l2Ctrls[errorIdx].id;
+	LOG(V4L2, Error) << "Unable to set control " << utils::hex(id)
+			 << ": " << strerror(-ret);
 
-	return ret;
+	return errorIdx;
 }
 
 /**
@@ -376,11 +403,11 @@ int V4L2Device::setControls(ControlList *ctrls)
  */
 const struct v4l2_query_ext_ctrl *V4L2Device::controlInfo(uint32_t id) const
 {
-	const auto it = controlInfo_.find(id);
-	if (it == controlInfo_.end())
+	const ControlTableEntry *entry = findControl(id);
+	if (!entry)
 		return nullptr;
 
-	return &it->second;
+	return &entry->info;
 }
 
 /**
@@ -445,6 +472,17 @@ int V4L2Device::setFrameStartEnabled(bool enable)
  * \brief A Signal emitted when capture of a frame has started
  */
 
+/**
+ * \fn V4L2Device::frameStartTime()
+ * \brief Retrieve the time at which capture of the last frame has started
+ *
+ * The time is reported by the kernel in the frame start event, and is valid
+ * when the frameStart signal is emitted. It can be used to measure the latency
+ * of the operations performed in response to the signal.
+ *
+ * \return The time of the last frame start event
+ */
+
 /**
  * \brief Perform an IOCTL system call on the device node
  * \param[in] request The IOCTL request code
@@ -604,6 +642,8 @@ void V4L2Device::listControls()
 	ControlInfoMap::Map ctrls;
 	struct v4l2_query_ext_ctrl ctrl = {};
 
+	controlTable_.clear();
+
 	while (1) {
 		ctrl.id |= V4L2_CTRL_FLAG_NEXT_CTRL |
 			   V4L2_CTRL_FLAG_NEXT_COMPOUND;
@@ -637,7 +677,11 @@ void V4L2Device::listControls()
 
 		controlIds_.emplace_back(v4l2ControlId(ctrl));
 		controlIdMap_[ctrl.id] = controlIds_.back().get();
-		controlInfo_.emplace(ctrl.id, ctrl);
+
+		size_t payloadSize = ctrl.flags & V4L2_CTRL_FLAG_HAS_PAYLOAD
+				   ? ctrl.elems * ctrl.elem_size : 0;
+		controlTable_.push_back({ ctrl, v4l2CtrlType(ctrl.type),
+					  payloadSize, false });
 
 		std::optional<ControlInfo> info = v4l2ControlInfo(ctrl);
 
@@ -650,9 +694,41 @@ void V4L2Device::listControls()
 		}
 
 		ctrls.emplace(controlIds_.back().get(), *info);
+		controlTable_.back().registered = true;
 	}
 
 	controls_ = ControlInfoMap(std::move(ctrls), controlIdMap_);
+
+	/*
+	 * Controls are enumerated in increasing id order, but sort the table
+	 * nonetheless as findControl() relies on it. The table isn't modified
+	 * after this point, which keeps pointers returned by controlInfo()
+	 * valid. Size the ioctl buffer to hold all controls, to avoid
+	 * allocations when reading and writing controls.
+	 */
+	std::sort(controlTable_.begin(), controlTable_.end(),
+		  [](const ControlTableEntry &a, const ControlTableEntry &b) {
+			  return a.info.id < b.info.id;
+		  });
+
+	v4l2Ctrls_.reserve(controlTable_.size());
+}
+
+/*
+ * \brief Find the entry for a control in the control table
+ * \param[in] id The V4L2 control id
+ * \return The control table entry, or nullptr if the control isn't supported
+ */
+const V4L2Device::ControlTableEntry *V4L2Device::findControl(uint32_t id) const
+{
+	auto it = std::lower_bound(controlTable_.begin(), controlTable_.end(), id,
+				   [](const ControlTableEntry &entry, uint32_t value) {
+					   return entry.info.id < value;
+				   });
+	if (it == controlTable_.end() || it->info.id != id)
+		return nullptr;
+
+	return &*it;
 }
 
 /**
@@ -672,14 +748,12 @@ void V4L2Device::listControls()
  */
 void V4L2Device::updateControlInfo()
 {
-	for (auto &[controlId, info] : controls_) {
-		unsigned int id = controlId->id();
+	for (ControlTableEntry &entry : controlTable_) {
+		if (!entry.registered)
+			continue;
 
-		/*
-		 * Assume controlInfo_ has a corresponding entry, as it has been
-		 * generated by listControls().
-		 */
-		struct v4l2_query_ext_ctrl &ctrl = controlInfo_[id];
+		struct v4l2_query_ext_ctrl &ctrl = entry.info;
+		unsigned int id = ctrl.id;
 
 		if (ioctl(VIDIOC_QUERY_EXT_CTRL, &ctrl)) {
 			LOG(V4L2, Debug)
@@ -688,7 +762,10 @@ void V4L2Device::updateControlInfo()
 			continue;
 		}
 
-		info = *v4l2ControlInfo(ctrl);
+		if (ctrl.flags & V4L2_CTRL_FLAG_HAS_PAYLOAD)
+			entry.payloadSize = ctrl.elems * ctrl.elem_size;
+
+		controls_.find(id)->second = *v4l2ControlInfo(ctrl);
 	}
 }
 
@@ -714,10 +791,10 @@ void V4L2Device::updateControls(ControlList *ctrls,
 			continue;
 		}
 
-		const auto iter = controls_.find(id);
-		ASSERT(iter != controls_.end());
+		const ControlTableEntry *entry = findControl(id);
+		ASSERT(entry);
 
-		switch (iter->first->type()) {
+		switch (entry->type) {
 		case ControlTypeInteger64:
 			value.set<int64_t>(v4l2Ctrl.value64);
 			break;
@@ -762,6 +839,10 @@ void V4L2Device::eventAvailable()
 		return;
 	}
 
+	/* V4L2 events are timestamped with CLOCK_MONOTONIC. */
+	frameStartTime_ = utils::time_point(std::chrono::seconds(event.timestamp.tv_sec) +
+					    std::chrono::nanoseconds(event.timestamp.tv_nsec));
+
 	frameStart.emit(event.u.frame_sync.frame_sequence);
 }
 
@@ -0,0 +1,223 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Copyright (C) 2022, Google Inc.
+ *
+ * buffer-pool.cpp - BufferPool tests
+ */
+
+#include <iostream>
+#include <memory>
+#include <vector>
+
+#include <libcamera/formats.h>
+#include <libcamera/framebuffer.h>
+#include <libcamera/stream.h>
+
+#include "libcamera/internal/buffer_pool.h"
+#include "libcamera/internal/mapped_framebuffer.h"
+
+#include "test.h"
+
+using namespace libcamera;
+using namespace std;
+
+namespace {
+
+class BufferPoolTest : public Test
+{
+protected:
+	int init() override
+	{
+		/* Prefer udmabuf when available, memfd otherwise. */
+		pool_ = std::make_shared<BufferPool>(DmaHeap::DmaHeapFlag::UDmaBuf |
+						     DmaHeap::DmaHeapFlag::MemFd);
+		if (!pool_->isValid()) {
+			cerr << "Failed to create buffer pool" << endl;
+			return TestFail;
+		}
+
+		return TestPass;
+	}
+
+	int testSizeClass()
+	{
+		if (BufferPool::sizeClass(1) != BufferPool::sizeClass(4096)) {
+			cerr << "Sizes not rounded to pages" << endl;
+			return TestFail;
+		}
+
+		for (size_t size : { 4096UL, 100000UL, 640UL * 480 * 3 / 2,
+				     3840UL * 2160 * 3 / 2, 12345678UL }) {
+			size_t sizeClass = BufferPool::sizeClass(size);
+			if (sizeClass < size || sizeClass > size + size / 8 + 4096) {
+				cerr << "Invalid size class " << sizeClass
+				     << " for size " << size << endl;
+				return TestFail;
+			}
+		}
+
+		return TestPass;
+	}
+
+	int testAllocation()
+	{
+		StreamConfiguration cfg;
+		cfg.pixelFormat = formats::NV12;
+		cfg.size = { 640, 480 };
+		cfg.stride = 640;
+		cfg.frameSize = 640 * 480 * 3 / 2;
+		cfg.bufferCount = 4;
+
+		std::vector<std::unique_ptr<FrameBuffer>> buffers;
+		int ret = pool_->allocate(cfg, &buffers);
+		if (ret != static_cast<int>(cfg.bufferCount) ||
+		    buffers.size() != cfg.bufferCount) {
+			cerr << "Failed to allocate buffers" << endl;
+			return TestFail;
+		}
+
+		const std::vector<FrameBuffer::Plane> &planes = buffers[0]->planes();
+		if (planes.size() != 2 ||
+		    planes[0].offset != 0 || planes[0].length != 640 * 480 ||
+		    planes[1].offset != 640 * 480 || planes[1].length != 640 * 240 ||
+		    planes[0].fd != planes[1].fd) {
+			cerr << "Invalid plane layout" << endl;
+			return TestFail;
+		}
+
+		MappedFrameBuffer map(buffers[0].get(),
+				      MappedFrameBuffer::MapFlag::ReadWrite);
+		if (!map.isValid()) {
+			cerr << "Failed to map buffer" << endl;
+			return TestFail;
+		}
+
+		map.planes()[1][640 * 240 - 1] = 0x42;
+
+		BufferPool::Statistics stats = pool_->statistics();
+		if (stats.misses != cfg.bufferCount || stats.hits != 0) {
+			cerr << "Unexpected statistics after allocation" << endl;
+			return TestFail;
+		}
+
+		/* Freeing the buffers returns their memory to the pool. */
+		buffers.clear();
+
+		stats = pool_->statistics();
+		if (stats.idle != cfg.bufferCount ||
+		    stats.idleSize != cfg.bufferCount * BufferPool::sizeClass(cfg.frameSize)) {
+			cerr << "Freed buffers not kept idle" << endl;
+			return TestFail;
+		}
+
+		/* A slightly different configuration reuses the same memory. */
+		cfg.size = { 640, 472 };
+		cfg.frameSize = 640 * 472 * 3 / 2;
+
+		ret = pool_->allocate(cfg, &buffers);
+		if (ret != static_cast<int>(cfg.bufferCount)) {
+			cerr << "Failed to reallocate buffers" << endl;
+			return TestFail;
+		}
+
+		stats = pool_->statistics();
+		if (stats.hits != cfg.bufferCount || stats.misses != cfg.bufferCount ||
+		    stats.idle != 0) {
+			cerr << "Idle memory not reused: " << stats.hits << " hits, "
+			     << stats.misses << " misses" << endl;
+			return TestFail;
+		}
+
+		/* Recycled memory must still be accessible. */
+		MappedFrameBuffer recycled(buffers[0].get(),
+					   MappedFrameBuffer::MapFlag::Read);
+		if (!recycled.isValid()) {
+			cerr << "Failed to map recycled buffer" << endl;
+			return TestFail;
+		}
+
+		/* A much larger configuration allocates new memory. */
+		std::vector<std::unique_ptr<FrameBuffer>> large;
+		cfg.size = { 1920, 1080 };
+		cfg.stride = 1920;
+		cfg.frameSize = 1920 * 1080 * 3 / 2;
+		cfg.bufferCount = 2;
+
+		ret = pool_->allocate(cfg, &large);
+		if (ret != static_cast<int>(cfg.bufferCount) ||
+		    pool_->statistics().misses != stats.misses + cfg.bufferCount) {
+			cerr << "Unexpected reuse of smaller buffers" << endl;
+			return TestFail;
+		}
+
+		return TestPass;
+	}
+
+	int testTrim()
+	{
+		BufferPool::Statistics stats = pool_->statistics();
+		if (stats.idle == 0) {
+			cerr << "No idle buffers to trim" << endl;
+			return TestFail;
+		}
+
+		size_t size = stats.idleSize;
+		pool_->setMaxIdleSize(size / 2);
+
+		stats = pool_->statistics();
+		if (stats.idleSize > size / 2 || stats.evictions == 0) {
+			cerr << "Idle memory not bounded" << endl;
+			return TestFail;
+		}
+
+		pool_->trim();
+		if (pool_->statistics().idle != 0) {
+			cerr << "Idle memory not trimmed" << endl;
+			return TestFail;
+		}
+
+		/* Buffers outliving the pool release their memory. */
+		StreamConfiguration cfg;
+		cfg.pixelFormat = formats::MJPEG;
+		cfg.size = { 640, 480 };
+		cfg.frameSize = 100000;
+		cfg.bufferCount = 1;
+
+		std::vector<std::unique_ptr<FrameBuffer>> buffers;
+		if (pool_->allocate(cfg, &buffers) != 1 ||
+		    buffers[0]->planes().size() != 1 ||
+		    buffers[0]->planes()[0].length != cfg.frameSize) {
+			cerr << "Failed to allocate compressed buffer" << endl;
+			return TestFail;
+		}
+
+		pool_.reset();
+		buffers.clear();
+
+		return TestPass;
+	}
+
+	int run() override
+	{
+		int ret = testSizeClass();
+		if (ret != TestPass)
+			return ret;
+
+		ret = testAllocation();
+		if (ret != TestPass)
+			return ret;
+
+		ret = testTrim();
+		if (ret != TestPass)
+			return ret;
+
+		return TestPass;
+	}
+
+private:
+	std::shared_ptr<BufferPool> pool_;
+};
+
+} /* namespace */
+
+TEST_REGISTER(BufferPoolTest)
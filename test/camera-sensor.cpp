@@ -108,6 +108,43 @@ protected:
 			return TestFail;
 		}
 
+		/* Repeated lookups must return the same format. */
+		V4L2SubdeviceFormat format2 = sensor_->getFormat({ 0xdeadbeef,
+								   MEDIA_BUS_FMT_SBGGR10_1X10,
+								   MEDIA_BUS_FMT_BGR888_1X24 },
+								 Size(1024, 768));
+		if (format2.mbus_code != format.mbus_code ||
+		    format2.size != format.size) {
+			cerr << "Inconsistent format on repeated lookup, got "
+			     << format2 << endl;
+			return TestFail;
+		}
+
+		/* Lookups with different codes must not return the cached format. */
+		format2 = sensor_->getFormat({ MEDIA_BUS_FMT_BGR888_1X24,
+					       MEDIA_BUS_FMT_SBGGR10_1X10 },
+					     Size(1024, 768));
+		if (format2.mbus_code != MEDIA_BUS_FMT_BGR888_1X24) {
+			cerr << "Cached format returned for different codes, got "
+			     << format2 << endl;
+			return TestFail;
+		}
+
+		/*
+		 * Same for different sizes. All the vimc sensor sizes are
+		 * continuous ranges up to 4096x2160, use a size that no code
+		 * supports.
+		 */
+		format2 = sensor_->getFormat({ 0xdeadbeef,
+					       MEDIA_BUS_FMT_SBGGR10_1X10,
+					       MEDIA_BUS_FMT_BGR888_1X24 },
+					     Size(8192, 4320));
+		if (format2.mbus_code || format2.size == format.size) {
+			cerr << "Cached format returned for a different size, got "
+			     << format2 << endl;
+			return TestFail;
+		}
+
 		if (lens_ && lens_->setFocusPosition(10)) {
 			cerr << "Failed to set lens focus position" << endl;
 			return TestFail;
@@ -0,0 +1,175 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Copyright (C) 2024, Ideas On Board
+ *
+ * libcamera Camera API tests
+ *
+ * Test that validating the same configuration multiple times gives the same
+ * result, as pipeline handlers may cache the validation results.
+ */
+
+#include <iostream>
+
+#include <libcamera/camera.h>
+#include <libcamera/camera_manager.h>
+
+#include "test.h"
+
+using namespace libcamera;
+using namespace std;
+
+namespace {
+
+struct Result {
+	CameraConfiguration::Status status;
+	StreamConfiguration cfg;
+};
+
+class ConfigurationCache : public Test
+{
+protected:
+	int init() override
+	{
+		cm_ = make_unique<CameraManager>();
+		if (cm_->start()) {
+			cerr << "Failed to start camera manager" << endl;
+			return TestFail;
+		}
+
+		return TestPass;
+	}
+
+	/* Validate a configuration with a single stream of the given size. */
+	int validate(Camera *camera, const Size &size, Result *result)
+	{
+		unique_ptr<CameraConfiguration> config =
+			camera->generateConfiguration({ StreamRole::Viewfinder });
+		if (!config || config->size() != 1)
+			return TestSkip;
+
+		if (!size.isNull())
+			config->at(0).size = size;
+
+		result->status = config->validate();
+		result->cfg = config->at(0);
+
+		if (result->status == CameraConfiguration::Invalid) {
+			cerr << camera->id() << ": configuration invalid" << endl;
+			return TestFail;
+		}
+
+		return TestPass;
+	}
+
+	bool equal(const Result &a, const Result &b)
+	{
+		return a.status == b.status &&
+		       a.cfg.pixelFormat == b.cfg.pixelFormat &&
+		       a.cfg.size == b.cfg.size &&
+		       a.cfg.stride == b.cfg.stride &&
+		       a.cfg.frameSize == b.cfg.frameSize &&
+		       a.cfg.bufferCount == b.cfg.bufferCount;
+	}
+
+	int checkRepeated(Camera *camera, const Size &size)
+	{
+		Result first;
+		Result second;
+
+		int ret = validate(camera, size, &first);
+		if (ret != TestPass)
+			return ret;
+
+		ret = validate(camera, size, &second);
+		if (ret != TestPass)
+			return ret;
+
+		if (!equal(first, second)) {
+			cerr << camera->id() << ": validating " << size
+			     << " gave " << first.cfg.toString() << " (status "
+			     << first.status << ", stride " << first.cfg.stride
+			     << ", frame size " << first.cfg.frameSize
+			     << ") then " << second.cfg.toString() << " (status "
+			     << second.status << ", stride " << second.cfg.stride
+			     << ", frame size " << second.cfg.frameSize << ")"
+			     << endl;
+			return TestFail;
+		}
+
+		return TestPass;
+	}
+
+	int testCamera(Camera *camera)
+	{
+		/* The default configuration, validated twice. */
+		Result result;
+		int ret = validate(camera, {}, &result);
+		if (ret != TestPass)
+			return ret;
+
+		ret = checkRepeated(camera, {});
+		if (ret != TestPass)
+			return ret;
+
+		/* An adjusted configuration must stay adjusted. */
+		ret = checkRepeated(camera, Size(1, 1));
+		if (ret != TestPass)
+			return ret;
+
+		/*
+		 * A different size must not reuse the previous results. Pick
+		 * the smallest size of the default format, if different from
+		 * the default size.
+		 */
+		const vector<Size> sizes =
+			result.cfg.formats().sizes(result.cfg.pixelFormat);
+		if (sizes.empty() || sizes.front() == result.cfg.size)
+			return TestPass;
+
+		Result other;
+		ret = validate(camera, sizes.front(), &other);
+		if (ret != TestPass)
+			return ret;
+
+		if (other.cfg.size == result.cfg.size) {
+			cerr << camera->id() << ": size " << sizes.front()
+			     << " adjusted to the default " << result.cfg.size
+			     << endl;
+			return TestFail;
+		}
+
+		return checkRepeated(camera, sizes.front());
+	}
+
+	int run() override
+	{
+		bool tested = false;
+
+		for (const shared_ptr<Camera> &camera : cm_->cameras()) {
+			int ret = testCamera(camera.get());
+			if (ret == TestFail)
+				return ret;
+			if (ret == TestPass)
+				tested = true;
+		}
+
+		if (!tested) {
+			cout << "No camera to test" << endl;
+			return TestSkip;
+		}
+
+		return TestPass;
+	}
+
+	void cleanup() override
+	{
+		cm_->stop();
+	}
+
+private:
+	unique_ptr<CameraManager> cm_;
+};
+
+} /* namespace */
+
+TEST_REGISTER(ConfigurationCache)
@@ -0,0 +1,126 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Copyright (C) 2024, Ideas On Board
+ *
+ * libcamera Camera API tests
+ *
+ * Test that raw formats advertised by cameras can be configured, notably when
+ * the simple pipeline handler debayers frames with the software converter.
+ */
+
+#include <iostream>
+
+#include <libcamera/camera.h>
+#include <libcamera/camera_manager.h>
+
+#include "libcamera/internal/formats.h"
+
+#include "test.h"
+
+using namespace libcamera;
+using namespace std;
+
+namespace {
+
+class ConfigurationRaw : public Test
+{
+protected:
+	int init() override
+	{
+		cm_ = make_unique<CameraManager>();
+		if (cm_->start()) {
+			cerr << "Failed to start camera manager" << endl;
+			return TestFail;
+		}
+
+		return TestPass;
+	}
+
+	int validateRaw(Camera *camera, StreamRole role, unsigned int count)
+	{
+		StreamRoles roles(count, role);
+		unique_ptr<CameraConfiguration> config =
+			camera->generateConfiguration(roles);
+		if (!config || config->size() != count)
+			return TestSkip;
+
+		/* Pick the first raw format advertised by the camera. */
+		const StreamFormats &formats = config->at(0).formats();
+		PixelFormat rawFormat;
+		for (const PixelFormat &format : formats.pixelformats()) {
+			const PixelFormatInfo &info = PixelFormatInfo::info(format);
+			if (info.colourEncoding == PixelFormatInfo::ColourEncodingRAW) {
+				rawFormat = format;
+				break;
+			}
+		}
+
+		if (!rawFormat.isValid())
+			return TestSkip;
+
+		const vector<Size> sizes = formats.sizes(rawFormat);
+		if (sizes.empty()) {
+			cerr << camera->id() << ": no size for " << rawFormat
+			     << endl;
+			return TestFail;
+		}
+
+		/*
+		 * Request the raw format in the first stream, the other
+		 * streams keep their default, processed, format.
+		 */
+		StreamConfiguration &cfg = config->at(0);
+		cfg.pixelFormat = rawFormat;
+		cfg.size = sizes.back();
+
+		if (config->validate() == CameraConfiguration::Invalid) {
+			cerr << camera->id() << ": raw configuration invalid"
+			     << endl;
+			return TestFail;
+		}
+
+		if (cfg.pixelFormat != rawFormat) {
+			cerr << camera->id() << ": raw format " << rawFormat
+			     << " adjusted to " << cfg.pixelFormat << endl;
+			return TestFail;
+		}
+
+		return TestPass;
+	}
+
+	int run() override
+	{
+		bool tested = false;
+
+		for (const shared_ptr<Camera> &camera : cm_->cameras()) {
+			/* Raw alone, and alongside a processed stream. */
+			for (unsigned int count : { 1, 2 }) {
+				int ret = validateRaw(camera.get(),
+						      StreamRole::Raw, count);
+				if (ret == TestFail)
+					return ret;
+				if (ret == TestPass)
+					tested = true;
+			}
+		}
+
+		if (!tested) {
+			cout << "No camera exposes raw formats" << endl;
+			return TestSkip;
+		}
+
+		return TestPass;
+	}
+
+	void cleanup() override
+	{
+		cm_->stop();
+	}
+
+private:
+	unique_ptr<CameraManager> cm_;
+};
+
+} /* namespace */
+
+TEST_REGISTER(ConfigurationRaw)
@@ -5,6 +5,7 @@
  * delayed_controls.cpp - libcamera delayed controls test
  */
 
+#include <chrono>
 #include <iostream>
 
 #include "libcamera/internal/delayed_controls.h"
@@ -96,7 +97,7 @@ protected:
 
 			delayed->applyControls(i);
 
-			ControlList result = delayed->get(i);
+			ControlList result = delayed->get(i).first;
 			int32_t brightness = result.get(V4L2_CID_BRIGHTNESS).get<int32_t>();
 			if (brightness != value) {
 				cerr << "Failed single control without delay"
@@ -138,7 +139,7 @@ protected:
 
 			delayed->applyControls(i);
 
-			ControlList result = delayed->get(i);
+			ControlList result = delayed->get(i).first;
 			int32_t brightness = result.get(V4L2_CID_BRIGHTNESS).get<int32_t>();
 			if (brightness != expected) {
 				cerr << "Failed single control with delay"
@@ -187,7 +188,7 @@ protected:
 
 			delayed->applyControls(i);
 
-			ControlList result = delayed->get(i);
+			ControlList result = delayed->get(i).first;
 			int32_t brightness = result.get(V4L2_CID_BRIGHTNESS).get<int32_t>();
 			int32_t contrast = result.get(V4L2_CID_CONTRAST).get<int32_t>();
 			if (brightness != expected || contrast != expected + 1) {
@@ -247,7 +248,7 @@ protected:
 
 			delayed->applyControls(i);
 
-			ControlList result = delayed->get(i);
+			ControlList result = delayed->get(i).first;
 
 			int32_t brightness = result.get(V4L2_CID_BRIGHTNESS).get<int32_t>();
 			int32_t contrast = result.get(V4L2_CID_CONTRAST).get<int32_t>();
@@ -267,6 +268,155 @@ protected:
 		return TestPass;
 	}
 
+	int cookies()
+	{
+		static const unsigned int maxDelay = 2;
+
+		std::unordered_map<uint32_t, DelayedControls::ControlParams> delays = {
+			{ V4L2_CID_BRIGHTNESS, { 1, false } },
+			{ V4L2_CID_CONTRAST, { maxDelay, false } }
+		};
+		std::unique_ptr<DelayedControls> delayed =
+			std::make_unique<DelayedControls>(dev_.get(), delays);
+		ControlList ctrls;
+
+		delayed->reset(1000);
+		delayed->applyControls(0);
+
+		/* The cookie follows the controls it has been pushed with. */
+		for (unsigned int i = 1; i < 100; i++) {
+			ctrls.set(V4L2_CID_BRIGHTNESS, static_cast<int32_t>(10 + i));
+			ctrls.set(V4L2_CID_CONTRAST, static_cast<int32_t>(10 + i));
+			delayed->push(ctrls, i);
+
+			delayed->applyControls(i);
+
+			unsigned int cookie = delayed->get(i).second;
+			unsigned int expected = i <= maxDelay ? 1000 : i - maxDelay;
+			if (cookie != expected) {
+				cerr << "Failed cookie frame " << i
+				     << " expected " << expected
+				     << " got " << cookie << endl;
+				return TestFail;
+			}
+		}
+
+		return TestPass;
+	}
+
+	/*
+	 * Replay the control pattern of a typical AGC loop, with exposure-like
+	 * and gain-like controls updated every frame, and report the time
+	 * spent in the helper per frame. The time spent reading back the
+	 * controls is also reported when copying the returned list, as done by
+	 * get() before it updated its list in place, for comparison.
+	 */
+	int replay()
+	{
+		static const unsigned int kFrames = 10000;
+		static const unsigned int maxDelay = 2;
+
+		std::unordered_map<uint32_t, DelayedControls::ControlParams> delays = {
+			{ V4L2_CID_BRIGHTNESS, { 1, false } },
+			{ V4L2_CID_CONTRAST, { maxDelay, false } },
+			{ V4L2_CID_SATURATION, { 0, true } },
+		};
+		std::unique_ptr<DelayedControls> delayed =
+			std::make_unique<DelayedControls>(dev_.get(), delays);
+		ControlList ctrls;
+
+		delayed->reset();
+		delayed->applyControls(0);
+
+		std::chrono::duration<double, std::micro> getTime{};
+		std::chrono::duration<double, std::micro> copyTime{};
+
+		auto start = std::chrono::steady_clock::now();
+
+		for (unsigned int i = 1; i < kFrames; i++) {
+			/* Controls are computed from the frame that just completed. */
+			auto getStart = std::chrono::steady_clock::now();
+			const ControlList &result = delayed->get(i - 1).first;
+			getTime += std::chrono::steady_clock::now() - getStart;
+
+			if (result.empty()) {
+				cerr << "No controls for frame " << i - 1 << endl;
+				return TestFail;
+			}
+
+			getStart = std::chrono::steady_clock::now();
+			ControlList copy = delayed->get(i - 1).first;
+			copyTime += std::chrono::steady_clock::now() - getStart;
+
+			if (copy.size() != result.size()) {
+				cerr << "Inconsistent controls for frame " << i - 1
+				     << endl;
+				return TestFail;
+			}
+
+			int32_t value = 10 + i % 100;
+			ctrls.set(V4L2_CID_BRIGHTNESS, value);
+			ctrls.set(V4L2_CID_CONTRAST, value);
+			if (i % 30 == 0)
+				ctrls.set(V4L2_CID_SATURATION, value);
+			delayed->push(ctrls, i);
+
+			delayed->applyControls(i);
+		}
+
+		auto end = std::chrono::steady_clock::now();
+		double us = std::chrono::duration<double, std::micro>(end - start - copyTime).count();
+
+		cout << "Replayed " << kFrames << " frames, "
+		     << us / kFrames << " us/frame, get() "
+		     << getTime.count() / kFrames << " us/frame in place, "
+		     << copyTime.count() / kFrames << " us/frame copied" << endl;
+
+		const DelayedControls::Statistics &stats = delayed->statistics();
+		if (stats.underruns || stats.skipped) {
+			cerr << "Unexpected slips during replay" << endl;
+			return TestFail;
+		}
+
+		return TestPass;
+	}
+
+	int slipStatistics()
+	{
+		std::unordered_map<uint32_t, DelayedControls::ControlParams> delays = {
+			{ V4L2_CID_BRIGHTNESS, { 1, false } },
+		};
+		std::unique_ptr<DelayedControls> delayed =
+			std::make_unique<DelayedControls>(dev_.get(), delays);
+		ControlList ctrls;
+
+		delayed->reset();
+		delayed->applyControls(0);
+
+		/* Queue controls for the first 10 frames only. */
+		for (unsigned int i = 1; i < 20; i++) {
+			if (i < 10) {
+				ctrls.set(V4L2_CID_BRIGHTNESS, static_cast<int32_t>(i));
+				delayed->push(ctrls);
+			}
+
+			/* Lose the frame start event of frame 15. */
+			if (i != 15)
+				delayed->applyControls(i);
+		}
+
+		const DelayedControls::Statistics &stats = delayed->statistics();
+		if (stats.frames != 19 || stats.skipped != 1 ||
+		    stats.underruns != 10 || stats.late != 0) {
+			cerr << "Invalid statistics: " << stats.frames << " frames, "
+			     << stats.skipped << " skipped, " << stats.underruns
+			     << " underruns, " << stats.late << " late" << endl;
+			return TestFail;
+		}
+
+		return TestPass;
+	}
+
 	int run() override
 	{
 		int ret;
@@ -291,6 +441,21 @@ protected:
 		if (ret)
 			return ret;
 
+		/* Test cookies associated with the controls. */
+		ret = cookies();
+		if (ret)
+			return ret;
+
+		/* Replay a typical control pattern and measure the overhead. */
+		ret = replay();
+		if (ret)
+			return ret;
+
+		/* Test the accounting of frames with late controls. */
+		ret = slipStatistics();
+		if (ret)
+			return ret;
+
 		return TestPass;
 	}
 
@@ -0,0 +1,111 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Copyright (C) 2022, Google Inc.
+ *
+ * discovery-cache.cpp - DiscoveryCache tests
+ */
+
+#include <errno.h>
+#include <fstream>
+#include <iostream>
+#include <stdlib.h>
+#include <string>
+#include <unistd.h>
+
+#include "libcamera/internal/discovery_cache.h"
+
+#include "test.h"
+
+using namespace std;
+using namespace libcamera;
+
+class DiscoveryCacheTest : public Test
+{
+protected:
+	int init()
+	{
+		dir_ = "/tmp/libcamera.test.XXXXXX";
+		if (!mkdtemp(&dir_.front()))
+			return TestFail;
+
+		/* Exercise the creation of the parent directories. */
+		path_ = dir_ + "/discovery/vimc-platform_vimc";
+
+		return TestPass;
+	}
+
+	int run()
+	{
+		/* The cache is disabled unless a directory is given. */
+		unsetenv("LIBCAMERA_CACHE_DIR");
+		if (!DiscoveryCache::directory().empty()) {
+			cerr << "Cache enabled by default" << endl;
+			return TestFail;
+		}
+
+		setenv("LIBCAMERA_CACHE_DIR", dir_.c_str(), 1);
+		if (DiscoveryCache::directory() != dir_) {
+			cerr << "Cache directory not honoured" << endl;
+			return TestFail;
+		}
+
+		DiscoveryCache cache(path_, "vimc|5.15");
+
+		if (cache.load() != -ENOENT) {
+			cerr << "Missing cache file not reported" << endl;
+			return TestFail;
+		}
+
+		cache.setValue("sensor-formats:Sensor A:0", "8199 1 16 16 4096 2160 1 1 ");
+		cache.setValue("empty", "");
+
+		if (cache.save() < 0) {
+			cerr << "Failed to save the cache" << endl;
+			return TestFail;
+		}
+
+		/* Load the cache in a new instance with the same signature. */
+		DiscoveryCache loaded(path_, "vimc|5.15");
+		if (loaded.load() < 0) {
+			cerr << "Failed to load the cache" << endl;
+			return TestFail;
+		}
+
+		if (loaded.value("sensor-formats:Sensor A:0") != "8199 1 16 16 4096 2160 1 1 " ||
+		    loaded.value("empty") != "" || loaded.value("missing")) {
+			cerr << "Invalid cache entries" << endl;
+			return TestFail;
+		}
+
+		/* A different signature must discard the entries. */
+		DiscoveryCache stale(path_, "vimc|6.1");
+		if (stale.load() != -ESTALE || stale.value("empty")) {
+			cerr << "Stale cache not discarded" << endl;
+			return TestFail;
+		}
+
+		/* So must a corrupted file. */
+		std::ofstream(path_, std::ios::app) << "corrupted\n";
+
+		DiscoveryCache corrupted(path_, "vimc|5.15");
+		if (corrupted.load() != -EINVAL || corrupted.value("empty")) {
+			cerr << "Corrupted cache not discarded" << endl;
+			return TestFail;
+		}
+
+		return TestPass;
+	}
+
+	void cleanup()
+	{
+		unlink(path_.c_str());
+		rmdir((dir_ + "/discovery").c_str());
+		rmdir(dir_.c_str());
+	}
+
+private:
+	std::string dir_;
+	std::string path_;
+};
+
+TEST_REGISTER(DiscoveryCacheTest)
@@ -0,0 +1,211 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Copyright (C) 2022, Google Inc.
+ *
+ * fence-waiter.cpp - Fence waiter stress test
+ */
+
+#include <array>
+#include <chrono>
+#include <iostream>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <libcamera/base/event_dispatcher.h>
+#include <libcamera/base/thread.h>
+#include <libcamera/base/unique_fd.h>
+#include <libcamera/base/utils.h>
+
+#include "libcamera/internal/fence_waiter.h"
+
+#include "test.h"
+
+using namespace libcamera;
+using namespace std;
+using namespace std::chrono_literals;
+
+namespace {
+
+constexpr unsigned int kRequests = 8;
+constexpr unsigned int kFences = 4;
+constexpr unsigned int kFrames = 2000;
+
+/* Every kTimeoutPeriod frames, one request will have a fence never signalled. */
+constexpr unsigned int kTimeoutPeriod = 100;
+
+class TestRequest : public FenceWaiter::Listener
+{
+public:
+	TestRequest()
+		: signalled_(0), timedOut_(false), done_(true)
+	{
+		for (UniqueFD &fd : fds_)
+			fd = UniqueFD(eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK));
+	}
+
+	bool isValid() const
+	{
+		for (const UniqueFD &fd : fds_) {
+			if (!fd.isValid())
+				return false;
+		}
+
+		return true;
+	}
+
+	int queue(FenceWaiter *waiter, std::chrono::milliseconds timeout)
+	{
+		signalled_ = 0;
+		timedOut_ = false;
+		done_ = false;
+
+		for (unsigned int i = 0; i < kFences; ++i) {
+			/* Reset the eventfd counter to unsignal the fence. */
+			uint64_t value;
+			while (read(fds_[i].get(), &value, sizeof(value)) > 0)
+				;
+
+			int ret = waiter->wait(this, reinterpret_cast<FrameBuffer *>(i + 1),
+					       fds_[i].get());
+			if (ret)
+				return ret;
+		}
+
+		waiter->setTimeout(this, timeout);
+
+		return 0;
+	}
+
+	void signal(unsigned int index)
+	{
+		uint64_t value = 1;
+		[[maybe_unused]] ssize_t ret = write(fds_[index].get(), &value,
+						     sizeof(value));
+	}
+
+	unsigned int signalled() const { return signalled_; }
+	bool timedOut() const { return timedOut_; }
+	bool done() const { return done_; }
+
+private:
+	void fenceSignalled([[maybe_unused]] FrameBuffer *buffer) override
+	{
+		if (++signalled_ == kFences)
+			done_ = true;
+	}
+
+	void fenceTimeout() override
+	{
+		timedOut_ = true;
+		done_ = true;
+	}
+
+	std::array<UniqueFD, kFences> fds_;
+	unsigned int signalled_;
+	bool timedOut_;
+	bool done_;
+};
+
+} /* namespace */
+
+class FenceWaiterTest : public Test
+{
+protected:
+	int run() override
+	{
+		EventDispatcher *dispatcher = Thread::current()->eventDispatcher();
+		FenceWaiter waiter;
+		std::array<TestRequest, kRequests> requests;
+		unsigned int timeouts = 0;
+
+		if (!waiter.isValid()) {
+			cerr << "Failed to create fence waiter" << endl;
+			return TestFail;
+		}
+
+		for (const TestRequest &request : requests) {
+			if (!request.isValid()) {
+				cerr << "Failed to create eventfd" << endl;
+				return TestFail;
+			}
+		}
+
+		auto start = utils::clock::now();
+
+		for (unsigned int frame = 0; frame < kFrames; frame += kRequests) {
+			bool expectTimeout = frame % kTimeoutPeriod == 0;
+
+			for (TestRequest &request : requests) {
+				if (request.queue(&waiter, expectTimeout ? 10ms : 1000ms)) {
+					cerr << "Failed to wait on fences" << endl;
+					return TestFail;
+				}
+			}
+
+			/* Signal fences in an interleaved order across requests. */
+			for (unsigned int i = 0; i < kFences; ++i) {
+				for (unsigned int r = 0; r < kRequests; ++r) {
+					unsigned int index = (i + r) % kFences;
+					if (expectTimeout && r == 0 && index == 0)
+						continue;
+
+					requests[r].signal(index);
+				}
+			}
+
+			auto done = [&]() {
+				for (const TestRequest &request : requests) {
+					if (!request.done())
+						return false;
+				}
+				return true;
+			};
+
+			while (!done())
+				dispatcher->processEvents();
+
+			for (unsigned int r = 0; r < kRequests; ++r) {
+				const TestRequest &request = requests[r];
+				bool timedOut = expectTimeout && r == 0;
+
+				if (request.timedOut() != timedOut) {
+					cerr << "Unexpected timeout status for request "
+					     << r << " at frame " << frame << endl;
+					return TestFail;
+				}
+
+				if (!timedOut && request.signalled() != kFences) {
+					cerr << "Missing fence signal for request "
+					     << r << " at frame " << frame << endl;
+					return TestFail;
+				}
+
+				if (timedOut)
+					timeouts++;
+			}
+		}
+
+		auto duration = utils::clock::now() - start;
+
+		if (waiter.pending()) {
+			cerr << waiter.pending() << " fences still pending" << endl;
+			return TestFail;
+		}
+
+		/* The wait entries pool must not grow past the peak usage. */
+		if (waiter.capacity() > kRequests * kFences) {
+			cerr << "Wait entries pool grew to " << waiter.capacity()
+			     << " entries" << endl;
+			return TestFail;
+		}
+
+		cout << kFrames / kRequests * kRequests * kFences << " fences, "
+		     << timeouts << " timeouts, in "
+		     << std::chrono::duration_cast<std::chrono::milliseconds>(duration).count()
+		     << "ms" << endl;
+
+		return TestPass;
+	}
+};
+
+TEST_REGISTER(FenceWaiterTest)
@@ -0,0 +1,240 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Copyright (C) 2022, Google Inc.
+ *
+ * frame-matcher.cpp - FrameMatcher tests
+ */
+
+#include <algorithm>
+#include <iostream>
+#include <optional>
+#include <random>
+#include <stdint.h>
+#include <vector>
+
+#include "libcamera/internal/frame_matcher.h"
+
+#include "test.h"
+
+using namespace libcamera;
+using namespace std;
+
+namespace {
+
+constexpr unsigned int kCapacity = 16;
+
+/* Entries carry their sequence number to verify the matches. */
+struct Entry {
+	uint32_t sequence;
+};
+
+using Matcher = FrameMatcher<Entry, Entry, kCapacity>;
+
+struct Event {
+	bool primary;
+	uint32_t sequence;
+};
+
+class FrameMatcherTest : public Test
+{
+protected:
+	/*
+	 * Generate primary and secondary events for a sequence of frames,
+	 * randomly losing some of them and delivering them out of order.
+	 */
+	std::vector<Event> generate(uint32_t first, unsigned int frames,
+				    unsigned int *complete)
+	{
+		std::mt19937 gen(42);
+		std::uniform_int_distribution<unsigned int> percent(0, 99);
+		std::vector<Event> events;
+
+		*complete = 0;
+
+		for (unsigned int i = 0; i < frames; ++i) {
+			uint32_t sequence = first + i;
+			bool primary = percent(gen) >= 3;
+			bool secondary = percent(gen) >= 3;
+
+			if (primary && secondary)
+				(*complete)++;
+
+			/* Either node can complete first. */
+			if (percent(gen) < 50) {
+				if (primary)
+					events.push_back({ true, sequence });
+				if (secondary)
+					events.push_back({ false, sequence });
+			} else {
+				if (secondary)
+					events.push_back({ false, sequence });
+				if (primary)
+					events.push_back({ true, sequence });
+			}
+		}
+
+		/* Delay some events by a few frames. */
+		for (unsigned int i = 0; i + 4 < events.size(); ++i) {
+			if (percent(gen) < 2)
+				std::rotate(events.begin() + i, events.begin() + i + 1,
+					    events.begin() + i + 4);
+		}
+
+		return events;
+	}
+
+	int testOutOfOrder(uint32_t first)
+	{
+		static constexpr unsigned int kFrames = 10000;
+
+		unsigned int complete;
+		std::vector<Event> events = generate(first, kFrames, &complete);
+
+		Matcher matcher;
+		matcher.setSecondaryRequired(true, 2);
+
+		unsigned int primaryPushed = 0, secondaryPushed = 0;
+		unsigned int primaryDropped = 0, secondaryDropped = 0;
+		unsigned int released = 0;
+		std::optional<uint32_t> lastReleased;
+
+		auto dropPrimary = [&](Entry &&) { primaryDropped++; };
+		auto dropSecondary = [&](Entry &&) { secondaryDropped++; };
+
+		for (const Event &event : events) {
+			if (event.primary) {
+				matcher.pushPrimary(event.sequence, { event.sequence },
+						    dropPrimary);
+				primaryPushed++;
+			} else {
+				matcher.pushSecondary(event.sequence, { event.sequence },
+						      dropSecondary);
+				secondaryPushed++;
+			}
+
+			Entry primary;
+			std::optional<Entry> secondary;
+
+			while (matcher.match(&primary, &secondary, dropSecondary)) {
+				if (secondary && secondary->sequence != primary.sequence) {
+					cerr << "Mismatched frames " << primary.sequence
+					     << " and " << secondary->sequence << endl;
+					return TestFail;
+				}
+
+				if (lastReleased &&
+				    static_cast<int32_t>(primary.sequence - *lastReleased) <= 0) {
+					cerr << "Frame " << primary.sequence
+					     << " released after " << *lastReleased << endl;
+					return TestFail;
+				}
+
+				lastReleased = primary.sequence;
+				released++;
+			}
+		}
+
+		unsigned int primaryPending = matcher.primaryPending();
+		unsigned int secondaryPending = matcher.secondaryPending();
+
+		/* Every entry must be accounted for exactly once. */
+		const Matcher::Statistics &stats = matcher.statistics();
+
+		if (stats.matched + stats.unmatched != released ||
+		    stats.primaryDropped != primaryDropped ||
+		    stats.secondaryDropped != secondaryDropped) {
+			cerr << "Inconsistent statistics" << endl;
+			return TestFail;
+		}
+
+		if (released + primaryDropped + primaryPending != primaryPushed) {
+			cerr << "Primary entries leaked" << endl;
+			return TestFail;
+		}
+
+		if (stats.matched + secondaryDropped + secondaryPending != secondaryPushed) {
+			cerr << "Secondary entries leaked" << endl;
+			return TestFail;
+		}
+
+		/* Delays of a few frames must not cause cascades of drops. */
+		if (stats.matched < complete * 98 / 100) {
+			cerr << "Only " << stats.matched << " of " << complete
+			     << " complete frames matched" << endl;
+			return TestFail;
+		}
+
+		cout << "First sequence " << first << ": " << stats.matched
+		     << "/" << complete << " matched, " << stats.unmatched
+		     << " unmatched, " << stats.primaryDropped << " primary and "
+		     << stats.secondaryDropped << " secondary dropped" << endl;
+
+		matcher.clear(dropPrimary, dropSecondary);
+		if (matcher.primaryPending() || matcher.secondaryPending()) {
+			cerr << "Entries left after clear" << endl;
+			return TestFail;
+		}
+
+		return TestPass;
+	}
+
+	int testOverflow()
+	{
+		static constexpr unsigned int kExtra = 4;
+
+		Matcher matcher;
+		std::vector<uint32_t> dropped;
+
+		for (uint32_t sequence = 0; sequence < kCapacity + kExtra; ++sequence)
+			matcher.pushPrimary(sequence, { sequence },
+					    [&](Entry &&e) { dropped.push_back(e.sequence); });
+
+		/* The oldest entries are evicted. */
+		if (dropped.size() != kExtra || dropped.front() != 0 ||
+		    dropped.back() != kExtra - 1 ||
+		    matcher.primaryPending() != kCapacity) {
+			cerr << "Invalid eviction on overflow" << endl;
+			return TestFail;
+		}
+
+		Entry primary;
+		std::optional<Entry> secondary;
+		if (!matcher.match(&primary, &secondary, [](Entry &&) {}) ||
+		    primary.sequence != kExtra || secondary) {
+			cerr << "Invalid match after overflow" << endl;
+			return TestFail;
+		}
+
+		/* Late entries are dropped immediately. */
+		dropped.clear();
+		matcher.pushPrimary(1, { 1 }, [&](Entry &&e) { dropped.push_back(e.sequence); });
+		if (dropped.size() != 1 || matcher.statistics().primaryDropped != kExtra + 1) {
+			cerr << "Late entry not dropped" << endl;
+			return TestFail;
+		}
+
+		return TestPass;
+	}
+
+	int run() override
+	{
+		int ret = testOutOfOrder(0);
+		if (ret != TestPass)
+			return ret;
+
+		/* Test sequence number wrap-around. */
+		ret = testOutOfOrder(UINT32_MAX - 5000);
+		if (ret != TestPass)
+			return ret;
+
+		ret = testOverflow();
+		if (ret != TestPass)
+			return ret;
+
+		return TestPass;
+	}
+};
+
+} /* namespace */
+
+TEST_REGISTER(FrameMatcherTest)
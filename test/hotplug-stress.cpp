@@ -0,0 +1,179 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Copyright (C) 2022, Google Inc.
+ *
+ * hotplug-stress.cpp - Test coalescing of media device hotplug events
+ */
+
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <string>
+
+#include <libcamera/base/event_dispatcher.h>
+#include <libcamera/base/thread.h>
+#include <libcamera/base/timer.h>
+#include <libcamera/base/utils.h>
+
+#include "libcamera/internal/device_enumerator.h"
+#include "libcamera/internal/media_device.h"
+
+#include "test.h"
+
+using namespace libcamera;
+using namespace std;
+using namespace std::chrono_literals;
+
+namespace {
+
+/* Enumerator that adds unpopulated media devices on demand. */
+class FakeEnumerator : public DeviceEnumerator
+{
+public:
+	int init() override { return 0; }
+	int enumerate() override { return 0; }
+
+	void plug(unsigned int count)
+	{
+		for (unsigned int i = 0; i < count; ++i)
+			addDevice(std::make_unique<MediaDevice>(node(next_++)));
+	}
+
+	void unplug(unsigned int index)
+	{
+		removeDevice(node(index));
+	}
+
+private:
+	static std::string node(unsigned int index)
+	{
+		return "/dev/fake-media" + std::to_string(index);
+	}
+
+	unsigned int next_ = 0;
+};
+
+class HotplugStressTest : public Test
+{
+protected:
+	/*
+	 * Simulate the camera manager matching pass, with a number of
+	 * pipeline handlers that each search all devices.
+	 */
+	void devicesAdded()
+	{
+		static constexpr unsigned int kNumHandlers = 16;
+
+		utils::time_point start = utils::clock::now();
+
+		for (unsigned int i = 0; i < kNumHandlers; ++i) {
+			if (!enumerator_->hasNewDevices())
+				break;
+
+			/* No device can be acquired, search them all. */
+			DeviceMatch dm("");
+			enumerator_->search(dm);
+		}
+
+		enumerator_->clearNewDevices();
+
+		matchTime_ += utils::clock::now() - start;
+		passes_++;
+	}
+
+	/*
+	 * Process events until the number of matching passes reaches \a passes.
+	 * The timeout is a safety net only, set well above the hotplug delay to
+	 * avoid depending on the scheduling latency.
+	 */
+	bool waitForPasses(unsigned int passes)
+	{
+		EventDispatcher *dispatcher = Thread::current()->eventDispatcher();
+		Timer timeout;
+
+		timeout.start(5s);
+		while (passes_ < passes && timeout.isRunning())
+			dispatcher->processEvents();
+
+		return passes_ >= passes;
+	}
+
+	int runBurst(std::chrono::milliseconds delay, unsigned int bursts,
+		     unsigned int devices, unsigned int passesPerBurst)
+	{
+		enumerator_ = std::make_unique<FakeEnumerator>();
+		enumerator_->setHotplugDelay(delay);
+		enumerator_->devicesAdded.connect(this, &HotplugStressTest::devicesAdded);
+
+		passes_ = 0;
+		matchTime_ = {};
+
+		for (unsigned int i = 0; i < bursts; ++i) {
+			enumerator_->plug(devices);
+			if (!waitForPasses((i + 1) * passesPerBurst))
+				break;
+		}
+
+		cout << "Delay " << delay.count() << "ms: " << passes_
+		     << " matching passes for " << bursts * devices
+		     << " devices in " << matchTime_.get<std::micro>() << "us"
+		     << endl;
+
+		return passes_;
+	}
+
+	int run()
+	{
+		static constexpr unsigned int kBursts = 10;
+		static constexpr unsigned int kDevices = 8;
+
+		/* Without delay, every device triggers a matching pass. */
+		unsigned int passes = runBurst(0ms, kBursts, kDevices, kDevices);
+		if (passes != kBursts * kDevices) {
+			cerr << "Expected one pass per device, got " << passes << endl;
+			return TestFail;
+		}
+
+		/* With a delay, additions are coalesced in one pass per burst. */
+		passes = runBurst(20ms, kBursts, kDevices, 1);
+		if (passes != kBursts) {
+			cerr << "Expected one pass per burst, got " << passes << endl;
+			return TestFail;
+		}
+
+		/* Devices are only new until the end of the matching pass. */
+		enumerator_->plug(1);
+		if (!enumerator_->hasNewDevices()) {
+			cerr << "Added device not reported as new" << endl;
+			return TestFail;
+		}
+
+		enumerator_->unplug(kBursts * kDevices);
+		if (enumerator_->hasNewDevices()) {
+			cerr << "Removed device reported as new" << endl;
+			return TestFail;
+		}
+
+		/* The notification is still emitted, but finds no new device. */
+		if (!waitForPasses(kBursts + 1)) {
+			cerr << "Missing notification after removal" << endl;
+			return TestFail;
+		}
+
+		return TestPass;
+	}
+
+	void cleanup()
+	{
+		enumerator_.reset();
+	}
+
+private:
+	std::unique_ptr<FakeEnumerator> enumerator_;
+	unsigned int passes_;
+	utils::Duration matchTime_;
+};
+
+} /* namespace */
+
+TEST_REGISTER(HotplugStressTest)
@@ -0,0 +1,174 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Copyright (C) 2022, Ideas On Board
+ *
+ * af_search_test.cpp - Auto focus search engine frames-to-focus benchmark
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+
+#include "libipa/af_search.h"
+
+#include "test.h"
+
+using namespace std;
+using namespace libcamera;
+using namespace libcamera::ipa;
+
+/*
+ * Sweep the lens through a synthetic contrast curve modelled after the IPU3 AF
+ * statistics variance, and measure the number of frames needed to focus and
+ * the focus error.
+ */
+class AfSearchTest : public Test
+{
+protected:
+	static constexpr int32_t kMaxPosition = 1023;
+	static constexpr unsigned int kMaxFrames = 200;
+
+	/* Maximum focus error, about 1% of contrast loss. */
+	static constexpr int32_t kMaxError = 12;
+
+	struct Scene {
+		double peak;
+		double width;
+	};
+
+	static double contrast(const Scene &scene, int32_t position,
+			       unsigned int frame)
+	{
+		double x = (position - scene.peak) / scene.width;
+		double noise = 1.0 + 0.01 * std::sin(frame * 12.9898);
+
+		return (50.0 + 1000.0 * std::exp(-x * x / 2)) * noise;
+	}
+
+	AfSearch::Config config()
+	{
+		AfSearch::Config config{};
+		config.minPosition = 0;
+		config.maxPosition = kMaxPosition;
+		config.coarseStep = 30;
+		config.fineStep = 1;
+		config.settleFrames = 1;
+		config.dropThreshold = 0.1;
+		config.rescanThreshold = 0.5;
+		config.rescanFrames = 2;
+		return config;
+	}
+
+	/* Run the search until focused, return the number of frames. */
+	unsigned int focus(AfSearch &search, const Scene &scene, unsigned int &frame)
+	{
+		unsigned int start = frame;
+
+		while (frame - start < kMaxFrames) {
+			search.process(contrast(scene, search.position(), frame++));
+			if (search.state() == AfSearch::State::Focused)
+				break;
+		}
+
+		return frame - start;
+	}
+
+	/* Frames needed by an exhaustive linear coarse then fine scan. */
+	unsigned int linearScanFrames(const Scene &scene)
+	{
+		unsigned int frames = 0;
+		double best = 0.0;
+		int32_t bestPosition = 0;
+
+		for (int32_t position = 0; position <= kMaxPosition; position += 30) {
+			frames += 2;
+			double value = contrast(scene, position, 0);
+			if (value < best * 0.9)
+				break;
+			if (value > best) {
+				best = value;
+				bestPosition = position;
+			}
+		}
+
+		best = 0.0;
+		for (int32_t position = bestPosition * 0.95;
+		     position <= kMaxPosition; ++position) {
+			frames += 2;
+			double value = contrast(scene, position, 0);
+			if (value < best * 0.9)
+				break;
+			best = std::max(best, value);
+		}
+
+		return frames;
+	}
+
+	int run() override
+	{
+		AfSearch search;
+		unsigned int totalSearch = 0;
+		unsigned int totalLinear = 0;
+
+		for (double peak : { 20.0, 250.0, 500.0, 780.0, 1010.0 }) {
+			Scene scene{ peak, 80.0 };
+			unsigned int frame = 0;
+
+			search.configure(config());
+			unsigned int frames = focus(search, scene, frame);
+			unsigned int linear = linearScanFrames(scene);
+
+			int32_t error = std::abs(search.position() - static_cast<int32_t>(peak));
+
+			cout << "Peak " << peak << ": focused at " << search.position()
+			     << " in " << frames << " frames (linear scan: "
+			     << linear << " frames)" << endl;
+
+			if (search.state() != AfSearch::State::Focused) {
+				cerr << "Failed to focus on peak " << peak << endl;
+				return TestFail;
+			}
+
+			if (error > kMaxError) {
+				cerr << "Focus error " << error << " too large" << endl;
+				return TestFail;
+			}
+
+			totalSearch += frames;
+			totalLinear += linear;
+
+			/* Let the lens settle and the reference contrast be measured. */
+			for (unsigned int i = 0; i < 4; ++i)
+				search.process(contrast(scene, search.position(), frame++));
+
+			/* Move the subject, and check continuous AF tracking. */
+			scene.peak = peak < kMaxPosition / 2 ? peak + 150.0 : peak - 150.0;
+			for (unsigned int i = 0; i < 4; ++i)
+				search.process(contrast(scene, search.position(), frame++));
+
+			if (search.state() == AfSearch::State::Focused) {
+				cerr << "Scene change not detected" << endl;
+				return TestFail;
+			}
+
+			focus(search, scene, frame);
+
+			error = std::abs(search.position() - static_cast<int32_t>(scene.peak));
+			if (search.state() != AfSearch::State::Focused || error > kMaxError) {
+				cerr << "Failed to track peak " << scene.peak
+				     << ", focused at " << search.position() << endl;
+				return TestFail;
+			}
+		}
+
+		if (totalSearch >= totalLinear) {
+			cerr << "Search slower than linear scan" << endl;
+			return TestFail;
+		}
+
+		return TestPass;
+	}
+};
+
+TEST_REGISTER(AfSearchTest)
@@ -0,0 +1,139 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Copyright (C) 2022, Ideas On Board
+ *
+ * exposure_predictor_test.cpp - Exposure predictor convergence benchmark
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <iostream>
+#include <vector>
+
+#include <libcamera/base/utils.h>
+
+#include "libipa/exposure_predictor.h"
+
+#include "test.h"
+
+using namespace std;
+using namespace libcamera;
+using namespace libcamera::ipa;
+using namespace std::literals::chrono_literals;
+
+/*
+ * Replay a scene brightness trace through a simple sensor model with a fixed
+ * control delay, and measure how fast and how accurately an exposure control
+ * loop converges after each scene change.
+ */
+class ExposurePredictorTest : public Test
+{
+protected:
+	static constexpr unsigned int kDelay = 2;
+	static constexpr double kTarget = 0.16;
+
+	struct Result {
+		unsigned int convergence;
+		double overshoot;
+	};
+
+	using Controller = std::function<utils::Duration(uint32_t, utils::Duration)>;
+
+	Result replay(const vector<double> &scene, Controller controller)
+	{
+		/* Exposure requested after processing each frame. */
+		vector<utils::Duration> requested(scene.size(), 10ms);
+		Result result{ 0, 0.0 };
+		unsigned int lastChange = 0;
+		bool converged = true;
+
+		for (unsigned int frame = 0; frame < scene.size(); ++frame) {
+			/*
+			 * Requests made after processing a frame take effect
+			 * kDelay frames after the next one.
+			 */
+			utils::Duration applied = frame > kDelay
+						? requested[frame - kDelay - 1] : 10ms;
+
+			/* The sensor saturates, limiting the measurable gain. */
+			double luminance = std::min(scene[frame] * applied.get<std::milli>(), 1.0);
+			double gain = std::min(10.0, kTarget / (luminance + .001));
+
+			requested[frame] = controller(frame, applied * gain);
+
+			if (frame && scene[frame] != scene[frame - 1]) {
+				lastChange = frame;
+				converged = false;
+			}
+
+			double ideal = kTarget / scene[frame];
+			double error = applied.get<std::milli>() / ideal - 1.0;
+
+			if (frame > lastChange && lastChange)
+				result.overshoot = std::max(result.overshoot,
+							    scene[lastChange] > scene[lastChange - 1]
+							    ? -error : error);
+
+			if (!converged && std::abs(error) < 0.05) {
+				result.convergence = std::max(result.convergence,
+							      frame - lastChange);
+				converged = true;
+			}
+		}
+
+		if (!converged)
+			result.convergence = scene.size();
+
+		return result;
+	}
+
+	int run() override
+	{
+		/* Steps up and down in scene brightness, in 40 frames segments. */
+		vector<double> scene;
+		for (double level : { 0.02, 0.1, 0.015, 0.03, 0.08 })
+			scene.insert(scene.end(), 40, level);
+
+		/*
+		 * Reference: low-pass filtered target, as used by the mean-based
+		 * AGC algorithms in their default mode.
+		 */
+		utils::Duration filtered = 0s;
+		unsigned int count = 0;
+		Result reference = replay(scene, [&](uint32_t, utils::Duration target) {
+			double speed = count++ < 10 ? 1.0 : 0.2;
+			if (filtered < 1.2 * target && filtered > 0.8 * target)
+				speed = sqrt(speed);
+			filtered = speed * target + filtered * (1.0 - speed);
+			return filtered;
+		});
+
+		ExposurePredictor predictor;
+		predictor.configure(kDelay);
+		Result predictive = replay(scene, [&](uint32_t frame, utils::Duration target) {
+			return predictor.update(frame, target);
+		});
+
+		cout << "Filtered:   convergence " << reference.convergence
+		     << " frames, overshoot " << reference.overshoot * 100 << "%"
+		     << endl;
+		cout << "Predictive: convergence " << predictive.convergence
+		     << " frames, overshoot " << predictive.overshoot * 100 << "%"
+		     << endl;
+
+		if (predictive.convergence > kDelay + 1) {
+			cerr << "Predictive AGC converged too slowly" << endl;
+			return TestFail;
+		}
+
+		if (predictive.overshoot > 0.05) {
+			cerr << "Predictive AGC overshoot too large" << endl;
+			return TestFail;
+		}
+
+		return TestPass;
+	}
+};
+
+TEST_REGISTER(ExposurePredictorTest)
@@ -0,0 +1,171 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Copyright (C) 2022, Ideas On Board
+ *
+ * fc_queue_test.cpp - Frame context queue tests
+ */
+
+#include <atomic>
+#include <iostream>
+#include <thread>
+
+#include "libipa/fc_queue.h"
+
+#include "test.h"
+
+using namespace std;
+using namespace libcamera;
+using namespace libcamera::ipa;
+
+struct TestFrameContext : public FrameContext {
+	uint32_t value;
+};
+
+class FCQueueTest : public Test
+{
+protected:
+	int testSize()
+	{
+		FCQueue<TestFrameContext> queue(5);
+		if (queue.size() != 8) {
+			cerr << "Invalid queue size " << queue.size() << endl;
+			return TestFail;
+		}
+
+		return TestPass;
+	}
+
+	int testUnderrun()
+	{
+		FCQueue<TestFrameContext> queue(4);
+
+		for (uint32_t frame = 0; frame < 5; ++frame)
+			queue.alloc(frame).value = frame;
+
+		if (queue.get(4).value != 4) {
+			cerr << "Invalid context for frame 4" << endl;
+			return TestFail;
+		}
+
+		/* Allocating a frame twice preserves its context. */
+		if (queue.alloc(4).value != 4) {
+			cerr << "Context reinitialised by a second alloc()" << endl;
+			return TestFail;
+		}
+
+		/* Underrun: get() before alloc() initialises the context. */
+		TestFrameContext &underrun = queue.get(5);
+		underrun.value = 5;
+		if (queue.alloc(5).value != 5) {
+			cerr << "Underrun context reinitialised by alloc()" << endl;
+			return TestFail;
+		}
+
+		/* A late alloc() leaves the newer context in the slot untouched. */
+		if (queue.alloc(1).value != 5) {
+			cerr << "Newer context reinitialised by a late alloc()" << endl;
+			return TestFail;
+		}
+
+		return TestPass;
+	}
+
+	int testPeek()
+	{
+		FCQueue<TestFrameContext> queue(4);
+
+		for (uint32_t frame = 0; frame < 3; ++frame)
+			queue.alloc(frame).value = frame;
+
+		/* Contexts allocated ahead can be looked up. */
+		TestFrameContext *context = queue.peek(2);
+		if (!context || context->value != 2) {
+			cerr << "Failed to peek at frame 2" << endl;
+			return TestFail;
+		}
+
+		/* Peeking doesn't allocate. */
+		if (queue.peek(3) || queue.peek(3)) {
+			cerr << "Peeked at an unallocated frame" << endl;
+			return TestFail;
+		}
+
+		/* Recycled contexts can't be looked up. */
+		queue.alloc(4).value = 4;
+		if (queue.peek(0)) {
+			cerr << "Peeked at a recycled frame" << endl;
+			return TestFail;
+		}
+
+		return TestPass;
+	}
+
+	int testConcurrent()
+	{
+		static constexpr uint32_t kFrames = 200000;
+
+		FCQueue<TestFrameContext> queue(8);
+		std::atomic<uint32_t> produced = 0;
+		std::atomic<uint32_t> consumed = 0;
+		std::atomic<bool> failed = false;
+
+		/*
+		 * Emulate the request queue thread, staying at most the queue
+		 * size ahead of the statistics processing thread.
+		 */
+		std::thread producer([&]() {
+			for (uint32_t frame = 0; frame < kFrames; ++frame) {
+				while (frame - consumed.load() >= queue.size())
+					std::this_thread::yield();
+
+				queue.alloc(frame).value = frame * 3;
+				produced.store(frame + 1);
+			}
+		});
+
+		std::thread consumer([&]() {
+			for (uint32_t frame = 0; frame < kFrames; ++frame) {
+				while (produced.load() <= frame)
+					std::this_thread::yield();
+
+				if (queue.get(frame).value != frame * 3) {
+					cerr << "Invalid context for frame " << frame << endl;
+					failed = true;
+				}
+
+				consumed.store(frame + 1);
+			}
+		});
+
+		producer.join();
+		consumer.join();
+
+		if (failed)
+			return TestFail;
+
+		return TestPass;
+	}
+
+	int run() override
+	{
+		int ret = testSize();
+		if (ret)
+			return ret;
+
+		ret = testUnderrun();
+		if (ret)
+			return ret;
+
+		ret = testPeek();
+		if (ret)
+			return ret;
+
+		ret = testConcurrent();
+		if (ret)
+			return ret;
+
+		return TestPass;
+	}
+};
+
+TEST_REGISTER(FCQueueTest)
@@ -46,6 +46,37 @@ protected:
 			     << "name = "                 << info.name << endl;
 		}
 
+		/* Construct the module from known information. */
+		IPAModule cached(path, info);
+		if (!cached.isValid() || memcmp(&cached.info(), &info, sizeof(info))) {
+			cerr << "IPA module constructed from information is invalid"
+			     << endl;
+			ret = -1;
+		} else if (!cached.verifyInfo()) {
+			cerr << "Failed to verify IPA module information" << endl;
+			ret = -1;
+		} else if (!cached.load()) {
+			cerr << "Failed to load IPA module constructed from information"
+			     << endl;
+			ret = -1;
+		}
+
+		/* Tampered information must be detected and replaced. */
+		struct IPAModuleInfo tampered = info;
+		strcpy(tampered.pipelineName, "PipelineHandlerTampered");
+
+		IPAModule forged(path, tampered);
+		if (forged.verifyInfo()) {
+			cerr << "Tampered IPA module information not detected"
+			     << endl;
+			ret = -1;
+		} else if (!forged.isValid() ||
+			   memcmp(&forged.info(), &info, sizeof(info))) {
+			cerr << "Tampered IPA module information not replaced"
+			     << endl;
+			ret = -1;
+		}
+
 		delete ll;
 		return ret;
 	}
@@ -0,0 +1,332 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Copyright (C) 2022, Ideas On Board
+ *
+ * module_scheduler.cpp - IPA module algorithms scheduler tests
+ */
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <iostream>
+#include <mutex>
+#include <stdlib.h>
+#include <string>
+#include <unistd.h>
+
+#include <libcamera/base/file.h>
+
+#include <libcamera/control_ids.h>
+
+#include "libcamera/internal/yaml_parser.h"
+
+#include "libipa/algorithm.h"
+#include "libipa/module.h"
+
+#include "test.h"
+
+using namespace std;
+using namespace std::chrono_literals;
+using namespace libcamera;
+using namespace libcamera::ipa;
+
+namespace {
+
+struct Execution {
+	atomic<unsigned int> calls;
+	atomic<unsigned int> start;
+	atomic<unsigned int> end;
+};
+
+struct TestContext {
+	/* Indexed by algorithm position in the tuning data. */
+	Execution executions[4];
+	atomic<unsigned int> sequence;
+
+	/* Rendezvous between the two independent stage 0 algorithms. */
+	bool concurrent;
+	mutex lock;
+	condition_variable cv;
+	unsigned int arrived;
+	bool timeout;
+};
+
+struct TestFrameContext {
+};
+
+struct TestConfig {
+};
+
+struct TestParams {
+};
+
+struct TestStats {
+};
+
+using TestModule = Module<TestContext, TestFrameContext, TestConfig,
+			  TestParams, TestStats>;
+
+class TestIPA : public TestModule
+{
+protected:
+	std::string logPrefix() const override
+	{
+		return "test";
+	}
+};
+
+template<unsigned int Index>
+class TestAlgorithm : public Algorithm<TestModule>
+{
+public:
+	void process(TestContext &context, [[maybe_unused]] const uint32_t frame,
+		     [[maybe_unused]] TestFrameContext &frameContext,
+		     [[maybe_unused]] const TestStats *stats,
+		     ControlList &metadata) override
+	{
+		Execution &execution = context.executions[Index];
+		execution.calls++;
+		execution.start = context.sequence++;
+
+		run(context, metadata);
+
+		execution.end = context.sequence++;
+	}
+
+protected:
+	virtual void run(TestContext &context, ControlList &metadata) = 0;
+
+	void rendezvous(TestContext &context)
+	{
+		if (!context.concurrent)
+			return;
+
+		unique_lock<mutex> locker(context.lock);
+		context.arrived++;
+		context.cv.notify_all();
+
+		if (!context.cv.wait_for(locker, 5s, [&] { return context.arrived == 2; }))
+			context.timeout = true;
+	}
+};
+
+/* Stage 0, independent from all other algorithms. */
+class Awb : public TestAlgorithm<0>
+{
+public:
+	Awb()
+	{
+		setProcessDependencies({});
+	}
+
+protected:
+	void run(TestContext &context, ControlList &metadata) override
+	{
+		rendezvous(context);
+		metadata.set(controls::ColourTemperature, 5000);
+		metadata.set(controls::Lux, 1.0f);
+	}
+};
+
+/* Stage 1, after Awb. */
+class Agc : public TestAlgorithm<1>
+{
+public:
+	Agc()
+	{
+		setProcessDependencies({ "Awb" });
+	}
+
+protected:
+	void run([[maybe_unused]] TestContext &context, ControlList &metadata) override
+	{
+		metadata.set(controls::Lux, 2.0f);
+	}
+};
+
+/* Stage 0, concurrently with Awb, but after Agc in the metadata order. */
+class Lsc : public TestAlgorithm<2>
+{
+public:
+	Lsc()
+	{
+		setProcessDependencies({});
+	}
+
+protected:
+	void run(TestContext &context, ControlList &metadata) override
+	{
+		rendezvous(context);
+		metadata.set(controls::Lux, 3.0f);
+	}
+};
+
+/* Stage 2, no declared dependencies, after all other algorithms. */
+class Histogram : public TestAlgorithm<3>
+{
+protected:
+	void run([[maybe_unused]] TestContext &context,
+		 [[maybe_unused]] ControlList &metadata) override
+	{
+	}
+};
+
+REGISTER_IPA_ALGORITHM(Awb, "Awb")
+REGISTER_IPA_ALGORITHM(Agc, "Agc")
+REGISTER_IPA_ALGORITHM(Lsc, "Lsc")
+REGISTER_IPA_ALGORITHM(Histogram, "Histogram")
+
+const string tuningData =
+	"algorithms:\n"
+	"  - Awb:\n"
+	"  - Agc:\n"
+	"  - Lsc:\n"
+	"  - Histogram:\n";
+
+} /* namespace */
+
+class ModuleSchedulerTest : public Test
+{
+protected:
+	int init()
+	{
+		tuningFile_ = "/tmp/libcamera.test.XXXXXX";
+		int fd = mkstemp(&tuningFile_.front());
+		if (fd == -1)
+			return TestFail;
+
+		int ret = write(fd, tuningData.c_str(), tuningData.size());
+		close(fd);
+
+		if (ret != static_cast<int>(tuningData.size()))
+			return TestFail;
+
+		File file(tuningFile_);
+		if (!file.open(File::OpenModeFlag::ReadOnly))
+			return TestFail;
+
+		tuning_ = YamlParser::parse(file);
+		if (!tuning_) {
+			cerr << "Failed to parse tuning data" << endl;
+			return TestFail;
+		}
+
+		return TestPass;
+	}
+
+	int process(unsigned int threads, ControlList &metadata,
+		    const function<bool(const Algorithm<TestModule> *)> &filter = {})
+	{
+		TestIPA module;
+		TestContext context{};
+		context.concurrent = threads > 1 && !filter;
+
+		int ret = module.createAlgorithms(context, (*tuning_)["algorithms"]);
+		if (ret) {
+			cerr << "Failed to create algorithms" << endl;
+			return TestFail;
+		}
+
+		module.setProcessThreads(threads);
+
+		TestFrameContext frameContext;
+		TestStats stats;
+		module.processAlgorithms(context, 0, frameContext, &stats,
+					 metadata, filter);
+
+		if (context.timeout) {
+			cerr << "Independent algorithms didn't run concurrently"
+			     << endl;
+			return TestFail;
+		}
+
+		const Execution *executions = context.executions;
+
+		for (unsigned int i = 0; i < 4; ++i) {
+			unsigned int expected = filter && i == 2 ? 0 : 1;
+			if (executions[i].calls != expected) {
+				cerr << "Algorithm " << i << " processed "
+				     << executions[i].calls << " times with "
+				     << threads << " threads" << endl;
+				return TestFail;
+			}
+		}
+
+		/* Agc must start after Awb completes. */
+		if (executions[1].start < executions[0].end) {
+			cerr << "Dependent algorithm started too early with "
+			     << threads << " threads" << endl;
+			return TestFail;
+		}
+
+		/* Histogram must start after all other algorithms complete. */
+		for (unsigned int i = 0; i < 3; ++i) {
+			if (!executions[i].calls)
+				continue;
+
+			if (executions[3].start < executions[i].end) {
+				cerr << "Serial algorithm started too early with "
+				     << threads << " threads" << endl;
+				return TestFail;
+			}
+		}
+
+		return TestPass;
+	}
+
+	int checkMetadata(const ControlList &metadata, float lux)
+	{
+		if (metadata.get(controls::ColourTemperature).value_or(0) != 5000 ||
+		    metadata.get(controls::Lux).value_or(0.0f) != lux) {
+			cerr << "Invalid metadata, expected lux " << lux << ", got "
+			     << metadata.get(controls::Lux).value_or(0.0f) << endl;
+			return TestFail;
+		}
+
+		return TestPass;
+	}
+
+	int run()
+	{
+		for (unsigned int threads : { 1, 2, 4 }) {
+			/*
+			 * Metadata are merged in the algorithms order, Lsc
+			 * thus overrides Agc even if it runs first.
+			 */
+			ControlList metadata(controls::controls);
+			int ret = process(threads, metadata);
+			if (ret != TestPass)
+				return ret;
+
+			ret = checkMetadata(metadata, 3.0f);
+			if (ret != TestPass)
+				return ret;
+
+			/* Filtered out algorithms are not processed. */
+			metadata = ControlList(controls::controls);
+			ret = process(threads, metadata,
+				      [](const Algorithm<TestModule> *algo) {
+					      return algo->name() != "Lsc";
+				      });
+			if (ret != TestPass)
+				return ret;
+
+			ret = checkMetadata(metadata, 2.0f);
+			if (ret != TestPass)
+				return ret;
+		}
+
+		return TestPass;
+	}
+
+	void cleanup()
+	{
+		unlink(tuningFile_.c_str());
+	}
+
+private:
+	string tuningFile_;
+	unique_ptr<YamlObject> tuning_;
+};
+
+TEST_REGISTER(ModuleSchedulerTest)
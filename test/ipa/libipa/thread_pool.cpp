@@ -0,0 +1,179 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Copyright (C) 2022, Ideas On Board
+ *
+ * thread_pool.cpp - IPA algorithms thread pool tests
+ */
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "libipa/thread_pool.h"
+
+#include "test.h"
+
+using namespace std;
+using namespace std::chrono_literals;
+using namespace libcamera;
+using namespace libcamera::ipa;
+
+class ThreadPoolTest : public Test
+{
+protected:
+	int testSequential()
+	{
+		ThreadPool pool(0);
+		if (pool.size() != 0) {
+			cerr << "Invalid pool size " << pool.size() << endl;
+			return TestFail;
+		}
+
+		/* Without workers, tasks run in order in the calling thread. */
+		const thread::id self = this_thread::get_id();
+		vector<unsigned int> order;
+		bool foreign = false;
+
+		pool.run(5, [&](unsigned int index) {
+			if (this_thread::get_id() != self)
+				foreign = true;
+			order.push_back(index);
+		});
+
+		if (foreign) {
+			cerr << "Task ran outside of the calling thread" << endl;
+			return TestFail;
+		}
+
+		if (order != vector<unsigned int>{ 0, 1, 2, 3, 4 }) {
+			cerr << "Tasks didn't run in order" << endl;
+			return TestFail;
+		}
+
+		return TestPass;
+	}
+
+	int testCompletion()
+	{
+		ThreadPool pool(3);
+		if (pool.size() != 3) {
+			cerr << "Invalid pool size " << pool.size() << endl;
+			return TestFail;
+		}
+
+		/*
+		 * Run batches larger than the pool, and make sure every task
+		 * runs exactly once and has completed when run() returns.
+		 */
+		for (unsigned int batch = 0; batch < 100; ++batch) {
+			constexpr unsigned int count = 16;
+			vector<atomic<unsigned int>> calls(count);
+
+			pool.run(count, [&](unsigned int index) {
+				if (index % 4 == 0)
+					this_thread::sleep_for(100us);
+				calls[index]++;
+			});
+
+			for (unsigned int i = 0; i < count; ++i) {
+				if (calls[i] != 1) {
+					cerr << "Task " << i << " of batch " << batch
+					     << " ran " << calls[i] << " times" << endl;
+					return TestFail;
+				}
+			}
+		}
+
+		return TestPass;
+	}
+
+	int testConcurrency()
+	{
+		ThreadPool pool(3);
+
+		/*
+		 * A pool of N workers runs N + 1 tasks concurrently. Each task
+		 * waits for all the others to start, which would time out if
+		 * any of them was serialized.
+		 */
+		constexpr unsigned int count = 4;
+		mutex mutex;
+		condition_variable cv;
+		unsigned int started = 0;
+		atomic<unsigned int> timeouts = 0;
+
+		pool.run(count, [&](unsigned int) {
+			unique_lock<std::mutex> locker(mutex);
+			started++;
+			cv.notify_all();
+
+			if (!cv.wait_for(locker, 5s, [&] { return started == count; }))
+				timeouts++;
+		});
+
+		if (timeouts) {
+			cerr << timeouts << " tasks didn't run concurrently" << endl;
+			return TestFail;
+		}
+
+		return TestPass;
+	}
+
+	int testShutdown()
+	{
+		/*
+		 * Destroy pools right after creation, before the workers had a
+		 * chance to wait for work, and right after a batch with more
+		 * tasks than workers. None of this shall hang or lose tasks.
+		 */
+		for (unsigned int i = 0; i < 50; ++i) {
+			ThreadPool pool(4);
+		}
+
+		for (unsigned int i = 0; i < 50; ++i) {
+			atomic<unsigned int> calls = 0;
+
+			{
+				ThreadPool pool(2);
+				pool.run(32, [&](unsigned int) { calls++; });
+			}
+
+			if (calls != 32) {
+				cerr << "Lost tasks on shutdown, " << calls
+				     << " completed" << endl;
+				return TestFail;
+			}
+		}
+
+		return TestPass;
+	}
+
+	int run()
+	{
+		int ret;
+
+		ret = testSequential();
+		if (ret != TestPass)
+			return ret;
+
+		ret = testCompletion();
+		if (ret != TestPass)
+			return ret;
+
+		ret = testConcurrency();
+		if (ret != TestPass)
+			return ret;
+
+		ret = testShutdown();
+		if (ret != TestPass)
+			return ret;
+
+		return TestPass;
+	}
+};
+
+TEST_REGISTER(ThreadPoolTest)
@@ -0,0 +1,316 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Copyright (C) 2022, Google Inc.
+ *
+ * mapping-cache.cpp - MappingCache tests
+ */
+
+#include <iostream>
+#include <memory>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <vector>
+
+#include <libcamera/base/shared_fd.h>
+#include <libcamera/base/unique_fd.h>
+
+#include <libcamera/framebuffer.h>
+
+#include "libcamera/internal/mapped_framebuffer.h"
+
+#include "test.h"
+
+using namespace libcamera;
+using namespace std;
+
+namespace {
+
+constexpr unsigned int kPlaneSize = 4096;
+
+class MappingCacheTest : public Test
+{
+protected:
+	std::unique_ptr<FrameBuffer> createBuffer()
+	{
+		UniqueFD fd(memfd_create("mapping-cache", MFD_CLOEXEC));
+		if (!fd.isValid() || ftruncate(fd.get(), kPlaneSize * 2) < 0)
+			return nullptr;
+
+		SharedFD shared(std::move(fd));
+		std::vector<FrameBuffer::Plane> planes(2);
+		for (unsigned int i = 0; i < planes.size(); ++i) {
+			planes[i].fd = shared;
+			planes[i].offset = kPlaneSize * i;
+			planes[i].length = kPlaneSize;
+		}
+
+		return std::make_unique<FrameBuffer>(planes);
+	}
+
+	int testReuse(MappingCache *cache)
+	{
+		std::unique_ptr<FrameBuffer> buffer = createBuffer();
+		if (!buffer) {
+			cerr << "Failed to create buffer" << endl;
+			return TestFail;
+		}
+
+		MappingCache::Statistics before = cache->statistics();
+		const uint8_t *address;
+
+		{
+			MappedFrameBuffer map(buffer.get(),
+					      MappedFrameBuffer::MapFlag::ReadWrite |
+					      MappedFrameBuffer::MapFlag::Cached);
+			if (!map.isValid()) {
+				cerr << "Failed to map buffer" << endl;
+				return TestFail;
+			}
+
+			address = map.planes()[0].data();
+			map.planes()[1][0] = 0x42;
+
+			/* A concurrent mapping of the same buffer shares memory. */
+			MappedFrameBuffer map2(buffer.get(),
+					       MappedFrameBuffer::MapFlag::ReadWrite |
+					       MappedFrameBuffer::MapFlag::Cached);
+			if (map2.planes()[0].data() != address ||
+			    map2.planes()[1][0] != 0x42) {
+				cerr << "Concurrent mapping not shared" << endl;
+				return TestFail;
+			}
+		}
+
+		/* The mapping is kept idle, and reused by the next map. */
+		MappingCache::Statistics idle = cache->statistics();
+		if (idle.idle != before.idle + 1) {
+			cerr << "Released mapping not kept idle" << endl;
+			return TestFail;
+		}
+
+		MappedFrameBuffer map(buffer.get(),
+				      MappedFrameBuffer::MapFlag::ReadWrite |
+				      MappedFrameBuffer::MapFlag::Cached);
+		if (map.planes()[0].data() != address) {
+			cerr << "Idle mapping not reused" << endl;
+			return TestFail;
+		}
+
+		MappingCache::Statistics after = cache->statistics();
+		if (after.misses != before.misses + 1 ||
+		    after.hits != before.hits + 2) {
+			cerr << "Invalid statistics: " << after.hits << " hits, "
+			     << after.misses << " misses" << endl;
+			return TestFail;
+		}
+
+		/* Different protection flags result in a different mapping. */
+		MappedFrameBuffer readOnly(buffer.get(),
+					   MappedFrameBuffer::MapFlag::Read |
+					   MappedFrameBuffer::MapFlag::Cached);
+		if (readOnly.planes()[0].data() == address ||
+		    readOnly.planes()[1][0] != 0x42) {
+			cerr << "Invalid read-only mapping" << endl;
+			return TestFail;
+		}
+
+		return TestPass;
+	}
+
+	int testEviction(MappingCache *cache)
+	{
+		static constexpr unsigned int kBuffers = 8;
+		static constexpr unsigned int kMaxIdle = 3;
+
+		cache->trim();
+		cache->setMaxIdle(kMaxIdle);
+
+		std::vector<std::unique_ptr<FrameBuffer>> buffers;
+		for (unsigned int i = 0; i < kBuffers; ++i) {
+			buffers.push_back(createBuffer());
+			if (!buffers.back()) {
+				cerr << "Failed to create buffer" << endl;
+				return TestFail;
+			}
+		}
+
+		MappingCache::Statistics before = cache->statistics();
+
+		for (const std::unique_ptr<FrameBuffer> &buffer : buffers) {
+			MappedFrameBuffer map(buffer.get(),
+					      MappedFrameBuffer::MapFlag::Read |
+					      MappedFrameBuffer::MapFlag::Cached);
+			if (!map.isValid()) {
+				cerr << "Failed to map buffer" << endl;
+				return TestFail;
+			}
+		}
+
+		MappingCache::Statistics after = cache->statistics();
+		if (after.idle != kMaxIdle ||
+		    after.evictions - before.evictions != kBuffers - kMaxIdle) {
+			cerr << "Idle mappings not trimmed: " << after.idle
+			     << " idle" << endl;
+			return TestFail;
+		}
+
+		/* The most recently used mappings are kept. */
+		MappedFrameBuffer map(buffers.back().get(),
+				      MappedFrameBuffer::MapFlag::Read |
+				      MappedFrameBuffer::MapFlag::Cached);
+		if (cache->statistics().hits != after.hits + 1) {
+			cerr << "Most recently used mapping evicted" << endl;
+			return TestFail;
+		}
+
+		cache->trim();
+		if (cache->statistics().entries != 1) {
+			cerr << "Mapping in use trimmed" << endl;
+			return TestFail;
+		}
+
+		return TestPass;
+	}
+
+	int testRelease(MappingCache *cache)
+	{
+		cache->trim();
+		cache->setMaxIdle(4);
+
+		std::unique_ptr<FrameBuffer> buffer = createBuffer();
+		std::unique_ptr<FrameBuffer> busy = createBuffer();
+		if (!buffer || !busy) {
+			cerr << "Failed to create buffers" << endl;
+			return TestFail;
+		}
+
+		{
+			MappedFrameBuffer map(buffer.get(),
+					      MappedFrameBuffer::MapFlag::Read |
+					      MappedFrameBuffer::MapFlag::Cached);
+		}
+
+		auto map = std::make_unique<MappedFrameBuffer>(busy.get(),
+							       MappedFrameBuffer::MapFlag::Read |
+							       MappedFrameBuffer::MapFlag::Cached);
+
+		MappingCache::Statistics before = cache->statistics();
+		if (before.entries != 2 || before.idle != 1) {
+			cerr << "Unexpected cache state" << endl;
+			return TestFail;
+		}
+
+		/* Releasing a buffer drops its idle mappings. */
+		cache->release(buffer.get());
+		buffer.reset();
+		if (cache->statistics().entries != 1) {
+			cerr << "Idle mapping of released buffer kept" << endl;
+			return TestFail;
+		}
+
+		/* Mappings in use are dropped when unmapped. */
+		cache->release(busy.get());
+		busy.reset();
+		if (cache->statistics().entries != 1) {
+			cerr << "Mapping in use dropped" << endl;
+			return TestFail;
+		}
+
+		map.reset();
+		if (cache->statistics().entries != 0) {
+			cerr << "Mapping of freed buffer kept after release" << endl;
+			return TestFail;
+		}
+
+		return TestPass;
+	}
+
+	int testTemporaryBuffer(MappingCache *cache)
+	{
+		cache->trim();
+		cache->setMaxIdle(4);
+
+		/* The pipeline handler owns the buffer memory. */
+		std::unique_ptr<FrameBuffer> buffer = createBuffer();
+		if (!buffer) {
+			cerr << "Failed to create buffer" << endl;
+			return TestFail;
+		}
+
+		/*
+		 * IPA modules map the buffers through a temporary FrameBuffer
+		 * built from duplicated file descriptors, as received over IPC,
+		 * and keep the mapping until the buffers are unmapped.
+		 */
+		auto mapBuffer = [&]() {
+			std::vector<FrameBuffer::Plane> planes = buffer->planes();
+			const int num = planes[0].fd.get();
+			SharedFD fd(num);
+			for (FrameBuffer::Plane &plane : planes)
+				plane.fd = fd;
+
+			const FrameBuffer fb(planes);
+			return std::make_unique<MappedFrameBuffer>(&fb,
+								   MappedFrameBuffer::MapFlag::ReadWrite |
+								   MappedFrameBuffer::MapFlag::Cached);
+		};
+
+		MappingCache::Statistics before = cache->statistics();
+
+		std::unique_ptr<MappedFrameBuffer> map = mapBuffer();
+		if (!map->isValid()) {
+			cerr << "Failed to map buffer" << endl;
+			return TestFail;
+		}
+
+		/* Unmapping and remapping the buffer hits the cache. */
+		map.reset();
+		map = mapBuffer();
+
+		MappingCache::Statistics after = cache->statistics();
+		if (after.misses != before.misses + 1 ||
+		    after.hits != before.hits + 1) {
+			cerr << "Temporary buffer mapping not reused: " << after.hits
+			     << " hits, " << after.misses << " misses" << endl;
+			return TestFail;
+		}
+
+		/* The mapping is dropped when the owner frees the buffer. */
+		map.reset();
+		cache->release(buffer.get());
+		buffer.reset();
+		if (cache->statistics().entries != 0) {
+			cerr << "Mapping of freed buffer kept" << endl;
+			return TestFail;
+		}
+
+		return TestPass;
+	}
+
+	int run() override
+	{
+		MappingCache *cache = MappingCache::instance();
+
+		int ret = testReuse(cache);
+		if (ret != TestPass)
+			return ret;
+
+		ret = testEviction(cache);
+		if (ret != TestPass)
+			return ret;
+
+		ret = testRelease(cache);
+		if (ret != TestPass)
+			return ret;
+
+		ret = testTemporaryBuffer(cache);
+		if (ret != TestPass)
+			return ret;
+
+		return TestPass;
+	}
+};
+
+} /* namespace */
+
+TEST_REGISTER(MappingCacheTest)
@@ -0,0 +1,488 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Copyright (C) 2022, Google Inc.
+ *
+ * software-converter.cpp - SoftwareConverter tests and benchmark
+ */
+
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include <libcamera/base/event_dispatcher.h>
+#include <libcamera/base/message.h>
+#include <libcamera/base/thread.h>
+
+#include <libcamera/formats.h>
+#include <libcamera/framebuffer.h>
+#include <libcamera/stream.h>
+
+#include "libcamera/internal/buffer_pool.h"
+#include "libcamera/internal/converter/converter_software.h"
+#include "libcamera/internal/mapped_framebuffer.h"
+
+#include "test.h"
+
+using namespace libcamera;
+using namespace std;
+
+namespace {
+
+/* Flat 10-bit colour used to validate the conversion. */
+constexpr unsigned int kRed = 800;
+constexpr unsigned int kGreen = 400;
+constexpr unsigned int kBlue = 200;
+
+class SoftwareConverterTest : public Test
+{
+protected:
+	int init() override
+	{
+		pool_ = std::make_shared<BufferPool>(DmaHeap::DmaHeapFlag::UDmaBuf |
+						     DmaHeap::DmaHeapFlag::MemFd);
+		if (!pool_->isValid()) {
+			cerr << "Failed to create buffer pool" << endl;
+			return TestSkip;
+		}
+
+		return TestPass;
+	}
+
+	/* Fill an SRGGB10_CSI2P buffer with a flat colour. */
+	int fillInput(FrameBuffer *buffer, const Size &size, unsigned int stride)
+	{
+		MappedFrameBuffer map(buffer, MappedFrameBuffer::MapFlag::Write);
+		if (!map.isValid())
+			return -EINVAL;
+
+		uint8_t *data = map.planes()[0].data();
+
+		for (unsigned int y = 0; y < size.height; ++y) {
+			uint8_t *line = data + y * stride;
+			unsigned int even = y & 1 ? kGreen : kRed;
+			unsigned int odd = y & 1 ? kBlue : kGreen;
+
+			for (unsigned int x = 0; x < size.width; x += 4, line += 5) {
+				line[0] = even >> 2;
+				line[1] = odd >> 2;
+				line[2] = even >> 2;
+				line[3] = odd >> 2;
+				line[4] = (even & 3) | (odd & 3) << 2
+					| (even & 3) << 4 | (odd & 3) << 6;
+			}
+		}
+
+		return 0;
+	}
+
+	int allocateInputs(const Size &size, unsigned int count,
+			   StreamConfiguration *cfg)
+	{
+		cfg->pixelFormat = formats::SRGGB10_CSI2P;
+		cfg->size = size;
+		cfg->stride = size.width * 5 / 4;
+		cfg->frameSize = cfg->stride * size.height;
+		cfg->bufferCount = count;
+
+		inputs_.clear();
+		int ret = pool_->allocate(*cfg, &inputs_);
+		if (ret != static_cast<int>(count))
+			return -ENOMEM;
+
+		for (const std::unique_ptr<FrameBuffer> &buffer : inputs_) {
+			ret = fillInput(buffer.get(), size, cfg->stride);
+			if (ret < 0)
+				return ret;
+		}
+
+		return 0;
+	}
+
+	void inputReady([[maybe_unused]] FrameBuffer *buffer)
+	{
+		inputsDone_++;
+	}
+
+	void outputReady(FrameBuffer *buffer)
+	{
+		if (buffer->metadata().status != FrameMetadata::FrameSuccess)
+			outputErrors_++;
+		outputsDone_++;
+	}
+
+	void statisticsReady([[maybe_unused]] uint32_t sequence,
+			     const SoftwareConverter::Statistics &stats)
+	{
+		stats_ = stats;
+		statsDone_++;
+	}
+
+	void waitForOutputs(unsigned int count)
+	{
+		EventDispatcher *dispatcher = Thread::current()->eventDispatcher();
+
+		/*
+		 * Completion is signalled through messages, which processEvents()
+		 * only dispatches before waiting. Dispatch them explicitly to
+		 * avoid waiting when all buffers have completed.
+		 */
+		while (true) {
+			Thread::current()->dispatchMessages(Message::Type::InvokeMessage);
+			if (outputsDone_ >= count)
+				break;
+
+			dispatcher->processEvents();
+		}
+	}
+
+	int testFormats()
+	{
+		SoftwareConverter converter(nullptr);
+
+		for (PixelFormat format : { formats::SBGGR8, formats::SGRBG10_CSI2P,
+					    formats::SGBRG12_CSI2P, formats::SRGGB10 }) {
+			if (converter.formats(format).empty()) {
+				cerr << "Input format " << format << " not supported" << endl;
+				return TestFail;
+			}
+		}
+
+		if (!converter.formats(formats::YUYV).empty() ||
+		    !converter.formats(formats::SBGGR10_IPU3).empty()) {
+			cerr << "Unsupported input format accepted" << endl;
+			return TestFail;
+		}
+
+		SizeRange sizes = converter.sizes({ 1920, 1080 });
+		if (!sizes.contains({ 1920, 1080 }) || !sizes.contains({ 640, 480 }) ||
+		    sizes.contains({ 2560, 1440 })) {
+			cerr << "Invalid output sizes " << sizes << endl;
+			return TestFail;
+		}
+
+		/* The converter is registered with the converter factory. */
+		std::unique_ptr<Converter> instance = ConverterFactoryBase::create("software");
+		if (!dynamic_cast<SoftwareConverter *>(instance.get())) {
+			cerr << "Software converter not registered" << endl;
+			return TestFail;
+		}
+
+		return TestPass;
+	}
+
+	int testConversion()
+	{
+		const Size inputSize{ 64, 48 };
+
+		SoftwareConverter converter(nullptr);
+		converter.inputBufferReady.connect(this, &SoftwareConverterTest::inputReady);
+		converter.outputBufferReady.connect(this, &SoftwareConverterTest::outputReady);
+
+		StreamConfiguration inputCfg;
+		if (allocateInputs(inputSize, 1, &inputCfg) < 0) {
+			cerr << "Failed to allocate input buffers" << endl;
+			return TestFail;
+		}
+
+		/* Full size RGB and half size NV12 outputs. */
+		StreamConfiguration rgbCfg;
+		rgbCfg.pixelFormat = formats::BGR888;
+		rgbCfg.size = inputSize;
+
+		StreamConfiguration yuvCfg;
+		yuvCfg.pixelFormat = formats::NV12;
+		yuvCfg.size = { 32, 24 };
+
+		for (StreamConfiguration *cfg : { &rgbCfg, &yuvCfg })
+			std::tie(cfg->stride, cfg->frameSize) =
+				converter.strideAndFrameSize(cfg->pixelFormat, cfg->size);
+
+		int ret = converter.configure(inputCfg, { rgbCfg, yuvCfg });
+		if (ret < 0) {
+			cerr << "Failed to configure converter" << endl;
+			return TestFail;
+		}
+
+		std::vector<std::unique_ptr<FrameBuffer>> rgbBuffers;
+		std::vector<std::unique_ptr<FrameBuffer>> yuvBuffers;
+		if (converter.exportBuffers(0, 1, &rgbBuffers) != 1 ||
+		    converter.exportBuffers(1, 1, &yuvBuffers) != 1) {
+			cerr << "Failed to export buffers" << endl;
+			return TestFail;
+		}
+
+		if (converter.start() < 0) {
+			cerr << "Failed to start converter" << endl;
+			return TestFail;
+		}
+
+		inputsDone_ = outputsDone_ = outputErrors_ = 0;
+
+		ret = converter.queueBuffers(inputs_[0].get(),
+					     { { 0, rgbBuffers[0].get() },
+					       { 1, yuvBuffers[0].get() } });
+		if (ret < 0) {
+			cerr << "Failed to queue buffers" << endl;
+			return TestFail;
+		}
+
+		waitForOutputs(2);
+		converter.stop();
+
+		if (inputsDone_ != 1 || outputErrors_) {
+			cerr << "Invalid buffer completion" << endl;
+			return TestFail;
+		}
+
+		/* BGR888 stores R, G and B in memory order. */
+		MappedFrameBuffer rgbMap(rgbBuffers[0].get(),
+					 MappedFrameBuffer::MapFlag::Read);
+		const uint8_t *rgb = rgbMap.planes()[0].data();
+
+		for (unsigned int y = 0; y < rgbCfg.size.height; ++y) {
+			const uint8_t *line = rgb + y * rgbCfg.stride;
+
+			for (unsigned int x = 0; x < rgbCfg.size.width; ++x) {
+				if (line[3 * x] != kRed >> 2 ||
+				    line[3 * x + 1] != kGreen >> 2 ||
+				    line[3 * x + 2] != kBlue >> 2) {
+					cerr << "Invalid RGB value at (" << x << ", " << y
+					     << "): " << static_cast<unsigned int>(line[3 * x])
+					     << ", " << static_cast<unsigned int>(line[3 * x + 1])
+					     << ", " << static_cast<unsigned int>(line[3 * x + 2])
+					     << endl;
+					return TestFail;
+				}
+			}
+		}
+
+		/* Expected BT.601 limited range values for the flat colour. */
+		MappedFrameBuffer yuvMap(yuvBuffers[0].get(),
+					 MappedFrameBuffer::MapFlag::Read);
+		const uint8_t *luma = yuvMap.planes()[0].data();
+		const uint8_t *chroma = yuvMap.planes()[1].data();
+
+		for (unsigned int y = 0; y < yuvCfg.size.height; ++y) {
+			for (unsigned int x = 0; x < yuvCfg.size.width; ++x) {
+				if (abs(luma[y * yuvCfg.stride + x] - 123) > 1) {
+					cerr << "Invalid luma value at (" << x << ", "
+					     << y << ")" << endl;
+					return TestFail;
+				}
+			}
+		}
+
+		for (unsigned int y = 0; y < yuvCfg.size.height / 2; ++y) {
+			for (unsigned int x = 0; x < yuvCfg.size.width / 2; ++x) {
+				const uint8_t *uv = &chroma[y * yuvCfg.stride + 2 * x];
+				if (abs(uv[0] - 91) > 1 || abs(uv[1] - 175) > 1) {
+					cerr << "Invalid chroma value at (" << x << ", "
+					     << y << ")" << endl;
+					return TestFail;
+				}
+			}
+		}
+
+		return TestPass;
+	}
+
+	int testStatistics()
+	{
+		const Size inputSize{ 64, 48 };
+
+		SoftwareConverter converter(nullptr);
+		converter.inputBufferReady.connect(this, &SoftwareConverterTest::inputReady);
+		converter.outputBufferReady.connect(this, &SoftwareConverterTest::outputReady);
+		converter.statisticsReady.connect(this, &SoftwareConverterTest::statisticsReady);
+
+		StreamConfiguration inputCfg;
+		if (allocateInputs(inputSize, 1, &inputCfg) < 0) {
+			cerr << "Failed to allocate input buffers" << endl;
+			return TestFail;
+		}
+
+		StreamConfiguration cfg;
+		cfg.pixelFormat = formats::BGR888;
+		cfg.size = inputSize;
+		std::tie(cfg.stride, cfg.frameSize) =
+			converter.strideAndFrameSize(cfg.pixelFormat, cfg.size);
+
+		std::vector<std::unique_ptr<FrameBuffer>> outputs;
+		if (converter.configure(inputCfg, { cfg }) < 0 ||
+		    converter.exportBuffers(0, 1, &outputs) != 1 ||
+		    converter.start() < 0) {
+			cerr << "Failed to set up converter" << endl;
+			return TestFail;
+		}
+
+		/* Balance the flat colour to grey. */
+		converter.setStatisticsEnabled(true);
+		converter.setColourGains(0.5, 2.0);
+
+		inputsDone_ = outputsDone_ = outputErrors_ = statsDone_ = 0;
+
+		int ret = converter.queueBuffers(inputs_[0].get(),
+						 { { 0, outputs[0].get() } });
+		if (ret < 0) {
+			cerr << "Failed to queue buffers" << endl;
+			return TestFail;
+		}
+
+		waitForOutputs(1);
+		converter.stop();
+
+		if (statsDone_ != 1) {
+			cerr << "Statistics not reported" << endl;
+			return TestFail;
+		}
+
+		/* Statistics are computed before white balance. */
+		uint32_t blocks = 0;
+		for (const SoftwareConverter::Statistics::Zone &zone : stats_.zones) {
+			if (!zone.count)
+				continue;
+
+			if (zone.red != zone.count * (kRed >> 2) ||
+			    zone.green != zone.count * (kGreen >> 2) ||
+			    zone.blue != zone.count * (kBlue >> 2)) {
+				cerr << "Invalid zone statistics" << endl;
+				return TestFail;
+			}
+
+			blocks += zone.count;
+		}
+
+		/* The flat colour falls in a single histogram bin. */
+		if (!blocks || stats_.histogram[31] != blocks || stats_.sharpness) {
+			cerr << "Invalid histogram or sharpness" << endl;
+			return TestFail;
+		}
+
+		MappedFrameBuffer map(outputs[0].get(), MappedFrameBuffer::MapFlag::Read);
+		const uint8_t *rgb = map.planes()[0].data();
+
+		for (unsigned int y = 0; y < cfg.size.height; ++y) {
+			const uint8_t *line = rgb + y * cfg.stride;
+
+			for (unsigned int x = 0; x < 3 * cfg.size.width; ++x) {
+				if (line[x] != kGreen >> 2) {
+					cerr << "White balance not applied at (" << x / 3
+					     << ", " << y << ")" << endl;
+					return TestFail;
+				}
+			}
+		}
+
+		return TestPass;
+	}
+
+	int benchmark()
+	{
+		static constexpr unsigned int kBuffers = 4;
+		static constexpr unsigned int kFrames = 30;
+
+		const Size size{ 1920, 1080 };
+
+		SoftwareConverter converter(nullptr);
+		converter.inputBufferReady.connect(this, &SoftwareConverterTest::inputReady);
+		converter.outputBufferReady.connect(this, &SoftwareConverterTest::outputReady);
+
+		StreamConfiguration inputCfg;
+		if (allocateInputs(size, kBuffers, &inputCfg) < 0) {
+			cerr << "Failed to allocate input buffers" << endl;
+			return TestFail;
+		}
+
+		for (PixelFormat format : { formats::RGB888, formats::NV12 }) {
+			StreamConfiguration cfg;
+			cfg.pixelFormat = format;
+			cfg.size = size;
+			std::tie(cfg.stride, cfg.frameSize) =
+				converter.strideAndFrameSize(cfg.pixelFormat, cfg.size);
+
+			std::vector<std::unique_ptr<FrameBuffer>> outputs;
+			if (converter.configure(inputCfg, { cfg }) < 0 ||
+			    converter.exportBuffers(0, kBuffers, &outputs) != kBuffers ||
+			    converter.start() < 0) {
+				cerr << "Failed to set up converter" << endl;
+				return TestFail;
+			}
+
+			inputsDone_ = outputsDone_ = outputErrors_ = 0;
+
+			auto start = std::chrono::steady_clock::now();
+
+			/* Keep all buffers in flight. */
+			for (unsigned int frame = 0; frame < kFrames; ++frame) {
+				if (frame >= kBuffers)
+					waitForOutputs(frame - kBuffers + 1);
+
+				unsigned int index = frame % kBuffers;
+				int ret = converter.queueBuffers(inputs_[index].get(),
+								 { { 0, outputs[index].get() } });
+				if (ret < 0) {
+					cerr << "Failed to queue buffers" << endl;
+					return TestFail;
+				}
+			}
+
+			waitForOutputs(kFrames);
+
+			auto end = std::chrono::steady_clock::now();
+			converter.stop();
+
+			if (outputErrors_) {
+				cerr << "Conversion failed" << endl;
+				return TestFail;
+			}
+
+			double seconds = std::chrono::duration<double>(end - start).count();
+
+			cout << size << "-" << inputCfg.pixelFormat << " -> "
+			     << cfg.pixelFormat << ": " << kFrames / seconds
+			     << " fps, " << kFrames * size.width * size.height / seconds / 1e6
+			     << " MPix/s" << endl;
+		}
+
+		return TestPass;
+	}
+
+	int run() override
+	{
+		int ret = testFormats();
+		if (ret != TestPass)
+			return ret;
+
+		ret = testConversion();
+		if (ret != TestPass)
+			return ret;
+
+		ret = testStatistics();
+		if (ret != TestPass)
+			return ret;
+
+		ret = benchmark();
+		if (ret != TestPass)
+			return ret;
+
+		return TestPass;
+	}
+
+private:
+	std::shared_ptr<BufferPool> pool_;
+	std::vector<std::unique_ptr<FrameBuffer>> inputs_;
+
+	unsigned int inputsDone_;
+	unsigned int outputsDone_;
+	unsigned int outputErrors_;
+
+	SoftwareConverter::Statistics stats_;
+	unsigned int statsDone_;
+};
+
+} /* namespace */
+
+TEST_REGISTER(SoftwareConverterTest)
@@ -5,6 +5,7 @@
  * utils.cpp - Miscellaneous utility tests
  */
 
+#include <atomic>
 #include <iostream>
 #include <map>
 #include <optional>
@@ -170,6 +171,32 @@ protected:
 		return TestPass;
 	}
 
+	int testParallelFor()
+	{
+		static constexpr unsigned int kCount = 100;
+
+		std::vector<std::atomic<unsigned int>> calls(kCount);
+		utils::parallelFor(kCount, [&](unsigned int i) { calls[i]++; }, 4);
+
+		for (const std::atomic<unsigned int> &count : calls) {
+			if (count != 1) {
+				cerr << "utils::parallelFor() failed to call each index once"
+				     << endl;
+				return TestFail;
+			}
+		}
+
+		/* An empty range must not call the function. */
+		bool called = false;
+		utils::parallelFor(0, [&]([[maybe_unused]] unsigned int i) { called = true; });
+		if (called) {
+			cerr << "utils::parallelFor() called with an empty range" << endl;
+			return TestFail;
+		}
+
+		return TestPass;
+	}
+
 	int run()
 	{
 		/* utils::hex() test. */
@@ -290,6 +317,10 @@ protected:
 		if (testDuration() != TestPass)
 			return TestFail;
 
+		/* utils::parallelFor() test. */
+		if (testParallelFor() != TestPass)
+			return TestFail;
+
 		return TestPass;
 	}
 };
@@ -0,0 +1,281 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Copyright (C) 2022, Google Inc.
+ *
+ * v4l2_control_transaction.cpp - V4L2 control transaction test
+ */
+
+#include <iostream>
+
+#include "libcamera/internal/device_enumerator.h"
+#include "libcamera/internal/media_device.h"
+#include "libcamera/internal/v4l2_control_transaction.h"
+#include "libcamera/internal/v4l2_videodevice.h"
+
+#include "test.h"
+
+using namespace std;
+using namespace libcamera;
+
+class V4L2ControlTransactionTest : public Test
+{
+protected:
+	int init() override
+	{
+		enumerator_ = DeviceEnumerator::create();
+		if (!enumerator_) {
+			cerr << "Failed to create device enumerator" << endl;
+			return TestFail;
+		}
+
+		if (enumerator_->enumerate()) {
+			cerr << "Failed to enumerate media devices" << endl;
+			return TestFail;
+		}
+
+		DeviceMatch dm("vivid");
+		dm.add("vivid-000-vid-cap");
+
+		media_ = enumerator_->search(dm);
+		if (!media_) {
+			cerr << "vivid video device found" << endl;
+			return TestSkip;
+		}
+
+		/*
+		 * Open the video device twice, the transaction handles the two
+		 * instances as different devices.
+		 */
+		dev_ = V4L2VideoDevice::fromEntityName(media_.get(), "vivid-000-vid-cap");
+		dev2_ = V4L2VideoDevice::fromEntityName(media_.get(), "vivid-000-vid-cap");
+		if (dev_->open() || dev2_->open()) {
+			cerr << "Failed to open video device" << endl;
+			return TestFail;
+		}
+
+		const ControlInfoMap &infoMap = dev_->controls();
+
+		/* Make sure the controls we require are present. */
+		if (infoMap.empty()) {
+			cerr << "Failed to enumerate controls" << endl;
+			return TestFail;
+		}
+
+		if (infoMap.find(V4L2_CID_BRIGHTNESS) == infoMap.end() ||
+		    infoMap.find(V4L2_CID_CONTRAST) == infoMap.end() ||
+		    infoMap.find(V4L2_CID_SATURATION) == infoMap.end() ||
+		    infoMap.find(V4L2_CID_HUE) == infoMap.end()) {
+			cerr << "Missing controls" << endl;
+			return TestFail;
+		}
+
+		return TestPass;
+	}
+
+	int checkStatistics(const V4L2ControlTransaction &transaction,
+			    uint64_t commits, uint64_t ioctls, uint64_t controls)
+	{
+		const V4L2ControlTransaction::Statistics &stats =
+			transaction.statistics();
+
+		if (stats.commits != commits || stats.ioctls != ioctls ||
+		    stats.controls != controls) {
+			cerr << "Invalid statistics, expected " << commits << "/"
+			     << ioctls << "/" << controls << ", got "
+			     << stats.commits << "/" << stats.ioctls << "/"
+			     << stats.controls << endl;
+			return TestFail;
+		}
+
+		if (stats.commits && (stats.max < stats.last ||
+				      stats.total < stats.max)) {
+			cerr << "Inconsistent durations" << endl;
+			return TestFail;
+		}
+
+		return TestPass;
+	}
+
+	int checkValues(V4L2VideoDevice *dev,
+			const vector<pair<uint32_t, int32_t>> &values)
+	{
+		vector<uint32_t> ids;
+		for (const auto &[id, value] : values)
+			ids.push_back(id);
+
+		ControlList ctrls = dev->getControls(ids);
+		if (ctrls.empty()) {
+			cerr << "Failed to get controls" << endl;
+			return TestFail;
+		}
+
+		for (const auto &[id, value] : values) {
+			int32_t actual = ctrls.get(id).get<int32_t>();
+			if (actual != value) {
+				cerr << "Control " << utils::hex(id) << " is "
+				     << actual << ", expected " << value << endl;
+				return TestFail;
+			}
+		}
+
+		return TestPass;
+	}
+
+	int run() override
+	{
+		const ControlInfoMap &infoMap = dev_->controls();
+		V4L2ControlTransaction transaction;
+		int ret;
+
+		/* Controls must exist on the device. */
+		if (transaction.addControl(dev_.get(), 0xdeadbeef) != -EINVAL) {
+			cerr << "Unknown control added to the transaction" << endl;
+			return TestFail;
+		}
+
+		/*
+		 * Add a priority control to each device and two regular controls
+		 * to the first device only. Adding a control twice is a no-op.
+		 */
+		if (transaction.addControl(dev_.get(), V4L2_CID_BRIGHTNESS) ||
+		    transaction.addControl(dev_.get(), V4L2_CID_CONTRAST) ||
+		    transaction.addControl(dev_.get(), V4L2_CID_CONTRAST) ||
+		    transaction.addControl(dev_.get(), V4L2_CID_HUE, true) ||
+		    transaction.addControl(dev2_.get(), V4L2_CID_SATURATION, true)) {
+			cerr << "Failed to add controls" << endl;
+			return TestFail;
+		}
+
+		/* Only added controls can be set. */
+		if (transaction.set(dev2_.get(), V4L2_CID_BRIGHTNESS, 0) != -ENOENT) {
+			cerr << "Control set on the wrong device" << endl;
+			return TestFail;
+		}
+
+		if (transaction.pending()) {
+			cerr << "Empty transaction has pending controls" << endl;
+			return TestFail;
+		}
+
+		/* Nothing is written without pending controls. */
+		ret = transaction.commit();
+		if (ret) {
+			cerr << "Failed to commit empty transaction" << endl;
+			return TestFail;
+		}
+
+		ret = checkStatistics(transaction, 0, 0, 0);
+		if (ret != TestPass)
+			return ret;
+
+		/*
+		 * Priority controls are written with one ioctl each, and the
+		 * other controls with one ioctl per device. The last value set
+		 * before the commit is written.
+		 */
+		int32_t brightness = infoMap.at(V4L2_CID_BRIGHTNESS).min().get<int32_t>();
+		int32_t contrast = infoMap.at(V4L2_CID_CONTRAST).max().get<int32_t>();
+		int32_t hue = infoMap.at(V4L2_CID_HUE).min().get<int32_t>();
+		int32_t saturation = infoMap.at(V4L2_CID_SATURATION).max().get<int32_t>();
+
+		transaction.set(dev_.get(), V4L2_CID_BRIGHTNESS, brightness + 1);
+		transaction.set(dev_.get(), V4L2_CID_BRIGHTNESS, brightness);
+		transaction.set(dev_.get(), V4L2_CID_CONTRAST, contrast);
+		transaction.set(dev_.get(), V4L2_CID_HUE, hue);
+		transaction.set(dev2_.get(), V4L2_CID_SATURATION, saturation);
+
+		if (!transaction.pending()) {
+			cerr << "Transaction has no pending controls" << endl;
+			return TestFail;
+		}
+
+		ret = transaction.commit();
+		if (ret) {
+			cerr << "Failed to commit transaction" << endl;
+			return TestFail;
+		}
+
+		ret = checkStatistics(transaction, 1, 3, 4);
+		if (ret != TestPass)
+			return ret;
+
+		ret = checkValues(dev_.get(), { { V4L2_CID_BRIGHTNESS, brightness },
+						{ V4L2_CID_CONTRAST, contrast },
+						{ V4L2_CID_HUE, hue },
+						{ V4L2_CID_SATURATION, saturation } });
+		if (ret != TestPass)
+			return ret;
+
+		/* Pending values are consumed by the commit. */
+		if (transaction.pending()) {
+			cerr << "Pending controls left after commit" << endl;
+			return TestFail;
+		}
+
+		transaction.set(dev_.get(), V4L2_CID_CONTRAST, contrast - 1);
+
+		ret = transaction.commit();
+		if (ret) {
+			cerr << "Failed to commit transaction" << endl;
+			return TestFail;
+		}
+
+		ret = checkStatistics(transaction, 2, 4, 5);
+		if (ret != TestPass)
+			return ret;
+
+		ret = checkValues(dev_.get(), { { V4L2_CID_BRIGHTNESS, brightness },
+						{ V4L2_CID_CONTRAST, contrast - 1 } });
+		if (ret != TestPass)
+			return ret;
+
+		/* Reset discards the pending values but keeps the controls. */
+		transaction.set(dev_.get(), V4L2_CID_CONTRAST, contrast);
+		transaction.reset();
+
+		if (transaction.pending() || transaction.commit()) {
+			cerr << "Pending controls left after reset" << endl;
+			return TestFail;
+		}
+
+		ret = checkStatistics(transaction, 2, 4, 5);
+		if (ret != TestPass)
+			return ret;
+
+		if (transaction.set(dev_.get(), V4L2_CID_CONTRAST, contrast)) {
+			cerr << "Control removed by reset" << endl;
+			return TestFail;
+		}
+
+		transaction.resetStatistics();
+		ret = checkStatistics(transaction, 0, 0, 0);
+		if (ret != TestPass)
+			return ret;
+
+		/* Clear removes all controls. */
+		transaction.clear();
+		if (transaction.pending() ||
+		    transaction.set(dev_.get(), V4L2_CID_CONTRAST, contrast) != -ENOENT) {
+			cerr << "Controls left after clear" << endl;
+			return TestFail;
+		}
+
+		return TestPass;
+	}
+
+	void cleanup() override
+	{
+		if (dev_)
+			dev_->close();
+		if (dev2_)
+			dev2_->close();
+	}
+
+private:
+	std::unique_ptr<DeviceEnumerator> enumerator_;
+	std::shared_ptr<MediaDevice> media_;
+	std::unique_ptr<V4L2VideoDevice> dev_;
+	std::unique_ptr<V4L2VideoDevice> dev2_;
+};
+
+TEST_REGISTER(V4L2ControlTransactionTest)
@@ -0,0 +1,134 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Copyright (C) 2022, Google Inc.
+ *
+ * controls_benchmark.cpp - V4L2 device controls read and write benchmark
+ */
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <functional>
+#include <iostream>
+
+#include "libcamera/internal/v4l2_videodevice.h"
+
+#include "v4l2_videodevice_test.h"
+
+/* These come from the vivid driver. */
+#define VIVID_CID_CUSTOM_BASE		(V4L2_CID_USER_BASE | 0xf000)
+#define VIVID_CID_INTEGER64		(VIVID_CID_CUSTOM_BASE + 3)
+#define VIVID_CID_U8_4D_ARRAY		(VIVID_CID_CUSTOM_BASE + 10)
+
+/* Helper for VIVID_CID_U8_4D_ARRAY control array size: not from kernel. */
+#define VIVID_CID_U8_ARRAY_SIZE		(2 * 3 * 4 * 5)
+
+using namespace std;
+using namespace libcamera;
+
+class V4L2ControlBenchmark : public V4L2VideoDeviceTest
+{
+public:
+	V4L2ControlBenchmark()
+		: V4L2VideoDeviceTest("vivid", "vivid-000-vid-cap")
+	{
+	}
+
+protected:
+	static constexpr unsigned int kIterations = 10000;
+
+	int measure(const char *name, const std::function<int()> &func)
+	{
+		auto start = std::chrono::steady_clock::now();
+
+		for (unsigned int i = 0; i < kIterations; ++i) {
+			if (func()) {
+				cerr << name << " failed at iteration " << i << endl;
+				return TestFail;
+			}
+		}
+
+		auto end = std::chrono::steady_clock::now();
+		double ns = std::chrono::duration<double, std::nano>(end - start).count();
+
+		cout << name << ": " << ns / kIterations << " ns/call" << endl;
+
+		return TestPass;
+	}
+
+	int run()
+	{
+		const ControlInfoMap &infoMap = capture_->controls();
+
+		if (infoMap.find(V4L2_CID_BRIGHTNESS) == infoMap.end() ||
+		    infoMap.find(V4L2_CID_CONTRAST) == infoMap.end() ||
+		    infoMap.find(VIVID_CID_INTEGER64) == infoMap.end() ||
+		    infoMap.find(VIVID_CID_U8_4D_ARRAY) == infoMap.end()) {
+			cerr << "Missing controls" << endl;
+			return TestFail;
+		}
+
+		const ControlInfo &brightness = infoMap.find(V4L2_CID_BRIGHTNESS)->second;
+		const ControlInfo &contrast = infoMap.find(V4L2_CID_CONTRAST)->second;
+		const ControlInfo &u8 = infoMap.find(VIVID_CID_U8_4D_ARRAY)->second;
+
+		/* Scalar controls, as written by pipeline handlers every frame. */
+		ControlList scalars(infoMap);
+		scalars.set(V4L2_CID_BRIGHTNESS, brightness.min());
+		scalars.set(V4L2_CID_CONTRAST, contrast.max());
+		scalars.set(VIVID_CID_INTEGER64, static_cast<int64_t>(0));
+
+		int ret = measure("setControls (3 scalars)",
+				  [&]() { return capture_->setControls(&scalars); });
+		if (ret != TestPass)
+			return ret;
+
+		ret = measure("getControls (3 scalars)", [&]() {
+			ControlList ctrls = capture_->getControls({ V4L2_CID_BRIGHTNESS,
+								    V4L2_CID_CONTRAST,
+								    VIVID_CID_INTEGER64 });
+			return ctrls.empty() ? -1 : 0;
+		});
+		if (ret != TestPass)
+			return ret;
+
+		/* Array control. */
+		std::array<uint8_t, VIVID_CID_U8_ARRAY_SIZE> u8Values;
+		std::fill(u8Values.begin(), u8Values.end(), u8.max().get<uint8_t>());
+
+		ControlList array(infoMap);
+		array.set(VIVID_CID_U8_4D_ARRAY, Span<const uint8_t>(u8Values));
+
+		ret = measure("setControls (u8 array)",
+			      [&]() { return capture_->setControls(&array); });
+		if (ret != TestPass)
+			return ret;
+
+		ret = measure("getControls (u8 array)", [&]() {
+			ControlList ctrls = capture_->getControls({ VIVID_CID_U8_4D_ARRAY });
+			return ctrls.empty() ? -1 : 0;
+		});
+		if (ret != TestPass)
+			return ret;
+
+		/* Verify the values written by the benchmark. */
+		ControlList ctrls = capture_->getControls({ V4L2_CID_BRIGHTNESS,
+							    V4L2_CID_CONTRAST,
+							    VIVID_CID_U8_4D_ARRAY });
+		if (ctrls.get(V4L2_CID_BRIGHTNESS) != brightness.min() ||
+		    ctrls.get(V4L2_CID_CONTRAST) != contrast.max()) {
+			cerr << "Incorrect scalar control values" << endl;
+			return TestFail;
+		}
+
+		Span<const uint8_t> u8Span = ctrls.get(VIVID_CID_U8_4D_ARRAY).get<Span<const uint8_t>>();
+		if (!std::equal(u8Span.begin(), u8Span.end(), u8Values.begin(), u8Values.end())) {
+			cerr << "Incorrect array control values" << endl;
+			return TestFail;
+		}
+
+		return TestPass;
+	}
+};
+
+TEST_REGISTER(V4L2ControlBenchmark)